@@ -0,0 +1,55 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "eapp_utils.h"
+#include "edge_call.h"
+#include <syscall.h>
+
+#define OCALL_NULL 1
+#define OCALL_REPORT 2
+
+#define WARMUP_ROUNDS 100
+#define BENCH_ROUNDS 10000
+
+/* shared with host/host.cpp */
+struct bench_result {
+  unsigned long rounds;
+  unsigned long min;
+  unsigned long max;
+  unsigned long total;
+};
+
+static inline unsigned long read_cycles(void)
+{
+  unsigned long cycles;
+  asm volatile ("rdcycle %0" : "=r" (cycles));
+  return cycles;
+}
+
+/* Times the enclave -> host -> enclave round trip of an ocall that
+ * carries no data and does nothing on the host */
+int main(){
+  struct bench_result res = { BENCH_ROUNDS, -1UL, 0, 0 };
+  unsigned long start, cycles;
+  int i;
+
+  for (i = 0; i < WARMUP_ROUNDS; i++)
+    ocall(OCALL_NULL, NULL, 0, NULL, 0);
+
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    start = read_cycles();
+    ocall(OCALL_NULL, NULL, 0, NULL, 0);
+    cycles = read_cycles() - start;
+
+    if (cycles < res.min)
+      res.min = cycles;
+    if (cycles > res.max)
+      res.max = cycles;
+    res.total += cycles;
+  }
+
+  ocall(OCALL_REPORT, &res, sizeof(res), NULL, 0);
+
+  EAPP_RETURN(0);
+}
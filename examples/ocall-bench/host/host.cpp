@@ -0,0 +1,73 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include <edge_call.h>
+#include <keystone.h>
+
+#define OCALL_NULL 1
+#define OCALL_REPORT 2
+
+/* shared with eapp/ocall_bench.c */
+struct bench_result {
+  unsigned long rounds;
+  unsigned long min;
+  unsigned long max;
+  unsigned long total;
+};
+
+/* the ocall being timed: no arguments, no return value */
+void
+null_wrapper(void* buffer) {
+  struct edge_call* edge_call = (struct edge_call*)buffer;
+  edge_call->return_data.call_status = CALL_STATUS_OK;
+}
+
+void
+report_wrapper(void* buffer) {
+  struct edge_call* edge_call = (struct edge_call*)buffer;
+  struct bench_result* res;
+  uintptr_t call_args;
+  size_t arg_len;
+
+  if (edge_call_args_ptr(edge_call, &call_args, &arg_len) != 0 ||
+      arg_len < sizeof(struct bench_result)) {
+    edge_call->return_data.call_status = CALL_STATUS_BAD_OFFSET;
+    return;
+  }
+
+  res = (struct bench_result*)call_args;
+  printf(
+      "[ocall-bench] null ocall round trip over %lu calls: "
+      "min %lu, avg %lu, max %lu cycles\n",
+      res->rounds, res->min, res->total / res->rounds, res->max);
+
+  edge_call->return_data.call_status = CALL_STATUS_OK;
+}
+
+int
+main(int argc, char** argv) {
+  Keystone::Enclave enclave;
+  Keystone::Params params;
+  unsigned long start, end;
+
+  params.setFreeMemSize(1024 * 1024);
+  params.setUntrustedSize(1024 * 1024);
+
+  enclave.init(argv[1], argv[2], argv[3], params);
+
+  enclave.registerOcallDispatch(incoming_call_dispatch);
+  register_call(OCALL_NULL, null_wrapper);
+  register_call(OCALL_REPORT, report_wrapper);
+
+  edge_call_init_internals(
+      (uintptr_t)enclave.getSharedBuffer(), enclave.getSharedBufferSize());
+
+  asm volatile("rdcycle %0" : "=r"(start));
+  enclave.run();
+  asm volatile("rdcycle %0" : "=r"(end));
+
+  printf("[ocall-bench] enclave run: %lu cycles\n", end - start);
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "app/eapp_utils.h"
+#include "app/syscall.h"
+
+/* Fresh anonymous pages are only backed on first touch. Here, the runtime
+ * is the first to touch both of them, from inside one getrandom, so that
+ * it takes two page faults of its own in the same syscall */
+
+#define PAGE_SIZE 4096
+#define LEN (2 * PAGE_SIZE)
+
+void EAPP_ENTRY eapp_entry(){
+  unsigned long* buf;
+  unsigned long first = 0, second = 0;
+  unsigned long ret;
+  int i;
+
+  buf = (unsigned long*)SYSCALL_6(SYS_mmap, 0, LEN, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED)
+    EAPP_RETURN(1);
+
+  ret = SYSCALL_3(SYS_getrandom, buf, LEN, 0);
+  if (ret != LEN)
+    EAPP_RETURN(2);
+
+  /* random bytes must have landed in both pages */
+  for (i = 0; i < PAGE_SIZE / sizeof(unsigned long); i++) {
+    first |= buf[i];
+    second |= buf[PAGE_SIZE / sizeof(unsigned long) + i];
+  }
+
+  EAPP_RETURN(first && second ? 0 : 3);
+}
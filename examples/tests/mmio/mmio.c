@@ -0,0 +1,38 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "app/eapp_utils.h"
+#include "app/syscall.h"
+
+/* Reads the goldfish RTC of the QEMU virt machine through the device
+ * window the host grants with --device-base 0x101000 --device-size 0x1000 */
+
+#define RTC_TIME_LOW  0x00
+#define RTC_TIME_HIGH 0x04
+
+static unsigned long
+rtc_read(volatile uint8_t* rtc) {
+  /* reading TIME_LOW latches TIME_HIGH */
+  uint32_t low  = *(volatile uint32_t*)(rtc + RTC_TIME_LOW);
+  uint32_t high = *(volatile uint32_t*)(rtc + RTC_TIME_HIGH);
+  return ((unsigned long)high << 32) | low;
+}
+
+void EAPP_ENTRY eapp_entry(){
+  uintptr_t base;
+  size_t size;
+  volatile uint8_t* rtc = spirs_hw_map(&base, &size);
+  unsigned long before, after;
+  int i;
+
+  if (!rtc)
+    EAPP_RETURN(1);
+
+  before = rtc_read(rtc);
+  for (i = 0; i < 100000; i++)
+    asm volatile("nop");
+  after = rtc_read(rtc);
+
+  EAPP_RETURN(after > before ? 0 : 2);
+}
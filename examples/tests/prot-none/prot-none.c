@@ -0,0 +1,66 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "app/eapp_utils.h"
+#include "app/syscall.h"
+
+/* A PROT_NONE mapping of a whole megapage is reserved with a single
+ * demand-zero entry that has no R/W/X bits. It must still be found by
+ * mprotect, which makes it usable, and by munmap, which drops it */
+
+#define MEGAPAGE_SIZE (2 * 1024 * 1024)
+#define WORDS (MEGAPAGE_SIZE / sizeof(unsigned long))
+
+static unsigned long*
+map_none() {
+  return (unsigned long*)SYSCALL_6(SYS_mmap, 0, MEGAPAGE_SIZE, PROT_NONE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+void EAPP_ENTRY eapp_entry(){
+  unsigned long* buf;
+  unsigned long* again;
+
+  buf = map_none();
+  if (buf == MAP_FAILED)
+    EAPP_RETURN(1);
+
+  if (SYSCALL_3(SYS_mprotect, buf, MEGAPAGE_SIZE, PROT_READ | PROT_WRITE))
+    EAPP_RETURN(2);
+
+  /* backed with zeros on first touch */
+  if (buf[0] || buf[WORDS - 1])
+    EAPP_RETURN(3);
+  buf[0]         = 1;
+  buf[WORDS - 1] = 2;
+
+  /* back to PROT_NONE, now over frames */
+  if (SYSCALL_3(SYS_mprotect, buf, MEGAPAGE_SIZE, PROT_NONE))
+    EAPP_RETURN(4);
+
+  if (SYSCALL_2(SYS_munmap, buf, MEGAPAGE_SIZE))
+    EAPP_RETURN(5);
+
+  /* the range is free again, with nothing left of the old mapping */
+  again = map_none();
+  if (again != buf)
+    EAPP_RETURN(6);
+
+  if (SYSCALL_3(SYS_mprotect, again, MEGAPAGE_SIZE, PROT_READ | PROT_WRITE))
+    EAPP_RETURN(7);
+  if (again[0] || again[WORDS - 1])
+    EAPP_RETURN(8);
+
+  /* and a reservation that was never made accessible goes as well */
+  if (SYSCALL_2(SYS_munmap, again, MEGAPAGE_SIZE))
+    EAPP_RETURN(9);
+  again = map_none();
+  if (again != buf || SYSCALL_2(SYS_munmap, again, MEGAPAGE_SIZE))
+    EAPP_RETURN(10);
+
+  EAPP_RETURN(0);
+}
@@ -58,7 +58,8 @@ main(int argc, char** argv) {
   if (argc < 4 || argc > 9) {
     printf(
         "Usage: %s <eapp> <runtime> [--utm-size SIZE(K)] [--freemem-size "
-        "SIZE(K)] [--time] [--load-only] [--utm-ptr 0xPTR] [--retval EXPECTED]\n",
+        "SIZE(K)] [--time] [--load-only] [--utm-ptr 0xPTR] [--retval EXPECTED] "
+        "[--device-base 0xPADDR --device-size 0xSIZE]\n",
         argv[0]);
     return 0;
   }
@@ -70,6 +71,8 @@ main(int argc, char** argv) {
   size_t freemem_size   = 48 * 1024 * 1024;
   bool retval_exist = false;
   unsigned long retval = 0;
+  uintptr_t device_base = 0;
+  size_t device_size    = 0;
 
   static struct option long_options[] = {
       {"time", no_argument, &self_timing, 1},
@@ -77,6 +80,8 @@ main(int argc, char** argv) {
       {"utm-size", required_argument, 0, 'u'},
       {"freemem-size", required_argument, 0, 'f'},
       {"retval", required_argument, 0, 'r'},
+      {"device-base", required_argument, 0, 'b'},
+      {"device-size", required_argument, 0, 's'},
       {0, 0, 0, 0}};
 
   char* eapp_file = argv[1];
@@ -103,6 +108,12 @@ main(int argc, char** argv) {
         retval_exist = true;
         retval = atoi(optarg);
         break;
+      case 'b':
+        device_base = strtoul(optarg, NULL, 0);
+        break;
+      case 's':
+        device_size = strtoul(optarg, NULL, 0);
+        break;
     }
   }
 
@@ -112,6 +123,7 @@ main(int argc, char** argv) {
 
   params.setFreeMemSize(freemem_size);
   params.setUntrustedSize(untrusted_size);
+  params.setDeviceWindow(device_base, device_size);
 
   if (self_timing) {
     asm volatile("rdcycle %0" : "=r"(cycles1));
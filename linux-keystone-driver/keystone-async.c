@@ -0,0 +1,208 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "keystone.h"
+#include "keystone-sbi.h"
+#include "keystone_user.h"
+
+#include <linux/atomic.h>
+#include <linux/eventfd.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/version.h>
+#include <linux/workqueue.h>
+
+/* KEYSTONE_IOC_RUN_ENCLAVE blocks the calling thread for as long as the
+ * enclave runs, and hands every timer interrupt back to it as a resume.
+ * The asynchronous ioctls instead run or resume thread 0 on a worker,
+ * which resumes it on interrupts by itself and returns as soon as the
+ * enclave exits or stops for an edge call or a new thread. The result is
+ * then collected with KEYSTONE_IOC_ENCLAVE_RESULT; until then the device
+ * file polls readable, and the eventfd set with KEYSTONE_IOC_SET_EVENTFD,
+ * if any, is signalled. A host can thus serve many enclaves from one
+ * epoll loop and resumes each explicitly once it has served its call. */
+
+static struct workqueue_struct* async_wq;
+
+static void enclave_async_work(struct work_struct* work)
+{
+  struct enclave_async* async = container_of(work, struct enclave_async, work);
+  struct enclave* enclave = container_of(async, struct enclave, async);
+  bool resume = async->resume;
+  struct sbiret ret;
+
+  do {
+    if (resume)
+      ret = sbi_sm_resume_enclave(enclave->eid);
+    else
+      ret = sbi_sm_run_enclave(enclave->eid);
+    resume = true;
+    cond_resched();
+  } while (ret.error == SBI_ERR_SM_ENCLAVE_INTERRUPTED &&
+           !READ_ONCE(async->stop));
+
+  async->error = ret.error;
+  async->value = ret.value;
+  atomic_set_release(&async->state, ENCLAVE_ASYNC_DONE);
+
+  wake_up_interruptible_poll(&async->wait, EPOLLIN | EPOLLRDNORM);
+  spin_lock(&async->lock);
+  if (async->eventfd) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+    eventfd_signal(async->eventfd);
+#else
+    eventfd_signal(async->eventfd, 1);
+#endif
+  }
+  spin_unlock(&async->lock);
+}
+
+void enclave_async_init(struct enclave* enclave)
+{
+  struct enclave_async* async = &enclave->async;
+
+  INIT_WORK(&async->work, enclave_async_work);
+  init_waitqueue_head(&async->wait);
+  spin_lock_init(&async->lock);
+  atomic_set(&async->state, ENCLAVE_ASYNC_IDLE);
+  async->stop = false;
+  async->eventfd = NULL;
+}
+
+/* Leaves the enclave stopped, so that the SM can destroy it. A run in
+ * progress ends at the next interrupt */
+void enclave_async_stop(struct enclave* enclave)
+{
+  WRITE_ONCE(enclave->async.stop, true);
+  flush_work(&enclave->async.work);
+}
+
+void enclave_async_destroy(struct enclave* enclave)
+{
+  struct enclave_async* async = &enclave->async;
+
+  enclave_async_stop(enclave);
+
+  /* the waitqueue goes away with the enclave; let pollers drop it first */
+  if (waitqueue_active(&async->wait)) {
+    wake_up_pollfree(&async->wait);
+    synchronize_rcu();
+  }
+
+  if (async->eventfd)
+    eventfd_ctx_put(async->eventfd);
+  async->eventfd = NULL;
+}
+
+int keystone_run_enclave_async(unsigned long data, bool resume)
+{
+  struct keystone_ioctl_run_enclave *arg = (struct keystone_ioctl_run_enclave*) data;
+  struct enclave* enclave;
+
+  enclave = get_enclave_by_id(arg->eid);
+  if (!enclave) {
+    keystone_err("invalid enclave id\n");
+    return -EINVAL;
+  }
+
+  if (enclave->eid < 0) {
+    keystone_err("real enclave does not exist\n");
+    return -EINVAL;
+  }
+
+  if (READ_ONCE(enclave->async.stop))
+    return -EINVAL;
+
+  /* one run at a time, and only once the last result has been taken */
+  if (atomic_cmpxchg(&enclave->async.state, ENCLAVE_ASYNC_IDLE,
+                     ENCLAVE_ASYNC_RUNNING) != ENCLAVE_ASYNC_IDLE)
+    return -EBUSY;
+
+  enclave->async.resume = resume;
+  queue_work(async_wq, &enclave->async.work);
+  return 0;
+}
+
+/* -EAGAIN while the enclave is still running */
+int keystone_enclave_result(unsigned long data)
+{
+  struct keystone_ioctl_run_enclave *arg = (struct keystone_ioctl_run_enclave*) data;
+  struct enclave* enclave;
+
+  enclave = get_enclave_by_id(arg->eid);
+  if (!enclave) {
+    keystone_err("invalid enclave id\n");
+    return -EINVAL;
+  }
+
+  switch (atomic_read_acquire(&enclave->async.state)) {
+    case ENCLAVE_ASYNC_RUNNING:
+      return -EAGAIN;
+    case ENCLAVE_ASYNC_IDLE:
+      return -EINVAL;
+  }
+
+  arg->error = enclave->async.error;
+  arg->value = enclave->async.value;
+  atomic_set(&enclave->async.state, ENCLAVE_ASYNC_IDLE);
+  return 0;
+}
+
+int keystone_set_eventfd(unsigned long data)
+{
+  struct keystone_ioctl_eventfd *arg = (struct keystone_ioctl_eventfd*) data;
+  struct eventfd_ctx *ctx = NULL, *old;
+  struct enclave* enclave;
+
+  enclave = get_enclave_by_id(arg->eid);
+  if (!enclave) {
+    keystone_err("invalid enclave id\n");
+    return -EINVAL;
+  }
+
+  if (arg->fd >= 0) {
+    ctx = eventfd_ctx_fdget(arg->fd);
+    if (IS_ERR(ctx))
+      return PTR_ERR(ctx);
+  }
+
+  spin_lock(&enclave->async.lock);
+  old = enclave->async.eventfd;
+  enclave->async.eventfd = ctx;
+  spin_unlock(&enclave->async.lock);
+
+  if (old)
+    eventfd_ctx_put(old);
+  return 0;
+}
+
+__poll_t keystone_poll(struct file* filp, poll_table* wait)
+{
+  struct enclave* enclave;
+
+  enclave = get_enclave_by_id((unsigned long) filp->private_data);
+  if (!enclave)
+    return EPOLLERR;
+
+  poll_wait(filp, &enclave->async.wait, wait);
+  if (atomic_read_acquire(&enclave->async.state) == ENCLAVE_ASYNC_DONE)
+    return EPOLLIN | EPOLLRDNORM;
+  return 0;
+}
+
+int keystone_async_init(void)
+{
+  /* a worker stays busy for the whole time an enclave runs */
+  async_wq = alloc_workqueue("keystone_run", WQ_UNBOUND, 0);
+  if (!async_wq)
+    return -ENOMEM;
+  return 0;
+}
+
+void keystone_async_exit(void)
+{
+  if (async_wq)
+    destroy_workqueue(async_wq);
+  async_wq = NULL;
+}
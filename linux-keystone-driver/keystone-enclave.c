@@ -19,6 +19,8 @@ int destroy_enclave(struct enclave* enclave)
   if (enclave == NULL)
     return -ENOSYS;
 
+  enclave_async_destroy(enclave);
+
   epm = enclave->epm;
   utm = enclave->utm;
 
@@ -49,6 +51,7 @@ struct enclave* create_enclave(unsigned long min_pages)
   enclave->eid = -1;
   enclave->utm = NULL;
   enclave->close_on_pexit = 1;
+  enclave_async_init(enclave);
 
   enclave->epm = kmalloc(sizeof(struct epm), GFP_KERNEL);
   enclave->is_init = true;
@@ -72,6 +72,8 @@ int keystone_finalize_enclave(unsigned long arg)
   create_args.user_paddr = enclp->user_paddr;
   create_args.free_paddr = enclp->free_paddr;
   create_args.free_requested = enclp->free_requested;
+  create_args.device_region.paddr = enclp->device_paddr;
+  create_args.device_region.size = enclp->device_size;
 
   ret = sbi_sm_create_enclave(&create_args);
 
@@ -177,11 +179,19 @@ int __keystone_destroy_enclave(unsigned int ueid)
   }
 
   if (enclave->eid >= 0) {
+    /* the SM only destroys an enclave that is not running */
+    enclave_async_stop(enclave);
     ret = sbi_sm_destroy_enclave(enclave->eid);
     if (ret.error) {
       keystone_err("fatal: cannot destroy enclave: SBI failed with error code %ld\n", ret.error);
       return -EINVAL;
     }
+
+    /* the SM keeps the EPM until it has been scrubbed in the background */
+    if (enclave->epm) {
+      epm_scrub(enclave->epm);
+      enclave->epm = NULL;
+    }
   } else {
     keystone_warn("keystone_destroy_enclave: skipping (enclave does not exist)\n");
   }
@@ -220,6 +230,34 @@ int keystone_resume_enclave(unsigned long data)
   return 0;
 }
 
+/* runs a thread the enclave created (SBI_ERR_SM_ENCLAVE_NEW_THREAD), or
+ * resumes one that stopped. Threads of one enclave run in parallel when
+ * the host makes these calls from several threads */
+int keystone_run_thread(unsigned long data)
+{
+  struct sbiret ret;
+  struct keystone_ioctl_run_thread *arg = (struct keystone_ioctl_run_thread*) data;
+  struct enclave* enclave;
+  enclave = get_enclave_by_id(arg->eid);
+
+  if (!enclave) {
+    keystone_err("invalid enclave id\n");
+    return -EINVAL;
+  }
+
+  if (enclave->eid < 0) {
+    keystone_err("real enclave does not exist\n");
+    return -EINVAL;
+  }
+
+  ret = sbi_sm_run_thread(enclave->eid, arg->tid);
+
+  arg->error = ret.error;
+  arg->value = ret.value;
+
+  return 0;
+}
+
 long keystone_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 {
   long ret;
@@ -252,6 +290,21 @@ long keystone_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
     case KEYSTONE_IOC_RESUME_ENCLAVE:
       ret = keystone_resume_enclave((unsigned long) data);
       break;
+    case KEYSTONE_IOC_RUN_THREAD:
+      ret = keystone_run_thread((unsigned long) data);
+      break;
+    case KEYSTONE_IOC_RUN_ENCLAVE_ASYNC:
+      ret = keystone_run_enclave_async((unsigned long) data, false);
+      break;
+    case KEYSTONE_IOC_RESUME_ENCLAVE_ASYNC:
+      ret = keystone_run_enclave_async((unsigned long) data, true);
+      break;
+    case KEYSTONE_IOC_ENCLAVE_RESULT:
+      ret = keystone_enclave_result((unsigned long) data);
+      break;
+    case KEYSTONE_IOC_SET_EVENTFD:
+      ret = keystone_set_eventfd((unsigned long) data);
+      break;
     /* Note that following commands could have been implemented as a part of ADD_PAGE ioctl.
      * However, there was a weird bug in compiler that generates a wrong control flow
      * that ends up with an illegal instruction if we combine switch-case and if statements.
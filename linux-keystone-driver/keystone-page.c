@@ -15,19 +15,24 @@ int epm_destroy(struct epm* epm) {
     return 0;
 
   /* free the EPM hold by the enclave */
-  if (epm->is_cma) {
+  if (epm->in_pool) {
+    epm_pool_free(epm->pa, epm->size >> PAGE_SHIFT, epm->scrubbed);
+  } else if (epm->is_cma) {
     dma_free_coherent(keystone_dev.this_device,
         epm->size,
         (void*) epm->ptr,
         epm->pa);
   } else {
-    free_pages(epm->ptr, epm->order);
+    free_pages_exact((void*) epm->ptr, epm->size);
   }
 
   return 0;
 }
 
-/* Create an EPM and initialize the free list */
+/* Create an EPM and initialize the free list. The EPM is exactly min_pages
+ * long: the buddy allocator takes back the tail of the power-of-two block
+ * it has to start from, and the SM covers a range that is not a naturally
+ * aligned power of two with a TOR region. */
 int epm_init(struct epm* epm, unsigned int min_pages)
 {
   vaddr_t epm_vaddr = 0;
@@ -35,24 +40,29 @@ int epm_init(struct epm* epm, unsigned int min_pages)
   unsigned long count = min_pages;
   phys_addr_t device_phys_addr = 0;
 
-  /* try to allocate contiguous memory */
   epm->is_cma = 0;
-  order = ilog2(min_pages - 1) + 1;
-  count = 0x1 << order;
+  epm->scrubbed = 0;
+
+  /* the reserved pool comes first, and hands out zeroed pages */
+  epm_vaddr = epm_pool_alloc(count, &device_phys_addr);
+  epm->in_pool = !!epm_vaddr;
+
+  /* try to allocate contiguous memory */
+  order = get_order(count << PAGE_SHIFT);
 
   /* prevent kernel from complaining about an invalid argument */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
-  if (order < MAX_PAGE_ORDER)
+  if (!epm_vaddr && order < MAX_PAGE_ORDER)
 #else
-  if (order < MAX_ORDER)
+  if (!epm_vaddr && order < MAX_ORDER)
 #endif
-    epm_vaddr = (vaddr_t) __get_free_pages(GFP_HIGHUSER, order);
+    epm_vaddr = (vaddr_t) alloc_pages_exact(count << PAGE_SHIFT,
+                                            GFP_HIGHUSER);
 
 #ifdef CONFIG_CMA
   /* If buddy allocator fails, we fall back to the CMA */
   if (!epm_vaddr) {
     epm->is_cma = 1;
-    count = min_pages;
 
     epm_vaddr = (vaddr_t) dma_alloc_coherent(keystone_dev.this_device,
       count << PAGE_SHIFT,
@@ -70,11 +80,11 @@ int epm_init(struct epm* epm, unsigned int min_pages)
   }
 
   /* zero out */
-  memset((void*)epm_vaddr, 0, PAGE_SIZE*count);
+  if (!epm->in_pool)
+    memset((void*)epm_vaddr, 0, PAGE_SIZE*count);
 
   epm->root_page_table = (void*)epm_vaddr;
-  epm->pa = (epm->is_cma) ? device_phys_addr : __pa(epm_vaddr);
-  epm->order = order;
+  epm->pa = (epm->is_cma || epm->in_pool) ? device_phys_addr : __pa(epm_vaddr);
   epm->size = count << PAGE_SHIFT;
   epm->ptr = epm_vaddr;
 
@@ -103,7 +113,8 @@ int utm_init(struct utm* utm, size_t untrusted_size)
 
   /* Currently, UTM does not utilize CMA.
    * It is always allocated from the buddy allocator */
-  utm->ptr = (void*) __get_free_pages(GFP_HIGHUSER, order);
+  /* handed out zeroed; the SM no longer clears the UTM itself */
+  utm->ptr = (void*) __get_free_pages(GFP_HIGHUSER | __GFP_ZERO, order);
   if (!utm->ptr) {
     keystone_err("failed to allocate UTM (size = %i bytes)\n",(1<<order));
     return -ENOMEM;
@@ -0,0 +1,129 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "keystone.h"
+#include "keystone-sbi.h"
+#include "sm_err.h"
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <asm/smp.h>
+
+/* The SM counts its SBI calls and context switches per hart (see
+ * sm_perf.h). debugfs keystone/sm_perf shows them per hart, with
+ * histograms; the sm_perf attribute of the device sums them over all
+ * online harts. Both read the counters afresh on every open. */
+
+static const char* const sm_perf_names[SM_PERF_COUNTERS] = SM_PERF_COUNTER_NAMES;
+
+struct dentry* keystone_debugfs_dir;
+
+static int sm_perf_read(int cpu, struct sm_perf_stats* stats)
+{
+  struct sbiret ret = sbi_sm_get_perf_stats(cpuid_to_hartid_map(cpu), stats);
+
+  if (ret.error == SBI_ERR_SM_NOT_IMPLEMENTED)
+    return -EOPNOTSUPP;
+  if (ret.error)
+    return -EIO;
+  return 0;
+}
+
+static int sm_perf_show(struct seq_file* m, void* v)
+{
+  struct sm_perf_stats* stats;
+  struct sm_perf_counter_stats* c;
+  int cpu, i, b, ret = 0;
+
+  stats = kmalloc(sizeof(*stats), GFP_KERNEL);
+  if (!stats)
+    return -ENOMEM;
+
+  seq_printf(m, "# hart counter count cycles max_cycles avg_cycles"
+      " hist(<2^%d, then x2 per bucket)\n", SM_PERF_HIST_SHIFT + 1);
+
+  for_each_online_cpu(cpu) {
+    ret = sm_perf_read(cpu, stats);
+    if (ret)
+      break;
+
+    for (i = 0; i < SM_PERF_COUNTERS; i++) {
+      c = &stats->counters[i];
+      if (!c->count)
+        continue;
+      seq_printf(m, "%lu %s %llu %llu %llu %llu",
+          cpuid_to_hartid_map(cpu), sm_perf_names[i], c->count, c->cycles,
+          c->max_cycles, div64_u64(c->cycles, c->count));
+      for (b = 0; b < SM_PERF_HIST_BUCKETS; b++)
+        seq_printf(m, " %llu", c->hist[b]);
+      seq_putc(m, '\n');
+    }
+  }
+
+  kfree(stats);
+  return ret;
+}
+DEFINE_SHOW_ATTRIBUTE(sm_perf);
+
+static ssize_t sm_perf_attr_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  struct sm_perf_stats* stats;
+  u64 count[SM_PERF_COUNTERS] = {0}, cycles[SM_PERF_COUNTERS] = {0};
+  u64 max[SM_PERF_COUNTERS] = {0};
+  struct sm_perf_counter_stats* c;
+  int cpu, i, ret = 0;
+  ssize_t len = 0;
+
+  stats = kmalloc(sizeof(*stats), GFP_KERNEL);
+  if (!stats)
+    return -ENOMEM;
+
+  for_each_online_cpu(cpu) {
+    ret = sm_perf_read(cpu, stats);
+    if (ret)
+      break;
+    for (i = 0; i < SM_PERF_COUNTERS; i++) {
+      c = &stats->counters[i];
+      count[i] += c->count;
+      cycles[i] += c->cycles;
+      max[i] = max(max[i], c->max_cycles);
+    }
+  }
+  kfree(stats);
+  if (ret)
+    return ret;
+
+  /* counter count cycles max_cycles */
+  for (i = 0; i < SM_PERF_COUNTERS; i++)
+    len += scnprintf(buf + len, PAGE_SIZE - len, "%s %llu %llu %llu\n",
+        sm_perf_names[i], count[i], cycles[i], max[i]);
+  return len;
+}
+static struct device_attribute dev_attr_sm_perf =
+  __ATTR(sm_perf, 0444, sm_perf_attr_show, NULL);
+
+static struct attribute* keystone_perf_attrs[] = {
+  &dev_attr_sm_perf.attr,
+  NULL,
+};
+
+const struct attribute_group keystone_perf_group = {
+  .attrs = keystone_perf_attrs,
+};
+
+/* debugfs is optional, so failing to set it up is not an error */
+void keystone_perf_init(void)
+{
+  keystone_debugfs_dir = debugfs_create_dir("keystone", NULL);
+  debugfs_create_file("sm_perf", 0444, keystone_debugfs_dir, NULL, &sm_perf_fops);
+}
+
+void keystone_perf_exit(void)
+{
+  debugfs_remove_recursive(keystone_debugfs_dir);
+  keystone_debugfs_dir = NULL;
+}
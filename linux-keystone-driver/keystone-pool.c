@@ -0,0 +1,289 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "keystone.h"
+
+#include <linux/bitmap.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+
+/* A contiguous carve-out, set aside when the module loads, that EPMs are
+ * allocated from page by page before the driver turns to the buddy
+ * allocator and the CMA. It does not fragment with the rest of the kernel,
+ * and it remembers which of its free pages are already zero: those of an
+ * EPM the SM has scrubbed on destroy, and the whole pool at first. Only
+ * the others are cleared when an EPM is handed out again. */
+
+static unsigned long epm_pool_size;
+module_param(epm_pool_size, ulong, 0444);
+MODULE_PARM_DESC(epm_pool_size,
+    "Bytes of contiguous memory to set aside for EPMs at load time (0: none)");
+
+static bool epm_pool_selftest;
+module_param(epm_pool_selftest, bool, 0444);
+MODULE_PARM_DESC(epm_pool_selftest,
+    "Check the alignment of EPMs from the pool when the module loads");
+
+static struct {
+  vaddr_t va;
+  paddr_t pa;
+  unsigned long pages;
+  unsigned long* used;
+  unsigned long* dirty;  /* free pages that are not known to be zero */
+  unsigned long used_pages;
+  unsigned long dirty_pages;
+} pool;
+
+static DEFINE_MUTEX(pool_lock);
+
+/* statistics, exposed through sysfs */
+static atomic64_t pool_hits = ATOMIC64_INIT(0);
+static atomic64_t pool_misses = ATOMIC64_INIT(0);
+static atomic64_t pool_zeroed_bytes = ATOMIC64_INIT(0);
+static atomic64_t pool_reused_clean_bytes = ATOMIC64_INIT(0);
+
+/* An EPM starts on a boundary of its own order, up to a megapage, as it
+ * would from the buddy allocator or the CMA. The runtime maps the EPM at a
+ * megapage-aligned address and relies on blocks from its own buddy
+ * allocator, which are aligned by physical address, being aligned in
+ * virtual memory as well. */
+static unsigned int epm_pool_align_order(unsigned long count)
+{
+  return min_t(unsigned int, get_order(count << PAGE_SHIFT),
+      PMD_SHIFT - PAGE_SHIFT);
+}
+
+static unsigned long epm_pool_align_mask(unsigned long count)
+{
+  return (1UL << epm_pool_align_order(count)) - 1;
+}
+
+/* Takes count zeroed pages out of the pool. Returns their address, or 0 if
+ * there is no pool or no run of free pages long enough */
+vaddr_t epm_pool_alloc(unsigned long count, paddr_t* pa)
+{
+  unsigned long mask = epm_pool_align_mask(count);
+  unsigned long first, i, dirty = 0;
+
+  if (!pool.pages)
+    return 0;
+
+  mutex_lock(&pool_lock);
+  first = bitmap_find_next_zero_area_off(pool.used, pool.pages, 0, count,
+      mask, (pool.pa >> PAGE_SHIFT) & mask);
+  if (first >= pool.pages) {
+    mutex_unlock(&pool_lock);
+    atomic64_inc(&pool_misses);
+    return 0;
+  }
+  bitmap_set(pool.used, first, count);
+  pool.used_pages += count;
+  mutex_unlock(&pool_lock);
+
+  /* the dirty bits of pages in use only change when they are freed */
+  i = first;
+  for_each_set_bit_from(i, pool.dirty, first + count) {
+    memset((void*) (pool.va + (i << PAGE_SHIFT)), 0, PAGE_SIZE);
+    dirty++;
+  }
+
+  mutex_lock(&pool_lock);
+  bitmap_clear(pool.dirty, first, count);
+  pool.dirty_pages -= dirty;
+  mutex_unlock(&pool_lock);
+
+  atomic64_inc(&pool_hits);
+  atomic64_add(dirty << PAGE_SHIFT, &pool_zeroed_bytes);
+  atomic64_add((count - dirty) << PAGE_SHIFT, &pool_reused_clean_bytes);
+
+  *pa = pool.pa + (first << PAGE_SHIFT);
+  return pool.va + (first << PAGE_SHIFT);
+}
+
+/* Gives pages back; scrubbed if the SM has cleared them */
+void epm_pool_free(paddr_t pa, unsigned long count, bool scrubbed)
+{
+  unsigned long first = (pa - pool.pa) >> PAGE_SHIFT;
+
+  mutex_lock(&pool_lock);
+  if (!scrubbed) {
+    bitmap_set(pool.dirty, first, count);
+    pool.dirty_pages += count;
+  }
+  bitmap_clear(pool.used, first, count);
+  pool.used_pages -= count;
+  mutex_unlock(&pool_lock);
+}
+
+static ssize_t epm_pool_total_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lu\n", pool.pages << PAGE_SHIFT);
+}
+static DEVICE_ATTR_RO(epm_pool_total_bytes);
+
+static ssize_t epm_pool_used_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lu\n", READ_ONCE(pool.used_pages) << PAGE_SHIFT);
+}
+static DEVICE_ATTR_RO(epm_pool_used_bytes);
+
+/* free, but to be cleared before the next EPM gets them */
+static ssize_t epm_pool_dirty_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lu\n", READ_ONCE(pool.dirty_pages) << PAGE_SHIFT);
+}
+static DEVICE_ATTR_RO(epm_pool_dirty_bytes);
+
+/* fragmentation: the number of free runs and the longest of them */
+static ssize_t epm_pool_free_extents_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  unsigned long start, end = 0, extents = 0, largest = 0;
+
+  mutex_lock(&pool_lock);
+  while ((start = find_next_zero_bit(pool.used, pool.pages, end)) < pool.pages) {
+    end = find_next_bit(pool.used, pool.pages, start);
+    largest = max(largest, end - start);
+    extents++;
+  }
+  mutex_unlock(&pool_lock);
+
+  return sprintf(buf, "%lu %lu\n", extents, largest << PAGE_SHIFT);
+}
+static DEVICE_ATTR_RO(epm_pool_free_extents);
+
+static ssize_t epm_pool_hits_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lld\n", atomic64_read(&pool_hits));
+}
+static DEVICE_ATTR_RO(epm_pool_hits);
+
+static ssize_t epm_pool_misses_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lld\n", atomic64_read(&pool_misses));
+}
+static DEVICE_ATTR_RO(epm_pool_misses);
+
+static ssize_t epm_pool_zeroed_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lld\n", atomic64_read(&pool_zeroed_bytes));
+}
+static DEVICE_ATTR_RO(epm_pool_zeroed_bytes);
+
+/* handed out without clearing, as the SM had scrubbed them */
+static ssize_t epm_pool_reused_clean_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lld\n", atomic64_read(&pool_reused_clean_bytes));
+}
+static DEVICE_ATTR_RO(epm_pool_reused_clean_bytes);
+
+static struct attribute* keystone_pool_attrs[] = {
+  &dev_attr_epm_pool_total_bytes.attr,
+  &dev_attr_epm_pool_used_bytes.attr,
+  &dev_attr_epm_pool_dirty_bytes.attr,
+  &dev_attr_epm_pool_free_extents.attr,
+  &dev_attr_epm_pool_hits.attr,
+  &dev_attr_epm_pool_misses.attr,
+  &dev_attr_epm_pool_zeroed_bytes.attr,
+  &dev_attr_epm_pool_reused_clean_bytes.attr,
+  NULL,
+};
+
+const struct attribute_group keystone_pool_group = {
+  .attrs = keystone_pool_attrs,
+};
+
+/* Allocates EPMs of a few sizes behind a one-page EPM that throws the
+ * pool off its alignment, and checks where each of them starts */
+static int epm_pool_check_alignment(void)
+{
+  static const unsigned long counts[] = { 1, 2, 3, 4, 5, 17, 512, 513, 1000 };
+  unsigned long i, mask;
+  paddr_t pad_pa, pa;
+  int ret = 0;
+
+  if (!epm_pool_alloc(1, &pad_pa))
+    return -ENOMEM;
+
+  for (i = 0; i < ARRAY_SIZE(counts) && !ret; i++) {
+    if (!epm_pool_alloc(counts[i], &pa))
+      continue;
+
+    mask = (PAGE_SIZE << epm_pool_align_order(counts[i])) - 1;
+    if (pa & mask) {
+      keystone_err("EPM of %lu page(s) from the pool at misaligned 0x%llx\n",
+          counts[i], (unsigned long long) pa);
+      ret = -EINVAL;
+    }
+    /* never written to, so still zero */
+    epm_pool_free(pa, counts[i], true);
+  }
+  epm_pool_free(pad_pa, 1, true);
+
+  atomic64_set(&pool_hits, 0);
+  atomic64_set(&pool_misses, 0);
+  atomic64_set(&pool_zeroed_bytes, 0);
+  atomic64_set(&pool_reused_clean_bytes, 0);
+  return ret;
+}
+
+/* after misc_register: the carve-out comes from the CMA of the device */
+int epm_pool_init(void)
+{
+  unsigned long pages = epm_pool_size >> PAGE_SHIFT;
+
+  if (!pages)
+    return 0;
+
+  pool.used = bitmap_zalloc(pages, GFP_KERNEL);
+  pool.dirty = bitmap_zalloc(pages, GFP_KERNEL);
+  if (pool.used && pool.dirty)
+    pool.va = (vaddr_t) dma_alloc_coherent(keystone_dev.this_device,
+        pages << PAGE_SHIFT, &pool.pa, GFP_KERNEL);
+
+  if (!pool.va) {
+    keystone_err("cannot set aside an EPM pool of %lu page(s)\n", pages);
+    bitmap_free(pool.used);
+    bitmap_free(pool.dirty);
+    return -ENOMEM;
+  }
+
+  /* handed out zeroed */
+  pool.pages = pages;
+  keystone_info("EPM pool of %lu page(s) at 0x%llx\n", pages,
+      (unsigned long long) pool.pa);
+
+  if (epm_pool_selftest && epm_pool_check_alignment()) {
+    epm_pool_exit();
+    return -EINVAL;
+  }
+  return 0;
+}
+
+/* after every EPM has been freed */
+void epm_pool_exit(void)
+{
+  if (!pool.pages)
+    return;
+
+  if (pool.used_pages)
+    keystone_warn("EPM pool still has %lu page(s) in use, leaking it\n",
+        pool.used_pages);
+  else
+    dma_free_coherent(keystone_dev.this_device, pool.pages << PAGE_SHIFT,
+        (void*) pool.va, pool.pa);
+
+  bitmap_free(pool.used);
+  bitmap_free(pool.dirty);
+  pool.pages = 0;
+}
@@ -18,8 +18,33 @@ struct sbiret sbi_sm_destroy_enclave(unsigned long eid) {
       eid, 0, 0, 0, 0, 0);
 }
 
+struct sbiret sbi_sm_scrub_enclave_memory(unsigned long epm_paddr) {
+  return sbi_ecall(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
+      SBI_SM_SCRUB_ENCLAVE_MEMORY,
+      epm_paddr, 0, 0, 0, 0, 0);
+}
+
 struct sbiret sbi_sm_resume_enclave(unsigned long eid) {
   return sbi_ecall(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
       SBI_SM_RESUME_ENCLAVE,
       eid, 0, 0, 0, 0, 0);
 }
+
+struct sbiret sbi_sm_run_thread(unsigned long eid, unsigned long tid) {
+  return sbi_ecall(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
+      SBI_SM_RUN_THREAD,
+      eid, tid, 0, 0, 0, 0);
+}
+
+struct sbiret sbi_sm_get_perf_stats(unsigned long hart, struct sm_perf_stats* stats) {
+  return sbi_ecall(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
+      SBI_SM_GET_PERF_STATS,
+      hart, (unsigned long) stats, 0, 0, 0, 0);
+}
+
+struct sbiret sbi_sm_drain_trace(unsigned long hart, struct sm_trace_record* recs,
+    unsigned long max) {
+  return sbi_ecall(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
+      SBI_SM_DRAIN_TRACE,
+      hart, (unsigned long) recs, max, 0, 0, 0);
+}
@@ -7,12 +7,19 @@
 
 #include "keystone_user.h"
 #include "sm_call.h"
+#include "sm_perf.h"
+#include "sm_trace.h"
 
 #include <asm/sbi.h>
 
 struct sbiret sbi_sm_create_enclave(struct keystone_sbi_create_t* args);
 struct sbiret sbi_sm_destroy_enclave(unsigned long eid);
+struct sbiret sbi_sm_scrub_enclave_memory(unsigned long epm_paddr);
 struct sbiret sbi_sm_run_enclave(unsigned long eid);
 struct sbiret sbi_sm_resume_enclave(unsigned long eid);
+struct sbiret sbi_sm_run_thread(unsigned long eid, unsigned long tid);
+struct sbiret sbi_sm_get_perf_stats(unsigned long hart, struct sm_perf_stats* stats);
+struct sbiret sbi_sm_drain_trace(unsigned long hart, struct sm_trace_record* recs,
+    unsigned long max);
 
 #endif
@@ -0,0 +1,187 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "keystone.h"
+#include "keystone-sbi.h"
+
+#include <linux/atomic.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+
+/* The SM does not clear the EPM of a destroyed enclave in the destroy
+ * call. It keeps the memory locked down and clears it one bounded chunk
+ * per SBI_SM_SCRUB_ENCLAVE_MEMORY call instead, releasing it after the
+ * last chunk. Here, scrubbers on an unbound workqueue make those calls in
+ * the background, several of them in parallel for a large EPM, and the
+ * last one to finish gives the pages back to the kernel. */
+
+static unsigned int scrub_max_workers;
+module_param(scrub_max_workers, uint, 0644);
+MODULE_PARM_DESC(scrub_max_workers,
+    "CPUs that may scrub one destroyed EPM in parallel (0: all online CPUs)");
+
+/* chunk size of the SM, only used to decide how many scrubbers to start */
+#define SCRUB_CHUNK_SIZE (1 << 20)
+
+struct epm_scrub;
+
+struct epm_scrubber {
+  struct work_struct work;
+  struct epm_scrub* scrub;
+};
+
+struct epm_scrub {
+  struct epm* epm;
+  atomic_t running;
+  atomic_t failed;
+  struct epm_scrubber workers[];
+};
+
+static struct workqueue_struct* scrub_wq;
+
+/* statistics, exposed through sysfs */
+static atomic64_t scrub_pending_bytes = ATOMIC64_INIT(0);
+static atomic64_t scrub_cleared_bytes = ATOMIC64_INIT(0);
+static atomic64_t scrub_busy_ns = ATOMIC64_INIT(0);
+
+/* have the SM clear chunks of the EPM until none are left to hand out */
+static int __epm_scrub(struct epm* epm)
+{
+  struct sbiret ret;
+  ktime_t start;
+
+  do {
+    start = ktime_get();
+    ret = sbi_sm_scrub_enclave_memory(epm->pa);
+    atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)), &scrub_busy_ns);
+
+    if (ret.error) {
+      keystone_err("scrubbing EPM at 0x%lx failed with error code %ld\n",
+          (unsigned long) epm->pa, ret.error);
+      return -EINVAL;
+    }
+
+    atomic64_add(ret.value, &scrub_cleared_bytes);
+    atomic64_sub(ret.value, &scrub_pending_bytes);
+    cond_resched();
+  } while (ret.value);
+
+  return 0;
+}
+
+static void epm_scrub_work(struct work_struct* work)
+{
+  struct epm_scrubber* worker = container_of(work, struct epm_scrubber, work);
+  struct epm_scrub* scrub = worker->scrub;
+
+  if (__epm_scrub(scrub->epm))
+    atomic_set(&scrub->failed, 1);
+
+  if (!atomic_dec_and_test(&scrub->running))
+    return;
+
+  /* on failure the SM still holds the memory, so it must not be reused */
+  if (!atomic_read(&scrub->failed)) {
+    scrub->epm->scrubbed = true;
+    epm_destroy(scrub->epm);
+  }
+  kfree(scrub->epm);
+  kfree(scrub);
+}
+
+/* Takes over an EPM the SM has just destroyed, and frees it once the SM
+ * has cleared it */
+void epm_scrub(struct epm* epm)
+{
+  struct epm_scrub* scrub;
+  unsigned int n, i;
+
+  atomic64_add(epm->size, &scrub_pending_bytes);
+
+  n = scrub_max_workers ? scrub_max_workers : num_online_cpus();
+  n = min_t(unsigned long, n, DIV_ROUND_UP(epm->size, SCRUB_CHUNK_SIZE));
+  n = max(n, 1U);
+
+  scrub = kzalloc(struct_size(scrub, workers, n), GFP_KERNEL);
+  if (!scrub || !scrub_wq) {
+    /* fall back to scrubbing in the caller rather than leaking the EPM */
+    kfree(scrub);
+    if (!__epm_scrub(epm)) {
+      epm->scrubbed = true;
+      epm_destroy(epm);
+    }
+    kfree(epm);
+    return;
+  }
+
+  scrub->epm = epm;
+  atomic_set(&scrub->running, n);
+  for (i = 0; i < n; i++) {
+    scrub->workers[i].scrub = scrub;
+    INIT_WORK(&scrub->workers[i].work, epm_scrub_work);
+    queue_work(scrub_wq, &scrub->workers[i].work);
+  }
+}
+
+static ssize_t scrub_pending_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lld\n", atomic64_read(&scrub_pending_bytes));
+}
+static DEVICE_ATTR_RO(scrub_pending_bytes);
+
+static ssize_t scrub_cleared_bytes_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  return sprintf(buf, "%lld\n", atomic64_read(&scrub_cleared_bytes));
+}
+static DEVICE_ATTR_RO(scrub_cleared_bytes);
+
+/* MB/s over the time spent in scrub calls, summed over all scrubbers */
+static ssize_t scrub_throughput_show(struct device* dev,
+    struct device_attribute* attr, char* buf)
+{
+  s64 ns = atomic64_read(&scrub_busy_ns);
+  s64 bytes = atomic64_read(&scrub_cleared_bytes);
+
+  return sprintf(buf, "%lld\n", ns ? div64_s64(bytes * 1000, ns) : 0);
+}
+static DEVICE_ATTR_RO(scrub_throughput);
+
+static struct attribute* keystone_scrub_attrs[] = {
+  &dev_attr_scrub_pending_bytes.attr,
+  &dev_attr_scrub_cleared_bytes.attr,
+  &dev_attr_scrub_throughput.attr,
+  NULL,
+};
+
+static const struct attribute_group keystone_scrub_group = {
+  .attrs = keystone_scrub_attrs,
+};
+
+const struct attribute_group* keystone_attr_groups[] = {
+  &keystone_scrub_group,
+  &keystone_perf_group,
+  &keystone_pool_group,
+  NULL,
+};
+
+int keystone_scrub_init(void)
+{
+  scrub_wq = alloc_workqueue("keystone_scrub", WQ_UNBOUND, 0);
+  if (!scrub_wq)
+    return -ENOMEM;
+  return 0;
+}
+
+void keystone_scrub_exit(void)
+{
+  /* waits for every queued EPM to be cleared and freed */
+  if (scrub_wq)
+    destroy_workqueue(scrub_wq);
+  scrub_wq = NULL;
+}
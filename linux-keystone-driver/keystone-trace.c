@@ -0,0 +1,131 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "keystone.h"
+#include "keystone-sbi.h"
+#include "sm_err.h"
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <asm/smp.h>
+
+/* The SM logs into a ring per hart (see sm_trace.h). Opening debugfs
+ * keystone/sm_trace drains the rings of all online harts, which removes
+ * those records from the SM, and reading it shows them as text, one line
+ * per record with its continuations. */
+
+/* records kept by one open, the rest stay in the SM for the next one */
+#define TRACE_MAX_RECORDS 4096
+#define TRACE_CHUNK (PAGE_SIZE / sizeof(struct sm_trace_record))
+
+static const char* const sm_trace_events[SM_TRACE_EVENTS] = SM_TRACE_EVENT_NAMES;
+static const char* const sm_trace_levels[] = SM_LOG_LEVEL_NAMES;
+
+struct trace_snapshot {
+  size_t count;
+  unsigned long hart[TRACE_MAX_RECORDS];
+  struct sm_trace_record recs[TRACE_MAX_RECORDS];
+};
+
+static int sm_trace_drain(struct trace_snapshot* snap)
+{
+  struct sbiret ret;
+  unsigned long hart, max, i;
+  int cpu;
+
+  for_each_online_cpu(cpu) {
+    hart = cpuid_to_hartid_map(cpu);
+    do {
+      max = min_t(size_t, TRACE_CHUNK, TRACE_MAX_RECORDS - snap->count);
+      if (!max)
+        return 0;
+
+      ret = sbi_sm_drain_trace(hart, &snap->recs[snap->count], max);
+      if (ret.error == SBI_ERR_SM_NOT_IMPLEMENTED)
+        return -EOPNOTSUPP;
+      if (ret.error)
+        return -EIO;
+
+      for (i = 0; i < ret.value; i++)
+        snap->hart[snap->count++] = hart;
+    } while (ret.value == max);
+  }
+  return 0;
+}
+
+static int sm_trace_show(struct seq_file* m, void* v)
+{
+  struct trace_snapshot* snap = m->private;
+  struct sm_trace_record* r;
+  bool more = false;
+  size_t i;
+  int len, b;
+
+  seq_puts(m, "# hart seq mtime level event data\n");
+
+  for (i = 0; i < snap->count; i++) {
+    r = &snap->recs[i];
+    len = min_t(int, r->len & SM_TRACE_LEN_MASK, SM_TRACE_DATA_SIZE);
+
+    /* a continuation of another hart's record means that one was lost */
+    if (more && snap->hart[i] != snap->hart[i - 1])
+      seq_puts(m, " (truncated)\n");
+    if (!more || snap->hart[i] != snap->hart[i - 1])
+      seq_printf(m, "%lu %u %llu %s %s ", snap->hart[i], r->seq, r->time,
+          r->level < ARRAY_SIZE(sm_trace_levels) ? sm_trace_levels[r->level] : "?",
+          r->event < SM_TRACE_EVENTS ? sm_trace_events[r->event] : "?");
+
+    if (r->event == SM_TRACE_MSG)
+      seq_printf(m, "%.*s", len, r->data);
+    else
+      for (b = 0; b < len; b++)
+        seq_printf(m, "%02x", r->data[b]);
+
+    more = r->len & SM_TRACE_MORE;
+    if (!more)
+      seq_putc(m, '\n');
+  }
+  if (more)
+    seq_puts(m, " (truncated)\n");
+  return 0;
+}
+
+static int sm_trace_open(struct inode* inode, struct file* file)
+{
+  struct trace_snapshot* snap;
+  int ret;
+
+  snap = kvzalloc(sizeof(*snap), GFP_KERNEL);
+  if (!snap)
+    return -ENOMEM;
+
+  ret = sm_trace_drain(snap);
+  if (!ret)
+    ret = single_open(file, sm_trace_show, snap);
+  if (ret)
+    kvfree(snap);
+  return ret;
+}
+
+static int sm_trace_release(struct inode* inode, struct file* file)
+{
+  kvfree(((struct seq_file*) file->private_data)->private);
+  return single_release(inode, file);
+}
+
+static const struct file_operations sm_trace_fops = {
+  .owner = THIS_MODULE,
+  .open = sm_trace_open,
+  .read = seq_read,
+  .llseek = seq_lseek,
+  .release = sm_trace_release,
+};
+
+/* under the debugfs directory of keystone_perf_init */
+void keystone_trace_init(void)
+{
+  debugfs_create_file("sm_trace", 0400, keystone_debugfs_dir, NULL, &sm_trace_fops);
+}
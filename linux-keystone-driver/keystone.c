@@ -25,6 +25,7 @@ MODULE_LICENSE("Dual BSD/GPL");
 static const struct file_operations keystone_fops = {
     .owner          = THIS_MODULE,
     .mmap           = keystone_mmap,
+    .poll           = keystone_poll,
     .unlocked_ioctl = keystone_ioctl,
     .release        = keystone_release
 };
@@ -33,6 +34,7 @@ struct miscdevice keystone_dev = {
   .minor = MISC_DYNAMIC_MINOR,
   .name = "keystone_enclave",
   .fops = &keystone_fops,
+  .groups = keystone_attr_groups,
   .mode = 0666,
 };
 
@@ -79,15 +81,50 @@ static int __init keystone_dev_init(void)
 {
   int  ret;
 
+  ret = keystone_scrub_init();
+  if (ret < 0)
+  {
+    pr_err("keystone_enclave: cannot create the scrub workqueue\n");
+    return ret;
+  }
+
+  ret = keystone_async_init();
+  if (ret < 0)
+  {
+    pr_err("keystone_enclave: cannot create the run workqueue\n");
+    keystone_scrub_exit();
+    return ret;
+  }
 
   ret = misc_register(&keystone_dev);
   if (ret < 0)
   {
     pr_err("keystone_enclave: misc_register() failed\n");
+    keystone_async_exit();
+    keystone_scrub_exit();
+    return ret;
   }
 
   keystone_dev.this_device->coherent_dma_mask = DMA_BIT_MASK(32);
 
+  /* enclaves still get their EPM elsewhere without the pool, but one that
+   * hands out misaligned EPMs must not be used */
+  ret = epm_pool_init();
+  if (ret == -EINVAL)
+  {
+    pr_err("keystone_enclave: EPM pool self-test failed\n");
+    misc_deregister(&keystone_dev);
+    keystone_async_exit();
+    keystone_scrub_exit();
+    return ret;
+  }
+  if (ret)
+    pr_warn("keystone_enclave: running without an EPM pool\n");
+  ret = 0;
+
+  keystone_perf_init();
+  keystone_trace_init();
+
   pr_info("keystone_enclave: " DRV_DESCRIPTION " v" DRV_VERSION "\n");
   return ret;
 }
@@ -95,6 +132,11 @@ static int __init keystone_dev_init(void)
 static void __exit keystone_dev_exit(void)
 {
   pr_info("keystone_enclave: keystone_dev_exit()\n");
+  keystone_perf_exit();
+  keystone_async_exit();
+  /* EPMs being scrubbed go back to the pool, which needs the device */
+  keystone_scrub_exit();
+  epm_pool_exit();
   misc_deregister(&keystone_dev);
   return;
 }
@@ -16,6 +16,9 @@
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/idr.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include <linux/file.h>
 
@@ -32,15 +35,17 @@ extern struct miscdevice keystone_dev;
 long keystone_ioctl(struct file* filep, unsigned int cmd, unsigned long arg);
 int keystone_release(struct inode *inode, struct file *file);
 int keystone_mmap(struct file *filp, struct vm_area_struct *vma);
+__poll_t keystone_poll(struct file *filp, poll_table *wait);
 
 /* enclave private memory */
 struct epm {
   pte_t* root_page_table;
   vaddr_t ptr;
   size_t size;
-  unsigned long order;
   paddr_t pa;
   bool is_cma;
+  bool in_pool;
+  bool scrubbed;  /* cleared by the SM before it gave the EPM back */
 };
 
 struct utm {
@@ -50,6 +55,25 @@ struct utm {
   unsigned long order;
 };
 
+/* runs of the enclave made by a worker on behalf of the host, see
+ * keystone-async.c */
+enum enclave_async_state {
+  ENCLAVE_ASYNC_IDLE = 0,
+  ENCLAVE_ASYNC_RUNNING,
+  ENCLAVE_ASYNC_DONE,   /* stopped, result not yet collected */
+};
+
+struct enclave_async {
+  struct work_struct work;
+  wait_queue_head_t wait;
+  atomic_t state;
+  bool resume;
+  bool stop;
+  unsigned long error;
+  unsigned long value;
+  spinlock_t lock;      /* guards eventfd */
+  struct eventfd_ctx* eventfd;
+};
 
 struct enclave
 {
@@ -58,6 +82,7 @@ struct enclave
   struct utm* utm;
   struct epm* epm;
   bool is_init;
+  struct enclave_async async;
 };
 
 
@@ -85,11 +110,38 @@ static inline uintptr_t  epm_satp(struct epm* epm) {
 }
 
 int epm_destroy(struct epm* epm);
+void epm_scrub(struct epm* epm);
 int epm_init(struct epm* epm, unsigned int count);
 int utm_destroy(struct utm* utm);
 int utm_init(struct utm* utm, size_t untrusted_size);
 paddr_t epm_va_to_pa(struct epm* epm, vaddr_t addr);
 
+int epm_pool_init(void);
+void epm_pool_exit(void);
+vaddr_t epm_pool_alloc(unsigned long count, paddr_t* pa);
+void epm_pool_free(paddr_t pa, unsigned long count, bool scrubbed);
+extern const struct attribute_group keystone_pool_group;
+
+int keystone_scrub_init(void);
+void keystone_scrub_exit(void);
+extern const struct attribute_group* keystone_attr_groups[];
+
+void keystone_perf_init(void);
+void keystone_perf_exit(void);
+extern const struct attribute_group keystone_perf_group;
+extern struct dentry* keystone_debugfs_dir;
+
+void keystone_trace_init(void);
+
+int keystone_async_init(void);
+void keystone_async_exit(void);
+void enclave_async_init(struct enclave* enclave);
+void enclave_async_stop(struct enclave* enclave);
+void enclave_async_destroy(struct enclave* enclave);
+int keystone_run_enclave_async(unsigned long data, bool resume);
+int keystone_enclave_result(unsigned long data);
+int keystone_set_eventfd(unsigned long data);
+
 #define keystone_info(fmt, ...) \
   pr_info("keystone_enclave: " fmt, ##__VA_ARGS__)
 #define keystone_err(fmt, ...) \
@@ -20,8 +20,6 @@
     mmap
 */
 
-#define MAX_STRACE_PRINT 20
-
 uintptr_t io_syscall_sync(){
   struct edge_syscall* edge_syscall = (struct edge_syscall*)edge_call_data_ptr();
 
@@ -30,7 +28,6 @@ uintptr_t io_syscall_sync(){
   size_t totalsize = (sizeof(struct edge_syscall));
 
   uintptr_t ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
-  print_strace("[runtime] proxied sync\r\n");
   return ret;
 }
 
@@ -46,7 +43,6 @@ uintptr_t io_syscall_ftruncate(int fd, off_t offset){
                       sizeof(sargs_SYS_ftruncate));
 
   uintptr_t ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
-  print_strace("[runtime] proxied ftruncate (%i) = %li\r\n", fd, ret);
   return ret;
 }
 uintptr_t io_syscall_fsync(int fd){
@@ -60,7 +56,6 @@ uintptr_t io_syscall_fsync(int fd){
                       sizeof(sargs_SYS_fsync));
 
   uintptr_t ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
-  print_strace("[runtime] proxied fsync (%i) = %li\r\n", fd, ret);
   return ret;
 }
 
@@ -77,8 +72,6 @@ uintptr_t io_syscall_lseek(int fd, off_t offset, int whence){
                       sizeof(sargs_SYS_lseek));
 
   uintptr_t ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
-  print_strace("[runtime] proxied lseek (on fd:%i to %li from %i) = %li\r\n",
-               fd, offset, whence, ret);
   return ret;
 }
 
@@ -93,7 +86,6 @@ uintptr_t io_syscall_close(int fd){
                       sizeof(sargs_SYS_close));
 
   uintptr_t ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
-  print_strace("[runtime] proxied close (%i) = %li\r\n", fd, ret);
   return ret;
 }
 
@@ -124,20 +116,10 @@ uintptr_t io_syscall_read(int fd, void* buf, size_t len){
   copy_to_user(buf, args->buf, ret > len? len: ret);
 
  done:
-  print_strace("[runtime] proxied read from %i (size: %lu) = %li\r\n",fd, len, ret);
   return ret;
 }
 
 uintptr_t io_syscall_write(int fd, void* buf, size_t len){
-  /* print_strace("[write] len :%lu\r\n", len); */
-  /* if(len > 0){ */
-  /*   size_t stracelen = len > MAX_STRACE_PRINT? MAX_STRACE_PRINT:len; */
-  /*   char* lbuf[MAX_STRACE_PRINT+1]; */
-  /*   memset(lbuf, 0, sizeof(lbuf)); */
-  /*   copy_from_user(lbuf, (void*)buf, stracelen); */
-  /*   print_strace("[write] \"%s\"\r\n", (char*)lbuf); */
-  /* } */
-
   struct edge_syscall* edge_syscall = (struct edge_syscall*)edge_call_data_ptr();
   sargs_SYS_write* args = (sargs_SYS_write*)edge_syscall->data;
   uintptr_t ret = -1;
@@ -160,7 +142,6 @@ uintptr_t io_syscall_write(int fd, void* buf, size_t len){
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
  done:
-  print_strace("[runtime] proxied write to %i (size: %lu) = %li\r\n",fd, len, ret);
   return ret;
 }
 
@@ -192,8 +173,6 @@ uintptr_t io_syscall_openat(int dirfd, char* path,
 
  done:
   // TODO path print here isn't necessarily correct or even copied!
-  print_strace("[runtime] proxied openat(path: %.*s) = %li\r\n",
-               pathlen>MAX_STRACE_PRINT?MAX_STRACE_PRINT:pathlen,args->path, ret);
 
   return ret;
 }
@@ -224,8 +203,6 @@ uintptr_t io_syscall_unlinkat(int dirfd, char* path,
 
  done:
   // TODO path print here isn't necessarily correct or even copied!
-  print_strace("[runtime] proxied unlinkat(path: %.*s) = %li\r\n",
-               pathlen>MAX_STRACE_PRINT?MAX_STRACE_PRINT:pathlen,args->path, ret);
   return ret;
 }
 
@@ -233,7 +210,6 @@ uintptr_t io_syscall_writev(int fd, const struct iovec *iov, int iovcnt){
   int i=0;
   uintptr_t ret = 0;
   size_t total = 0;
-  print_strace("[runtime] Simulating writev (cnt %i) with write calls\r\n",iovcnt);
   for(i=0; i<iovcnt && ret >= 0;i++){
     struct iovec iov_local;
     copy_from_user(&iov_local, &(iov[i]), sizeof(struct iovec));
@@ -241,7 +217,6 @@ uintptr_t io_syscall_writev(int fd, const struct iovec *iov, int iovcnt){
     total += ret;
   }
   ret = total;
-  print_strace("[runtime] Simulated writev = %li\r\n",ret);
   return ret;
 }
 
@@ -249,7 +224,6 @@ uintptr_t io_syscall_readv(int fd, const struct iovec *iov, int iovcnt){
   int i=0;
   uintptr_t ret = 0;
   size_t total = 0;
-  print_strace("[runtime] Simulating readv (cnt %i) with read calls\r\n",iovcnt);
   for(i=0; i<iovcnt && ret >= 0;i++){
     struct iovec iov_local;
     copy_from_user(&iov_local, &(iov[i]), sizeof(struct iovec));
@@ -258,7 +232,6 @@ uintptr_t io_syscall_readv(int fd, const struct iovec *iov, int iovcnt){
   }
 
   ret = total;
-  print_strace("[runtime] Simulated readv = %li\r\n",ret);
   return ret;
 }
 
@@ -291,8 +264,6 @@ uintptr_t io_syscall_fstatat(int dirfd, char *pathname, struct stat *statbuf,
   }
 
  done:
-  print_strace("[runtime] proxied fstatat (path %.*s) = %li\r\n",
-               pathlen>MAX_STRACE_PRINT?MAX_STRACE_PRINT:pathlen,args->pathname, ret);
   return ret;
 
 }
@@ -313,7 +284,6 @@ uintptr_t io_syscall_pipe(int *fds){
     copy_to_user(fds, args, 2 * sizeof(int));
   }
 
-  print_strace("[runtime] proxied pipe \r\n");
   return ret;
 }
 
@@ -331,7 +301,6 @@ uintptr_t io_syscall_epoll_create(int size){
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_epoll_create1);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied epoll_create: %d \r\n", ret);
   return ret; 
 }
 
@@ -351,7 +320,6 @@ uintptr_t io_syscall_epoll_ctl(int epfd, int op, int fd, uintptr_t event){
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_epoll_ctl);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied epoll_create: %d \r\n", ret);
   return ret; 
 }
 
@@ -366,9 +334,8 @@ uintptr_t io_syscall_fcntl(int fd, int cmd, uintptr_t arg){
 
   size_t totalsize;
   if (cmd == F_SETLK || cmd == F_SETLKW || cmd == F_GETLK) {
-    print_strace("F_SETLK, FSETLKW, or FGETLK");
     if(edge_call_check_ptr_valid((uintptr_t)args->arg, sizeof(struct flock)) != 0){
-      print_strace("Ptr not valid");
+      debug("fcntl lock struct not valid");
       goto done;
     }
     copy_from_user((struct flock *) args->arg, (struct flock *) arg, sizeof(struct flock));
@@ -389,7 +356,6 @@ uintptr_t io_syscall_fcntl(int fd, int cmd, uintptr_t arg){
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
  done: 
-  print_strace("[runtime] proxied fcntl = %li\r\n", ret);
   return ret;
 }
 
@@ -408,7 +374,6 @@ uintptr_t io_syscall_getcwd(char* buf, size_t size){
   dispatch_edgecall_syscall(edge_syscall, totalsize);
 
   copy_to_user(buf, &args->buf, size);
-  print_strace("[runtime] proxied getcwd\r\n");
   return (uintptr_t) buf;
 }
 
@@ -427,7 +392,6 @@ uintptr_t io_syscall_chdir(char* path) {
   size_t totalsize = (sizeof(struct edge_syscall)) + strlen(args->path) + 1;
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied chdir: %s\r\n", args->path);
   return ret;
 }
 
@@ -449,7 +413,6 @@ uintptr_t io_syscall_epoll_pwait(int epfd, uintptr_t events, int maxevents, int
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
   copy_to_user((void *) events, &args->events, sizeof(struct epoll_event));
-  print_strace("[runtime] proxied epoll_pwait: epfd: %d, ret: %d\r\n", args->epfd, ret);
   return ret;
 }
 
@@ -470,7 +433,6 @@ uintptr_t io_syscall_renameat2(int olddirfd,  uintptr_t oldpath, int newdirfd, u
   size_t totalsize = (sizeof(struct edge_syscall)) + sizeof(sargs_SYS_renameat2);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied renameat2: oldpath: %s, newpath: %s, ret: %d\r\n", args->oldpath, args->newpath, ret);
   return ret;
 }
 
@@ -485,7 +447,6 @@ uintptr_t io_syscall_umask(int mask){
   size_t totalsize = (sizeof(struct edge_syscall)) + sizeof(sargs_SYS_umask);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied umask: mask: %d, ret: %d\r\n", args->mask, ret);
   return ret;
 }
   
@@ -506,7 +467,6 @@ uintptr_t io_syscall_fstat(int fd, struct stat *statbuf){
     copy_to_user(statbuf, &args->stats, sizeof(struct stat));
   }
 
-  print_strace("[runtime] proxied fstat = %li\r\n", ret);
   return ret;
 
 }
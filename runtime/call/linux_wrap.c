@@ -10,6 +10,8 @@
 
 #include "mm/freemem.h"
 #include "mm/mm.h"
+#include "mm/vaspace.h"
+#include "sys/thread.h"
 #include "util/rt_util.h"
 #include "call/syscall.h"
 #include "uaccess.h"
@@ -18,7 +20,6 @@
 
 //TODO we should check which clock this is
 uintptr_t linux_clock_gettime(__clockid_t clock, struct timespec *tp){
-  print_strace("[runtime] clock_gettime not fully supported (clock %x, assuming)\r\n", clock);
   unsigned long cycles;
   __asm__ __volatile__("rdcycle %0" : "=r"(cycles));
 
@@ -32,36 +33,33 @@ uintptr_t linux_clock_gettime(__clockid_t clock, struct timespec *tp){
 }
 
 uintptr_t linux_set_tid_address(int* tidptr_t){
-  //Ignore for now
-  print_strace("[runtime] set_tid_address, not setting address (%p), IGNORING\r\n",tidptr_t);
-  return 1;
+  rt_set_clear_tid(tidptr_t);
+  return rt_gettid();
 }
 
 uintptr_t linux_rt_sigprocmask(int how, const sigset_t *set, sigset_t *oldset){
-  print_strace("[runtime] rt_sigprocmask not supported (how %x), IGNORING\r\n", how);
+  debug("rt_sigprocmask not supported (how %x), ignoring", how);
   return 0;
 }
 
 uintptr_t linux_RET_ZERO_wrap(unsigned long which){
-  print_strace("[runtime] Cannot handle syscall %lu, IGNORING = 0\r\n", which);
+  debug("cannot handle syscall %lu, ignoring", which);
   return 0;
 }
 
 uintptr_t linux_RET_BAD_wrap(unsigned long which){
-  print_strace("[runtime] Cannot handle syscall %lu, FAILING = -1\r\n", which);
+  debug("cannot handle syscall %lu, failing", which);
   return -1;
 }
 
 uintptr_t linux_getpid(){
   uintptr_t fakepid = 2;
-  print_strace("[runtime] Faking getpid with %lx\r\n",fakepid);
   return fakepid;
 }
 
 uintptr_t linux_getrandom(void *buf, size_t buflen, unsigned int flags){
 
   uintptr_t ret = rt_util_getrandom(buf, buflen);
-  print_strace("[runtime] getrandom IGNORES FLAGS (size %lx), PLATFORM DEPENDENT IF SAFE = ret %lu\r\n", buflen, ret);
   return ret;
 }
 
@@ -95,16 +93,17 @@ uintptr_t linux_uname(void* buf){
 
 
  uname_done:
-  print_strace("[runtime] uname = %x\n",ret);
   return ret;
 }
 
 uintptr_t syscall_munmap(void *addr, size_t length){
   uintptr_t ret = (uintptr_t)((void*)-1);
+  size_t pages = vpn(PAGE_UP(length));
 
-  free_pages(vpn((uintptr_t)addr), length/RISCV_PAGE_SIZE);
+  free_pages(vpn((uintptr_t)addr), pages);
+  // free_pages has shot down the TLBs before giving the frames back
+  vaspace_release(vpn((uintptr_t)addr), pages);
   ret = 0;
-  tlb_flush();
   return ret;
 }
 
@@ -137,35 +136,39 @@ uintptr_t syscall_mmap(void *addr, size_t length, int prot, int flags,
     goto done;
   }
 
-  // Start looking at EYRIE_ANON_REGION_START for VA space
-  uintptr_t starting_vpn = vpn(EYRIE_ANON_REGION_START);
-  uintptr_t valid_pages;
-  while((starting_vpn + req_pages) <= EYRIE_ANON_REGION_END){
-    valid_pages = test_va_range(starting_vpn, req_pages);
-
-    if(req_pages == valid_pages){
-      // Set a successful value if we allocate
-      // TODO free partial allocation on failure
-      if(alloc_pages(starting_vpn, req_pages, pte_flags) == req_pages){
-        ret = starting_vpn << RISCV_PAGE_BITS;
-      }
-      break;
-    }
-    else
-      starting_vpn += valid_pages + 1;
+  // Take the lowest free VA range in the anonymous region. Large
+  // mappings are megapage-aligned so that they can use megapages
+  uintptr_t starting_vpn = 0;
+  if(req_pages >= RISCV_MEGAPAGE_PAGES){
+    starting_vpn = vaspace_alloc_aligned(req_pages, RISCV_MEGAPAGE_ORDER);
+  }
+  if(!starting_vpn){
+    starting_vpn = vaspace_alloc(req_pages);
+  }
+  if(!starting_vpn){
+    goto done;
+  }
+
+  // Frames are only put in place (zeroed) when a page is first touched
+  if(alloc_pages_lazy(starting_vpn, req_pages, pte_flags) == req_pages){
+    ret = starting_vpn << RISCV_PAGE_BITS;
+  }
+  else{
+    // Undo the partial allocation
+    free_pages(starting_vpn, req_pages);
+    vaspace_release(starting_vpn, req_pages);
   }
 
  done:
   tlb_flush();
-  print_strace("[runtime] [mmap]: addr: 0x%p, length %lu, prot 0x%x, flags 0x%x, fd %i, offset %lu (%li pages %x) = 0x%p\r\n", addr, length, prot, flags, fd, offset, req_pages, pte_flags, ret);
 
   // If we get here everything went wrong
   return ret;
 }
 
 uintptr_t syscall_mprotect(void *addr, size_t len, int prot) {
-  int i, ret;
   size_t pages = len / RISCV_PAGE_SIZE;
+  uintptr_t ret;
 
   int pte_flags = PTE_U | PTE_A;
   if(prot & PROT_READ)
@@ -175,13 +178,15 @@ uintptr_t syscall_mprotect(void *addr, size_t len, int prot) {
   if(prot & PROT_EXEC)
     pte_flags |= PTE_X;
 
-  for(i = 0; i < pages; i++) {
-    ret = realloc_page(vpn((uintptr_t) addr) + i, pte_flags);
-    if(!ret)
-      return -1;
-  }
+  // Refuse up front rather than fail halfway through the range
+  if(!vaspace_is_mapped(vpn((uintptr_t) addr), pages))
+    return -1;
 
-  return 0;
+  ret = realloc_pages(vpn((uintptr_t) addr), pages, pte_flags) != pages ? -1 : 0;
+
+  // Permissions taken away must not linger in the TLBs of other threads
+  tlb_shootdown();
+  return ret;
 }
 
 uintptr_t syscall_brk(void* addr){
@@ -214,12 +219,18 @@ uintptr_t syscall_brk(void* addr){
     goto done;
   }
 
-  // Allocate pages
-  // TODO free pages on failure
-  if( alloc_pages(vpn(current_break),
+  // The heap may not grow into an existing mapping
+  if( vaspace_reserve(vpn(current_break), req_page_count) != 0){
+    goto done;
+  }
+
+  // Map the pages; they are backed on first touch
+  if( alloc_pages_lazy(vpn(current_break),
                   req_page_count,
                   PTE_W | PTE_R | PTE_D | PTE_U | PTE_A)
       != req_page_count){
+    free_pages(vpn(current_break), req_page_count);
+    vaspace_release(vpn(current_break), req_page_count);
     goto done;
   }
 
@@ -230,7 +241,6 @@ uintptr_t syscall_brk(void* addr){
 
  done:
   tlb_flush();
-  print_strace("[runtime] brk (0x%p) (req pages %i) = 0x%p\r\n",req_break, req_page_count, ret);
   return ret;
 
 }
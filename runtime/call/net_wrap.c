@@ -27,7 +27,6 @@ uintptr_t io_syscall_socket(int domain, int type, int protocol){
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_socket);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied socket: %d \r\n", ret);
   return ret; 
 }
 
@@ -57,7 +56,6 @@ uintptr_t io_syscall_setsockopt(int socket, int level, int option_name, const vo
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
   done:
-    print_strace("[runtime] proxied setsockopt: %d \r\n", ret);
     return ret; 
 
 }
@@ -81,7 +79,6 @@ uintptr_t io_syscall_connect(int sockfd, uintptr_t addr, socklen_t addrlen){
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_connect);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied connect: %d \r\n", ret);
   return ret;
 }
 
@@ -105,7 +102,6 @@ uintptr_t io_syscall_bind (int sockfd, uintptr_t addr, socklen_t addrlen){
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_bind);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied bind: %d \r\n", ret);
   return ret; 
 
 }
@@ -123,7 +119,6 @@ uintptr_t io_syscall_listen(int sockfd, int backlog){
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_listen);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied listen: %d \r\n", ret);
   return ret; 
 
 }
@@ -147,7 +142,6 @@ uintptr_t io_syscall_accept(int sockfd, uintptr_t addr, uintptr_t addrlen) {
   size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_accept);
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied accept: %d \r\n", ret);
   return ret; 
 }
 
@@ -193,7 +187,6 @@ uintptr_t io_syscall_recvfrom(int sockfd, uintptr_t buf, size_t len, int flags,
 	}
 
 	done: 
-		print_strace("[runtime] proxied recvfrom: %d \r\n", ret);
 		return ret; 
 }
 
@@ -230,13 +223,11 @@ uintptr_t io_syscall_sendto(int sockfd, uintptr_t buf, size_t len, int flags,
     	goto done;
   	}	
 	copy_from_user(&args->buf, (void *) buf, len);
-	print_strace("[runtime] sendto buf: %s \r\n", &args->buf);
 
 	size_t totalsize = sizeof(struct edge_syscall) + sizeof(sargs_SYS_sendto) + len;
 	ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
 	done: 
-		print_strace("[runtime] proxied sendto: %d \r\n", ret);
 		return ret; 
 }
 
@@ -269,7 +260,6 @@ uintptr_t io_syscall_sendfile(int out_fd, int in_fd, uintptr_t offset, int count
 	copy_to_user((void *) offset, &args->offset, sizeof(off_t)); 
 
 	done: 
-		print_strace("[runtime] proxied sendfile: %d \r\n", ret);
 		return ret; 
 }
 
@@ -292,7 +282,6 @@ uintptr_t io_syscall_getpeername(int sockfd, uintptr_t addr,
 	copy_to_user((void *) addr, &args->addr, args->addrlen > *(socklen_t*)addrlen ? *(socklen_t*)addrlen : args->addrlen); 
 	copy_to_user((void *) addrlen, &args->addrlen, sizeof(socklen_t)); 
 
-  print_strace("[runtime] proxied getpeername: fd: %d, ret: %d\r\n", args->sockfd, ret);
   return ret;
 }
 
@@ -314,7 +303,6 @@ uintptr_t io_syscall_getsockname(int sockfd, uintptr_t addr,
   copy_to_user((void *) addr, &args->addr, args->addrlen > *(socklen_t*)addrlen ? *(socklen_t*)addrlen : args->addrlen);
   copy_to_user((void *) addrlen, &args->addrlen, sizeof(socklen_t));
 
-  print_strace("[runtime] proxied getsockname: fd: %d, ret: %d\r\n", args->sockfd, ret);
   return ret;
 }
 
@@ -327,7 +315,6 @@ uintptr_t io_syscall_getuid() {
   size_t totalsize = (sizeof(struct edge_syscall));
   ret = dispatch_edgecall_syscall(edge_syscall, totalsize);
 
-  print_strace("[runtime] proxied getuid, ret: %d\r\n", ret);
   return ret;
 }
 
@@ -384,7 +371,6 @@ uintptr_t io_syscall_pselect(int nfds, uintptr_t readfds, uintptr_t writefds,
           copy_to_user((void *) exceptfds, &args->exceptfds, sizeof(fd_set));
   }
 
-  print_strace("[runtime] proxied pselect: nfds: %d, ret: %d\r\n", args->nfds, ret);
   return ret;
 }
 
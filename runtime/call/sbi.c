@@ -47,6 +47,13 @@ sbi_set_timer(uint64_t stime_value) {
 #endif
 }
 
+/* sfence.vma of the whole address space on every hart; returns once all
+ * of them have done it */
+void
+sbi_remote_sfence_vma_all(void) {
+  SBI_CALL_4(SBI_EXT_RFENCE, SBI_RFENCE_SFENCE_VMA, 0, -1UL, 0, -1UL);
+}
+
 uintptr_t
 sbi_stop_enclave(uint64_t request) {
   return SBI_CALL_1(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_STOP_ENCLAVE, request);
@@ -57,6 +64,11 @@ sbi_exit_enclave(uint64_t retval) {
   SBI_CALL_1(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_EXIT_ENCLAVE, retval);
 }
 
+uintptr_t
+sbi_create_thread(uintptr_t tid, uintptr_t entry, uintptr_t arg) {
+  return SBI_CALL_3(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_CREATE_THREAD, tid, entry, arg);
+}
+
 uintptr_t
 sbi_random() {
   SBI_CALL_0(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_RANDOM);
@@ -76,11 +88,28 @@ sbi_query_multimem_addr(uintptr_t *addr) {
       SBI_SM_CALL_PLUGIN, SM_MULTIMEM_PLUGIN_ID, SM_MULTIMEM_CALL_GET_ADDR, addr);
 }
 
+uintptr_t
+sbi_query_device(size_t *size) {
+  return SBI_CALL_3(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
+      SBI_SM_CALL_PLUGIN, SM_MULTIMEM_PLUGIN_ID, SM_MULTIMEM_CALL_GET_DEVICE_SIZE, size);
+}
+
+uintptr_t
+sbi_query_device_addr(uintptr_t *addr) {
+  return SBI_CALL_3(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE,
+      SBI_SM_CALL_PLUGIN, SM_MULTIMEM_PLUGIN_ID, SM_MULTIMEM_CALL_GET_DEVICE_ADDR, addr);
+}
+
 uintptr_t
 sbi_attest_enclave(void* report, void* buf, uintptr_t len) {
   return SBI_CALL_3(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_ATTEST_ENCLAVE, report, buf, len);
 }
 
+uintptr_t
+sbi_attest_enclave_batch(void* report, void* proofs, void* buf, void* sizes, uintptr_t count) {
+  return SBI_CALL_5(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_ATTEST_BATCH, report, proofs, buf, sizes, count);
+}
+
 uintptr_t
 sbi_get_sealing_key(uintptr_t key_struct, uintptr_t key_ident, uintptr_t len) {
   return SBI_CALL_3(SBI_EXT_EXPERIMENTAL_KEYSTONE_ENCLAVE, SBI_SM_GET_SEALING_KEY, key_struct, key_ident, len);
@@ -0,0 +1,91 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "call/strace.h"
+
+#include "eyrie_utm.h"
+#include "sys/thread.h"
+#include "sys/timex.h"
+#include "util/string.h"
+
+/* One record per syscall, written when it returns, into the trace area
+ * the host reserved in the UTM. Each thread has a syscall of its own in
+ * flight; the cycles it spends stopped for edge calls are counted apart,
+ * so that the host can tell the time of the runtime from its own. */
+
+static struct eyrie_strace_header* strace;
+static struct eyrie_strace_record* strace_records;
+static uint64_t strace_capacity;
+static uint64_t strace_taken;
+
+static struct eyrie_strace_record strace_calls[RT_MAX_THREADS];
+static int strace_active[RT_MAX_THREADS];
+
+void
+strace_init(uintptr_t area, size_t size) {
+  if (size < sizeof(struct eyrie_strace_header) +
+                 sizeof(struct eyrie_strace_record))
+    return;
+
+  strace          = (struct eyrie_strace_header*)area;
+  strace_records  = (struct eyrie_strace_record*)(strace + 1);
+  strace_capacity = (size - sizeof(*strace)) /
+                    sizeof(struct eyrie_strace_record);
+
+  strace->capacity = strace_capacity;
+  strace->taken    = 0;
+}
+
+void
+strace_enter(struct encl_ctx* ctx) {
+  int tid = rt_thread_current()->tid;
+  struct eyrie_strace_record* rec = &strace_calls[tid];
+
+  if (!strace)
+    return;
+
+  rec->nr          = ctx->regs.a7;
+  rec->args[0]     = ctx->regs.a0;
+  rec->args[1]     = ctx->regs.a1;
+  rec->args[2]     = ctx->regs.a2;
+  rec->args[3]     = ctx->regs.a3;
+  rec->args[4]     = ctx->regs.a4;
+  rec->args[5]     = ctx->regs.a5;
+  rec->host_cycles = 0;
+  rec->tid         = tid;
+  rec->reserved    = 0;
+  strace_active[tid] = 1;
+  rec->start       = get_cycles64();
+}
+
+void
+strace_exit(uintptr_t ret) {
+  uint64_t end = get_cycles64();
+  int tid      = rt_thread_current()->tid;
+  struct eyrie_strace_record* rec = &strace_calls[tid];
+  uint64_t n;
+
+  if (!strace_active[tid])
+    return;
+  strace_active[tid] = 0;
+
+  rec->ret    = ret;
+  rec->cycles = end - rec->start;
+
+  n = __atomic_fetch_add(&strace_taken, 1, __ATOMIC_RELAXED);
+  memcpy(&strace_records[n % strace_capacity], rec, sizeof(*rec));
+  __atomic_fetch_add(&strace->taken, 1, __ATOMIC_RELEASE);
+}
+
+/* hands the hart to the host for an edge call of the current syscall */
+uintptr_t
+strace_stop_enclave(uint64_t request) {
+  int tid         = rt_thread_current()->tid;
+  uint64_t start  = get_cycles64();
+  uintptr_t ret   = sbi_stop_enclave(request);
+
+  if (strace_active[tid])
+    strace_calls[tid].host_cycles += get_cycles64() - start;
+  return ret;
+}
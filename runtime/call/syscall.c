@@ -6,11 +6,15 @@
 #include <stddef.h>
 #include <sys/select.h>
 #include "call/syscall.h"
+#include "call/strace.h"
 #include "util/string.h"
 #include "edge_call.h"
 #include "uaccess.h"
+#include "mm/device.h"
 #include "mm/mm.h"
 #include "util/rt_util.h"
+#include "sys/thread.h"
+#include "attest_batch.h"
 
 #include "call/syscall_nums.h"
 
@@ -43,7 +47,7 @@ uintptr_t dispatch_edgecall_syscall(struct edge_syscall* syscall_data_ptr, size_
     return -1;
   }
 
-  ret = sbi_stop_enclave(STOP_EDGE_CALL_HOST);
+  ret = strace_stop_enclave(STOP_EDGE_CALL_HOST);
 
   if (ret != 0) {
     return -1;
@@ -92,7 +96,7 @@ uintptr_t dispatch_edgecall_ocall( unsigned long call_id,
     goto ocall_error;
   }
 
-  ret = sbi_stop_enclave(STOP_EDGE_CALL_HOST);
+  ret = strace_stop_enclave(STOP_EDGE_CALL_HOST);
 
   if (ret != 0) {
     goto ocall_error;
@@ -165,9 +169,14 @@ void handle_syscall(struct encl_ctx* ctx)
 
   ctx->regs.sepc += 4;
 
+  /* other threads of the eapp may be in the runtime on other harts */
+  rt_lock();
+  strace_enter(ctx);
+
   switch (n) {
   case(RUNTIME_SYSCALL_EXIT):
-    sbi_exit_enclave(arg0);
+    strace_exit(arg0);
+    rt_thread_exit(arg0);
     break;
   case(RUNTIME_SYSCALL_OCALL):
     ret = dispatch_edgecall_ocall(arg0, (void*)arg1, arg2, (void*)arg3, arg4);
@@ -182,7 +191,32 @@ void handle_syscall(struct encl_ctx* ctx)
 
     /* TODO we consistently don't have report size when we need it */
     copy_to_user((void*)arg0, (void*)rt_copy_buffer_1, 2048);
-    //print_strace("[ATTEST] p1 0x%p->0x%p p2 0x%p->0x%p sz %lx = %lu\r\n",arg0,arg0_trans,arg1,arg1_trans,arg2,ret);
+    break;
+  case(RUNTIME_SYSCALL_ATTEST_BATCH):;
+    /* report, proofs, blobs back to back, their sizes, number of blobs */
+    uint32_t* batch_sizes = (uint32_t*) rt_copy_buffer_3;
+    struct attest_batch_proof* batch_proofs =
+        (struct attest_batch_proof*) (rt_copy_buffer_3 + ATTEST_BATCH_MAX * sizeof(uint32_t));
+    size_t batch_len = 0;
+
+    if (arg4 == 0 || arg4 > ATTEST_BATCH_MAX) {
+      ret = -1;
+      break;
+    }
+    copy_from_user(batch_sizes, (void*)arg3, arg4 * sizeof(uint32_t));
+    for (uintptr_t i = 0; i < arg4; i++)
+      batch_len += batch_sizes[i];
+    if (batch_len > sizeof(rt_copy_buffer_2)) {
+      ret = -1;
+      break;
+    }
+    copy_from_user(rt_copy_buffer_2, (void*)arg2, batch_len);
+
+    ret = sbi_attest_enclave_batch(rt_copy_buffer_1, batch_proofs, rt_copy_buffer_2, batch_sizes, arg4);
+    if (!ret) {
+      copy_to_user((void*)arg0, (void*)rt_copy_buffer_1, 2048);
+      copy_to_user((void*)arg1, (void*)batch_proofs, arg4 * sizeof(struct attest_batch_proof));
+    }
     break;
   case(RUNTIME_SYSCALL_GET_SEALING_KEY):;
     /* Stores the key receive structure */
@@ -284,22 +318,23 @@ void handle_syscall(struct encl_ctx* ctx)
     }
     copy_from_user(rt_copy_buffer_1, (void*) arg1, arg2);
     copy_from_user(rt_copy_buffer_3, (void*) arg5, PUBLIC_KEY_SIZE);
+    /* room for the result, replaced with its length */
+    size_t crypto_out_len = sizeof(rt_copy_buffer_2);
     // buffer_1_pa = translate((uintptr_t)rt_copy_buffer_1);
     // buffer_2_pa = translate((uintptr_t)rt_copy_buffer_2);
     // buffer_3_pa = translate((uintptr_t)sizes);
     // uintptr_t buffer_4_pa = translate((uintptr_t)rt_copy_buffer_3);
 
     // ret = sbi_crypto_interface(arg0, buffer_1_pa, arg2, buffer_2_pa, buffer_3_pa, buffer_4_pa);
-    ret = sbi_crypto_interface(arg0, (uintptr_t)rt_copy_buffer_1, arg2, (uintptr_t)rt_copy_buffer_2, (uintptr_t)sizes, (uintptr_t)rt_copy_buffer_3);
+    ret = sbi_crypto_interface(arg0, (uintptr_t)rt_copy_buffer_1, arg2, (uintptr_t)rt_copy_buffer_2, (uintptr_t)&crypto_out_len, (uintptr_t)rt_copy_buffer_3);
     if (!ret) {
-      copy_to_user((void*)arg3, (void*)rt_copy_buffer_2, sizes[0]);
-      copy_to_user((void*)arg4, (void*)sizes, sizeof(unsigned long));
+      copy_to_user((void*)arg3, (void*)rt_copy_buffer_2, crypto_out_len);
+      copy_to_user((void*)arg4, (void*)&crypto_out_len, sizeof(size_t));
     }
     
     memset(rt_copy_buffer_1, 0x00, sizeof(rt_copy_buffer_1));
     memset(rt_copy_buffer_2, 0x00, sizeof(rt_copy_buffer_2));
     memset(rt_copy_buffer_3, 0x00, sizeof(rt_copy_buffer_3));
-    memset(sizes, 0x00, sizeof(sizes));
     break;
 
   case(RUNTIME_SYSCALL_PRINT_STRING):
@@ -307,7 +342,6 @@ void handle_syscall(struct encl_ctx* ctx)
     printf((char *)rt_copy_buffer_1);
     ret = 0;
   case RUNTIME_SYSCALL_WRITE_BUFFER:
-    print_strace("[runtime] RUNTIME_SYSCALL_WRITE_BUFFER: (%lx) (%lx) (%lu)\r\n", arg0, arg1, arg2);
 
     uintptr_t user_buffer_pa = translate((uintptr_t)rt_copy_buffer_1);
 
@@ -324,7 +358,6 @@ void handle_syscall(struct encl_ctx* ctx)
     break;
 
   case RUNTIME_SYSCALL_READ_REGISTER:
-    print_strace("[runtime] RUNTIME_SYSCALL_READ_BUFFER: (%lx) (%ld) (%lx)\r\n", arg0, arg1, arg2);
 
     uint64_t reg = -1; // must be initialized
     uintptr_t rt_reg_pa = translate((uintptr_t)&reg);
@@ -339,6 +372,17 @@ void handle_syscall(struct encl_ctx* ctx)
 
     break;
 
+  case RUNTIME_SYSCALL_MAP_DEVICE:;
+    uintptr_t device_base = 0;
+    size_t device_size = 0;
+
+    ret = device_map(&device_base, &device_size);
+    if (ret) {
+      copy_to_user((void*)arg0, &device_base, sizeof(device_base));
+      copy_to_user((void*)arg1, &device_size, sizeof(device_size));
+    }
+    break;
+
 
 
 #ifdef USE_LINUX_SYSCALL
@@ -370,6 +414,18 @@ void handle_syscall(struct encl_ctx* ctx)
     ret = linux_set_tid_address((int*) arg0);
     break;
 
+  case(SYS_clone):
+    ret = rt_clone(ctx, arg0, arg1, (int*) arg2, arg3, (int*) arg4);
+    break;
+
+  case(SYS_futex):
+    ret = rt_futex((int*) arg0, (int) arg1, (int) arg2, (void*) arg3);
+    break;
+
+  case(SYS_gettid):
+    ret = rt_gettid();
+    break;
+
   case(SYS_brk):
     ret = syscall_brk((void*) arg0);
     break;
@@ -389,8 +445,8 @@ void handle_syscall(struct encl_ctx* ctx)
 
   case(SYS_exit):
   case(SYS_exit_group):
-    print_strace("[runtime] exit or exit_group (%lu)\r\n",n);
-    sbi_exit_enclave(arg0);
+    strace_exit(arg0);
+    rt_thread_exit(arg0);
     break;
 #endif /* USE_LINUX_SYSCALL */
 
@@ -509,11 +565,14 @@ void handle_syscall(struct encl_ctx* ctx)
 
   case(RUNTIME_SYSCALL_UNKNOWN):
   default:
-    print_strace("[runtime] syscall %ld not implemented\r\n", (unsigned long) n);
+    debug("syscall %ld not implemented", (unsigned long) n);
     ret = -1;
     break;
   }
 
+  strace_exit(ret);
+  rt_unlock();
+
   /* store the result in the stack */
   ctx->regs.a0 = ret;
   return;
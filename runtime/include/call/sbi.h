@@ -10,23 +10,37 @@
 
 #include "sm_call.h"
 
+/* standard RFENCE extension, for shootdowns across the enclave's harts */
+#define SBI_EXT_RFENCE 0x52464E43
+#define SBI_RFENCE_SFENCE_VMA 1
+
 void
 sbi_putchar(char c);
 void
 sbi_set_timer(uint64_t stime_value);
+void
+sbi_remote_sfence_vma_all(void);
 uintptr_t
 sbi_stop_enclave(uint64_t request);
 void
 sbi_exit_enclave(uint64_t retval);
 uintptr_t
+sbi_create_thread(uintptr_t tid, uintptr_t entry, uintptr_t arg);
+uintptr_t
 sbi_random();
 uintptr_t
 sbi_query_multimem(size_t *size);
 uintptr_t
 sbi_query_multimem_addr(uintptr_t *addr);
 uintptr_t
+sbi_query_device(size_t *size);
+uintptr_t
+sbi_query_device_addr(uintptr_t *addr);
+uintptr_t
 sbi_attest_enclave(void* report, void* buf, uintptr_t len);
 uintptr_t
+sbi_attest_enclave_batch(void* report, void* proofs, void* buf, void* sizes, uintptr_t count);
+uintptr_t
 sbi_get_sealing_key(uintptr_t key_struct, uintptr_t key_ident, uintptr_t len);
 uintptr_t
 sbi_create_keypair(uintptr_t pk, uintptr_t index, uintptr_t issued_crt, uintptr_t issued_crt_len);
@@ -0,0 +1,28 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#ifndef _STRACE_H_
+#define _STRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "call/sbi.h"
+#include "util/regs.h"
+
+/* Binary syscall trace into the UTM (see eyrie_utm.h) */
+
+#ifdef USE_INTERNAL_STRACE
+void strace_init(uintptr_t area, size_t size);
+void strace_enter(struct encl_ctx* ctx);
+void strace_exit(uintptr_t ret);
+uintptr_t strace_stop_enclave(uint64_t request);
+#else
+#define strace_init(area, size) ((void)(area), (void)(size))
+#define strace_enter(ctx)
+#define strace_exit(ret)
+#define strace_stop_enclave(request) sbi_stop_enclave(request)
+#endif
+
+#endif /* _STRACE_H_ */
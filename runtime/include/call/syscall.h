@@ -17,13 +17,4 @@ void init_edge_internals(void);
 uintptr_t dispatch_edgecall_syscall(struct edge_syscall* syscall_data_ptr,
                                     size_t data_len);
 
-// Define this to enable printing of a large amount of syscall information
-//#define USE_INTERNAL_STRACE 1
-
-#ifdef USE_INTERNAL_STRACE
-#define print_strace printf
-#else
-#define print_strace(...)
-#endif
-
 #endif /* syscall.h */
@@ -0,0 +1,9 @@
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+uintptr_t device_map(uintptr_t* base, size_t* size);
+
+#endif
@@ -4,20 +4,41 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define NEXT_PAGE(page) *((uintptr_t*)page)
-#define LIST_EMPTY(list) ((list).count == 0 || (list).head == 0)
-#define LIST_INIT(list) { (list).count = 0; (list).head = 0; (list).tail = 0; }
+#include "mm/vm_defs.h"
 
-struct pg_list
+/* largest block the page allocator hands out: one megapage */
+#define SPA_MAX_ORDER RISCV_MEGAPAGE_ORDER
+#define SPA_NONE ((uint32_t) -1)
+
+/* pages kept zeroed ahead of time, and how many a timer tick may zero
+ * (ZERO_REFILL_BATCH in CMake, 0 for none). A tick's work is taken from
+ * the eapp, so it is kept to a page by default */
+#define SPA_ZERO_POOL_SIZE 64
+#ifndef SPA_ZERO_REFILL_BATCH
+#define SPA_ZERO_REFILL_BATCH 1
+#endif
+
+/* per-page allocator metadata, kept outside of the pages */
+struct spa_page
 {
-	uintptr_t head;
-	uintptr_t tail;
-	unsigned int count;
+	uint32_t next;  /* free list links (page indices), SPA_NONE if none */
+	uint32_t prev;
+	uint8_t order;  /* order of the block this page is the head of */
+	uint8_t free;   /* set while the block is on a free list */
 };
 
 void spa_init(uintptr_t base, size_t size);
+void spa_init_used(uintptr_t base, size_t used, size_t size);
 uintptr_t spa_get(void);
 uintptr_t spa_get_zero(void);
 void spa_put(uintptr_t page);
+uintptr_t spa_get_contig(unsigned int order);
+uintptr_t spa_get_contig_zero(unsigned int order);
+void spa_put_contig(uintptr_t page, unsigned int order);
+void spa_split(uintptr_t page, unsigned int order);
+uintptr_t spa_get_megapage(void);
+uintptr_t spa_get_megapage_zero(void);
+void spa_put_megapage(uintptr_t page);
 unsigned int spa_available();
+unsigned int spa_refill_zero_pool(unsigned int budget);
 #endif
@@ -8,12 +8,17 @@
 uintptr_t translate(uintptr_t va);
 pte* pte_of_va(uintptr_t va);
 uintptr_t map_page(uintptr_t vpn, uintptr_t ppn, int flags);
+uintptr_t map_megapage(uintptr_t vpn, uintptr_t ppn, int flags);
 uintptr_t alloc_page(uintptr_t vpn, int flags);
+uintptr_t alloc_megapage(uintptr_t vpn, int flags);
 uintptr_t realloc_page(uintptr_t vpn, int flags);
 void free_page(uintptr_t vpn);
+int split_megapage(uintptr_t va);
 size_t alloc_pages(uintptr_t vpn, size_t count, int flags);
+size_t alloc_pages_lazy(uintptr_t vpn, size_t count, int flags);
+int handle_demand_zero_fault(uintptr_t va);
+size_t realloc_pages(uintptr_t vpn, size_t count, int flags);
 void free_pages(uintptr_t vpn, size_t count);
-size_t test_va_range(uintptr_t vpn, size_t count);
 
 uintptr_t get_program_break();
 void set_program_break(uintptr_t new_break);
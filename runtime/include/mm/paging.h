@@ -27,6 +27,8 @@ extern pte paging_l3_page_table[BIT(RISCV_PT_INDEX_BITS)]
 
 void paging_inc_user_page(void);
 void paging_dec_user_page(void);
+void paging_inc_user_pages(uintptr_t count);
+void paging_dec_user_pages(uintptr_t count);
 /* page tables for loading physical memory */
 static inline uintptr_t __paging_pa(uintptr_t va)
 {
@@ -0,0 +1,31 @@
+#ifndef __VASPACE_H__
+#define __VASPACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Virtual address space allocator for the anonymous user region.
+ * Free ranges are kept as extents in a balanced tree ordered by VPN, and
+ * every node caches the largest extent in its subtree, so finding the
+ * lowest range of N free pages takes O(log n) in the number of extents.
+ * All addresses and sizes are in pages (VPNs). */
+
+struct va_extent
+{
+  uintptr_t vpn;       /* first free page of the extent */
+  uintptr_t count;     /* number of free pages */
+  uintptr_t max_count; /* largest count in this subtree */
+  struct va_extent* left;
+  struct va_extent* right;
+  int height;
+};
+
+void vaspace_init(uintptr_t start_vpn, uintptr_t end_vpn);
+uintptr_t vaspace_alloc(size_t count);
+uintptr_t vaspace_alloc_aligned(size_t count, unsigned int order);
+int vaspace_reserve(uintptr_t vpn, size_t count);
+int vaspace_release(uintptr_t vpn, size_t count);
+bool vaspace_is_mapped(uintptr_t vpn, size_t count);
+
+#endif
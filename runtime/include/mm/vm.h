@@ -61,7 +61,12 @@ static inline uintptr_t vpn(uintptr_t va)
 
 static inline uintptr_t pte_ppn(pte pte)
 {
+#if __riscv_xlen == 64
+  /* leave out the attribute bits above the PPN, such as PTE_PBMT_IO */
+  return (pte >> PTE_PPN_SHIFT) & MASK(PTE_PPN_BITS);
+#else
   return pte >> PTE_PPN_SHIFT;
+#endif
 }
 
 #endif
@@ -30,6 +30,14 @@
 #define MEGAPAGE_DOWN(n) ROUND_DOWN(n, RISCV_GET_LVL_PGSIZE_BITS(2))
 #define MEGAPAGE_UP(n) ROUND_UP(n, RISCV_GET_LVL_PGSIZE_BITS(2))
 
+/* The largest leaf we hand out to user mappings sits one level above the
+ * 4 KiB pages: 2 MiB on Sv39, 4 MiB on Sv32. */
+#define RISCV_MEGAPAGE_LEVEL (RISCV_PT_LEVELS - 1)
+#define RISCV_MEGAPAGE_BITS RISCV_GET_LVL_PGSIZE_BITS(RISCV_MEGAPAGE_LEVEL)
+#define RISCV_MEGAPAGE_SIZE BIT(RISCV_MEGAPAGE_BITS)
+#define RISCV_MEGAPAGE_ORDER (RISCV_MEGAPAGE_BITS - RISCV_PAGE_BITS)
+#define RISCV_MEGAPAGE_PAGES BIT(RISCV_MEGAPAGE_ORDER)
+
 /* Starting address of the enclave memory */
 
 #if __riscv_xlen == 64
@@ -62,9 +70,16 @@
 #define PTE_G 0x020  // Global
 #define PTE_A 0x040  // Accessed
 #define PTE_D 0x080  // Dirty
+#define PTE_DZ 0x100 // Demand-zero (software bit; only set while !PTE_V)
+#define PTE_IO 0x200 // Device window, no freemem frame behind it (software bit)
 #define PTE_FLAG_MASK 0x3ff
 #define PTE_PPN_SHIFT 10
 
+#if __riscv_xlen == 64
+#define PTE_PPN_BITS 44
+#define PTE_PBMT_IO (2UL << 61) // Svpbmt: non-cacheable, strongly ordered
+#endif
+
 #ifndef __PREPROCESSING__
 typedef uintptr_t pte;
 #endif
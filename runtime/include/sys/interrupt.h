@@ -9,6 +9,9 @@
 #define INTERRUPT_CAUSE_TIMER     5
 #define INTERRUPT_CAUSE_EXTERNAL  9
 
+/* cycles between two timer ticks of a thread */
+#define DEFAULT_CLOCK_DELAY 10000
+
 void init_timer(void);
 
 #endif
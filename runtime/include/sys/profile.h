@@ -0,0 +1,16 @@
+#ifdef USE_PROFILER
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/regs.h"
+
+void profile_init(uintptr_t area, size_t size);
+void profile_sample(struct encl_ctx* ctx);
+
+#endif /* _PROFILE_H_ */
+
+#endif /* USE_PROFILER */
@@ -0,0 +1,61 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+#include <stdint.h>
+
+#include "mm/vm_defs.h"
+#include "util/regs.h"
+
+/* must not exceed MAX_ENCL_THREADS of the SM */
+#define RT_MAX_THREADS 8
+
+/* kernel (trap) stack of every thread but the first, which runs on the
+ * boot stack in runtime.ld.S */
+#define RT_MAIN_STACK_SIZE (8 * RISCV_PAGE_SIZE)
+#define RT_THREAD_STACK_ORDER 2
+#define RT_THREAD_STACK_SIZE (RISCV_PAGE_SIZE << RT_THREAD_STACK_ORDER)
+
+/* linux thread ids; thread 0 shares its id with the faked pid */
+#define RT_TID(tid) ((tid) + 2)
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+#define FUTEX_PRIVATE_FLAG 128
+
+enum rt_thread_state {
+  RT_THREAD_FREE = 0,
+  RT_THREAD_RUNNING,
+  RT_THREAD_EXITING,
+};
+
+struct rt_thread {
+  uintptr_t stack_top;  /* loaded by rt_thread_entry, keep first */
+  uintptr_t stack;
+  int tid;              /* thread context in the SM */
+  int state;
+  int* clear_tid;       /* CLONE_CHILD_CLEARTID / set_tid_address */
+  uintptr_t futex;      /* address waited on, 0 if none */
+  int futex_woken;
+  uintptr_t user_stack_top;  /* the eapp stack grows down from here */
+  struct encl_ctx start_ctx;
+};
+
+struct rt_thread* rt_thread_current(void);
+int rt_thread_siblings(void);
+
+void rt_lock(void);
+int rt_trylock(void);
+void rt_unlock(void);
+
+uintptr_t rt_clone(struct encl_ctx* ctx, unsigned long flags, uintptr_t newsp,
+                   int* ptid, uintptr_t tls, int* ctid);
+uintptr_t rt_futex(int* uaddr, int op, int val, void* timeout);
+uintptr_t rt_gettid(void);
+void rt_set_clear_tid(int* tidptr);
+void rt_thread_exit(uintptr_t retval);
+
+#endif
@@ -12,7 +12,9 @@ size_t rt_util_getrandom(void* vaddr, size_t buflen);
 void not_implemented_fatal(struct encl_ctx* ctx);
 void rt_util_misc_fatal();
 void rt_page_fault(struct encl_ctx* ctx);
+void handle_page_fault(struct encl_ctx* ctx);
 void tlb_flush(void);
+void tlb_shootdown(void);
 
 extern unsigned char rt_copy_buffer_1[RISCV_PAGE_SIZE];
 extern unsigned char rt_copy_buffer_2[RISCV_PAGE_SIZE];
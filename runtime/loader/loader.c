@@ -42,9 +42,18 @@ int loadElf(elf_t* elf, bool user) {
       src = (char *) (PAGE_DOWN((uintptr_t) src) + RISCV_PAGE_SIZE);
     }
 
-    /* first load all pages that do not include .bss segment */
+    /* first load all pages that do not include .bss segment.
+     * Map the image in place with megapages where both sides line up */
     while (va + RISCV_PAGE_SIZE <= file_end) {
       uintptr_t src_pa = __pa((uintptr_t) src);
+      if (IS_ALIGNED(va, RISCV_MEGAPAGE_BITS) &&
+          IS_ALIGNED(src_pa, RISCV_MEGAPAGE_BITS) &&
+          va + RISCV_MEGAPAGE_SIZE <= file_end &&
+          map_megapage(vpn(va), ppn(src_pa), pt_mode) == 1) {
+        src += RISCV_MEGAPAGE_SIZE;
+        va += RISCV_MEGAPAGE_SIZE;
+        continue;
+      }
       if (!map_page(vpn(va), ppn(src_pa), pt_mode))
         return -1;
       src += RISCV_PAGE_SIZE;
@@ -53,6 +62,14 @@ int loadElf(elf_t* elf, bool user) {
 
     /* load the .bss segments */
     while (va < memory_end) {
+      /* pure .bss can take zeroed megapages */
+      if (va >= file_end && IS_ALIGNED(va, RISCV_MEGAPAGE_BITS) &&
+          PAGE_UP(memory_end) - va >= RISCV_MEGAPAGE_SIZE &&
+          alloc_megapage(vpn(va), pt_mode)) {
+        va += RISCV_MEGAPAGE_SIZE;
+        continue;
+      }
+
       uintptr_t new_page = alloc_page(vpn(va), pt_mode);
       if (!new_page)
         return -1;
@@ -66,29 +83,3 @@ int loadElf(elf_t* elf, bool user) {
 
    return 0;
 }
-
-// assumes beginning and next file are page-aligned
-static inline void freeUnusedElf(elf_t* elf) {
-  assert(false); // TODO: needs free to be implemented properly
-  for (unsigned int i = 0; i < elf_getNumProgramHeaders(elf); i++) {
-    uintptr_t start      = elf_getProgramHeaderVaddr(elf, i);
-    uintptr_t file_end   = start + elf_getProgramHeaderFileSize(elf, i);
-    uintptr_t src        = (uintptr_t) elf_getProgramSegment(elf, i);
-
-    if (elf_getProgramHeaderType(elf, i) != PT_LOAD) {
-      uintptr_t src_end = file_end - start + src;
-      for (; src < src_end; src += RISCV_PAGE_SIZE) {
-        // free_page(vpn(src));
-      }
-      continue;
-    }
-
-    if (RISCV_PAGE_OFFSET(start)) {
-      // free_page(vpn(start));
-    }
-
-    if (RISCV_PAGE_OFFSET(file_end)) {
-      // free_page(vpn(file_end));
-    }
-  }
-}
@@ -0,0 +1,94 @@
+#include "mm/device.h"
+
+#include "call/sbi.h"
+#include "mm/mm.h"
+#include "mm/vaspace.h"
+#include "mm/vm.h"
+#include "util/rt_util.h"
+
+/* The MMIO window the SM has given the enclave, if any, mapped into the
+ * eapp so that it reaches device registers with plain loads and stores
+ * instead of a syscall and an SBI call each. Its pages carry PTE_IO: no
+ * frame of freemem is behind them, so they are never freed to it or
+ * swapped out, and mprotect leaves their permissions as they are. With USE_SVPBMT they
+ * are of the IO memory type; otherwise the PMAs of the platform keep the
+ * window uncached. */
+
+static uintptr_t device_base;
+static size_t device_size;
+static uintptr_t device_va;
+static size_t device_pages;
+
+/* whether page i of the mapping still points at the window */
+static int
+device_page_mapped(size_t i) {
+  pte* p = pte_of_va(device_va + (i << RISCV_PAGE_BITS));
+  return p && (*p & PTE_IO) && pte_ppn(*p) == ppn(device_base) + i;
+}
+
+/* Drops what is left of a mapping the eapp has partly unmapped. The
+ * pages it has unmapped went back to the VA space already, and may have
+ * been handed out again */
+static void
+device_unmap_rest(void) {
+  size_t i;
+
+  for (i = 0; i < device_pages; i++) {
+    if (!device_page_mapped(i))
+      continue;
+    free_page(vpn(device_va) + i);
+    vaspace_release(vpn(device_va) + i, 1);
+  }
+  tlb_flush();
+  device_va    = 0;
+  device_pages = 0;
+}
+
+/* Maps the window on the first call and returns its user VA, or 0 if
+ * the enclave has none. base and size describe the window */
+uintptr_t
+device_map(uintptr_t* base, size_t* size) {
+  uintptr_t start;
+  size_t pages, i;
+
+  if (!device_size &&
+      (sbi_query_device(&device_size) || sbi_query_device_addr(&device_base))) {
+    device_size = 0;
+    return 0;
+  }
+  if (!device_size)
+    return 0;
+
+  *base = device_base;
+  *size = device_size;
+
+  /* still there unless the eapp has unmapped some of it */
+  if (device_va) {
+    for (i = 0; i < device_pages && device_page_mapped(i); i++)
+      ;
+    if (i == device_pages)
+      return device_va;
+    device_unmap_rest();
+  }
+
+  pages = vpn(device_size);
+  start = vaspace_alloc(pages);
+  if (!start)
+    return 0;
+
+  for (i = 0; i < pages; i++) {
+    if (map_page(start + i, ppn(device_base) + i,
+                 PTE_U | PTE_R | PTE_W | PTE_IO) != 1) {
+      free_pages(start, i);
+      vaspace_release(start, pages);
+      return 0;
+    }
+#ifdef USE_SVPBMT
+    *pte_of_va((start + i) << RISCV_PAGE_BITS) |= PTE_PBMT_IO;
+#endif
+  }
+
+  device_va    = start << RISCV_PAGE_BITS;
+  device_pages = pages;
+  return device_va;
+}
@@ -4,18 +4,200 @@
 #include "mm/freemem.h"
 #include "mm/paging.h"
 
-/* This file implements a simple page allocator (SPA)
- * which stores the pages based on a linked list.
- * Each of the element of linked list is stored in the header of each free page.
+/* This file implements the simple page allocator (SPA) as a binary buddy
+ * allocator over freemem.
+ *
+ * A block of order k is 2^k physically contiguous pages whose first page
+ * frame number is a multiple of 2^k, so that an order-RISCV_MEGAPAGE_ORDER
+ * block can back a megapage leaf. Free blocks sit on one doubly linked
+ * list per order; freeing a block merges it with its buddy while the buddy
+ * is free and of the same order.
+ *
+ * All bookkeeping lives in a struct spa_page array carved from the start of
+ * freemem, one entry per page. Free pages themselves are never written.
+ * The managed range may begin with pages that are in use from the start
+ * (see spa_init_used); their entries read as allocated until they are
+ * given back with spa_put.
+ * Only block heads carry meaningful entries, and a buddy lookup only ever
+ * lands on a block head, so the array needs no initialization for pages
+ * that have not been handed out yet.
+ *
+ * Initialization is lazy: the pages above spa_wild ("the wilderness") are
+ * not on any list yet. Whenever no block is large enough, the next largest
+ * aligned block is pulled in from the wilderness. Boot therefore only
+ * touches the metadata of the pages before the wilderness.
+ *
+ * A small pool of pages is zeroed ahead of time (spa_refill_zero_pool,
+ * called from the timer tick) so that spa_get_zero, and with it the
+ * demand-zero fault path, usually does not clear a page in line. Pooled
+ * pages are off the free lists but still count as available, and are
+ * handed back to the buddy lists whenever those run dry. */
 
- * SPA does not use any additional data structure (e.g., linked list).
- * Instead, it uses the pages themselves to store the linked list pointer.
- * Thus, each of the free pages contains the pointer to the next free page
- * which can be dereferenced by NEXT_PAGE() macro.
- * spa_free_pages will only hold the head and the tail pages so that
- * SPA can allocate/free a page in constant time. */
+static struct spa_page* spa_pages;
+static uint32_t spa_free_lists[SPA_MAX_ORDER + 1];
+static uintptr_t spa_free_count;
 
-static struct pg_list spa_free_pages;
+static uintptr_t spa_base;
+static uintptr_t spa_base_pfn;
+static uintptr_t spa_npages;
+static uintptr_t spa_wild;
+
+static uintptr_t spa_zero_pool[SPA_ZERO_POOL_SIZE];
+static unsigned int spa_zero_count;
+
+static inline uintptr_t
+__idx(uintptr_t page_addr)
+{
+  return (page_addr - spa_base) >> RISCV_PAGE_BITS;
+}
+
+static inline uintptr_t
+__addr(uintptr_t idx)
+{
+  return spa_base + (idx << RISCV_PAGE_BITS);
+}
+
+static void
+__list_push(unsigned int order, uintptr_t idx)
+{
+  struct spa_page* page = &spa_pages[idx];
+  uint32_t head         = spa_free_lists[order];
+
+  page->free  = 1;
+  page->order = order;
+  page->prev  = SPA_NONE;
+  page->next  = head;
+  if (head != SPA_NONE)
+    spa_pages[head].prev = idx;
+  spa_free_lists[order] = idx;
+}
+
+static void
+__list_del(unsigned int order, uintptr_t idx)
+{
+  struct spa_page* page = &spa_pages[idx];
+
+  if (page->prev != SPA_NONE)
+    spa_pages[page->prev].next = page->next;
+  else
+    spa_free_lists[order] = page->next;
+
+  if (page->next != SPA_NONE)
+    spa_pages[page->next].prev = page->prev;
+
+  page->free = 0;
+}
+
+/* index of the order-sized buddy of idx, or SPA_NONE if the buddy is not
+ * (entirely) below the wilderness */
+static uintptr_t
+__buddy(uintptr_t idx, unsigned int order)
+{
+  uintptr_t pfn = (spa_base_pfn + idx) ^ BIT(order);
+
+  if (pfn < spa_base_pfn || pfn - spa_base_pfn + BIT(order) > spa_wild)
+    return SPA_NONE;
+
+  return pfn - spa_base_pfn;
+}
+
+static void
+__free_block(uintptr_t idx, unsigned int order)
+{
+  uintptr_t buddy;
+
+  spa_free_count += BIT(order);
+
+  while (order < SPA_MAX_ORDER) {
+    buddy = __buddy(idx, order);
+    if (buddy == SPA_NONE || !spa_pages[buddy].free ||
+        spa_pages[buddy].order != order)
+      break;
+
+    __list_del(order, buddy);
+    if (buddy < idx)
+      idx = buddy;
+    order++;
+  }
+
+  __list_push(order, idx);
+}
+
+/* move the largest aligned block at the start of the wilderness onto the
+ * free lists. returns false once the wilderness is used up */
+static bool
+__pull_wild(void)
+{
+  unsigned int order = SPA_MAX_ORDER;
+  uintptr_t idx      = spa_wild;
+
+  if (idx == spa_npages)
+    return false;
+
+  while (order > 0 && (!IS_ALIGNED(spa_base_pfn + idx, order) ||
+                       idx + BIT(order) > spa_npages))
+    order--;
+
+  spa_wild += BIT(order);
+  __free_block(idx, order);
+  return true;
+}
+
+/* smallest order >= order with a free block, or -1 */
+static int
+__find_order(unsigned int order)
+{
+  for (; order <= SPA_MAX_ORDER; order++)
+    if (spa_free_lists[order] != SPA_NONE)
+      return order;
+  return -1;
+}
+
+/* return the pre-zeroed pages to the free lists */
+static bool
+__drain_zero_pool(void)
+{
+  if (!spa_zero_count)
+    return false;
+
+  while (spa_zero_count) {
+    uintptr_t idx = __idx(spa_zero_pool[--spa_zero_count]);
+    __free_block(idx, 0);
+  }
+  return true;
+}
+
+static uintptr_t
+__get_block(unsigned int order)
+{
+  uintptr_t idx;
+  int k;
+
+  while ((k = __find_order(order)) < 0) {
+    if (!__pull_wild() && !__drain_zero_pool())
+      return 0;
+  }
+
+  idx = spa_free_lists[k];
+  __list_del(k, idx);
+
+  /* return the upper halves until the block has the requested size */
+  while (k > order) {
+    k--;
+    __list_push(k, idx + BIT(k));
+  }
+
+  spa_pages[idx].order = order;
+  spa_free_count -= BIT(order);
+  return __addr(idx);
+}
+
+static inline bool
+__in_range(uintptr_t page_addr, unsigned int order)
+{
+  return page_addr >= spa_base &&
+         __idx(page_addr) + BIT(order) <= spa_npages;
+}
 
 /* get a free page from the simple page allocator */
 uintptr_t
@@ -23,13 +205,18 @@ __spa_get(bool zero)
 {
   uintptr_t free_page;
 
-  if (LIST_EMPTY(spa_free_pages)) {
+  if (zero && spa_zero_count)
+    return spa_zero_pool[--spa_zero_count];
+
+  free_page = __get_block(0);
+
+  if (!free_page) {
     /* try evict a page */
 #ifdef USE_PAGING
     uintptr_t new_pa = paging_evict_and_free_one(0);
     if(new_pa)
     {
-      spa_put(__va(new_pa));
+      free_page = __va(new_pa);
     }
     else
 #endif
@@ -39,16 +226,6 @@ __spa_get(bool zero)
     }
   }
 
-  free_page = spa_free_pages.head;
-  assert(free_page);
-
-  /* update list head */
-  uintptr_t next = NEXT_PAGE(spa_free_pages.head);
-  spa_free_pages.head = next;
-  spa_free_pages.count--;
-
-  assert(free_page > EYRIE_LOAD_START && free_page < (freemem_va_start + freemem_size));
-
   if (zero)
     memset((void*)free_page, 0, RISCV_PAGE_SIZE);
 
@@ -58,54 +235,144 @@ __spa_get(bool zero)
 uintptr_t spa_get() { return __spa_get(false); }
 uintptr_t spa_get_zero() { return __spa_get(true); }
 
+/* get 2^order physically contiguous pages, aligned to their size
+ * returns 0 if no such block is free; this never evicts */
+uintptr_t
+spa_get_contig(unsigned int order)
+{
+  if (order > SPA_MAX_ORDER)
+    return 0;
+
+  return __get_block(order);
+}
+
+uintptr_t
+spa_get_contig_zero(unsigned int order)
+{
+  uintptr_t block = spa_get_contig(order);
+
+  if (block)
+    memset((void*)block, 0, BIT(order) << RISCV_PAGE_BITS);
+
+  return block;
+}
+
+/* return a block obtained from spa_get_contig */
+void
+spa_put_contig(uintptr_t page_addr, unsigned int order)
+{
+  assert(order <= SPA_MAX_ORDER);
+  assert(IS_ALIGNED(__pa(page_addr), RISCV_PAGE_BITS + order));
+
+  if (!__in_range(page_addr, order)) {
+    warn("spa: dropping page 0x%lx outside of freemem", page_addr);
+    return;
+  }
+
+  assert(!spa_pages[__idx(page_addr)].free);
+  __free_block(__idx(page_addr), order);
+}
+
+/* turn an allocated block into 2^order allocated single pages, so that
+ * they can be returned one by one with spa_put */
+void
+spa_split(uintptr_t page_addr, unsigned int order)
+{
+  uintptr_t idx, i;
+
+  if (!__in_range(page_addr, order))
+    return;
+
+  idx = __idx(page_addr);
+  for (i = 0; i < BIT(order); i++) {
+    spa_pages[idx + i].order = 0;
+    spa_pages[idx + i].free  = 0;
+  }
+}
+
 /* put a page to the simple page allocator */
 void
 spa_put(uintptr_t page_addr)
 {
-  uintptr_t prev;
+  spa_put_contig(page_addr, 0);
+}
 
-  assert(IS_ALIGNED(page_addr, RISCV_PAGE_BITS));
-  assert(page_addr >= EYRIE_LOAD_START && page_addr < (freemem_va_start  + freemem_size));
+uintptr_t spa_get_megapage() { return spa_get_contig(RISCV_MEGAPAGE_ORDER); }
+uintptr_t spa_get_megapage_zero() { return spa_get_contig_zero(RISCV_MEGAPAGE_ORDER); }
+void spa_put_megapage(uintptr_t page) { spa_put_contig(page, RISCV_MEGAPAGE_ORDER); }
 
-  if (!LIST_EMPTY(spa_free_pages)) {
-    prev = spa_free_pages.tail;
-    assert(prev);
-    NEXT_PAGE(prev) = page_addr;
-  } else {
-    spa_free_pages.head = page_addr;
-  }
+/* zero up to budget free pages into the pre-zeroed pool. Pages are only
+ * taken while the free lists and the wilderness keep at least a pool's
+ * worth of pages, so this never causes eviction.
+ * returns the number of pages added */
+unsigned int
+spa_refill_zero_pool(unsigned int budget)
+{
+  unsigned int added = 0;
+  uintptr_t page;
 
-  NEXT_PAGE(page_addr) = 0;
-  spa_free_pages.tail = page_addr;
+  while (added < budget && spa_zero_count < SPA_ZERO_POOL_SIZE &&
+         spa_free_count + (spa_npages - spa_wild) > SPA_ZERO_POOL_SIZE) {
+    page = __get_block(0);
+    if (!page)
+      break;
 
-  spa_free_pages.count++;
-  return;
+    memset((void*)page, 0, RISCV_PAGE_SIZE);
+    spa_zero_pool[spa_zero_count++] = page;
+    added++;
+  }
+
+  return added;
 }
 
 unsigned int
 spa_available(){
+  unsigned int count = spa_free_count + (spa_npages - spa_wild) +
+                       spa_zero_count;
 #ifndef USE_PAGING
-  return spa_free_pages.count;
+  return count;
 #else
-  return spa_free_pages.count + paging_remaining_pages();
+  return count + paging_remaining_pages();
 #endif
 }
 
+/* manage [base, base + size), of which the first `used` bytes are
+ * already in use. Those pages are not handed out, but can be given back
+ * with spa_put later on like any allocated page */
 void
-spa_init(uintptr_t base, size_t size)
+spa_init_used(uintptr_t base, size_t used, size_t size)
 {
-  uintptr_t cur;
-
-  LIST_INIT(spa_free_pages);
+  unsigned int order;
+  uintptr_t meta_pages, used_pages;
 
-  // both base and size must be page-aligned
+  // base, used and size must be page-aligned
   assert(IS_ALIGNED(base, RISCV_PAGE_BITS));
+  assert(IS_ALIGNED(used, RISCV_PAGE_BITS));
   assert(IS_ALIGNED(size, RISCV_PAGE_BITS));
+  assert(used < size);
 
-  /* put all free pages in freemem (base) into spa_free_pages */
-  for(cur = base;
-      cur < base + size;
-      cur += RISCV_PAGE_SIZE) {
-    spa_put(cur);
-  }
+  spa_base     = base;
+  spa_base_pfn = ppn(__pa(base));
+  spa_npages   = size >> RISCV_PAGE_BITS;
+  used_pages   = used >> RISCV_PAGE_BITS;
+  assert(spa_npages < SPA_NONE);
+
+  /* the metadata array takes the first free pages */
+  meta_pages = PAGE_UP(spa_npages * sizeof(struct spa_page)) >> RISCV_PAGE_BITS;
+  assert(used_pages + meta_pages < spa_npages);
+
+  spa_pages      = (struct spa_page*) (base + used);
+  spa_wild       = used_pages + meta_pages;
+  spa_free_count = 0;
+  spa_zero_count = 0;
+  memset(spa_pages, 0, spa_wild * sizeof(struct spa_page));
+
+  for (order = 0; order <= SPA_MAX_ORDER; order++)
+    spa_free_lists[order] = SPA_NONE;
+}
+
+void
+spa_init(uintptr_t base, size_t size)
+{
+  spa_init_used(base, 0, size);
 }
@@ -34,6 +34,35 @@ void spa_put(uintptr_t page)
   assert(false); // not implemented
 }
 
+uintptr_t spa_get_megapage()
+{
+  return spa_get_megapage_zero();
+}
+
+uintptr_t spa_get_megapage_zero()
+{
+  // only hand out a megapage if the bump pointer happens to be aligned
+  if (!IS_ALIGNED(freeBase, RISCV_MEGAPAGE_BITS) ||
+      freeEnd - freeBase < RISCV_MEGAPAGE_SIZE) {
+    return 0;
+  }
+  uintptr_t new_page = freeBase;
+  memset((void *) new_page, 0, RISCV_MEGAPAGE_SIZE);
+
+  freeBase += RISCV_MEGAPAGE_SIZE;
+  return new_page;
+}
+
+void spa_put_megapage(uintptr_t page)
+{
+  assert(false); // not implemented
+}
+
+void spa_split(uintptr_t page, unsigned int order)
+{
+  // nothing to track
+}
+
 unsigned int spa_available()
 {
   return (freeEnd - freeBase) / RISCV_PAGE_SIZE;
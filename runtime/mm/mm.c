@@ -3,10 +3,7 @@
 #include "mm/vm.h"
 #include "mm/freemem.h"
 #include "mm/paging.h"
-
-/* Page table utilities */
-static pte*
-__walk_create(pte* root, uintptr_t addr);
+#include "util/rt_util.h"
 
 /* Hacky storage of current u-mode break */
 static uintptr_t current_program_break;
@@ -21,33 +18,53 @@ void set_program_break(uintptr_t new_break)
   current_program_break = new_break;
 }
 
-static pte*
-__continue_walk_create(pte* root, uintptr_t addr, pte* pte)
+static inline bool
+__pte_is_leaf(pte entry)
 {
-  uintptr_t new_page = spa_get_zero();
-  assert(new_page);
+  return entry & (PTE_R | PTE_W | PTE_X);
+}
 
-  unsigned long free_ppn = ppn(__pa(new_page));
-  *pte = ptd_create(free_ppn);
-  return __walk_create(root, addr);
+/* a mapped page that has no frame yet; see alloc_pages_lazy */
+static inline bool
+__pte_is_demand_zero(pte entry)
+{
+  return !(entry & PTE_V) && (entry & PTE_DZ);
 }
 
+/* walk the page table down to leaf_level and return the PTE there.
+ * The walk stops early at a superpage leaf (valid or demand-zero, which
+ * has no R/W/X bits when it was mapped PROT_NONE); *level
+ * (if given) is set to the level of the returned PTE. Missing tables are
+ * created if create is set, otherwise 0 is returned. */
 static pte*
-__walk_internal(pte* root, uintptr_t addr, int create)
+__walk_internal(pte* root, uintptr_t addr, int create, int leaf_level,
+                int* level)
 {
   pte* t = root;
   int i;
-  for (i = 1; i < RISCV_PT_LEVELS; i++)
+  for (i = 1; i < leaf_level; i++)
   {
     size_t idx = RISCV_GET_PT_INDEX(addr, i);
 
-    if (!(t[idx] & PTE_V))
-      return create ? __continue_walk_create(root, addr, &t[idx]) : 0;
+    if (__pte_is_leaf(t[idx]) || __pte_is_demand_zero(t[idx])) {
+      if (level)
+        *level = i;
+      return &t[idx];
+    } else if (!(t[idx] & PTE_V)) {
+      if (!create)
+        return 0;
+
+      uintptr_t new_page = spa_get_zero();
+      assert(new_page);
+      t[idx] = ptd_create(ppn(__pa(new_page)));
+    }
 
     t = (pte*) __va(pte_ppn(t[idx]) << RISCV_PAGE_BITS);
   }
 
-  return &t[RISCV_GET_PT_INDEX(addr, RISCV_PT_LEVELS)];
+  if (level)
+    *level = leaf_level;
+  return &t[RISCV_GET_PT_INDEX(addr, leaf_level)];
 }
 
 /* walk the page table and return PTE
@@ -55,7 +72,7 @@ __walk_internal(pte* root, uintptr_t addr, int create)
 static pte*
 __walk(pte* root, uintptr_t addr)
 {
-  return __walk_internal(root, addr, 0);
+  return __walk_internal(root, addr, 0, RISCV_PT_LEVELS, 0);
 }
 
 /* walk the page table and return PTE
@@ -63,17 +80,104 @@ __walk(pte* root, uintptr_t addr)
 static pte*
 __walk_create(pte* root, uintptr_t addr)
 {
-  return __walk_internal(root, addr, 1);
+  return __walk_internal(root, addr, 1, RISCV_PT_LEVELS, 0);
+}
+
+/* return the megapage leaf covering va, or 0 if va is not in one */
+static pte*
+__megapage_of_va(uintptr_t va)
+{
+  int level;
+  pte* pte = __walk_internal(root_page_table, va, 0, RISCV_PT_LEVELS, &level);
+
+  if (!pte || level != RISCV_MEGAPAGE_LEVEL ||
+      !(*pte & PTE_V || __pte_is_demand_zero(*pte)))
+    return 0;
+
+  return pte;
 }
 
-/* Create a virtual memory mapping between a physical and virtual page */
+/* Replace the megapage leaf covering va (if any) with a page table of
+ * 4 KiB leaves that map the same frames with the same permissions. A
+ * demand-zero megapage becomes 512 demand-zero pages.
+ * returns 0 on success or if there was nothing to split, -1 otherwise */
+int
+split_megapage(uintptr_t va)
+{
+  pte* leaf = __megapage_of_va(va);
+  pte* table;
+  uintptr_t base;
+  int flags, i;
+
+  if (!leaf)
+    return 0;
+
+  table = (pte*) spa_get();
+  if (!table)
+    return -1;
+
+  /* allocating the table may have evicted (and so split) this megapage */
+  leaf = __megapage_of_va(va);
+  if (!leaf) {
+    spa_put((uintptr_t) table);
+    return 0;
+  }
+
+  if (__pte_is_demand_zero(*leaf)) {
+    for (i = 0; i < BIT(RISCV_PT_INDEX_BITS); i++)
+      table[i] = *leaf;
+    *leaf = ptd_create(ppn(__pa((uintptr_t) table)));
+    return 0;
+  }
+
+  base  = pte_ppn(*leaf);
+  flags = *leaf & PTE_FLAG_MASK;
+  for (i = 0; i < BIT(RISCV_PT_INDEX_BITS); i++)
+    table[i] = pte_create(base + i, flags);
+
+  *leaf = ptd_create(ppn(__pa((uintptr_t) table)));
+
+  /* the frames will be freed one by one from now on */
+  spa_split(__va(base << RISCV_PAGE_BITS), RISCV_MEGAPAGE_ORDER);
+  return 0;
+}
+
+/* Create a virtual memory mapping between a physical and virtual page.
+ * A megapage covering vpn (demand-zero or not) is split first, so that
+ * the page goes into a table of its own */
 uintptr_t 
 map_page(uintptr_t vpn, uintptr_t ppn, int flags)
 {
-  pte* pte = __walk_create(root_page_table, vpn << RISCV_PAGE_BITS);
+  int level;
+  pte* pte;
+
+  if (split_megapage(vpn << RISCV_PAGE_BITS))
+    return -1;
+
+  pte = __walk_internal(root_page_table, vpn << RISCV_PAGE_BITS, 1,
+                        RISCV_PT_LEVELS, &level);
 
   // TODO: what is supposed to happen if page is already allocated?
-  if (*pte & PTE_V) {
+  if (level != RISCV_PT_LEVELS || (*pte & PTE_V)) {
+    return -1;
+  }
+
+  *pte = pte_create(ppn, PTE_D | PTE_A | PTE_V | flags);
+  return 1;
+}
+
+/* Create a megapage mapping; vpn and ppn must be megapage-aligned.
+ * Fails if anything (a leaf or a page table) already sits in the slot */
+uintptr_t
+map_megapage(uintptr_t vpn, uintptr_t ppn, int flags)
+{
+  pte* pte = __walk_internal(root_page_table, vpn << RISCV_PAGE_BITS, 1,
+                             RISCV_MEGAPAGE_LEVEL, 0);
+
+  assert(IS_ALIGNED(vpn, RISCV_MEGAPAGE_ORDER));
+  assert(IS_ALIGNED(ppn, RISCV_MEGAPAGE_ORDER));
+
+  if (*pte) {
     return -1;
   }
 
@@ -90,11 +194,16 @@ alloc_page(uintptr_t vpn, int flags)
   pte* pte = __walk_create(root_page_table, vpn << RISCV_PAGE_BITS);
 
   if (!pte)
+    return 0;
+
+  /* a demand-zero page is given its frame now */
+  if (__pte_is_demand_zero(*pte) &&
+      handle_demand_zero_fault(vpn << RISCV_PAGE_BITS))
     return 0;
 
 	/* if the page has been already allocated, return the page */
   if(*pte & PTE_V) {
-    return __va(*pte << RISCV_PAGE_BITS);
+    return __va(translate(vpn << RISCV_PAGE_BITS));
   }
 
 	/* otherwise, allocate one from the freemem */
@@ -109,15 +218,56 @@ alloc_page(uintptr_t vpn, int flags)
   return page;
 }
 
+/* allocate a zeroed megapage to a given megapage-aligned vpn
+ * returns VA of the megapage, (returns 0 if the slot is in use or
+ * no megapage is free) */
+uintptr_t
+alloc_megapage(uintptr_t vpn, int flags)
+{
+  uintptr_t page;
+  pte* pte = __walk_internal(root_page_table, vpn << RISCV_PAGE_BITS, 1,
+                             RISCV_MEGAPAGE_LEVEL, 0);
+
+  assert(IS_ALIGNED(vpn, RISCV_MEGAPAGE_ORDER));
+
+  if (!pte || *pte)
+    return 0;
+
+  page = spa_get_megapage_zero();
+  if (!page)
+    return 0;
+
+  *pte = pte_create(ppn(__pa(page)), PTE_D | PTE_A | PTE_V | flags);
+#ifdef USE_PAGING
+  paging_inc_user_pages(RISCV_MEGAPAGE_PAGES);
+#endif
+
+  return page;
+}
+
 uintptr_t
 realloc_page(uintptr_t vpn, int flags)
 {
   assert(flags & PTE_U);
 
+  if (split_megapage(vpn << RISCV_PAGE_BITS))
+    return 0;
+
   pte *pte = __walk(root_page_table, vpn << RISCV_PAGE_BITS);
   if(!pte)
     return 0;
 
+  /* no frame to point at yet; keep the page demand-zero */
+  if (__pte_is_demand_zero(*pte)) {
+    *pte = pte_create_invalid(0, flags | PTE_DZ);
+    return vpn << RISCV_PAGE_BITS;
+  }
+
+  /* device windows keep the permissions they were mapped with; the rest
+   * of the range is still changed */
+  if(*pte & PTE_IO)
+    return vpn << RISCV_PAGE_BITS;
+
   if(*pte & PTE_V) {
     *pte = pte_create(pte_ppn(*pte), flags);
     return __va(*pte << RISCV_PAGE_BITS);
@@ -126,18 +276,75 @@ realloc_page(uintptr_t vpn, int flags)
   return 0;
 }
 
-void
-free_page(uintptr_t vpn)
+/* Frames unmapped by free_page(s) are held here until tlb_shootdown() has
+ * run: a sibling thread on another hart may reach them through its TLB
+ * until then, so they must not be handed out again (or zeroed) before */
+#define FREE_BATCH_SIZE 32
+
+static struct {
+  uintptr_t page;
+  unsigned int order;
+} free_batch[FREE_BATCH_SIZE];
+static unsigned int free_batch_count;
+/* a valid PTE was cleared, frame or not (device pages have none) */
+static bool free_batch_unmapped;
+
+static void
+__free_batch_release(void)
+{
+  unsigned int i;
+
+  if (!free_batch_unmapped)
+    return;
+
+  tlb_shootdown();
+  free_batch_unmapped = false;
+  for (i = 0; i < free_batch_count; i++)
+    spa_put_contig(free_batch[i].page, free_batch[i].order);
+  free_batch_count = 0;
+}
+
+static void
+__free_batch_add(uintptr_t page, unsigned int order)
+{
+  if (free_batch_count == FREE_BATCH_SIZE)
+    __free_batch_release();
+
+  free_batch_unmapped = true;
+  free_batch[free_batch_count].page  = page;
+  free_batch[free_batch_count].order = order;
+  free_batch_count++;
+}
+
+/* unmap vpn; its frame (if any) goes to the free batch */
+static void
+__free_page(uintptr_t vpn)
 {
+  if (split_megapage(vpn << RISCV_PAGE_BITS)) {
+    warn("cannot split megapage to free vpn 0x%lx", vpn);
+    return;
+  }
 
   pte* pte = __walk(root_page_table, vpn << RISCV_PAGE_BITS);
 
+  if (pte && __pte_is_demand_zero(*pte)) {
+    *pte = 0;
+    return;
+  }
+
   // No such PTE, or invalid
   if(!pte || !(*pte & PTE_V))
     return;
 
   assert(*pte & PTE_U);
 
+  // A device page is only unmapped
+  if (*pte & PTE_IO) {
+    *pte = 0;
+    free_batch_unmapped = true;
+    return;
+  }
+
   uintptr_t ppn = pte_ppn(*pte);
   // Mark invalid
   // TODO maybe do more here
@@ -146,64 +353,205 @@ free_page(uintptr_t vpn)
 #ifdef USE_PAGING
   paging_dec_user_page();
 #endif
-  // Return phys page
-  spa_put(__va(ppn << RISCV_PAGE_BITS));
+  // Return phys page, once no TLB can reach it
+  __free_batch_add(__va(ppn << RISCV_PAGE_BITS), 0);
 
   return;
 
 }
 
-/* allocate n new pages from a given vpn
+void
+free_page(uintptr_t vpn)
+{
+  __free_page(vpn);
+  __free_batch_release();
+}
+
+/* true if [vpn, vpn + count) holds a whole, aligned megapage at vpn */
+static inline bool
+__megapage_fits(uintptr_t vpn, size_t count)
+{
+  return IS_ALIGNED(vpn, RISCV_MEGAPAGE_ORDER) &&
+         count >= RISCV_MEGAPAGE_PAGES;
+}
+
+/* allocate n new pages from a given vpn, using megapage leaves where
+ * alignment and size allow
  * returns the number of pages allocated */
 size_t
 alloc_pages(uintptr_t vpn, size_t count, int flags)
 {
-  unsigned int i;
-  for (i = 0; i < count; i++) {
+  size_t i = 0;
+  while (i < count) {
+    if (__megapage_fits(vpn + i, count - i) && alloc_megapage(vpn + i, flags)) {
+      i += RISCV_MEGAPAGE_PAGES;
+      continue;
+    }
+
     if(!alloc_page(vpn + i, flags))
       break;
+    i++;
   }
 
   return i;
 }
 
-void
-free_pages(uintptr_t vpn, size_t count){
-  unsigned int i;
-  for (i = 0; i < count; i++) {
-    free_page(vpn + i);
+/* map n pages from a given vpn without backing them yet. The PTEs are
+ * left invalid with PTE_DZ and the permissions set, and the first access
+ * to a page traps into handle_demand_zero_fault, which puts a zeroed frame
+ * in place. Aligned megapage spans get a single megapage-level entry.
+ * Pages that are already mapped are left alone.
+ * returns the number of pages mapped */
+size_t
+alloc_pages_lazy(uintptr_t vpn, size_t count, int flags)
+{
+  pte dz = pte_create_invalid(0, PTE_DZ | PTE_D | PTE_A | flags);
+  size_t i = 0;
+  int level;
+
+  while (i < count) {
+    uintptr_t va = (vpn + i) << RISCV_PAGE_BITS;
+    pte* pte;
+
+    if (__megapage_fits(vpn + i, count - i)) {
+      pte = __walk_internal(root_page_table, va, 1, RISCV_MEGAPAGE_LEVEL,
+                            &level);
+      if (!*pte) {
+        *pte = dz;
+        i += RISCV_MEGAPAGE_PAGES;
+        continue;
+      }
+    }
+
+    pte = __walk_create(root_page_table, va);
+    if (!pte)
+      break;
+
+    if (!*pte)
+      *pte = dz;
+    i++;
   }
 
+  return i;
 }
 
-/*
- * Check if a range of VAs contains any allocated pages, starting with
- * the given VA. Returns the number of sequential pages that meet the
- * conditions.
- */
+/* give the demand-zero page (or megapage) covering va its zeroed frame.
+ * A demand-zero megapage that cannot get a whole free megapage is split
+ * and only the touched page is backed.
+ * returns 0 on success, -1 if va is not demand-zero, is mapped PROT_NONE
+ * or memory ran out */
+int
+handle_demand_zero_fault(uintptr_t va)
+{
+  int level;
+  pte* pte = __walk_internal(root_page_table, va, 0, RISCV_PT_LEVELS, &level);
+  uintptr_t page;
+
+  if (!pte || !__pte_is_demand_zero(*pte))
+    return -1;
+
+  /* a PROT_NONE page is not backed: the access is a real fault */
+  if (!__pte_is_leaf(*pte))
+    return -1;
+
+  if (level == RISCV_MEGAPAGE_LEVEL) {
+    page = spa_get_megapage_zero();
+    if (page) {
+      *pte = pte_create(ppn(__pa(page)), *pte & PTE_FLAG_MASK & ~PTE_DZ);
+#ifdef USE_PAGING
+      paging_inc_user_pages(RISCV_MEGAPAGE_PAGES);
+#endif
+      goto done;
+    }
+
+    if (split_megapage(va))
+      return -1;
+    pte = __walk(root_page_table, va);
+  }
+
+  page = spa_get_zero();
+  if (!page)
+    return -1;
+
+  *pte = pte_create(ppn(__pa(page)), *pte & PTE_FLAG_MASK & ~PTE_DZ);
+#ifdef USE_PAGING
+  paging_inc_user_page();
+#endif
+
+done:
+  __asm__ volatile("sfence.vma %0" : : "r"(va) : "memory");
+  return 0;
+}
+
+/* change the permission of n pages from a given vpn; megapages that are
+ * only partially covered are split
+ * returns the number of pages changed */
 size_t
-test_va_range(uintptr_t vpn, size_t count){
+realloc_pages(uintptr_t vpn, size_t count, int flags)
+{
+  size_t i = 0;
+  while (i < count) {
+    pte* leaf = __megapage_of_va((vpn + i) << RISCV_PAGE_BITS);
+    /* a megapage entry without R/W/X would read as a page table pointer,
+     * so PROT_NONE always goes through the split path */
+    if (leaf && __megapage_fits(vpn + i, count - i) && __pte_is_leaf(flags)) {
+      assert(flags & PTE_U);
+      if (__pte_is_demand_zero(*leaf))
+        *leaf = pte_create_invalid(0, flags | PTE_DZ);
+      else
+        *leaf = pte_create(pte_ppn(*leaf), flags);
+      i += RISCV_MEGAPAGE_PAGES;
+      continue;
+    }
 
-  unsigned int i;
-  /* Validate the region */
-  for (i = 0; i < count; i++) {
-    pte* pte = __walk_internal(root_page_table, (vpn+i) << RISCV_PAGE_BITS, 0);
-    // If the page exists and is valid then we cannot use it
-    if(pte && *pte){
+    if(!realloc_page(vpn + i, flags))
       break;
-    }
+    i++;
   }
+
   return i;
 }
 
+void
+free_pages(uintptr_t vpn, size_t count){
+  size_t i = 0;
+  while (i < count) {
+    pte* leaf = __megapage_of_va((vpn + i) << RISCV_PAGE_BITS);
+    if (leaf && __megapage_fits(vpn + i, count - i)) {
+      assert(*leaf & PTE_U);
+      if (__pte_is_demand_zero(*leaf)) {
+        *leaf = 0;
+        i += RISCV_MEGAPAGE_PAGES;
+        continue;
+      }
+
+      uintptr_t ppn = pte_ppn(*leaf);
+      *leaf = 0;
+#ifdef USE_PAGING
+      paging_dec_user_pages(RISCV_MEGAPAGE_PAGES);
+#endif
+      __free_batch_add(__va(ppn << RISCV_PAGE_BITS), RISCV_MEGAPAGE_ORDER);
+      i += RISCV_MEGAPAGE_PAGES;
+      continue;
+    }
+
+    __free_page(vpn + i);
+    i++;
+  }
+
+  __free_batch_release();
+}
+
 /* get a mapped physical address for a VA */
 uintptr_t
 translate(uintptr_t va)
 {
-  pte* pte = __walk(root_page_table, va);
+  int level;
+  pte* pte = __walk_internal(root_page_table, va, 0, RISCV_PT_LEVELS, &level);
 
   if(pte && (*pte & PTE_V))
-    return (pte_ppn(*pte) << RISCV_PAGE_BITS) | (RISCV_PAGE_OFFSET(va));
+    return (pte_ppn(*pte) << RISCV_PAGE_BITS) |
+           (va & MASK(RISCV_GET_LVL_PGSIZE_BITS(level)));
   else
     return 0;
 }
@@ -216,7 +564,6 @@ pte_of_va(uintptr_t va)
   return pte;
 }
 
-
 void
 __map_with_reserved_page_table_32(uintptr_t dram_base,
                                uintptr_t dram_size,
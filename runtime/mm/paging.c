@@ -3,6 +3,7 @@
 #include "mm/paging.h"
 
 #include "mm/page_swap.h"
+#include "mm/vaspace.h"
 #include "mm/vm.h"
 
 uintptr_t paging_pa_start;
@@ -17,8 +18,6 @@ static uintptr_t paging_backing_storage_size;
 
 static uintptr_t paging_user_page_count = 0;
 
-extern uintptr_t rt_trap_table;
-
 void paging_inc_user_page(void)
 {
   paging_user_page_count++;
@@ -30,11 +29,21 @@ void paging_dec_user_page(void)
   assert(paging_user_page_count >= 0);
 }
 
+void paging_inc_user_pages(uintptr_t count)
+{
+  paging_user_page_count += count;
+}
+
+void paging_dec_user_pages(uintptr_t count)
+{
+  assert(paging_user_page_count >= count);
+  paging_user_page_count -= count;
+}
+
 void init_paging(uintptr_t user_pa_start, uintptr_t user_pa_end)
 {
   uintptr_t addr = 0;
   uintptr_t size = 0;
-  uintptr_t* trap_table = &rt_trap_table;
 
   /* query if there is backing store */
   int ret = sbi_query_multimem(&size);
@@ -61,6 +70,9 @@ void init_paging(uintptr_t user_pa_start, uintptr_t user_pa_end)
   pswap_init();
   debug("BACK: 0x%lx-0x%lx (%u KB), va 0x%lx", addr, addr + size, size/1024, paging_backing_storage_addr);
 
+  /* the backing store window must never be handed out by mmap */
+  vaspace_reserve(vpn(EYRIE_PAGING_START), size >> RISCV_PAGE_BITS);
+
   /* create VA mapping, we don't give execution perm */
   map_with_reserved_page_table(addr, size, EYRIE_PAGING_START, paging_l2_page_table, paging_l3_page_table);
   /*
@@ -68,10 +80,7 @@ void init_paging(uintptr_t user_pa_start, uintptr_t user_pa_end)
                        ppn(addr), size >> RISCV_PAGE_BITS,
                        PTE_R | PTE_W | PTE_D | PTE_A);
   */
-  /* register page fault handler */
-  trap_table[RISCV_EXCP_INST_PAGE_FAULT] = (uintptr_t) paging_handle_page_fault;
-  trap_table[RISCV_EXCP_LOAD_PAGE_FAULT] = (uintptr_t) paging_handle_page_fault;
-  trap_table[RISCV_EXCP_STORE_PAGE_FAULT] = (uintptr_t) paging_handle_page_fault;
+  /* page faults now reach paging_handle_page_fault via handle_page_fault */
 
   paging_user_page_count = (user_pa_end - user_pa_start) >> RISCV_PAGE_BITS;
 
@@ -105,13 +114,18 @@ __traverse_page_table_and_pick_internal(
     if(level == 1 ||
         (entry & PTE_R) || (entry & PTE_W) || (entry & PTE_X))
     {
-      if ((entry & PTE_U) && (entry & PTE_V))
+      /* device pages have no frame that could be swapped out */
+      if ((entry & PTE_U) && (entry & PTE_V) && !(entry & PTE_IO))
       {
-        *count = *count - 1;
-      }
+        /* a megapage leaf stands for all the 4 KiB pages it covers */
+        uintptr_t leaf_bits = RISCV_PT_INDEX_BITS * (level - 1);
+        uintptr_t pages     = BIT(leaf_bits);
+
+        if (*count <= pages)
+          return (virt_addr << leaf_bits) + ((*count - 1) << RISCV_PAGE_BITS);
 
-      if (*count == 0)
-        return virt_addr;
+        *count = *count - pages;
+      }
     }
     else
     {
@@ -182,12 +196,24 @@ uintptr_t paging_evict_and_free_one(uintptr_t swap_va)
   uintptr_t target_va, dest_va, src_pa;
   pte* target_pte;
 
-  target_va = __pick_page();
+  do {
+    target_va = __pick_page();
 
-  if(!target_va) {
-    warn("**** failed to pick frame to evict");
-    return 0;
-  }
+    if(!target_va) {
+      warn("**** failed to pick frame to evict");
+      return 0;
+    }
+
+    /* only 4 KiB pages are swapped; break up a megapage victim first.
+     * The split allocates a page table and may evict the target itself,
+     * in which case we pick again */
+    if (split_megapage(target_va)) {
+      warn("**** failed to split megapage to evict");
+      return 0;
+    }
+
+    target_pte = pte_of_va(target_va);
+  } while (!target_pte || !(*target_pte & PTE_V));
 
   /* find the destination to swap out */
   if(swap_va)
@@ -200,8 +226,7 @@ uintptr_t paging_evict_and_free_one(uintptr_t swap_va)
                    paging_backing_storage_size);
 
   /* evict & load */
-  target_pte = pte_of_va(target_va);
-  assert(target_pte && (*target_pte & PTE_U));
+  assert(*target_pte & PTE_U);
 
   src_pa = pte_ppn(*target_pte) << RISCV_PAGE_BITS;
   page_swap_epm(dest_va, __va(src_pa), swap_va);
@@ -211,7 +236,8 @@ uintptr_t paging_evict_and_free_one(uintptr_t swap_va)
       *target_pte & PTE_FLAG_MASK);
   paging_dec_user_page();
 
-  tlb_flush();
+  /* the frame is reused as soon as this returns */
+  tlb_shootdown();
 
   return src_pa;
 }
@@ -0,0 +1,410 @@
+#include "mm/vaspace.h"
+
+#include "mm/common.h"
+#include "mm/freemem.h"
+#include "mm/vm_defs.h"
+
+/* This file implements the virtual address allocator that backs
+ * mmap/munmap/mprotect/brk. The managed window is described by the set of
+ * *free* extents; anything not covered by an extent is in use.
+ *
+ * Extents live in an AVL tree keyed by their first VPN. Each node also
+ * keeps the largest extent size of its subtree (max_count), which lets
+ * vaspace_alloc() descend straight to the lowest-addressed extent that is
+ * large enough instead of probing the page table page by page.
+ *
+ * Tree nodes are carved out of pages taken from the page allocator and
+ * recycled through a private free list; they are never given back. */
+
+static struct va_extent* vaspace_root;
+static struct va_extent* vaspace_free_nodes;
+static uintptr_t vaspace_start;
+static uintptr_t vaspace_end;
+
+static struct va_extent*
+__node_get(void)
+{
+  struct va_extent* node;
+
+  if (!vaspace_free_nodes) {
+    uintptr_t page = spa_get();
+    if (!page)
+      return 0;
+
+    for (node = (struct va_extent*) page;
+         (uintptr_t) (node + 1) <= page + RISCV_PAGE_SIZE;
+         node++) {
+      node->right        = vaspace_free_nodes;
+      vaspace_free_nodes = node;
+    }
+  }
+
+  node               = vaspace_free_nodes;
+  vaspace_free_nodes = node->right;
+  return node;
+}
+
+static void
+__node_put(struct va_extent* node)
+{
+  node->right        = vaspace_free_nodes;
+  vaspace_free_nodes = node;
+}
+
+/* AVL tree helpers */
+static inline int
+__height(struct va_extent* n)
+{
+  return n ? n->height : 0;
+}
+
+static inline uintptr_t
+__max_count(struct va_extent* n)
+{
+  return n ? n->max_count : 0;
+}
+
+static void
+__update(struct va_extent* n)
+{
+  int hl = __height(n->left), hr = __height(n->right);
+  uintptr_t ml = __max_count(n->left), mr = __max_count(n->right);
+
+  n->height    = 1 + (hl > hr ? hl : hr);
+  n->max_count = n->count;
+  if (ml > n->max_count)
+    n->max_count = ml;
+  if (mr > n->max_count)
+    n->max_count = mr;
+}
+
+static struct va_extent*
+__rotate_right(struct va_extent* n)
+{
+  struct va_extent* l = n->left;
+  n->left             = l->right;
+  l->right            = n;
+  __update(n);
+  __update(l);
+  return l;
+}
+
+static struct va_extent*
+__rotate_left(struct va_extent* n)
+{
+  struct va_extent* r = n->right;
+  n->right            = r->left;
+  r->left             = n;
+  __update(n);
+  __update(r);
+  return r;
+}
+
+static struct va_extent*
+__balance(struct va_extent* n)
+{
+  int diff;
+
+  __update(n);
+  diff = __height(n->left) - __height(n->right);
+
+  if (diff > 1) {
+    if (__height(n->left->left) < __height(n->left->right))
+      n->left = __rotate_left(n->left);
+    return __rotate_right(n);
+  }
+
+  if (diff < -1) {
+    if (__height(n->right->right) < __height(n->right->left))
+      n->right = __rotate_right(n->right);
+    return __rotate_left(n);
+  }
+
+  return n;
+}
+
+static struct va_extent*
+__insert(struct va_extent* root, struct va_extent* node)
+{
+  if (!root) {
+    node->left = node->right = 0;
+    __update(node);
+    return node;
+  }
+
+  if (node->vpn < root->vpn)
+    root->left = __insert(root->left, node);
+  else
+    root->right = __insert(root->right, node);
+
+  return __balance(root);
+}
+
+static struct va_extent*
+__remove_min(struct va_extent* root, struct va_extent** min)
+{
+  if (!root->left) {
+    *min = root;
+    return root->right;
+  }
+
+  root->left = __remove_min(root->left, min);
+  return __balance(root);
+}
+
+/* unlink the node whose key is vpn; the node itself is not freed */
+static struct va_extent*
+__remove(struct va_extent* root, uintptr_t vpn)
+{
+  struct va_extent* succ;
+
+  if (!root)
+    return 0;
+
+  if (vpn < root->vpn) {
+    root->left = __remove(root->left, vpn);
+  } else if (vpn > root->vpn) {
+    root->right = __remove(root->right, vpn);
+  } else {
+    if (!root->right)
+      return root->left;
+
+    root->right = __remove_min(root->right, &succ);
+    succ->left  = root->left;
+    succ->right = root->right;
+    return __balance(succ);
+  }
+
+  return __balance(root);
+}
+
+/* the extent with the greatest start VPN that is <= vpn */
+static struct va_extent*
+__floor(uintptr_t vpn)
+{
+  struct va_extent* n    = vaspace_root;
+  struct va_extent* best = 0;
+
+  while (n) {
+    if (n->vpn <= vpn) {
+      best = n;
+      n    = n->right;
+    } else {
+      n = n->left;
+    }
+  }
+
+  return best;
+}
+
+/* the lowest-addressed extent that can hold count pages */
+static struct va_extent*
+__first_fit(size_t count)
+{
+  struct va_extent* n = vaspace_root;
+
+  if (__max_count(n) < count)
+    return 0;
+
+  while (n) {
+    if (__max_count(n->left) >= count)
+      n = n->left;
+    else if (n->count >= count)
+      return n;
+    else
+      n = n->right;
+  }
+
+  return 0;
+}
+
+/* clamp [*vpn, *vpn + *count) to the managed window */
+static bool
+__clip(uintptr_t* vpn, size_t* count)
+{
+  uintptr_t start = *vpn;
+  uintptr_t end   = *vpn + *count;
+
+  if (start < vaspace_start)
+    start = vaspace_start;
+  if (end > vaspace_end)
+    end = vaspace_end;
+
+  if (end <= start)
+    return false;
+
+  *vpn   = start;
+  *count = end - start;
+  return true;
+}
+
+void
+vaspace_init(uintptr_t start_vpn, uintptr_t end_vpn)
+{
+  struct va_extent* node;
+
+  assert(start_vpn && start_vpn < end_vpn);
+
+  vaspace_root  = 0;
+  vaspace_start = start_vpn;
+  vaspace_end   = end_vpn;
+
+  node = __node_get();
+  assert(node);
+
+  node->vpn    = start_vpn;
+  node->count  = end_vpn - start_vpn;
+  vaspace_root = __insert(vaspace_root, node);
+}
+
+/* allocate count contiguous pages
+ * returns the first VPN of the range, or 0 if no range is large enough */
+uintptr_t
+vaspace_alloc(size_t count)
+{
+  struct va_extent* e;
+  uintptr_t vpn;
+
+  if (!count)
+    return 0;
+
+  e = __first_fit(count);
+  if (!e)
+    return 0;
+
+  vpn          = e->vpn;
+  vaspace_root = __remove(vaspace_root, vpn);
+
+  if (e->count == count) {
+    __node_put(e);
+  } else {
+    e->vpn += count;
+    e->count -= count;
+    vaspace_root = __insert(vaspace_root, e);
+  }
+
+  return vpn;
+}
+
+/* allocate count contiguous pages starting at a multiple of 2^order pages
+ * returns the first VPN of the range, or 0 if no range is large enough */
+uintptr_t
+vaspace_alloc_aligned(size_t count, unsigned int order)
+{
+  uintptr_t vpn, aligned, slack = BIT(order) - 1;
+
+  if (!count)
+    return 0;
+
+  /* over-allocate, then hand the unaligned head and tail back */
+  vpn = vaspace_alloc(count + slack);
+  if (!vpn)
+    return 0;
+
+  aligned = ROUND_UP(vpn, order);
+  if (aligned > vpn)
+    vaspace_release(vpn, aligned - vpn);
+  if (aligned + count < vpn + count + slack)
+    vaspace_release(aligned + count, vpn + slack - aligned);
+
+  return aligned;
+}
+
+/* mark a specific range as used. The part of the range that lies outside
+ * the managed window is ignored.
+ * returns 0 on success, -1 if some page in the range is already in use */
+int
+vaspace_reserve(uintptr_t vpn, size_t count)
+{
+  struct va_extent *e, *tail = 0;
+  uintptr_t e_end;
+
+  if (!__clip(&vpn, &count))
+    return 0;
+
+  e = __floor(vpn);
+  if (!e || e->vpn + e->count < vpn + count)
+    return -1;
+
+  e_end = e->vpn + e->count;
+
+  /* reserving from the middle splits the extent in two */
+  if (e->vpn < vpn && vpn + count < e_end) {
+    tail = __node_get();
+    if (!tail)
+      return -1;
+  }
+
+  vaspace_root = __remove(vaspace_root, e->vpn);
+
+  if (e->vpn < vpn) {
+    e->count     = vpn - e->vpn;
+    vaspace_root = __insert(vaspace_root, e);
+    e            = tail;
+  }
+
+  if (vpn + count < e_end) {
+    e->vpn       = vpn + count;
+    e->count     = e_end - e->vpn;
+    vaspace_root = __insert(vaspace_root, e);
+  } else if (e) {
+    __node_put(e);
+  }
+
+  return 0;
+}
+
+/* give a range back. Releasing pages that are already free is harmless;
+ * the range is merged with any free neighbours.
+ * returns 0 on success, -1 if no tree node could be allocated */
+int
+vaspace_release(uintptr_t vpn, size_t count)
+{
+  struct va_extent *e, *node = 0;
+  uintptr_t start, end;
+
+  if (!__clip(&vpn, &count))
+    return 0;
+
+  start = vpn;
+  end   = vpn + count;
+
+  /* absorb every free extent that overlaps or touches [start, end) */
+  while ((e = __floor(end)) && e->vpn + e->count >= start) {
+    if (e->vpn < start)
+      start = e->vpn;
+    if (e->vpn + e->count > end)
+      end = e->vpn + e->count;
+
+    vaspace_root = __remove(vaspace_root, e->vpn);
+    if (node)
+      __node_put(node);
+    node = e;
+  }
+
+  if (!node)
+    node = __node_get();
+
+  if (!node) {
+    warn("vaspace: out of extent nodes, leaking 0x%lx pages", end - start);
+    return -1;
+  }
+
+  node->vpn    = start;
+  node->count  = end - start;
+  vaspace_root = __insert(vaspace_root, node);
+  return 0;
+}
+
+/* returns true if no page of the range (within the window) is free */
+bool
+vaspace_is_mapped(uintptr_t vpn, size_t count)
+{
+  struct va_extent* e;
+
+  if (!__clip(&vpn, &count))
+    return true;
+
+  e = __floor(vpn + count - 1);
+  return !(e && e->vpn + e->count > vpn);
+}
@@ -8,8 +8,12 @@
 #include "call/sbi.h"
 #include "mm/freemem.h"
 #include "mm/mm.h"
+#include "mm/vaspace.h"
 #include "sys/env.h"
 #include "mm/paging.h"
+#include "sys/profile.h"
+#include "eyrie_utm.h"
+#include "call/strace.h"
 #include "loader/elf.h"
 #include "loader/loader.h"
 
@@ -24,6 +28,22 @@ size_t utm_size;
 /* defined in entry.S */
 extern void* encl_trap_handler;
 
+/* keep mmap away from eapp segments linked into the anonymous region */
+void
+reserve_elf_va(elf_t* elf)
+{
+  for (unsigned int i = 0; i < elf_getNumProgramHeaders(elf); i++) {
+    if (elf_getProgramHeaderType(elf, i) != PT_LOAD) {
+      continue;
+    }
+
+    uintptr_t start = PAGE_DOWN(elf_getProgramHeaderVaddr(elf, i));
+    uintptr_t end   = PAGE_UP(elf_getProgramHeaderVaddr(elf, i) +
+                              elf_getProgramHeaderMemorySize(elf, i));
+    vaspace_reserve(vpn(start), vpn(end - start));
+  }
+}
+
 int verify_and_load_elf_file(uintptr_t ptr, size_t file_size, bool is_eapp) {
   int ret = 0;
   // validate elf 
@@ -44,15 +64,153 @@ int verify_and_load_elf_file(uintptr_t ptr, size_t file_size, bool is_eapp) {
   if (is_eapp) { // setup entry point
     uintptr_t entry = elf_getEntryPoint(&elf_file);
     csr_write(sepc, entry);
+    reserve_elf_va(&elf_file);
   }
   return ret;
 }
 
-/* initialize free memory with a simple page allocator*/
+/* initialize free memory with a simple page allocator. The boot image in
+ * front of freemem (loader, runtime and eapp) is managed as well, as in
+ * use, so that reclaim_boot_memory can hand its dead pages back */
 void
 init_freemem()
 {
-  spa_init(freemem_va_start, freemem_size);
+  uintptr_t epm_va_start = __va(load_pa_start);
+
+  spa_init_used(epm_va_start, freemem_va_start - epm_va_start,
+                freemem_va_start + freemem_size - epm_va_start);
+}
+
+/* mark the frames in [first_pfn, first_pfn + npages) that the page table
+ * under tb still uses: the tables themselves and the frames behind valid
+ * leaves. Leaves of the linear map of the EPM do not count. */
+static void
+__mark_used_frames(pte* tb, int level, uintptr_t va, uintptr_t first_pfn,
+                   uintptr_t npages, uint8_t* used)
+{
+  uintptr_t linear_end = freemem_va_start + freemem_size;
+  uintptr_t i, pfn, pages, entry_va;
+
+  for (i = 0; i < BIT(RISCV_PT_INDEX_BITS); i++) {
+    if (!(tb[i] & PTE_V))
+      continue;
+
+    entry_va = va | (i << RISCV_GET_LVL_PGSIZE_BITS(level));
+#if __riscv_xlen == 64
+    /* sign-extend the top index bit */
+    if (level == 1 && (i & BIT(RISCV_PT_INDEX_BITS - 1)))
+      entry_va |= ~MASK(RISCV_GET_LVL_PGSIZE_BITS(1) + RISCV_PT_INDEX_BITS);
+#endif
+
+    pfn   = pte_ppn(tb[i]);
+    pages = BIT(RISCV_GET_LVL_PGSIZE_BITS(level) - RISCV_PAGE_BITS);
+
+    if (level < RISCV_PT_LEVELS && !(tb[i] & (PTE_R | PTE_W | PTE_X))) {
+      pages = 1;
+      __mark_used_frames((pte*) __va(pfn << RISCV_PAGE_BITS), level + 1,
+                         entry_va, first_pfn, npages, used);
+    } else if (entry_va >= EYRIE_LOAD_START && entry_va < linear_end) {
+      continue;
+    }
+
+    for (; pages > 0; pages--, pfn++) {
+      if (pfn >= first_pfn && pfn < first_pfn + npages)
+        used[(pfn - first_pfn) / 8] |= BIT((pfn - first_pfn) % 8);
+    }
+  }
+}
+
+/* give the pages of the boot image that nothing maps anymore back to the
+ * page allocator: the loader binary, ELF headers and sections that are not
+ * loaded, and the pages whose contents loadElf copied elsewhere. The eapp
+ * ELF header must not be needed after this. */
+void
+reclaim_boot_memory(uintptr_t dram_base, uintptr_t free_paddr)
+{
+  uintptr_t first_pfn = ppn(dram_base);
+  uintptr_t npages    = (free_paddr - dram_base) >> RISCV_PAGE_BITS;
+  uintptr_t bitmap_pages = PAGE_UP((npages + 7) / 8) >> RISCV_PAGE_BITS;
+  unsigned int order  = 0;
+  uintptr_t i, freed  = 0;
+  uint8_t* used;
+
+  while (BIT(order) < bitmap_pages)
+    order++;
+
+  used = (uint8_t*) spa_get_contig_zero(order);
+  if (!used) {
+    warn("no memory to reclaim the boot image");
+    return;
+  }
+
+  /* the root table may sit in the loader image */
+  __mark_used_frames(root_page_table, 1, 0, first_pfn, npages, used);
+  i = ppn(kernel_va_to_pa(root_page_table));
+  if (i >= first_pfn && i < first_pfn + npages)
+    used[(i - first_pfn) / 8] |= BIT((i - first_pfn) % 8);
+
+  for (i = 0; i < npages; i++) {
+    if (used[i / 8] & BIT(i % 8))
+      continue;
+
+    spa_put(__va(dram_base + (i << RISCV_PAGE_BITS)));
+    freed++;
+  }
+
+  spa_put_contig((uintptr_t) used, order);
+
+  debug("RECLAIMED: %lu of %lu boot image pages (%lu KB)",
+        freed, npages, (freed << RISCV_PAGE_BITS) / 1024);
+}
+
+/* initialize the anonymous VA allocator. On rv32 the runtime and the
+ * untrusted window sit inside the anonymous region, so carve them out. */
+void
+init_vaspace()
+{
+  uintptr_t anon_end = EYRIE_ANON_REGION_END;
+
+  if (RUNTIME_VA_START < anon_end)
+    anon_end = RUNTIME_VA_START;
+
+  vaspace_init(vpn(EYRIE_ANON_REGION_START), vpn(anon_end));
+  vaspace_reserve(vpn(EYRIE_UNTRUSTED_START), vpn(PAGE_UP(shared_buffer_size)));
+}
+
+/* The host may set aside areas at the start of the UTM (eyrie_utm.h).
+ * Edge calls start after them whether or not the runtime uses them. */
+void
+init_utm_areas()
+{
+  struct eyrie_utm_header header;
+  uintptr_t reserved, area;
+
+  /* the host may change the header at any time, so use one copy of it */
+  memcpy(&header, (void*) shared_buffer, sizeof(header));
+  if (header.magic != EYRIE_UTM_MAGIC)
+    return;
+
+  /* each area at most the UTM, so that their sum cannot overflow */
+  if (header.profile_size % sizeof(uint64_t) ||
+      header.strace_size % sizeof(uint64_t) ||
+      header.profile_size > shared_buffer_size ||
+      header.strace_size > shared_buffer_size ||
+      EYRIE_UTM_RESERVED(&header) + RISCV_PAGE_SIZE > shared_buffer_size) {
+    printf("[runtime] UTM areas do not fit the UTM\r\n");
+    return;
+  }
+  reserved = EYRIE_UTM_RESERVED(&header);
+  area     = shared_buffer + sizeof(header);
+
+  #ifdef USE_PROFILER
+  profile_init(area, header.profile_size);
+  #endif /* USE_PROFILER */
+  area += header.profile_size;
+
+  strace_init(area, header.strace_size);
+
+  shared_buffer += reserved;
+  shared_buffer_size -= reserved;
 }
 
 /* initialize user stack */
@@ -65,6 +223,7 @@ init_user_stack_and_env(ELF(Ehdr) *hdr)
   size_t stack_count = EYRIE_USER_STACK_SIZE >> RISCV_PAGE_BITS;
 
   // allocated stack pages right below the runtime
+  vaspace_reserve(vpn(stack_end), stack_count);
   count = alloc_pages(vpn(stack_end), stack_count,
       PTE_R | PTE_W | PTE_D | PTE_A | PTE_U);
 
@@ -109,14 +268,11 @@ eyrie_boot(uintptr_t dummy, // $a0 contains the return value from the SBI
 
   /* initialize free memory */
   init_freemem();
+  init_vaspace();
 
   /* load eapp elf */
   assert(!verify_and_load_elf_file(__va(user_paddr), free_paddr-user_paddr, true));
 
-  /* free leaking memory */
-  // TODO: clean up after loader -- entire file no longer needed
-  // TODO: load elf file doesn't map some pages; those can be re-used. runtime and eapp.
-
   //TODO: This should be set by walking the userspace vm and finding
   //highest used addr. Instead we start partway through the anon space
   set_program_break(EYRIE_ANON_REGION_START + (1024 * 1024 * 1024));
@@ -128,6 +284,12 @@ eyrie_boot(uintptr_t dummy, // $a0 contains the return value from the SBI
   /* initialize user stack */
   init_user_stack_and_env((ELF(Ehdr) *) __va(user_paddr));
 
+  /* free the parts of the loader, runtime and eapp images left unmapped */
+  reclaim_boot_memory(dram_base, free_paddr);
+
+  /* skip what the host set aside at the start of the UTM */
+  init_utm_areas();
+
   /* prepare edge & system calls */
   init_edge_internals();
 
@@ -7,10 +7,11 @@
 #include "sys/timex.h"
 #include "sys/interrupt.h"
 #include "util/printf.h"
+#include "mm/freemem.h"
+#include "sys/thread.h"
+#include "sys/profile.h"
 #include <asm/csr.h>
 
-#define DEFAULT_CLOCK_DELAY 10000
-
 void init_timer(void)
 {
   sbi_set_timer(get_cycles64() + DEFAULT_CLOCK_DELAY);
@@ -21,6 +22,14 @@ void init_timer(void)
 void handle_timer_interrupt()
 {
   sbi_stop_enclave(0);
+#if SPA_ZERO_REFILL_BATCH > 0
+  /* top up the pre-zeroed pages while we are off the user's path, unless
+   * another thread is in the runtime */
+  if (rt_trylock()) {
+    spa_refill_zero_pool(SPA_ZERO_REFILL_BATCH);
+    rt_unlock();
+  }
+#endif
   unsigned long next_cycle = get_cycles64() + DEFAULT_CLOCK_DELAY;
   sbi_set_timer(next_cycle);
   csr_set(sstatus, SR_SPIE);
@@ -33,6 +42,9 @@ void handle_interrupts(struct encl_ctx* regs)
 
   switch(cause) {
     case INTERRUPT_CAUSE_TIMER:
+#ifdef USE_PROFILER
+      profile_sample(regs);
+#endif
       handle_timer_interrupt();
       break;
     /* ignore other interrupts */
@@ -0,0 +1,107 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "sys/profile.h"
+
+#ifdef USE_PROFILER
+
+#include <asm/csr.h>
+
+#include "eyrie_utm.h"
+#include "mm/mm.h"
+#include "mm/vm.h"
+#include "sys/interrupt.h"
+#include "sys/thread.h"
+#include "util/string.h"
+
+/* Sampling profiler. On every timer tick that interrupts the eapp, the
+ * runtime records the interrupted pc and the return addresses found by
+ * following the frame pointers (s0) of the eapp, which therefore needs to
+ * be built with -fno-omit-frame-pointer for more than the pc. A leaf
+ * function that keeps ra in its register does not show up as a caller.
+ * Without frame pointers s0 holds anything, so the walk only follows
+ * frames that lie on the stack of the thread, above the interrupted sp,
+ * each one above the last.
+ *
+ * Samples go to the profile area the host reserved in the UTM (see
+ * eyrie_utm.h), where the host reads them once the enclave has exited. */
+
+static struct eyrie_profile_header* profile;
+static struct eyrie_profile_sample* profile_samples;
+static uint64_t profile_capacity;
+static uint64_t profile_taken;
+
+/* starts profiling into the area the host set aside in the UTM */
+void
+profile_init(uintptr_t area, size_t size) {
+  if (size < sizeof(struct eyrie_profile_header) +
+                 sizeof(struct eyrie_profile_sample))
+    return;
+
+  profile          = (struct eyrie_profile_header*)area;
+  profile_samples  = (struct eyrie_profile_sample*)(profile + 1);
+  profile_capacity = (size - sizeof(*profile)) /
+                     sizeof(struct eyrie_profile_sample);
+
+  profile->period   = DEFAULT_CLOCK_DELAY;
+  profile->capacity = profile_capacity;
+  profile->taken    = 0;
+}
+
+/* reads a word of the eapp without faulting, 0 if it is not mapped for
+ * the eapp to read. Device pages are not in the linear map of the runtime,
+ * and reading them could have side effects anyway */
+static int
+profile_read_user(uintptr_t va, uintptr_t* val) {
+  pte* p = pte_of_va(va);
+  uintptr_t pa;
+
+  if (!p || (*p & (PTE_V | PTE_U | PTE_R)) != (PTE_V | PTE_U | PTE_R) ||
+      (*p & PTE_IO))
+    return 0;
+
+  pa   = translate(va);
+  *val = *(uintptr_t*)__va(pa);
+  return 1;
+}
+
+void
+profile_sample(struct encl_ctx* ctx) {
+  struct eyrie_profile_sample sample;
+  struct rt_thread* self;
+  uintptr_t fp, prev, ra, top;
+  uint64_t n;
+
+  /* ticks that interrupt the runtime itself are not counted */
+  if (!profile || (ctx->sstatus & SR_SPP))
+    return;
+
+  self         = rt_thread_current();
+  sample.tid   = self->tid;
+  sample.depth = 1;
+  sample.pc[0] = ctx->regs.sepc;
+
+  /* the page tables only hold still while no thread is in the runtime */
+  if (rt_trylock()) {
+    top  = self->user_stack_top;
+    prev = ctx->regs.sp;
+    fp   = ctx->regs.s0;
+    while (sample.depth < EYRIE_PROFILE_DEPTH &&
+           fp >= prev + 2 * sizeof(uintptr_t) && fp <= top &&
+           !(fp % (2 * sizeof(uintptr_t))) &&
+           profile_read_user(fp - sizeof(uintptr_t), &ra) && ra) {
+      sample.pc[sample.depth++] = ra;
+      prev = fp;
+      if (!profile_read_user(fp - 2 * sizeof(uintptr_t), &fp))
+        break;
+    }
+    rt_unlock();
+  }
+
+  n = __atomic_fetch_add(&profile_taken, 1, __ATOMIC_RELAXED);
+  memcpy(&profile_samples[n % profile_capacity], &sample, sizeof(sample));
+  __atomic_fetch_add(&profile->taken, 1, __ATOMIC_RELEASE);
+}
+
+#endif /* USE_PROFILER */
@@ -0,0 +1,254 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#define _GNU_SOURCE
+#include "sys/thread.h"
+
+#include <errno.h>
+#include <sched.h>
+
+#include "call/sbi.h"
+#include "call/syscall.h"
+#include "mm/freemem.h"
+#include "sys/interrupt.h"
+#include "uaccess.h"
+#include "util/string.h"
+
+/* Threads of the eapp (clone with CLONE_VM | CLONE_THREAD) run in thread
+ * contexts of the SM, which the host runs on harts of their own. Every
+ * thread traps onto a kernel stack of its own (sscratch is per hart), but
+ * all other runtime state is shared and guarded by one lock, held for the
+ * whole of every syscall and page fault. The lock nests, as a syscall may
+ * fault on user memory.
+ *
+ * rt_threads[tid] mirrors the SM context tid; thread 0 is the one the host
+ * started. A thread finds itself by looking up which kernel stack its stack
+ * pointer is on. Kernel stacks are not aligned to their size in virtual
+ * memory, as the EPM need not be, so sp cannot simply be masked. */
+
+extern char kernel_stack_end[];
+extern void rt_thread_entry(struct rt_thread* t);
+
+static struct rt_thread rt_threads[RT_MAX_THREADS] = {
+  [0] = { .state = RT_THREAD_RUNNING, .user_stack_top = EYRIE_USER_STACK_START },
+};
+
+static int rt_lock_owner = -1;
+static unsigned int rt_lock_depth;
+
+/* failed attempts after which a waiting thread hands its hart back to the
+ * host, so that it does not starve the host thread of the holder */
+#define RT_LOCK_SPINS 1000
+
+struct rt_thread*
+rt_thread_current(void) {
+  uintptr_t sp;
+  uintptr_t main_top = (uintptr_t) kernel_stack_end;
+
+  int tid;
+
+  __asm__ volatile("mv %0, sp" : "=r"(sp));
+  if (sp <= main_top && sp > main_top - RT_MAIN_STACK_SIZE)
+    return &rt_threads[0];
+
+  for (tid = 1; tid < RT_MAX_THREADS; tid++) {
+    if (sp <= rt_threads[tid].stack_top && sp > rt_threads[tid].stack)
+      return &rt_threads[tid];
+  }
+
+  /* not on a kernel stack of ours, which only the boot code is */
+  return &rt_threads[0];
+}
+
+/* true if threads other than the caller may be running eapp code on other
+ * harts. A thread that is out of the enclave gets a clean TLB when it is
+ * run again, as the SM flushes it on the way in */
+int
+rt_thread_siblings(void) {
+  struct rt_thread* self = rt_thread_current();
+  int tid;
+
+  for (tid = 0; tid < RT_MAX_THREADS; tid++) {
+    if (&rt_threads[tid] != self &&
+        __atomic_load_n(&rt_threads[tid].state, __ATOMIC_RELAXED) != RT_THREAD_FREE)
+      return 1;
+  }
+  return 0;
+}
+
+int
+rt_trylock(void) {
+  int self = rt_thread_current()->tid;
+  int free = -1;
+
+  if (__atomic_load_n(&rt_lock_owner, __ATOMIC_RELAXED) == self) {
+    rt_lock_depth++;
+    return 1;
+  }
+  if (!__atomic_compare_exchange_n(&rt_lock_owner, &free, self, 0,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return 0;
+
+  rt_lock_depth = 1;
+  return 1;
+}
+
+void
+rt_lock(void) {
+  unsigned int spins = 0;
+
+  while (!rt_trylock()) {
+    if (++spins == RT_LOCK_SPINS) {
+      sbi_stop_enclave(STOP_TIMER_INTERRUPT);
+      spins = 0;
+    }
+  }
+}
+
+void
+rt_unlock(void) {
+  if (--rt_lock_depth == 0)
+    __atomic_store_n(&rt_lock_owner, -1, __ATOMIC_RELEASE);
+}
+
+/* first code of a new thread, on its kernel stack (see rt_thread_entry):
+ * fill in the trap frame that returns to user mode */
+void
+rt_thread_init(struct rt_thread* t, struct encl_ctx* frame) {
+  memcpy(frame, &t->start_ctx, sizeof(struct encl_ctx));
+  init_timer();
+}
+
+/* The child returns from the syscall with a0 = 0 on the stack newsp and,
+ * with CLONE_SETTLS, the thread pointer tls. Called with the lock held */
+uintptr_t
+rt_clone(struct encl_ctx* ctx, unsigned long flags, uintptr_t newsp,
+         int* ptid, uintptr_t tls, int* ctid) {
+  struct rt_thread* t;
+  int tid, linux_tid;
+
+  if (!(flags & CLONE_VM) || !(flags & CLONE_THREAD)) {
+    debug("clone without CLONE_VM | CLONE_THREAD (flags %lx) not supported", flags);
+    return -ENOSYS;
+  }
+
+  for (tid = 1; tid < RT_MAX_THREADS; tid++) {
+    t = &rt_threads[tid];
+    if (t->state == RT_THREAD_RUNNING)
+      continue;
+
+    /* kernel stacks are kept for the next thread in the slot */
+    if (!t->stack) {
+      t->stack = spa_get_contig(RT_THREAD_STACK_ORDER);
+      if (!t->stack)
+        return -ENOMEM;
+      t->stack_top = t->stack + RT_THREAD_STACK_SIZE;
+    }
+
+    t->tid = tid;
+    t->clear_tid = (flags & CLONE_CHILD_CLEARTID) ? ctid : NULL;
+    t->futex = 0;
+    memcpy(&t->start_ctx, ctx, sizeof(struct encl_ctx));
+    t->start_ctx.regs.a0 = 0;
+    t->user_stack_top = rt_thread_current()->user_stack_top;
+    if (newsp) {
+      t->start_ctx.regs.sp = newsp;
+      t->user_stack_top    = newsp;
+    }
+    if (flags & CLONE_SETTLS)
+      t->start_ctx.regs.tp = tls;
+
+    /* the child may run before this returns */
+    linux_tid = RT_TID(tid);
+    if (flags & CLONE_PARENT_SETTID)
+      copy_to_user(ptid, &linux_tid, sizeof(int));
+    if (flags & CLONE_CHILD_SETTID)
+      copy_to_user(ctid, &linux_tid, sizeof(int));
+
+    /* fails while the SM context still belongs to an exiting thread */
+    if (sbi_create_thread(tid, (uintptr_t) rt_thread_entry, (uintptr_t) t))
+      continue;
+
+    t->state = RT_THREAD_RUNNING;
+    return linux_tid;
+  }
+
+  return -EAGAIN;
+}
+
+/* FUTEX_WAIT and FUTEX_WAKE on private futexes. A waiter drops the lock and
+ * hands its hart back to the host until it is woken; a timed wait gives up
+ * after one round, which callers see as a spurious wakeup */
+uintptr_t
+rt_futex(int* uaddr, int op, int val, void* timeout) {
+  struct rt_thread* self = rt_thread_current();
+  struct rt_thread* t;
+  int cur, woken = 0, i;
+
+  switch (op & ~FUTEX_PRIVATE_FLAG) {
+    case FUTEX_WAIT:
+      if (copy_from_user(&cur, uaddr, sizeof(int)))
+        return -EFAULT;
+      if (cur != val)
+        return -EAGAIN;
+
+      self->futex_woken = 0;
+      self->futex       = (uintptr_t) uaddr;
+      rt_unlock();
+      do {
+        sbi_stop_enclave(STOP_TIMER_INTERRUPT);
+      } while (!timeout && !__atomic_load_n(&self->futex_woken, __ATOMIC_ACQUIRE));
+      rt_lock();
+      self->futex = 0;
+      return 0;
+
+    case FUTEX_WAKE:
+      for (i = 0; i < RT_MAX_THREADS && woken < val; i++) {
+        t = &rt_threads[i];
+        if (t->futex == (uintptr_t) uaddr && !t->futex_woken) {
+          __atomic_store_n(&t->futex_woken, 1, __ATOMIC_RELEASE);
+          woken++;
+        }
+      }
+      return woken;
+
+    default:
+      debug("futex op %x not supported", op);
+      return -ENOSYS;
+  }
+}
+
+uintptr_t
+rt_gettid(void) {
+  return RT_TID(rt_thread_current()->tid);
+}
+
+void
+rt_set_clear_tid(int* tidptr) {
+  rt_thread_current()->clear_tid = tidptr;
+}
+
+/* Called with the lock held. Thread 0 ends the enclave run, any other
+ * thread only gives its SM context back */
+void
+rt_thread_exit(uintptr_t retval) {
+  struct rt_thread* self = rt_thread_current();
+  int zero = 0;
+
+  if (self->tid == 0) {
+    rt_unlock();
+    sbi_exit_enclave(retval);
+    return;
+  }
+
+  /* pthread_join waits on this */
+  if (self->clear_tid) {
+    copy_to_user(self->clear_tid, &zero, sizeof(int));
+    rt_futex(self->clear_tid, FUTEX_WAKE, 1, NULL);
+  }
+
+  self->state = RT_THREAD_EXITING;
+  rt_unlock();
+  sbi_exit_enclave(retval);
+}
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+
+#include "../mm/freemem.c"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "mock.h"
+
+#define REGION_SIZE (16 * RISCV_MEGAPAGE_SIZE)
+
+void
+sbi_exit_enclave(uintptr_t code) {
+  exit(code);
+}
+
+uintptr_t
+__va(uintptr_t pa) {
+  return pa;
+}
+
+uintptr_t
+__pa(uintptr_t va) {
+  return va;
+}
+
+static uintptr_t region;
+
+/* a freemem region that starts `offset` pages past a megapage boundary */
+static void
+setup_region(size_t offset, size_t size) {
+  if (!region) {
+    region = (uintptr_t)aligned_alloc(RISCV_MEGAPAGE_SIZE, REGION_SIZE);
+    assert_non_null(region);
+  }
+  spa_init(region + offset * RISCV_PAGE_SIZE, size);
+}
+
+static uint64_t
+now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+test_lazy_init(void** state) {
+  setup_region(0, REGION_SIZE);
+
+  // Only the metadata pages are accounted for at boot
+  uintptr_t meta = spa_wild;
+  assert_true(meta > 0);
+  assert_int_equal(spa_available(), REGION_SIZE / RISCV_PAGE_SIZE - meta);
+
+  // The first allocation pulls in no more than one block
+  uintptr_t page = spa_get();
+  assert_int_equal(page, spa_base + meta * RISCV_PAGE_SIZE);
+  assert_true(spa_wild - meta <= BIT(SPA_MAX_ORDER));
+}
+
+static void
+test_exhaust_and_coalesce(void** state) {
+  setup_region(0, REGION_SIZE);
+
+  size_t avail   = spa_available();
+  uintptr_t* all = calloc(avail, sizeof(uintptr_t));
+  size_t n       = 0;
+  uintptr_t page;
+
+  while ((page = spa_get_zero())) {
+    assert_true(page >= region && page < region + REGION_SIZE);
+    assert_int_equal(*(uintptr_t*)page, 0);
+    // Mark the page so that a second hand-out of it would be noticed
+    *(uintptr_t*)page = 1;
+    all[n++] = page;
+  }
+  assert_int_equal(n, avail);
+  assert_int_equal(spa_available(), 0);
+
+  for (size_t i = 0; i < n; i++) spa_put(all[n - 1 - i]);
+  assert_int_equal(spa_available(), avail);
+
+  // Freed pages merge back into megapages; only the one holding the
+  // metadata cannot be whole again
+  size_t megapages = 0;
+  while ((page = spa_get_megapage())) {
+    assert_true(IS_ALIGNED(page, RISCV_MEGAPAGE_BITS));
+    megapages++;
+  }
+  assert_int_equal(megapages, REGION_SIZE / RISCV_MEGAPAGE_SIZE - 1);
+  free(all);
+}
+
+static void
+test_contig(void** state) {
+  // Start a few pages past the megapage boundary
+  setup_region(3, REGION_SIZE - 3 * RISCV_PAGE_SIZE);
+
+  for (unsigned int order = 0; order <= SPA_MAX_ORDER; order++) {
+    uintptr_t block = spa_get_contig_zero(order);
+    assert_true(block);
+    assert_true(IS_ALIGNED(block, RISCV_PAGE_BITS + order));
+    spa_put_contig(block, order);
+  }
+  assert_int_equal(spa_get_contig(SPA_MAX_ORDER + 1), 0);
+
+  // A split block can be returned one page at a time
+  uintptr_t block = spa_get_megapage();
+  size_t avail    = spa_available();
+  spa_split(block, SPA_MAX_ORDER);
+  for (size_t i = 0; i < RISCV_MEGAPAGE_PAGES; i++)
+    spa_put(block + i * RISCV_PAGE_SIZE);
+  assert_int_equal(spa_available(), avail + RISCV_MEGAPAGE_PAGES);
+  assert_int_equal(spa_get_megapage(), block);
+}
+
+static void
+test_used_prefix(void** state) {
+  setup_region(0, REGION_SIZE);
+  size_t used = RISCV_MEGAPAGE_SIZE + 5 * RISCV_PAGE_SIZE;
+  spa_init_used(region, used, REGION_SIZE);
+
+  // Nothing in the used prefix is handed out or counted as available
+  assert_int_equal(spa_available(), REGION_SIZE / RISCV_PAGE_SIZE - spa_wild);
+  uintptr_t page;
+  while ((page = spa_get_megapage())) assert_true(page >= region + used);
+
+  // Given back page by page, the prefix merges into a whole megapage
+  for (size_t i = 0; i < RISCV_MEGAPAGE_PAGES; i++)
+    spa_put(region + i * RISCV_PAGE_SIZE);
+  assert_int_equal(spa_get_megapage(), region);
+  spa_put(region + RISCV_MEGAPAGE_SIZE);
+  assert_int_equal(spa_get(), region + RISCV_MEGAPAGE_SIZE);
+}
+
+static void
+test_zero_pool(void** state) {
+  setup_region(0, REGION_SIZE);
+
+  size_t avail = spa_available();
+  assert_int_equal(spa_refill_zero_pool(SPA_ZERO_POOL_SIZE + 1), SPA_ZERO_POOL_SIZE);
+  assert_int_equal(spa_refill_zero_pool(1), 0);
+
+  // Pooled pages still count as available and come back zeroed
+  assert_int_equal(spa_available(), avail);
+  uintptr_t page = spa_get_zero();
+  assert_int_equal(spa_zero_count, SPA_ZERO_POOL_SIZE - 1);
+  for (size_t i = 0; i < RISCV_PAGE_SIZE / sizeof(uintptr_t); i++)
+    assert_int_equal(((uintptr_t*)page)[i], 0);
+  spa_put(page);
+
+  // Contiguous requests drain the pool once nothing else is left
+  size_t megapages = 0;
+  while (spa_get_megapage()) megapages++;
+  assert_int_equal(megapages, REGION_SIZE / RISCV_MEGAPAGE_SIZE - 1);
+  assert_int_equal(spa_zero_count, 0);
+}
+
+/* Microbenchmark: single-page churn and mixed-order allocation */
+static void
+bench_alloc(void** state) {
+  const size_t rounds = 200;
+  const size_t batch  = 1024;
+  uintptr_t pages[1024];
+  uint64_t start;
+
+  setup_region(0, REGION_SIZE);
+
+  start = now_ns();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < batch; i++) pages[i] = spa_get();
+    for (size_t i = 0; i < batch; i++) spa_put(pages[i]);
+  }
+  printf(
+      "[ BENCH ] get+put order 0: %.1f ns/pair\n",
+      (double)(now_ns() - start) / (rounds * batch));
+
+  start = now_ns();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < 64; i++)
+      pages[i] = spa_get_contig(i % (SPA_MAX_ORDER - 2));
+    for (size_t i = 0; i < 64; i++)
+      spa_put_contig(pages[i], i % (SPA_MAX_ORDER - 2));
+  }
+  printf(
+      "[ BENCH ] get+put mixed orders: %.1f ns/pair\n",
+      (double)(now_ns() - start) / (rounds * 64));
+
+  start = now_ns();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < SPA_ZERO_POOL_SIZE; i++) pages[i] = spa_get_zero();
+    for (size_t i = 0; i < SPA_ZERO_POOL_SIZE; i++) spa_put(pages[i]);
+  }
+  printf(
+      "[ BENCH ] get_zero+put, in line: %.1f ns/pair\n",
+      (double)(now_ns() - start) / (rounds * SPA_ZERO_POOL_SIZE));
+
+  uint64_t pooled = 0;
+  for (size_t r = 0; r < rounds; r++) {
+    spa_refill_zero_pool(SPA_ZERO_POOL_SIZE);
+    start = now_ns();
+    for (size_t i = 0; i < SPA_ZERO_POOL_SIZE; i++) pages[i] = spa_get_zero();
+    pooled += now_ns() - start;
+    for (size_t i = 0; i < SPA_ZERO_POOL_SIZE; i++) spa_put(pages[i]);
+  }
+  printf(
+      "[ BENCH ] get_zero from the pool: %.1f ns/get\n",
+      (double)pooled / (rounds * SPA_ZERO_POOL_SIZE));
+
+  start = now_ns();
+  for (size_t r = 0; r < rounds; r++) setup_region(0, REGION_SIZE);
+  printf(
+      "[ BENCH ] spa_init (%d MiB): %.1f ns\n", (int)(REGION_SIZE >> 20),
+      (double)(now_ns() - start) / rounds);
+}
+
+int
+main() {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_lazy_init),
+      cmocka_unit_test(test_exhaust_and_coalesce),
+      cmocka_unit_test(test_contig),
+      cmocka_unit_test(test_used_prefix),
+      cmocka_unit_test(test_zero_pool),
+      cmocka_unit_test(bench_alloc),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,143 @@
+#include "../mm/vaspace.c"
+
+#include <stdlib.h>
+
+#include "mock.h"
+
+#define WINDOW_START 0x1000
+#define WINDOW_PAGES 0x100000
+
+void
+sbi_exit_enclave(uintptr_t code) {
+  exit(code);
+}
+
+uintptr_t
+spa_get() {
+  void* page = aligned_alloc(RISCV_PAGE_SIZE, RISCV_PAGE_SIZE);
+  assert_non_null(page);
+  return (uintptr_t)page;
+}
+
+static int
+setup(void** state) {
+  vaspace_free_nodes = 0;
+  vaspace_init(WINDOW_START, WINDOW_START + WINDOW_PAGES);
+  return 0;
+}
+
+static void
+test_alloc_first_fit(void** state) {
+  setup(state);
+
+  uintptr_t a = vaspace_alloc(16);
+  uintptr_t b = vaspace_alloc(32);
+  uintptr_t c = vaspace_alloc(16);
+  assert_int_equal(a, WINDOW_START);
+  assert_int_equal(b, WINDOW_START + 16);
+  assert_int_equal(c, WINDOW_START + 48);
+
+  // A hole that is too small is skipped, one that fits is reused
+  assert_int_equal(vaspace_release(a, 16), 0);
+  assert_int_equal(vaspace_alloc(20), WINDOW_START + 64);
+  assert_int_equal(vaspace_alloc(8), WINDOW_START);
+
+  assert_int_equal(vaspace_alloc(WINDOW_PAGES), 0);
+  assert_int_equal(vaspace_alloc(0), 0);
+}
+
+static void
+test_alloc_aligned(void** state) {
+  setup(state);
+
+  assert_int_equal(vaspace_alloc(3), WINDOW_START);
+
+  // The aligned range skips ahead; the slack in front stays usable
+  uintptr_t a = vaspace_alloc_aligned(1024, 9);
+  assert_int_equal(a & 0x1ff, 0);
+  assert_true(a >= WINDOW_START + 3);
+  assert_int_equal(vaspace_alloc(1), WINDOW_START + 3);
+  assert_false(vaspace_is_mapped(a + 1024, 1));
+  assert_true(vaspace_is_mapped(a, 1024));
+}
+
+static void
+test_release_merges(void** state) {
+  setup(state);
+
+  uintptr_t a = vaspace_alloc(10);
+  uintptr_t b = vaspace_alloc(10);
+  uintptr_t c = vaspace_alloc(10);
+
+  assert_int_equal(vaspace_release(a, 10), 0);
+  assert_int_equal(vaspace_release(c, 10), 0);
+  assert_int_equal(vaspace_release(b, 10), 0);
+
+  // Everything has coalesced back into a single extent
+  assert_non_null(vaspace_root);
+  assert_null(vaspace_root->left);
+  assert_null(vaspace_root->right);
+  assert_int_equal(vaspace_root->count, WINDOW_PAGES);
+
+  // Releasing free pages again is harmless
+  assert_int_equal(vaspace_release(WINDOW_START + 5, 100), 0);
+  assert_int_equal(vaspace_root->count, WINDOW_PAGES);
+}
+
+static void
+test_reserve(void** state) {
+  setup(state);
+
+  // Splits the window around the reservation
+  assert_int_equal(vaspace_reserve(WINDOW_START + 100, 50), 0);
+  assert_false(vaspace_is_mapped(WINDOW_START, 100));
+  assert_true(vaspace_is_mapped(WINDOW_START + 100, 50));
+  assert_false(vaspace_is_mapped(WINDOW_START + 149, 2));
+
+  // Overlapping reservations fail and leave the tree untouched
+  assert_int_equal(vaspace_reserve(WINDOW_START + 90, 20), -1);
+  assert_false(vaspace_is_mapped(WINDOW_START + 90, 10));
+
+  // Ranges outside the window are ignored
+  assert_int_equal(vaspace_reserve(0, WINDOW_START), 0);
+  assert_true(vaspace_is_mapped(0, WINDOW_START));
+
+  assert_int_equal(vaspace_alloc(101), WINDOW_START + 150);
+  assert_int_equal(vaspace_alloc(100), WINDOW_START);
+}
+
+static void
+test_many_extents(void** state) {
+  setup(state);
+
+  // Fragment the window into many single-page holes, then make sure the
+  // allocator still finds the one large hole at the end.
+  for (int i = 0; i < 4096; i++) {
+    assert_int_equal(vaspace_alloc(2), WINDOW_START + 2 * i);
+  }
+  for (int i = 0; i < 4096; i++) {
+    assert_int_equal(vaspace_release(WINDOW_START + 2 * i, 1), 0);
+  }
+
+  assert_true(__height(vaspace_root) < 2 * 13);
+  assert_int_equal(vaspace_alloc(2), WINDOW_START + 2 * 4096);
+  assert_int_equal(vaspace_alloc(1), WINDOW_START);
+
+  for (int i = 0; i < 4096; i++) {
+    assert_int_equal(vaspace_release(WINDOW_START + 2 * i + 1, 1), 0);
+  }
+  assert_false(vaspace_is_mapped(WINDOW_START + 1, 8190));
+  assert_true(vaspace_is_mapped(WINDOW_START, 1));
+}
+
+int
+main() {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_alloc_first_fit),
+      cmocka_unit_test(test_alloc_aligned),
+      cmocka_unit_test(test_release_merges),
+      cmocka_unit_test(test_reserve),
+      cmocka_unit_test(test_many_extents),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
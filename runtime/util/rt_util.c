@@ -7,6 +7,10 @@
 #include "util/printf.h"
 #include "uaccess.h"
 #include "mm/vm.h"
+#include "sys/thread.h"
+#ifdef USE_PAGING
+#include "mm/paging.h"
+#endif
 
 // Statically allocated copy-buffer
 unsigned char rt_copy_buffer_1[RISCV_PAGE_SIZE];
@@ -69,7 +73,41 @@ void rt_page_fault(struct encl_ctx* ctx)
   return;
 }
 
+/* all page faults land here. The first touch of a demand-zero page is
+ * resolved in place; anything else is a swapped-out page or fatal */
+void handle_page_fault(struct encl_ctx* ctx)
+{
+  /* nests if the fault is on user memory during a syscall */
+  rt_lock();
+
+  if (!handle_demand_zero_fault(ctx->sbadaddr)) {
+    rt_unlock();
+    return;
+  }
+
+#ifdef USE_PAGING
+  paging_handle_page_fault(ctx);
+#else
+  if (ctx->scause == RISCV_EXCP_INST_PAGE_FAULT)
+    not_implemented_fatal(ctx);
+  else
+    rt_page_fault(ctx);
+#endif
+  rt_unlock();
+}
+
+/* Enough after adding mappings: only this hart needs to see them now */
 void tlb_flush(void)
 {
   __asm__ volatile("fence.i\t\nsfence.vma\t\n");
 }
+
+/* After removing a mapping or taking permissions away, the harts of the
+ * other threads have to drop what they cached as well. Frames that were
+ * unmapped may only go back to the allocator once this returns */
+void tlb_shootdown(void)
+{
+  tlb_flush();
+  if (rt_thread_siblings())
+    sbi_remote_sfence_vma_all();
+}
@@ -31,7 +31,8 @@ sleep 60
 export CALL_LOGFILE="$CMD_LOGFILE"
 echo "" > "$CALL_LOGFILE"
 
-KEYSTONE_COMMAND="modprobe keystone-driver" make call
+# the EPM pool checks its own alignment, then backs the tests below
+KEYSTONE_COMMAND="modprobe keystone-driver epm_pool_size=67108864 epm_pool_selftest=1" make call
 KEYSTONE_COMMAND="/usr/share/keystone/examples/tests.ke" make call
 KEYSTONE_COMMAND="/usr/share/keystone/examples/attestor.ke" make call
 KEYSTONE_COMMAND="poweroff" make call
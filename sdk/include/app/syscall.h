@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include "sealing.h"
 
+#include "shared/attest_batch.h"
 #include "shared/eyrie_call.h"
 
 #define SYSCALL(which, arg0, arg1, arg2, arg3, arg4, arg5)           \
@@ -51,6 +52,12 @@ untrusted_mmap();
 int
 attest_enclave(void* report, void* data, size_t size);
 
+/* count blobs back to back at data, blob i being sizes[i] bytes long */
+int
+attest_enclave_batch(
+    void* report, struct attest_batch_proof* proofs, const void* data,
+    const uint32_t* sizes, size_t count);
+
 int
 get_sealing_key(
     struct sealing_key* sealing_key_struct, size_t sealing_key_struct_size,
@@ -70,5 +77,7 @@ rt_print_string(void* string, size_t length);
 // SPIRS
 int spirs_hw_write_buffer(uintptr_t base_addr, void* user_buffer, size_t buffer_size);
 int spirs_hw_read_register(uintptr_t base_addr, uintptr_t offset, uint64_t *reg_out);
+/* maps the device window granted to the enclave, NULL if there is none */
+void* spirs_hw_map(uintptr_t* base_addr, size_t* size);
 
 #endif /* syscall.h */
@@ -34,7 +34,7 @@ class ElfFile {
 
   unsigned int getPageMode() { return (isRuntime ? RT_FULL : USER_FULL); }
 
-  /* libelf wrapper function */
+  /* libelf wrapper function; no program headers if not an ELF */
   size_t getNumProgramHeaders(void);
   size_t getProgramHeaderType(size_t ph);
   size_t getProgramHeaderFileSize(size_t ph);
@@ -56,6 +56,9 @@ class ElfFile {
   /* is this runtime binary */
   bool isRuntime;
 
+  /* parsed as an ELF; the loader is a flat binary */
+  bool isElf;
+
   /* libelf structure */
   elf_t elf;
 };
@@ -11,16 +11,23 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cerrno>
 #include <cstring>
 #include <functional>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "./common.h"
 extern "C" {
 #include "common/sha3.h"
+#include "shared/eyrie_utm.h"
 }
 #include "ElfFile.hpp"
+#include "EnclaveImage.hpp"
 #include "Error.hpp"
 #include "KeystoneDevice.hpp"
 #include "Memory.hpp"
@@ -39,7 +46,25 @@ class Enclave {
   KeystoneDevice* pDevice;
   void* shared_buffer;
   size_t shared_buffer_size;
+  /* start of the UTM if the areas of eyrie_utm.h precede the shared
+   * buffer, otherwise null */
+  struct eyrie_utm_header* utmHeader;
   OcallFunc oFuncDispatch;
+  /* host threads running the threads the enclave created */
+  std::vector<std::thread> threadRunners;
+  std::mutex threadRunnersLock;
+  std::atomic<bool> threadsExiting;
+  /* eventfd of runAsync(), -1 until then */
+  int asyncFd;
+  /* measurement of the image the enclave was created from */
+  char hash[MDSIZE];
+  Error driveThread(uintptr_t tid, Error ret, uintptr_t* value);
+  void startThread(uintptr_t tid);
+  void joinThreads();
+  void writeRunOutputs();
+  size_t getUtmSize();
+  uint64_t getBootPages();
+  void* getStraceArea();
   bool mapUntrusted(size_t size);
   void copyFile(uintptr_t filePtr, size_t fileSize);
   void allocUninitialized(ElfFile* elfFile);
@@ -57,6 +82,8 @@ class Enclave {
   void* getSharedBuffer();
   size_t getSharedBufferSize();
   Memory* getMemory();
+  /* MDSIZE bytes */
+  const char* getHash() { return hash; }
   uintptr_t getRuntimeElfAddr() { return runtimeElfAddr; }
   uintptr_t getEnclaveElfAddr() { return enclaveElfAddr; }
   Error registerOcallDispatch(OcallFunc func);
@@ -64,8 +91,18 @@ class Enclave {
   Error init(
       const char* eapppath, const char* runtimepath, const char* loaderpath, Params _params,
       uintptr_t alternatePhysAddr);
+  Error init(const EnclaveImage& image, Params _params);
+  Error init(const EnclaveImage& image, Params _params, uintptr_t alternatePhysAddr);
   Error destroy();
   Error run(uintptr_t* ret = nullptr);
+  Error runAsync(int* eventFd = nullptr);
+  Error pollAsync(uintptr_t* ret = nullptr);
+  Error resumeAsync();
+  int getEventFd() { return asyncFd; }
+  bool readProfile(std::vector<struct eyrie_profile_sample>* samples, uint64_t* taken);
+  Error writeProfile(const std::string& path);
+  bool readStrace(std::vector<struct eyrie_strace_record>* records, uint64_t* taken);
+  Error writeStrace(const std::string& path);
 };
 
 uint64_t
@@ -0,0 +1,58 @@
+//******************************************************************************
+// Copyright (c) 2020, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "./common.h"
+extern "C" {
+#include "common/sha3.h"
+}
+#include "ElfFile.hpp"
+#include "Error.hpp"
+
+namespace Keystone {
+
+/* The loader, runtime and eapp of an enclave, mapped and checked once, with
+ * the EPM they need and the measurement the SM will report for them. Any
+ * number of enclaves can be created from one image; once init() returned,
+ * the image is only read, so threads can share it. */
+class EnclaveImage {
+ public:
+  /* a binary as it is copied into the EPM: padded with zeros to pages */
+  struct File {
+    const void* ptr;
+    size_t size;
+    size_t pages;
+  };
+
+  EnclaveImage();
+  Error init(const char* eapppath, const char* runtimepath, const char* loaderpath);
+  bool isInitialized() const { return initialized; }
+
+  const File& getLoader() const { return loader; }
+  const File& getRuntime() const { return runtime; }
+  const File& getEapp() const { return eapp; }
+  /* pages of the binaries and their bss, freemem not included */
+  uint64_t getRequiredPages() const { return requiredPages; }
+  /* MDSIZE bytes */
+  const char* getHash() const { return hash; }
+
+ private:
+  std::unique_ptr<ElfFile> loaderFile;
+  std::unique_ptr<ElfFile> runtimeFile;
+  std::unique_ptr<ElfFile> eappFile;
+  File loader;
+  File runtime;
+  File eapp;
+  uint64_t requiredPages;
+  char hash[MDSIZE];
+  bool initialized;
+};
+
+}  // namespace Keystone
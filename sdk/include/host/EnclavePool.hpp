@@ -0,0 +1,68 @@
+//******************************************************************************
+// Copyright (c) 2020, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Enclave.hpp"
+#include "EnclaveImage.hpp"
+#include "Error.hpp"
+#include "Params.hpp"
+
+namespace Keystone {
+
+/* Keeps enclaves of one EnclaveImage created and finalized ahead of time, so that
+ * a caller that needs one only has to run it. A background thread tops the
+ * pool up to its size after every checkout; when the pool is empty, the
+ * caller creates the enclave itself. An enclave runs once, so the caller
+ * owns the enclave it checked out and destroys it by dropping it. */
+class EnclavePool {
+ public:
+  struct Stats {
+    uint64_t hits;          /* checkouts served from the pool */
+    uint64_t misses;        /* checkouts that had to create an enclave */
+    uint64_t created;       /* enclaves created, by the pool or on a miss */
+    uint64_t failed;        /* creations that failed */
+    uint64_t create_ns;     /* total time of the successful creations */
+    uint64_t max_create_ns;
+    double hitRate() const {
+      return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+    }
+    uint64_t avgCreateNs() const { return created ? create_ns / created : 0; }
+  };
+
+  EnclavePool();
+  ~EnclavePool();
+  Error init(
+      const char* eapppath, const char* runtimepath, const char* loaderpath,
+      Params params, size_t size);
+  std::unique_ptr<Enclave> checkout();
+  size_t getReady();
+  Stats getStats();
+
+ private:
+  EnclaveImage image;
+  Params params;
+  size_t size;
+
+  std::deque<std::unique_ptr<Enclave>> ready;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::thread filler;
+  bool stopping;
+  /* the last creation failed: wait for a checkout before trying again */
+  bool stalled;
+  Stats stats;
+
+  std::unique_ptr<Enclave> create();
+  void fill();
+};
+
+}  // namespace Keystone
@@ -25,6 +25,8 @@ enum class Error {
   PageAllocationFailure,
   EdgeCallHost,
   EnclaveInterrupted,
+  EnclaveNewThread,
+  EnclaveRunning,
 };
 
 }  // namespace Keystone
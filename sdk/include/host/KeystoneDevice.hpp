@@ -31,6 +31,10 @@ class KeystoneDevice {
  private:
   int fd;
   Error __run(bool resume, uintptr_t* ret);
+  Error __runAsync(bool resume);
+  Error __result(
+      uintptr_t sbiError, uintptr_t value, uintptr_t* ret, Error error,
+      const char* call);
 
  public:
   virtual uintptr_t getPhysAddr() { return physAddr; }
@@ -42,10 +46,16 @@ class KeystoneDevice {
   virtual uintptr_t initUTM(size_t size);
   virtual Error finalize(
       uintptr_t runtimePhysAddr, uintptr_t eappPhysAddr, uintptr_t freePhysAddr,
-      uintptr_t freeRequested);
+      uintptr_t freeRequested, uintptr_t devicePhysAddr = 0,
+      uintptr_t deviceSize = 0);
   virtual Error destroy();
   virtual Error run(uintptr_t* ret);
   virtual Error resume(uintptr_t* ret);
+  virtual Error runThread(uintptr_t tid, uintptr_t* ret);
+  virtual Error runAsync();
+  virtual Error resumeAsync();
+  virtual Error asyncResult(uintptr_t* ret);
+  virtual Error setEventFd(int efd);
   virtual void* map(uintptr_t addr, size_t size);
 };
 
@@ -55,17 +65,23 @@ class MockKeystoneDevice : public KeystoneDevice {
   void* sharedBuffer;
 
  public:
-  MockKeystoneDevice() {}
+  MockKeystoneDevice() : sharedBuffer(nullptr) {}
   ~MockKeystoneDevice();
   bool initDevice(Params params);
   Error create(uint64_t minPages);
   uintptr_t initUTM(size_t size);
   Error finalize(
       uintptr_t runtimePhysAddr, uintptr_t eappPhysAddr, uintptr_t freePhysAddr,
-      uintptr_t freeRequested);
+      uintptr_t freeRequested, uintptr_t devicePhysAddr = 0,
+      uintptr_t deviceSize = 0);
   Error destroy();
   Error run(uintptr_t* ret);
   Error resume(uintptr_t* ret);
+  Error runThread(uintptr_t tid, uintptr_t* ret);
+  Error runAsync();
+  Error resumeAsync();
+  Error asyncResult(uintptr_t* ret);
+  Error setEventFd(int efd);
   void* map(uintptr_t addr, size_t size);
 };
 
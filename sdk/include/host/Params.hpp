@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstdio>
+#include <string>
 
 #if __riscv_xlen == 64
 #define DEFAULT_FREEMEM_SIZE 1024 * 1024  // 1 MB
@@ -33,6 +34,11 @@ class Params {
   Params() {
     untrusted_size = DEFAULT_UNTRUSTED_SIZE;
     freemem_size   = DEFAULT_FREEMEM_SIZE;
+    profile_size   = 0;
+    strace_size    = 0;
+    device_base    = 0;
+    device_size    = 0;
+    simulated      = false;
   }
 
   void setUntrustedSize(uint64_t size) { untrusted_size = size; }
@@ -40,9 +46,48 @@ class Params {
   uintptr_t getUntrustedSize() { return untrusted_size; }
   uintptr_t getFreeMemSize() { return freemem_size; }
 
+  /* Profiling with a runtime built with USE_PROFILER: size of the sample
+   * area set aside in addition to the untrusted memory, and the file that
+   * run() writes the samples to as folded stacks */
+  void setProfileSize(uint64_t size) { profile_size = size; }
+  void setProfilePath(const std::string& path) { profile_path = path; }
+  uint64_t getProfileSize() { return profile_size; }
+  const std::string& getProfilePath() { return profile_path; }
+
+  /* Syscall tracing with a runtime built with USE_INTERNAL_STRACE: size of
+   * the trace area, set aside like the profile area, and the file that
+   * run() writes the trace to for keystone-strace */
+  void setStraceSize(uint64_t size) { strace_size = size; }
+  void setStracePath(const std::string& path) { strace_path = path; }
+  uint64_t getStraceSize() { return strace_size; }
+  const std::string& getStracePath() { return strace_path; }
+
+  /* MMIO window the enclave gets for itself, mapped into the eapp by the
+   * runtime; the SM only grants windows its platform lists, and takes
+   * them from the host for the life of the enclave */
+  void setDeviceWindow(uintptr_t base, uint64_t size) {
+    device_base = base;
+    device_size = size;
+  }
+  uintptr_t getDeviceBase() { return device_base; }
+  uint64_t getDeviceSize() { return device_size; }
+
+  /* Builds the enclave in host memory against a mock device, for tests
+   * on machines without the driver: nothing can run, but creation and
+   * measurement go through the same paths */
+  void setSimulated(bool _simulated) { simulated = _simulated; }
+  bool isSimulated() { return simulated; }
+
  private:
   uint64_t untrusted_size;
   uint64_t freemem_size;
+  uint64_t profile_size;
+  std::string profile_path;
+  uint64_t strace_size;
+  std::string strace_path;
+  uintptr_t device_base;
+  uint64_t device_size;
+  bool simulated;
 };
 
 }  // namespace Keystone
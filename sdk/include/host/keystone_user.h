@@ -26,6 +26,16 @@
   _IOR(KEYSTONE_IOC_MAGIC, 0x06, struct keystone_ioctl_create_enclave)
 #define KEYSTONE_IOC_UTM_INIT \
   _IOR(KEYSTONE_IOC_MAGIC, 0x07, struct keystone_ioctl_create_enclave)
+#define KEYSTONE_IOC_RUN_THREAD \
+  _IOR(KEYSTONE_IOC_MAGIC, 0x08, struct keystone_ioctl_run_thread)
+#define KEYSTONE_IOC_RUN_ENCLAVE_ASYNC \
+  _IOR(KEYSTONE_IOC_MAGIC, 0x09, struct keystone_ioctl_run_enclave)
+#define KEYSTONE_IOC_RESUME_ENCLAVE_ASYNC \
+  _IOR(KEYSTONE_IOC_MAGIC, 0x0a, struct keystone_ioctl_run_enclave)
+#define KEYSTONE_IOC_ENCLAVE_RESULT \
+  _IOR(KEYSTONE_IOC_MAGIC, 0x0b, struct keystone_ioctl_run_enclave)
+#define KEYSTONE_IOC_SET_EVENTFD \
+  _IOW(KEYSTONE_IOC_MAGIC, 0x0c, struct keystone_ioctl_eventfd)
 
 #define RT_NOEXEC 0
 #define USER_NOEXEC 1
@@ -45,6 +55,8 @@ struct keystone_ioctl_create_enclave {
   uintptr_t user_paddr;
   uintptr_t free_paddr;
   uintptr_t free_requested;
+  uintptr_t device_paddr;
+  uintptr_t device_size;
 
   // driver -> host
   uintptr_t epm_paddr;
@@ -58,4 +70,18 @@ struct keystone_ioctl_run_enclave {
   uintptr_t value;
 };
 
+// runs or resumes one thread of an enclave
+struct keystone_ioctl_run_thread {
+  uintptr_t eid;
+  uintptr_t tid;
+  uintptr_t error;
+  uintptr_t value;
+};
+
+// eventfd signalled whenever an asynchronous run stops, -1 for none
+struct keystone_ioctl_eventfd {
+  uintptr_t eid;
+  intptr_t fd;
+};
+
 #endif
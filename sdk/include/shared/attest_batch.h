@@ -0,0 +1,35 @@
+#ifndef __ATTEST_BATCH_H__
+#define __ATTEST_BATCH_H__
+
+/* Batch attestation. The SM hashes every blob of a batch into a leaf of a
+ * Merkle tree and signs one report whose data is
+ *
+ *   ATTEST_BATCH_TAG | number of blobs (32-bit little endian) | root
+ *
+ * Each blob comes with a proof that leads from its leaf to the root.
+ * Nodes are SHA3-256; a leaf is H(0x00 | blob) and an inner node
+ * H(0x01 | left | right). A node without a right sibling moves up a level
+ * unchanged. Plain attestations may not carry data that starts with the
+ * tag, so a report of this form always comes from a batch.
+ *
+ * Needs uint8_t and uint32_t, which the SM does not get from <stdint.h>. */
+
+#define ATTEST_BATCH_MAX        16
+#define ATTEST_BATCH_DEPTH      4   /* log2(ATTEST_BATCH_MAX) */
+#define ATTEST_BATCH_NODE_SIZE  32
+
+#define ATTEST_BATCH_TAG        "keystone-batch1"
+#define ATTEST_BATCH_TAG_LEN    16  /* including the terminating NUL */
+#define ATTEST_BATCH_DATA_LEN   (ATTEST_BATCH_TAG_LEN + 4 + ATTEST_BATCH_NODE_SIZE)
+
+#define ATTEST_BATCH_LEAF       0x00
+#define ATTEST_BATCH_INNER      0x01
+
+struct attest_batch_proof {
+  uint32_t index;  /* of the blob in the batch */
+  uint32_t count;  /* blobs in the batch */
+  /* from the leaf level up, levels where the node has no sibling skipped */
+  uint8_t siblings[ATTEST_BATCH_DEPTH][ATTEST_BATCH_NODE_SIZE];
+};
+
+#endif  // __ATTEST_BATCH_H__
@@ -10,11 +10,13 @@
 #define RUNTIME_SYSCALL_GET_CHAIN           1007
 #define RUNTIME_SYSCALL_CRYPTO_INTERFACE    1008
 #define RUNTIME_SYSCALL_PRINT_STRING        1009
+#define RUNTIME_SYSCALL_ATTEST_BATCH        1010
 #define RUNTIME_SYSCALL_EXIT                1101
 
 #define RUNTIME_SYSCALL_WRITE_BUFFER        1109
 #define RUNTIME_SYSCALL_READ_BUFFER         1110
 #define RUNTIME_SYSCALL_READ_REGISTER       1111
 #define RUNTIME_SYSCALL_WRITE_REGISTER      1112
+#define RUNTIME_SYSCALL_MAP_DEVICE          1113
 
 #endif  // __EYRIE_CALL_H__
@@ -0,0 +1,66 @@
+#ifndef __EYRIE_UTM_H__
+#define __EYRIE_UTM_H__
+
+/* Areas the host sets aside at the start of the untrusted memory (UTM)
+ * for the runtime to report into. Before the first run, the host describes
+ * them in a header at offset 0 of the UTM; the areas follow the header,
+ * and edge calls use the UTM after them. The start, unlike the end, is the
+ * same for both: the driver may hand out more UTM than the host asked for.
+ * The runtime leaves alone the areas of features it was not built with,
+ * and all of them if they do not fit.
+ *
+ * Needs uint32_t and uint64_t. */
+
+#define EYRIE_UTM_MAGIC 0x6d747565  /* "eutm" */
+
+struct eyrie_utm_header {
+  uint32_t magic;
+  uint32_t reserved;
+  uint64_t profile_size;  /* bytes, a multiple of 8; 0 for none */
+  uint64_t strace_size;   /* bytes, a multiple of 8; 0 for none */
+};
+
+/* the areas follow the header in this order */
+#define EYRIE_UTM_RESERVED(header)                             \
+  (sizeof(struct eyrie_utm_header) + (header)->profile_size + \
+   (header)->strace_size)
+
+/* Profile area: a header and a ring of samples the runtime takes on timer
+ * ticks (USE_PROFILER). Sample n of a run goes to slot n % capacity, so the
+ * area keeps the last capacity samples. */
+#define EYRIE_PROFILE_DEPTH 16
+
+struct eyrie_profile_header {
+  uint64_t period;    /* cycles between two ticks of a thread */
+  uint64_t capacity;  /* samples the area holds */
+  uint64_t taken;     /* samples taken */
+};
+
+struct eyrie_profile_sample {
+  uint32_t tid;
+  uint32_t depth;                    /* entries of pc in use */
+  uint64_t pc[EYRIE_PROFILE_DEPTH];  /* interrupted pc, then the return
+                                        addresses of its callers */
+};
+
+/* Syscall trace area: a header and a ring of one record per syscall of
+ * the eapp (USE_INTERNAL_STRACE), in the order the syscalls returned. A
+ * trace file the SDK writes has the same layout, with capacity set to
+ * the number of records that follow, oldest first. */
+struct eyrie_strace_header {
+  uint64_t capacity;  /* records the area holds */
+  uint64_t taken;     /* syscalls traced */
+};
+
+struct eyrie_strace_record {
+  uint64_t nr;
+  uint64_t args[6];
+  uint64_t ret;
+  uint64_t start;        /* cycle counter at entry */
+  uint64_t cycles;       /* from entry to return */
+  uint64_t host_cycles;  /* of those, spent in edge calls to the host */
+  uint32_t tid;
+  uint32_t reserved;
+};
+
+#endif  // __EYRIE_UTM_H__
@@ -18,6 +18,10 @@
 #define SBI_SM_PRINT_MESSAGE     2010
 #define SBI_GET_MEASURES         2011
 #define SBI_GIVE_INFO_TPM        2012
+#define SBI_SM_SCRUB_ENCLAVE_MEMORY 2013
+#define SBI_SM_RUN_THREAD        2014
+#define SBI_SM_GET_PERF_STATS    2015
+#define SBI_SM_DRAIN_TRACE       2016
 #define FID_RANGE_HOST           2999
 
 /* 3000-3999 are called by enclave */
@@ -34,6 +38,8 @@
 #define SBI_SM_WRITE_REGISTER    3011
 #define SBI_SM_WRITE_BUFFER      3012
 #define SBI_SM_READ_BUFFER       3013
+#define SBI_SM_CREATE_THREAD     3014
+#define SBI_SM_ATTEST_BATCH      3015
 #define FID_RANGE_ENCLAVE        3999
 
 /* 4000-4999 are experimental */
@@ -44,6 +50,8 @@
 #define SM_MULTIMEM_PLUGIN_ID   0x01
 #define SM_MULTIMEM_CALL_GET_SIZE 0x01
 #define SM_MULTIMEM_CALL_GET_ADDR 0x02
+#define SM_MULTIMEM_CALL_GET_DEVICE_SIZE 0x03
+#define SM_MULTIMEM_CALL_GET_DEVICE_ADDR 0x04
 
 /* Enclave stop reasons requested */
 #define STOP_TIMER_INTERRUPT  0
@@ -70,6 +78,8 @@ struct keystone_sbi_pregion_t {
 struct keystone_sbi_create_t {
   struct keystone_sbi_pregion_t epm_region;
   struct keystone_sbi_pregion_t utm_region;
+  // device window mapped into the enclave, size 0 for none
+  struct keystone_sbi_pregion_t device_region;
 
   uintptr_t runtime_paddr;
   uintptr_t user_paddr;
@@ -0,0 +1,47 @@
+#ifndef __SM_PERF_H__
+#define __SM_PERF_H__
+
+/* Performance counters of the SM, kept per hart and read by the host with
+ * SBI_SM_GET_PERF_STATS. An SM built with KEYSTONE_SM_NO_PERF=y keeps none
+ * and fails the call with SBI_ERR_SM_NOT_IMPLEMENTED.
+ *
+ * Needs uint64_t, which the SM does not get from <stdint.h>. */
+
+enum sm_perf_counter {
+  SM_PERF_CREATE = 0,
+  SM_PERF_DESTROY,
+  SM_PERF_RUN,        /* run_enclave and run_thread */
+  SM_PERF_RESUME,
+  SM_PERF_STOP,
+  SM_PERF_EXIT,
+  SM_PERF_ATTEST,     /* attest_enclave and attest_enclave_batch */
+  SM_PERF_KEYPAIR,
+  SM_PERF_CRYPTO,
+  SM_PERF_SWITCH_TO_ENCLAVE,
+  SM_PERF_SWITCH_TO_HOST,
+  SM_PERF_COUNTERS,
+};
+
+#define SM_PERF_COUNTER_NAMES                                     \
+  { "create", "destroy", "run", "resume", "stop", "exit",         \
+    "attest", "keypair", "crypto", "switch_to_enclave",           \
+    "switch_to_host" }
+
+/* Bucket 0 counts the calls of fewer than 2^(SM_PERF_HIST_SHIFT + 1)
+ * cycles, bucket i > 0 those of [2^(SHIFT + i), 2^(SHIFT + i + 1)) cycles
+ * and the last one also all longer calls */
+#define SM_PERF_HIST_BUCKETS 16
+#define SM_PERF_HIST_SHIFT   7
+
+struct sm_perf_counter_stats {
+  uint64_t count;
+  uint64_t cycles;      /* mcycle, summed over all calls */
+  uint64_t max_cycles;
+  uint64_t hist[SM_PERF_HIST_BUCKETS];
+};
+
+struct sm_perf_stats {
+  struct sm_perf_counter_stats counters[SM_PERF_COUNTERS];
+};
+
+#endif  // __SM_PERF_H__
@@ -0,0 +1,55 @@
+#ifndef __SM_TRACE_H__
+#define __SM_TRACE_H__
+
+/* Binary log of the SM. Every hart writes fixed-size records into a ring
+ * of its own in SM memory; the host drains a hart's ring with
+ * SBI_SM_DRAIN_TRACE. Records a full ring overwrote before they were
+ * drained show up as a gap in seq.
+ *
+ * Needs uint8_t, uint16_t, uint32_t and uint64_t, which the SM does not
+ * get from <stdint.h>. */
+
+#define SM_LOG_ERROR 0
+#define SM_LOG_WARN  1
+#define SM_LOG_INFO  2
+#define SM_LOG_DEBUG 3
+
+#define SM_LOG_LEVEL_NAMES { "error", "warn", "info", "debug" }
+
+enum sm_trace_event {
+  SM_TRACE_MSG = 0,        /* text, not NUL-terminated */
+  SM_TRACE_HART_INIT,      /* data: hart id (u32) */
+  SM_TRACE_SM_HASH,        /* measurement of the SM, in parts */
+  SM_TRACE_DEV_PUBKEY,
+  SM_TRACE_SM_SIGNATURE,   /* signature of the SM by the device key, in parts */
+  SM_TRACE_CERT_SM,        /* DER certificates, in parts */
+  SM_TRACE_CERT_DEV,
+  SM_TRACE_CERT_MAN,
+  SM_TRACE_ENCLAVE_CREATE, /* data: eid (u32) */
+  SM_TRACE_ENCLAVE_DESTROY,/* data: eid (u32) */
+  SM_TRACE_KEYPAIR,        /* data: eid (u32), public key */
+  SM_TRACE_CERT_LDEV,      /* DER certificate, in parts */
+  SM_TRACE_EVENTS,
+};
+
+#define SM_TRACE_EVENT_NAMES                                      \
+  { "msg", "hart_init", "sm_hash", "dev_pubkey", "sm_signature",  \
+    "cert_sm", "cert_dev", "cert_man", "enclave_create",          \
+    "enclave_destroy", "keypair", "cert_ldev" }
+
+#define SM_TRACE_DATA_SIZE 48
+
+struct sm_trace_record {
+  uint64_t time;     /* mtime */
+  uint32_t seq;      /* per hart, counting from 0 */
+  uint16_t event;
+  uint8_t level;
+  uint8_t len;       /* bytes of data used; bit 7 set if the next record
+                        continues this one */
+  uint8_t data[SM_TRACE_DATA_SIZE];
+};
+
+#define SM_TRACE_MORE      0x80
+#define SM_TRACE_LEN_MASK  0x7f
+
+#endif  // __SM_TRACE_H__
@@ -7,8 +7,11 @@
 #include <iostream>
 #include <string>
 #include "Keys.hpp"
+extern "C" {
 #include "common/sha3.h"
+}
 #include "ed25519/ed25519.h"
+#include "shared/attest_batch.h"
 #include "verifier/json11.h"
 
 struct enclave_report_t {
@@ -46,6 +49,11 @@ class Report {
       const byte* expected_enclave_hash, const byte* expected_sm_hash,
       const byte* dev_public_key);
   int checkSignaturesOnly(const byte* dev_public_key);
+  /* for a report from attest_enclave_batch: whether data is one of the
+   * blobs of the batch. Check the report itself with verify() */
+  int isBatch();
+  int verifyBatchProof(
+      const byte* data, size_t len, const struct attest_batch_proof* proof);
   void* getDataSection();
   size_t getDataSize();
   byte* getEnclaveHash();
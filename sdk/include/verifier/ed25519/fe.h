@@ -9,9 +9,22 @@
     An element t, entries t[0]...t[9], represents the integer
     t[0]+2^26 t[1]+2^51 t[2]+2^77 t[3]+2^102 t[4]+...+2^230 t[9].
     Bounds on each t[i] vary depending on context.
+
+    Where the compiler has 128 bit integers, i.e. on 64-bit targets, an
+    element t is t[0]...t[4] instead and represents the integer
+    t[0]+2^51 t[1]+2^102 t[2]+2^153 t[3]+2^204 t[4]. Define
+    ED25519_NO_FE51 to use the 32-bit version there as well.
 */
 
+#if defined(__SIZEOF_INT128__) && !defined(ED25519_NO_FE51)
+#define ED25519_FE51
+#endif
+
+#ifdef ED25519_FE51
+typedef uint64_t fe[5];
+#else
 typedef int32_t fe[10];
+#endif
 
 void
 fe_0(fe h);
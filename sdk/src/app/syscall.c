@@ -24,6 +24,14 @@ attest_enclave(void* report, void* data, size_t size) {
   return SYSCALL_3(RUNTIME_SYSCALL_ATTEST_ENCLAVE, report, data, size);
 }
 
+int
+attest_enclave_batch(
+    void* report, struct attest_batch_proof* proofs, const void* data,
+    const uint32_t* sizes, size_t count) {
+  return SYSCALL_5(
+      RUNTIME_SYSCALL_ATTEST_BATCH, report, proofs, data, sizes, count);
+}
+
 /* returns sealing key */
 int
 get_sealing_key(
@@ -53,12 +61,78 @@ int
 rt_print_string(void* string, size_t length){
   return SYSCALL_2(RUNTIME_SYSCALL_PRINT_STRING, string, length);
 }
+
+void* spirs_hw_map(uintptr_t* base_addr, size_t* size)
+{
+  return (void*)SYSCALL_2(RUNTIME_SYSCALL_MAP_DEVICE, base_addr, size);
+}
+
+/* The device window of the enclave, if the host declared one, is mapped
+ * into the eapp once and then accessed with plain loads and stores.
+ * Accesses outside of it still go through the runtime and the SM.
+ * Threads may probe at the same time; the runtime hands all of them the
+ * same mapping, and the release store of spirs_window_probed publishes
+ * the window to the others */
+static volatile uint8_t* spirs_window;
+static uintptr_t spirs_window_base;
+static size_t spirs_window_size;
+static int spirs_window_probed;
+
+static volatile uint8_t*
+spirs_hw_window(uintptr_t base_addr, size_t len)
+{
+  volatile uint8_t* window;
+  uintptr_t window_base;
+  size_t window_size;
+
+  if (__atomic_load_n(&spirs_window_probed, __ATOMIC_ACQUIRE)) {
+    window      = __atomic_load_n(&spirs_window, __ATOMIC_RELAXED);
+    window_base = __atomic_load_n(&spirs_window_base, __ATOMIC_RELAXED);
+    window_size = __atomic_load_n(&spirs_window_size, __ATOMIC_RELAXED);
+  } else {
+    window_base = 0;
+    window_size = 0;
+    window = spirs_hw_map(&window_base, &window_size);
+    __atomic_store_n(&spirs_window, window, __ATOMIC_RELAXED);
+    __atomic_store_n(&spirs_window_base, window_base, __ATOMIC_RELAXED);
+    __atomic_store_n(&spirs_window_size, window_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&spirs_window_probed, 1, __ATOMIC_RELEASE);
+  }
+
+  if (!window || base_addr < window_base || len > window_size ||
+      base_addr - window_base > window_size - len)
+    return NULL;
+  return window + (base_addr - window_base);
+}
+
 int spirs_hw_write_buffer(uintptr_t base_addr, void* user_buffer, size_t buffer_size)
 {
-  return SYSCALL_3(RUNTIME_SYSCALL_WRITE_BUFFER, base_addr, (uintptr_t)user_buffer, buffer_size);
+  volatile uint8_t* dst = spirs_hw_window(base_addr, buffer_size);
+  const uint8_t* src = user_buffer;
+  size_t i = 0;
+
+  if (!dst)
+    return SYSCALL_3(RUNTIME_SYSCALL_WRITE_BUFFER, base_addr, (uintptr_t)user_buffer, buffer_size);
+
+  if (((uintptr_t)dst & 7) == 0) {
+    for (; i + 8 <= buffer_size; i += 8) {
+      uint64_t word;
+      __builtin_memcpy(&word, src + i, 8);
+      *(volatile uint64_t*)(dst + i) = word;
+    }
+  }
+  for (; i < buffer_size; i++)
+    dst[i] = src[i];
+  return 0;
 }
 
 int spirs_hw_read_register(uintptr_t base_addr, uintptr_t offset, uint64_t *reg_out)
 {
+  volatile uint64_t* reg;
+
+  if (((base_addr + offset) & 7) == 0 && (reg = (volatile uint64_t*)spirs_hw_window(base_addr + offset, 8))) {
+    *reg_out = *reg;
+    return 0;
+  }
   return SYSCALL_3(RUNTIME_SYSCALL_READ_REGISTER, base_addr, offset, reg_out);
 }
@@ -19,6 +19,7 @@ fstatFileSize(int filep) {
 ElfFile::ElfFile(std::string filename) {
   fileSize = 0;
   ptr      = NULL;
+  isElf    = false;
   filep    = open(filename.c_str(), O_RDONLY);
 
   if (filep < 0) {
@@ -40,6 +41,7 @@ ElfFile::ElfFile(std::string filename) {
   if (elf_newFile(ptr, fileSize, &elf)) {
     return;
   }
+  isElf = true;
 
   /* get bound vaddrs */
   elf_getMemoryBounds(&elf, VIRTUAL, &minVaddr, &maxVaddr);
@@ -51,9 +53,40 @@ ElfFile::ElfFile(std::string filename) {
   maxVaddr = ROUND_UP(maxVaddr, PAGE_BITS);
 }
 
+/* the file could be opened and mapped */
+bool
+ElfFile::isValid() {
+  return fileSize && ptr != NULL && ptr != MAP_FAILED;
+}
+
 ElfFile::~ElfFile() {
   close(filep);
   munmap(ptr, fileSize);
 }
 
+size_t
+ElfFile::getNumProgramHeaders(void) {
+  return isElf ? elf_getNumProgramHeaders(&elf) : 0;
+}
+
+size_t
+ElfFile::getProgramHeaderType(size_t ph) {
+  return elf_getProgramHeaderType(&elf, ph);
+}
+
+size_t
+ElfFile::getProgramHeaderFileSize(size_t ph) {
+  return elf_getProgramHeaderFileSize(&elf, ph);
+}
+
+size_t
+ElfFile::getProgramHeaderMemorySize(size_t ph) {
+  return elf_getProgramHeaderMemorySize(&elf, ph);
+}
+
+uintptr_t
+ElfFile::getProgramHeaderVaddr(size_t ph) {
+  return elf_getProgramHeaderVaddr(&elf, ph);
+}
+
 }  // namespace Keystone
@@ -4,8 +4,15 @@
 //------------------------------------------------------------------------------
 #include "Enclave.hpp"
 #include <math.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <algorithm>
+#include <cinttypes>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
 extern "C" {
 #include "common/sha3.h"
 #include "shared/keystone_user.h"
@@ -15,47 +22,104 @@ extern "C" {
 
 namespace Keystone {
 
-Enclave::Enclave() {
+Enclave::Enclave()
+    : pMemory(nullptr),
+      pDevice(nullptr),
+      utmHeader(nullptr),
+      threadsExiting(false),
+      asyncFd(-1) {
 }
 
 Enclave::~Enclave() {
   destroy();
 }
 
+/* Tables below the root that map the pages in [start, end) of a Sv39
+ * address space: one per 2 MiB and one per 1 GiB of it. Collected by
+ * level and index, so that ranges sharing a table count it once. An upper
+ * bound for Sv32 */
+static void
+page_tables_of(uintptr_t start, uintptr_t end, std::set<uintptr_t>* tables) {
+  if (start >= end) {
+    return;
+  }
+  for (int bits : {21, 30}) {
+    for (uintptr_t i = start >> bits; i <= (end - 1) >> bits; i++) {
+      tables->insert(i << 1 | (bits == 30));
+    }
+  }
+}
+
+/* Pages the loader (for the runtime) or the runtime (for the eapp) takes
+ * from freemem to load an ELF: the page holding the start of a segment
+ * that does not start on a page, the pages from the last partial page of
+ * the file image to the end of .bss, and the page tables. Pages wholly in
+ * the file image are mapped in place */
+static uint64_t
+elf_load_pages(ElfFile* elfFile) {
+  std::set<uintptr_t> tables;
+  uint64_t pages = 0;
+
+  for (size_t i = 0; i < elfFile->getNumProgramHeaders(); i++) {
+    if (elfFile->getProgramHeaderType(i) != PT_LOAD) {
+      continue;
+    }
+    uintptr_t start    = elfFile->getProgramHeaderVaddr(i);
+    uintptr_t fileEnd  = start + elfFile->getProgramHeaderFileSize(i);
+    uintptr_t memEnd   = start + elfFile->getProgramHeaderMemorySize(i);
+    uintptr_t bssStart = std::max<uintptr_t>(PAGE_DOWN(fileEnd), PAGE_UP(start));
+
+    if (start & (PAGE_SIZE - 1)) {
+      pages++;
+    }
+    if (PAGE_UP(memEnd) > bssStart) {
+      pages += (PAGE_UP(memEnd) - bssStart) / PAGE_SIZE;
+    }
+    page_tables_of(PAGE_DOWN(start), memEnd, &tables);
+  }
+  return pages + tables.size();
+}
+
+/* EPM pages of the binaries: their images, copied in page by page, and
+ * what loading them takes from freemem. The loader is a flat binary and
+ * runs in place */
 uint64_t
 calculate_required_pages(ElfFile** elfFiles, size_t numElfFiles) {
   uint64_t req_pages = 0;
 
-  for (int i = 0; i < numElfFiles; i++) {
+  for (size_t i = 0; i < numElfFiles; i++) {
     ElfFile* elfFile = elfFiles[i];
-    req_pages += ceil(elfFile->getFileSize() / PAGE_SIZE);
-  }
-  /* FIXME: calculate the required number of pages for the page table.
-   * We actually don't know how many page tables the enclave might need,
-   * because the SDK never knows how its memory will be aligned.
-   * Ideally, this should be managed by the driver.
-   * For now, we naively allocate enough pages so that we can temporarily get
-   * away from this problem.
-   * 15 pages will be more than sufficient to cover several hundreds of
-   * megabytes of enclave/runtime. */
-  /* FIXME Part 2: now that loader does loading, .bss sections also eat up
-   * space. Eapp dev must make FREEMEM big enough to fit this!!
-   * Possible fix -- re-add exact .bss calculations?
-   */
-
-  /* Add one page each for bss segments of runtime and eapp */ 
-  // TODO: add space for stack?
-  req_pages += 16;
+    req_pages += PAGE_UP(elfFile->getFileSize()) / PAGE_SIZE;
+    req_pages += elf_load_pages(elfFile);
+  }
   return req_pages;
 }
 
+/* Eyrie's user stack (EYRIE_USER_STACK_SIZE), allocated at boot right
+ * below EYRIE_USER_STACK_START */
+#define EYRIE_USER_STACK_PAGES 32
+
+/* EPM pages the runtime needs at boot besides the binaries: the tables
+ * that map the UTM at EYRIE_UNTRUSTED_START (DEFAULT_UNTRUSTED_PTR) and
+ * the user stack with its tables */
+uint64_t
+Enclave::getBootPages() {
+  uintptr_t stackEnd   = DEFAULT_STACK_START;
+  uintptr_t stackStart = stackEnd - EYRIE_USER_STACK_PAGES * PAGE_SIZE;
+  std::set<uintptr_t> utmTables, stackTables;
+
+  page_tables_of(
+      DEFAULT_UNTRUSTED_PTR, DEFAULT_UNTRUSTED_PTR + getUtmSize(), &utmTables);
+  page_tables_of(stackStart, stackEnd, &stackTables);
+  return utmTables.size() + EYRIE_USER_STACK_PAGES + stackTables.size();
+}
+
 bool
 Enclave::prepareEnclaveMemory(size_t requiredPages, uintptr_t alternatePhysAddr) {
-  // FIXME: this will be deprecated with complete freemem support.
-  // We just add freemem size for now.
+  /* the freemem asked for is what is left to the eapp after boot */
   uint64_t minPages;
-  minPages = ROUND_UP(params.getFreeMemSize(), PAGE_BITS) / PAGE_SIZE; 
-  minPages += requiredPages;
+  minPages = ROUND_UP(params.getFreeMemSize(), PAGE_BITS) / PAGE_SIZE;
+  minPages += requiredPages + getBootPages();
 
   /* Call Enclave Driver */
   if (pDevice->create(minPages) != Error::Success) {
@@ -101,44 +165,15 @@ Enclave::copyFile(uintptr_t filePtr, size_t fileSize) {
 	}
 }
 
-static void measureElfFile(hash_ctx_t* hash_ctx, ElfFile* file) {
-  uintptr_t fptr = (uintptr_t) file->getPtr();
-  uintptr_t fend = fptr + (uintptr_t) file->getFileSize();
-
-  for (; fptr < fend; fptr += PAGE_SIZE) {
-    if (fend - fptr < PAGE_SIZE) {
-      char page[PAGE_SIZE];
-      memset(page, 0, PAGE_SIZE);
-      memcpy(page, (const void*) fptr, (size_t)(fend-fptr));
-      hash_extend_page(hash_ctx, (void*) page);
-    } else {
-      hash_extend_page(hash_ctx, (void*) fptr);
-    }
-  }
-}
-
 Error
 Enclave::measure(char* hash, const char* eapppath, const char* runtimepath, const char* loaderpath) {
-  hash_ctx_t hash_ctx;
-  hash_init(&hash_ctx);
-
-  ElfFile* loader = new ElfFile(loaderpath);
-  ElfFile* runtime = new ElfFile(runtimepath);
-  ElfFile* eapp = new ElfFile(eapppath);
-
-  uintptr_t sizes[3] = { PAGE_UP(loader->getFileSize()), PAGE_UP(runtime->getFileSize()),
-                          PAGE_UP(eapp->getFileSize()) };
-  hash_extend(&hash_ctx, (void*) sizes, sizeof(sizes));
-
-  measureElfFile(&hash_ctx, loader);
-  delete loader;
-  measureElfFile(&hash_ctx, runtime);
-  delete runtime;
-  measureElfFile(&hash_ctx, eapp);
-  delete eapp;
-
-  hash_finalize(hash, &hash_ctx);
+  EnclaveImage image;
+  Error ret = image.init(eapppath, runtimepath, loaderpath);
 
+  if (ret != Error::Success) {
+    return ret;
+  }
+  memcpy(hash, image.getHash(), MDSIZE);
   return Error::Success;
 }
 
@@ -151,51 +186,73 @@ Error
 Enclave::init(
     const char* eapppath, const char* runtimepath, const char* loaderpath, Params _params,
     uintptr_t alternatePhysAddr) {
+  EnclaveImage image;
+  Error ret = image.init(eapppath, runtimepath, loaderpath);
+
+  if (ret != Error::Success) {
+    return ret;
+  }
+  return init(image, _params, alternatePhysAddr);
+}
+
+Error
+Enclave::init(const EnclaveImage& image, Params _params) {
+  return this->init(image, _params, (uintptr_t)0);
+}
+
+/* Only allocates the EPM and copies the binaries in: the image has been
+ * parsed and measured already */
+Error
+Enclave::init(const EnclaveImage& image, Params _params, uintptr_t alternatePhysAddr) {
   params = _params;
 
-  pMemory = new PhysicalEnclaveMemory();
-  pDevice = new KeystoneDevice();
+  if (!image.isInitialized()) {
+    return Error::InvalidEnclave;
+  }
+  memcpy(hash, image.getHash(), MDSIZE);
 
-  ElfFile* enclaveFile = new ElfFile(eapppath);
-  ElfFile* runtimeFile = new ElfFile(runtimepath);
-  ElfFile* loaderFile = new ElfFile(loaderpath);
+  if (params.isSimulated()) {
+    pMemory = new SimulatedEnclaveMemory();
+    pDevice = new MockKeystoneDevice();
+  } else {
+    pMemory = new PhysicalEnclaveMemory();
+    pDevice = new KeystoneDevice();
+  }
 
   if (!pDevice->initDevice(params)) {
     destroy();
     return Error::DeviceInitFailure;
   }
 
-  ElfFile* elfFiles[3] = {enclaveFile, runtimeFile, loaderFile};
-  size_t requiredPages = calculate_required_pages(elfFiles, 3);
-
-  if (!prepareEnclaveMemory(requiredPages, alternatePhysAddr)) {
+  if (!prepareEnclaveMemory(image.getRequiredPages(), alternatePhysAddr)) {
     destroy();
     return Error::DeviceError;
   }
-  if (!pMemory->allocUtm(params.getUntrustedSize())) {
+  if (!pMemory->allocUtm(getUtmSize())) {
     ERROR("failed to init untrusted memory - ioctl() failed");
     destroy();
     return Error::DeviceError;
   }
-	
+
   /* Copy loader into beginning of enclave memory */
-  copyFile((uintptr_t) loaderFile->getPtr(), loaderFile->getFileSize());
+  copyFile((uintptr_t) image.getLoader().ptr, image.getLoader().size);
 
   pMemory->startRuntimeMem();
-  copyFile((uintptr_t) runtimeFile->getPtr(), runtimeFile->getFileSize());
+  copyFile((uintptr_t) image.getRuntime().ptr, image.getRuntime().size);
 
   pMemory->startEappMem();
-  copyFile((uintptr_t) enclaveFile->getPtr(), enclaveFile->getFileSize());
+  copyFile((uintptr_t) image.getEapp().ptr, image.getEapp().size);
 
   pMemory->startFreeMem();
 
   if (pDevice->finalize(
           pMemory->getRuntimePhysAddr(), pMemory->getEappPhysAddr(),
-          pMemory->getFreePhysAddr(), params.getFreeMemSize()) != Error::Success) {
+          pMemory->getFreePhysAddr(), params.getFreeMemSize(),
+          params.getDeviceBase(), params.getDeviceSize()) != Error::Success) {
     destroy();
     return Error::DeviceError;
   }
-  if (!mapUntrusted(params.getUntrustedSize())) {
+  if (!mapUntrusted(getUtmSize())) {
     ERROR(
         "failed to finalize enclave - cannot obtain the untrusted buffer "
         "pointer \n");
@@ -203,13 +260,23 @@ Enclave::init(
     return Error::DeviceMemoryMapError;
   }
 
-  /* ELF files are no longer needed */
-  delete enclaveFile;
-  delete runtimeFile;
-  delete loaderFile;
   return Error::Success;
 }
 
+/* the untrusted memory asked for, plus the areas of eyrie_utm.h */
+size_t
+Enclave::getUtmSize() {
+  size_t size = params.getUntrustedSize();
+
+  if (params.getProfileSize() || params.getStraceSize()) {
+    size += PAGE_UP(
+        sizeof(struct eyrie_utm_header) +
+        ROUND_UP(params.getProfileSize(), 3) +
+        ROUND_UP(params.getStraceSize(), 3));
+  }
+  return size;
+}
+
 bool
 Enclave::mapUntrusted(size_t size) {
   if (size == 0) {
@@ -224,34 +291,387 @@ Enclave::mapUntrusted(size_t size) {
 
   shared_buffer_size = size;
 
+  if (params.getProfileSize() || params.getStraceSize()) {
+    utmHeader = reinterpret_cast<struct eyrie_utm_header*>(shared_buffer);
+    utmHeader->magic        = EYRIE_UTM_MAGIC;
+    utmHeader->reserved     = 0;
+    utmHeader->profile_size = ROUND_UP(params.getProfileSize(), 3);
+    utmHeader->strace_size  = ROUND_UP(params.getStraceSize(), 3);
+
+    /* the runtime fills in the area headers of the features it has */
+    if (utmHeader->profile_size) {
+      memset(utmHeader + 1, 0, sizeof(struct eyrie_profile_header));
+    }
+    if (utmHeader->strace_size) {
+      memset(getStraceArea(), 0, sizeof(struct eyrie_strace_header));
+    }
+
+    shared_buffer = reinterpret_cast<char*>(shared_buffer) +
+                    EYRIE_UTM_RESERVED(utmHeader);
+    shared_buffer_size -= EYRIE_UTM_RESERVED(utmHeader);
+  }
+
   return true;
 }
 
 Error
 Enclave::destroy() {
+  if (asyncFd >= 0) {
+    close(asyncFd);
+    asyncFd = -1;
+  }
+
+  /* init() has not got as far as the device */
+  if (!pDevice) {
+    return Error::Success;
+  }
   return pDevice->destroy();
 }
 
+/* Keeps running enclave thread tid, whose last run or resume returned
+ * ret, until it exits. Threads the enclave creates on the way get host
+ * threads of their own. Edge calls need no lock here: the runtime makes
+ * one at a time */
 Error
-Enclave::run(uintptr_t* retval) {
-  Error ret = pDevice->run(retval);
-  while (ret == Error::EdgeCallHost || ret == Error::EnclaveInterrupted) {
+Enclave::driveThread(uintptr_t tid, Error ret, uintptr_t* value) {
+  while (ret == Error::EdgeCallHost || ret == Error::EnclaveInterrupted ||
+         ret == Error::EnclaveNewThread) {
+    /* the enclave exits with thread 0; others are stopped at the next
+     * chance and left behind */
+    if (tid != 0 && threadsExiting) {
+      return Error::Success;
+    }
+
     /* enclave is stopped in the middle. */
     if (ret == Error::EdgeCallHost && oFuncDispatch != NULL) {
       oFuncDispatch(getSharedBuffer());
+    } else if (ret == Error::EnclaveNewThread) {
+      startThread(*value);
+    }
+
+    if (tid == 0) {
+      ret = pDevice->resume(value);
+    } else {
+      ret = pDevice->runThread(tid, value);
     }
-    ret = pDevice->resume(retval);
   }
 
+  return ret;
+}
+
+void
+Enclave::startThread(uintptr_t tid) {
+  std::lock_guard<std::mutex> lock(threadRunnersLock);
+
+  if (threadsExiting) {
+    return;
+  }
+
+  threadRunners.emplace_back([this, tid] {
+    uintptr_t value = 0;
+    Error ret = driveThread(tid, pDevice->runThread(tid, &value), &value);
+    if (ret != Error::Success) {
+      ERROR("failed to run enclave thread %lu", tid);
+    }
+  });
+}
+
+void
+Enclave::joinThreads() {
+  std::vector<std::thread> runners;
+
+  /* no runners are added once the flag is set */
+  threadsExiting = true;
+  {
+    std::lock_guard<std::mutex> lock(threadRunnersLock);
+    runners.swap(threadRunners);
+  }
+  for (auto& runner : runners) {
+    runner.join();
+  }
+  threadsExiting = false;
+}
+
+Error
+Enclave::run(uintptr_t* retval) {
+  uintptr_t value = 0;
+  Error ret = driveThread(0, pDevice->run(&value), &value);
+
+  joinThreads();
+
   if (ret != Error::Success) {
     ERROR("failed to run enclave - ioctl() failed");
     destroy();
     return Error::DeviceError;
   }
 
+  if (retval) {
+    *retval = value;
+  }
+
+  writeRunOutputs();
   return Error::Success;
 }
 
+/* Starts the enclave without waiting for it. The eventfd, which can go
+ * into an epoll set, becomes readable whenever the enclave stops; then
+ * pollAsync() tells why. A typical loop:
+ *
+ *   enclave.runAsync(&fd);  // and add fd to the epoll set
+ *   ...                     // fd is readable
+ *   switch (enclave.pollAsync(&ret)) {
+ *     case Error::EdgeCallHost:   // serve the call in the shared buffer
+ *       handle(enclave.getSharedBuffer());
+ *       enclave.resumeAsync();
+ *       break;
+ *     case Error::EnclaveRunning: // nothing to do yet
+ *       break;
+ *     case Error::Success:        // exited with ret
+ *       ...
+ *   }
+ */
+Error
+Enclave::runAsync(int* eventFd) {
+  Error ret;
+
+  if (asyncFd < 0) {
+    asyncFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (asyncFd < 0) {
+      PERROR("cannot create an eventfd");
+      return Error::DeviceError;
+    }
+    if (pDevice->setEventFd(asyncFd) != Error::Success) {
+      close(asyncFd);
+      asyncFd = -1;
+      return Error::DeviceError;
+    }
+  }
+
+  ret = pDevice->runAsync();
+  if (ret != Error::Success) {
+    ERROR("failed to run enclave - ioctl() failed");
+    return ret;
+  }
+
+  if (eventFd) {
+    *eventFd = asyncFd;
+  }
+  return Error::Success;
+}
+
+/* Never blocks. EnclaveRunning while the enclave runs; EdgeCallHost when
+ * it waits in an edge call, to be resumed with resumeAsync() once the
+ * call is served; Success with the return value once it has exited.
+ * Threads the enclave creates are run by host threads as in run() */
+Error
+Enclave::pollAsync(uintptr_t* retval) {
+  uint64_t count;
+  uintptr_t value = 0;
+  Error ret;
+
+  /* clear the eventfd before looking, so that the next stop signals it
+   * again */
+  if (asyncFd >= 0 && read(asyncFd, &count, sizeof(count)) < 0 &&
+      errno != EAGAIN) {
+    PERROR("cannot read the eventfd");
+  }
+
+  ret = pDevice->asyncResult(&value);
+  switch (ret) {
+    case Error::EnclaveRunning:
+    case Error::EdgeCallHost:
+      return ret;
+
+    case Error::EnclaveNewThread:
+      startThread(value);
+      ret = resumeAsync();
+      return ret == Error::Success ? Error::EnclaveRunning : ret;
+
+    case Error::Success:
+      joinThreads();
+      if (retval) {
+        *retval = value;
+      }
+      writeRunOutputs();
+      return Error::Success;
+
+    default:
+      joinThreads();
+      ERROR("failed to run enclave - ioctl() failed");
+      destroy();
+      return Error::DeviceError;
+  }
+}
+
+Error
+Enclave::resumeAsync() {
+  Error ret = pDevice->resumeAsync();
+  if (ret != Error::Success) {
+    ERROR("failed to resume enclave - ioctl() failed");
+  }
+  return ret;
+}
+
+void
+Enclave::writeRunOutputs() {
+  if (!params.getProfilePath().empty() &&
+      writeProfile(params.getProfilePath()) != Error::Success) {
+    ERROR("failed to write the profile to %s", params.getProfilePath().c_str());
+  }
+  if (!params.getStracePath().empty() &&
+      writeStrace(params.getStracePath()) != Error::Success) {
+    ERROR("failed to write the syscall trace to %s", params.getStracePath().c_str());
+  }
+}
+
+/* Copies the samples the runtime has kept, oldest first, once the enclave
+ * has exited. False if the runtime did not profile. */
+bool
+Enclave::readProfile(
+    std::vector<struct eyrie_profile_sample>* samples, uint64_t* taken) {
+  struct eyrie_profile_header header;
+  uintptr_t area;
+  uint64_t capacity, first, n;
+
+  if (!utmHeader || !utmHeader->profile_size) {
+    return false;
+  }
+
+  area = reinterpret_cast<uintptr_t>(utmHeader + 1);
+  memcpy(&header, reinterpret_cast<void*>(area), sizeof(header));
+
+  capacity = (ROUND_UP(params.getProfileSize(), 3) - sizeof(header)) /
+             sizeof(struct eyrie_profile_sample);
+  if (!header.capacity || header.capacity > capacity) {
+    return false;
+  }
+
+  n     = std::min(header.taken, header.capacity);
+  first = header.taken - n;
+
+  auto ring = reinterpret_cast<const struct eyrie_profile_sample*>(
+      area + sizeof(header));
+  samples->clear();
+  for (uint64_t i = first; i < header.taken; i++) {
+    samples->push_back(ring[i % header.capacity]);
+    samples->back().depth =
+        std::min<uint32_t>(samples->back().depth, EYRIE_PROFILE_DEPTH);
+  }
+
+  *taken = header.taken;
+  return true;
+}
+
+/* Writes the profile as folded stacks, one line per distinct stack with
+ * the number of its samples. Frames are eapp addresses, outermost first;
+ * symbolize them against the eapp ELF, e.g. with addr2line. Callers are
+ * return addresses and so point just past their call. */
+Error
+Enclave::writeProfile(const std::string& path) {
+  std::vector<struct eyrie_profile_sample> samples;
+  std::map<std::string, uint64_t> stacks;
+  uint64_t taken;
+
+  if (!readProfile(&samples, &taken)) {
+    ERROR("no profile: run a runtime built with USE_PROFILER and a profile size");
+    return Error::InvalidEnclave;
+  }
+
+  for (auto& sample : samples) {
+    std::ostringstream stack;
+    for (uint32_t i = sample.depth; i > 0; i--) {
+      stack << (i < sample.depth ? ";" : "") << "0x" << std::hex
+            << sample.pc[i - 1];
+    }
+    stacks[stack.str()]++;
+  }
+
+  std::ofstream out(path);
+  if (!out) {
+    return Error::FileInitFailure;
+  }
+  for (auto& stack : stacks) {
+    out << stack.first << " " << stack.second << "\n";
+  }
+  if (taken > samples.size()) {
+    ERROR(
+        "profile kept the last %zu of %" PRIu64 " samples", samples.size(),
+        taken);
+  }
+  return out ? Error::Success : Error::FileInitFailure;
+}
+
+/* the trace area follows the profile area */
+void*
+Enclave::getStraceArea() {
+  return reinterpret_cast<char*>(utmHeader + 1) + utmHeader->profile_size;
+}
+
+/* Copies the syscall records the runtime has kept, oldest first, once the
+ * enclave has exited. False if the runtime did not trace. */
+bool
+Enclave::readStrace(
+    std::vector<struct eyrie_strace_record>* records, uint64_t* taken) {
+  struct eyrie_strace_header header;
+  uint64_t capacity, first, n;
+
+  if (!utmHeader || !utmHeader->strace_size) {
+    return false;
+  }
+
+  memcpy(&header, getStraceArea(), sizeof(header));
+
+  capacity = (utmHeader->strace_size - sizeof(header)) /
+             sizeof(struct eyrie_strace_record);
+  if (!header.capacity || header.capacity > capacity) {
+    return false;
+  }
+
+  n     = std::min(header.taken, header.capacity);
+  first = header.taken - n;
+
+  auto ring = reinterpret_cast<const struct eyrie_strace_record*>(
+      reinterpret_cast<char*>(getStraceArea()) + sizeof(header));
+  records->clear();
+  for (uint64_t i = first; i < header.taken; i++) {
+    records->push_back(ring[i % header.capacity]);
+  }
+
+  *taken = header.taken;
+  return true;
+}
+
+/* Writes the syscall trace in the binary layout of eyrie_utm.h, for
+ * keystone-strace to decode */
+Error
+Enclave::writeStrace(const std::string& path) {
+  std::vector<struct eyrie_strace_record> records;
+  struct eyrie_strace_header header;
+  uint64_t taken;
+
+  if (!readStrace(&records, &taken)) {
+    ERROR("no syscall trace: run a runtime built with USE_INTERNAL_STRACE and a trace size");
+    return Error::InvalidEnclave;
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    return Error::FileInitFailure;
+  }
+  header.capacity = records.size();
+  header.taken    = taken;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(
+      reinterpret_cast<const char*>(records.data()),
+      records.size() * sizeof(struct eyrie_strace_record));
+  if (taken > records.size()) {
+    ERROR(
+        "syscall trace kept the last %zu of %" PRIu64 " syscalls",
+        records.size(), taken);
+  }
+  return out ? Error::Success : Error::FileInitFailure;
+}
+
 void*
 Enclave::getSharedBuffer() {
   return shared_buffer;
@@ -0,0 +1,77 @@
+//******************************************************************************
+// Copyright (c) 2020, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "EnclaveImage.hpp"
+#include "Enclave.hpp"
+#include "hash_util.hpp"
+
+namespace Keystone {
+
+EnclaveImage::EnclaveImage()
+    : loader(), runtime(), eapp(), requiredPages(0), hash(), initialized(false) {
+}
+
+static EnclaveImage::File
+imageFile(ElfFile* file) {
+  EnclaveImage::File image;
+  image.ptr   = file->getPtr();
+  image.size  = file->getFileSize();
+  image.pages = PAGE_UP(image.size) / PAGE_SIZE;
+  return image;
+}
+
+static void
+measureFile(hash_ctx_t* hash_ctx, const EnclaveImage::File& file) {
+  uintptr_t fptr = (uintptr_t) file.ptr;
+  uintptr_t fend = fptr + file.size;
+
+  for (; fptr < fend; fptr += PAGE_SIZE) {
+    if (fend - fptr < PAGE_SIZE) {
+      char page[PAGE_SIZE];
+      memset(page, 0, PAGE_SIZE);
+      memcpy(page, (const void*) fptr, (size_t)(fend - fptr));
+      hash_extend_page(hash_ctx, (void*) page);
+    } else {
+      hash_extend_page(hash_ctx, (void*) fptr);
+    }
+  }
+}
+
+Error
+EnclaveImage::init(const char* eapppath, const char* runtimepath, const char* loaderpath) {
+  hash_ctx_t hash_ctx;
+
+  if (initialized) {
+    return Error::InvalidEnclave;
+  }
+
+  eappFile.reset(new ElfFile(eapppath));
+  runtimeFile.reset(new ElfFile(runtimepath));
+  loaderFile.reset(new ElfFile(loaderpath));
+  if (!eappFile->isValid() || !runtimeFile->isValid() || !loaderFile->isValid()) {
+    return Error::FileInitFailure;
+  }
+
+  loader  = imageFile(loaderFile.get());
+  runtime = imageFile(runtimeFile.get());
+  eapp    = imageFile(eappFile.get());
+
+  ElfFile* elfFiles[3] = {eappFile.get(), runtimeFile.get(), loaderFile.get()};
+  requiredPages = calculate_required_pages(elfFiles, 3);
+
+  /* what the SM measures as the binaries are copied in */
+  uintptr_t sizes[3] = {loader.pages * PAGE_SIZE, runtime.pages * PAGE_SIZE,
+                        eapp.pages * PAGE_SIZE};
+  hash_init(&hash_ctx);
+  hash_extend(&hash_ctx, (void*) sizes, sizeof(sizes));
+  measureFile(&hash_ctx, loader);
+  measureFile(&hash_ctx, runtime);
+  measureFile(&hash_ctx, eapp);
+  hash_finalize(hash, &hash_ctx);
+
+  initialized = true;
+  return Error::Success;
+}
+
+}  // namespace Keystone
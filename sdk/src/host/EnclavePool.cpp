@@ -0,0 +1,133 @@
+//******************************************************************************
+// Copyright (c) 2020, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "EnclavePool.hpp"
+#include <algorithm>
+
+namespace Keystone {
+
+EnclavePool::EnclavePool() : size(0), stopping(false), stalled(false), stats() {
+}
+
+EnclavePool::~EnclavePool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (filler.joinable()) {
+    filler.join();
+  }
+  /* the enclaves left are destroyed with the queue */
+}
+
+Error
+EnclavePool::init(
+    const char* _eapppath, const char* _runtimepath, const char* _loaderpath,
+    Params _params, size_t _size) {
+  if (image.isInitialized() || _size == 0) {
+    return Error::InvalidEnclave;
+  }
+
+  Error ret = image.init(_eapppath, _runtimepath, _loaderpath);
+  if (ret != Error::Success) {
+    return ret;
+  }
+  params = _params;
+  size   = _size;
+
+  /* fail early rather than have the filler fail forever */
+  std::unique_ptr<Enclave> first = create();
+  if (!first) {
+    return Error::InvalidEnclave;
+  }
+  ready.push_back(std::move(first));
+
+  filler = std::thread([this] { fill(); });
+  return Error::Success;
+}
+
+/* Creates and finalizes one enclave, outside of the lock */
+std::unique_ptr<Enclave>
+EnclavePool::create() {
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Enclave> enclave(new Enclave());
+  Error ret = enclave->init(image, params);
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (ret != Error::Success) {
+    ERROR("enclave pool: failed to create an enclave (error %d)", static_cast<int>(ret));
+    stats.failed++;
+    return nullptr;
+  }
+  stats.created++;
+  stats.create_ns += ns;
+  stats.max_create_ns = std::max(stats.max_create_ns, ns);
+  return enclave;
+}
+
+void
+EnclavePool::fill() {
+  std::unique_lock<std::mutex> guard(lock);
+
+  for (;;) {
+    wake.wait(guard, [this] {
+      return stopping || (!stalled && ready.size() < size);
+    });
+    if (stopping) {
+      return;
+    }
+
+    guard.unlock();
+    std::unique_ptr<Enclave> enclave = create();
+    guard.lock();
+
+    if (enclave) {
+      ready.push_back(std::move(enclave));
+    } else {
+      stalled = true;
+    }
+  }
+}
+
+/* Hands out a finalized enclave that has not run yet, or null if none
+ * could be created */
+std::unique_ptr<Enclave>
+EnclavePool::checkout() {
+  std::unique_ptr<Enclave> enclave;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stalled = false;
+    if (!ready.empty()) {
+      enclave = std::move(ready.front());
+      ready.pop_front();
+      stats.hits++;
+    } else {
+      stats.misses++;
+    }
+  }
+  wake.notify_one();
+
+  if (!enclave) {
+    enclave = create();
+  }
+  return enclave;
+}
+
+size_t
+EnclavePool::getReady() {
+  std::lock_guard<std::mutex> guard(lock);
+  return ready.size();
+}
+
+EnclavePool::Stats
+EnclavePool::getStats() {
+  std::lock_guard<std::mutex> guard(lock);
+  return stats;
+}
+
+}  // namespace Keystone
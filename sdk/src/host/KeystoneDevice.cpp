@@ -41,13 +41,15 @@ KeystoneDevice::initUTM(size_t size) {
 Error
 KeystoneDevice::finalize(
     uintptr_t runtimePhysAddr, uintptr_t eappPhysAddr, uintptr_t freePhysAddr,
-    uintptr_t freeRequested) {
+    uintptr_t freeRequested, uintptr_t devicePhysAddr, uintptr_t deviceSize) {
   struct keystone_ioctl_create_enclave encl;
   encl.eid            = eid;
   encl.runtime_paddr  = runtimePhysAddr;
   encl.user_paddr     = eappPhysAddr;
   encl.free_paddr     = freePhysAddr;
   encl.free_requested = freeRequested;
+  encl.device_paddr   = devicePhysAddr;
+  encl.device_size    = deviceSize;
 
   if (ioctl(fd, KEYSTONE_IOC_FINALIZE_ENCLAVE, &encl)) {
     perror("ioctl error");
@@ -94,20 +96,33 @@ KeystoneDevice::__run(bool resume, uintptr_t* ret) {
     return error;
   }
 
-  switch (encl.error) {
+  return __result(
+      encl.error, encl.value, ret, error, resume ? "resume_enclave" : "run_enclave");
+}
+
+/* for SBI_ERR_SM_ENCLAVE_NEW_THREAD, value is the id of the new thread */
+Error
+KeystoneDevice::__result(
+    uintptr_t sbiError, uintptr_t value, uintptr_t* ret, Error error,
+    const char* call) {
+  switch (sbiError) {
     case SBI_ERR_SM_ENCLAVE_EDGE_CALL_HOST:
       return Error::EdgeCallHost;
     case SBI_ERR_SM_ENCLAVE_INTERRUPTED:
       return Error::EnclaveInterrupted;
+    case SBI_ERR_SM_ENCLAVE_NEW_THREAD:
+      if (ret) {
+        *ret = value;
+      }
+      return Error::EnclaveNewThread;
     case SBI_ERR_SM_ENCLAVE_SUCCESS:
       if (ret) {
-        *ret = encl.value;
+        *ret = value;
       }
       return Error::Success;
     default:
       ERROR(
-          "Unknown SBI error (%d) returned by %s_enclave\n", encl.error,
-          resume ? "resume" : "run");
+          "Unknown SBI error (%d) returned by %s\n", (int) sbiError, call);
       return error;
   }
 }
@@ -122,6 +137,74 @@ KeystoneDevice::resume(uintptr_t* ret) {
   return __run(true, ret);
 }
 
+Error
+KeystoneDevice::runThread(uintptr_t tid, uintptr_t* ret) {
+  struct keystone_ioctl_run_thread encl;
+  encl.eid = eid;
+  encl.tid = tid;
+
+  if (ioctl(fd, KEYSTONE_IOC_RUN_THREAD, &encl)) {
+    return Error::IoctlErrorResume;
+  }
+
+  return __result(encl.error, encl.value, ret, Error::IoctlErrorResume, "run_thread");
+}
+
+Error
+KeystoneDevice::__runAsync(bool resume) {
+  struct keystone_ioctl_run_enclave encl;
+  encl.eid = eid;
+
+  if (resume) {
+    if (ioctl(fd, KEYSTONE_IOC_RESUME_ENCLAVE_ASYNC, &encl)) {
+      return Error::IoctlErrorResume;
+    }
+  } else if (ioctl(fd, KEYSTONE_IOC_RUN_ENCLAVE_ASYNC, &encl)) {
+    return Error::IoctlErrorRun;
+  }
+  return Error::Success;
+}
+
+/* the driver runs the enclave on a worker, which stops only where the
+ * host has to step in; asyncResult() then tells why */
+Error
+KeystoneDevice::runAsync() {
+  return __runAsync(false);
+}
+
+Error
+KeystoneDevice::resumeAsync() {
+  return __runAsync(true);
+}
+
+Error
+KeystoneDevice::asyncResult(uintptr_t* ret) {
+  struct keystone_ioctl_run_enclave encl;
+  encl.eid = eid;
+
+  if (ioctl(fd, KEYSTONE_IOC_ENCLAVE_RESULT, &encl)) {
+    if (errno == EAGAIN) {
+      return Error::EnclaveRunning;
+    }
+    return Error::IoctlErrorRun;
+  }
+
+  return __result(encl.error, encl.value, ret, Error::IoctlErrorRun, "enclave_result");
+}
+
+Error
+KeystoneDevice::setEventFd(int efd) {
+  struct keystone_ioctl_eventfd encl;
+  encl.eid = eid;
+  encl.fd  = efd;
+
+  if (ioctl(fd, KEYSTONE_IOC_SET_EVENTFD, &encl)) {
+    perror("ioctl error");
+    return Error::DeviceError;
+  }
+  return Error::Success;
+}
+
 void*
 KeystoneDevice::map(uintptr_t addr, size_t size) {
   assert(fd >= 0);
@@ -156,7 +239,7 @@ MockKeystoneDevice::initUTM(size_t size) {
 Error
 MockKeystoneDevice::finalize(
     uintptr_t runtimePhysAddr, uintptr_t eappPhysAddr, uintptr_t freePhysAddr,
-    uintptr_t freeRequested) {
+    uintptr_t freeRequested, uintptr_t devicePhysAddr, uintptr_t deviceSize) {
   return Error::Success;
 }
 
@@ -175,6 +258,31 @@ MockKeystoneDevice::resume(uintptr_t* ret) {
   return Error::Success;
 }
 
+Error
+MockKeystoneDevice::runThread(uintptr_t tid, uintptr_t* ret) {
+  return Error::Success;
+}
+
+Error
+MockKeystoneDevice::runAsync() {
+  return Error::Success;
+}
+
+Error
+MockKeystoneDevice::resumeAsync() {
+  return Error::Success;
+}
+
+Error
+MockKeystoneDevice::asyncResult(uintptr_t* ret) {
+  return Error::Success;
+}
+
+Error
+MockKeystoneDevice::setEventFd(int efd) {
+  return Error::Success;
+}
+
 bool
 MockKeystoneDevice::initDevice(Params params) {
   return true;
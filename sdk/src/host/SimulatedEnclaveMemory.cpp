@@ -12,7 +12,9 @@ SimulatedEnclaveMemory::init(
   pDevice       = dev;
   epmSize       = PAGE_SIZE * min_pages;
   epmFreeList   = 0; // offset
-  startAddr 		= 0;
+  /* the EPM is a buffer of ours, and its addresses stand for the physical
+   * ones */
+  startAddr 		= allocMem(epmSize);
 }
 
 void*
@@ -22,7 +24,6 @@ SimulatedEnclaveMemory::allocateAligned(size_t size, size_t alignment) {
   return reinterpret_cast<void*>((mem + mask) & ~mask);
 }
 
-// unused
 uintptr_t
 SimulatedEnclaveMemory::allocMem(size_t size) {
   uintptr_t ret;
@@ -42,10 +43,11 @@ SimulatedEnclaveMemory::readMem(uintptr_t src, size_t size) {
   return src;
 }
 
-// TODO: change write Mem to use addresses relative to start of section rather than absolute addresses
+/* src: virtual address, offset: from the start of the EPM */
 void
-SimulatedEnclaveMemory::writeMem(uintptr_t src, uintptr_t dst, size_t size) {
-  memcpy(reinterpret_cast<void*>(dst), reinterpret_cast<void*>(src), size);
+SimulatedEnclaveMemory::writeMem(uintptr_t src, uintptr_t offset, size_t size) {
+  assert(offset + size <= epmSize);
+  memcpy(reinterpret_cast<void*>(startAddr + offset), reinterpret_cast<void*>(src), size);
 }
 
 }  // namespace Keystone
@@ -0,0 +1,200 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+extern "C" {
+#include "edge/syscall_nums.h"
+#include "shared/eyrie_call.h"
+}
+#include "shared/eyrie_utm.h"
+
+/* Decodes a syscall trace that Enclave::run() wrote (Params::setStracePath)
+ * into one strace-like line per syscall, followed by the latency of every
+ * syscall number as a histogram over power-of-two buckets of cycles.
+ *
+ *   keystone-strace [-c] trace
+ *
+ * -c leaves out the lines and prints only the histograms. The cycles of a
+ * syscall include the edge calls it made; those are also shown apart, as
+ * the time spent outside the enclave. */
+
+#define NAME(x) {__NR_##x, #x}
+#define RUNTIME_NAME(x) {RUNTIME_SYSCALL_##x, "runtime_" #x}
+
+static const std::map<uint64_t, const char*> syscall_names = {
+    NAME(getcwd),         NAME(dup),           NAME(dup3),
+    NAME(fcntl),          NAME(ioctl),         NAME(mkdirat),
+    NAME(unlinkat),       NAME(ftruncate),     NAME(faccessat),
+    NAME(chdir),          NAME(openat),        NAME(close),
+    NAME(pipe2),          NAME(getdents64),    NAME(lseek),
+    NAME(read),           NAME(write),         NAME(readv),
+    NAME(writev),         NAME(pread64),       NAME(pwrite64),
+    NAME(sendfile),       NAME(pselect6),      NAME(ppoll),
+    NAME(readlinkat),     NAME(fstatat)   ,    NAME(fstat),
+    NAME(fsync),          NAME(exit),          NAME(exit_group),
+    NAME(set_tid_address), NAME(futex),        NAME(set_robust_list),
+    NAME(nanosleep),      NAME(clock_gettime), NAME(sched_yield),
+    NAME(kill),           NAME(tgkill),        NAME(rt_sigaction),
+    NAME(rt_sigprocmask), NAME(uname),         NAME(getrusage),
+    NAME(gettimeofday),   NAME(getpid),        NAME(getppid),
+    NAME(getuid),         NAME(geteuid),       NAME(getgid),
+    NAME(getegid),        NAME(gettid),        NAME(sysinfo),
+    NAME(socket),         NAME(bind),          NAME(listen),
+    NAME(accept),         NAME(connect),       NAME(sendto),
+    NAME(recvfrom),       NAME(setsockopt),    NAME(getsockopt),
+    NAME(shutdown),       NAME(brk),           NAME(munmap),
+    NAME(mremap),         NAME(clone),         NAME(mmap),
+    NAME(mprotect),       NAME(madvise),       NAME(prlimit64),
+    NAME(getrandom),      NAME(epoll_create1), NAME(epoll_ctl),
+    NAME(epoll_pwait),    NAME(renameat2),     NAME(umask),
+    RUNTIME_NAME(OCALL),  RUNTIME_NAME(SHAREDCOPY),
+    RUNTIME_NAME(ATTEST_ENCLAVE),  RUNTIME_NAME(GET_SEALING_KEY),
+    RUNTIME_NAME(CREATE_KEYPAIR),  RUNTIME_NAME(GET_CHAIN),
+    RUNTIME_NAME(CRYPTO_INTERFACE), RUNTIME_NAME(PRINT_STRING),
+    RUNTIME_NAME(ATTEST_BATCH),    RUNTIME_NAME(EXIT),
+    RUNTIME_NAME(WRITE_BUFFER),    RUNTIME_NAME(READ_BUFFER),
+    RUNTIME_NAME(READ_REGISTER),   RUNTIME_NAME(WRITE_REGISTER),
+    RUNTIME_NAME(MAP_DEVICE),
+};
+
+/* buckets of the histograms: [2^i, 2^(i+1)) cycles */
+#define HIST_BUCKETS 64
+
+struct latency {
+  uint64_t count;
+  uint64_t cycles;
+  uint64_t host_cycles;
+  uint64_t max;
+  uint64_t buckets[HIST_BUCKETS];
+};
+
+static std::string
+syscall_name(uint64_t nr) {
+  auto name = syscall_names.find(nr);
+  if (name != syscall_names.end()) {
+    return name->second;
+  }
+  return "syscall_" + std::to_string(nr);
+}
+
+static unsigned int
+log2_bucket(uint64_t cycles) {
+  unsigned int i = 0;
+  while (cycles >>= 1) {
+    i++;
+  }
+  return i;
+}
+
+static void
+print_record(const struct eyrie_strace_record& rec, uint64_t t0) {
+  printf(
+      "%8" PRIu64 " [%u] %s(0x%" PRIx64 ", 0x%" PRIx64 ", 0x%" PRIx64
+      ", 0x%" PRIx64 ", 0x%" PRIx64 ", 0x%" PRIx64 ") = %" PRId64
+      " <%" PRIu64 " cycles, %" PRIu64 " on the host>\n",
+      rec.start - t0, rec.tid, syscall_name(rec.nr).c_str(), rec.args[0],
+      rec.args[1], rec.args[2], rec.args[3], rec.args[4], rec.args[5],
+      static_cast<int64_t>(rec.ret), rec.cycles, rec.host_cycles);
+}
+
+static void
+print_histogram(uint64_t nr, const struct latency& lat) {
+  uint64_t peak = 0;
+  unsigned int first = HIST_BUCKETS, last = 0;
+
+  for (unsigned int i = 0; i < HIST_BUCKETS; i++) {
+    if (!lat.buckets[i]) {
+      continue;
+    }
+    peak  = std::max(peak, lat.buckets[i]);
+    first = std::min(first, i);
+    last  = i;
+  }
+
+  printf(
+      "\n%s: %" PRIu64 " calls, avg %" PRIu64 " cycles (%" PRIu64
+      " on the host), max %" PRIu64 "\n",
+      syscall_name(nr).c_str(), lat.count, lat.cycles / lat.count,
+      lat.host_cycles / lat.count, lat.max);
+  for (unsigned int i = first; i <= last; i++) {
+    int width = static_cast<int>(lat.buckets[i] * 40 / peak);
+    printf(
+        "  %12" PRIu64 " .. %-12" PRIu64 " %8" PRIu64 " |%.*s\n",
+        i ? UINT64_C(1) << i : 0, (UINT64_C(1) << i) * 2 - 1, lat.buckets[i],
+        width,
+        "****************************************");
+  }
+}
+
+int
+main(int argc, char** argv) {
+  struct eyrie_strace_header header;
+  std::vector<struct eyrie_strace_record> records;
+  std::map<uint64_t, struct latency> latencies;
+  bool summary_only = false;
+  const char* path  = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-c")) {
+      summary_only = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path) {
+    fprintf(stderr, "usage: %s [-c] trace\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream in(path, std::ios::binary);
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    fprintf(stderr, "%s: not a syscall trace\n", path);
+    return 1;
+  }
+  in.seekg(0, std::ios::end);
+  if (header.capacity > (static_cast<uint64_t>(in.tellg()) - sizeof(header)) /
+                            sizeof(struct eyrie_strace_record)) {
+    fprintf(stderr, "%s: truncated trace\n", path);
+    return 1;
+  }
+  in.seekg(sizeof(header));
+  records.resize(header.capacity);
+  if (!in.read(
+          reinterpret_cast<char*>(records.data()),
+          records.size() * sizeof(struct eyrie_strace_record))) {
+    fprintf(stderr, "%s: truncated trace\n", path);
+    return 1;
+  }
+
+  if (header.taken > records.size()) {
+    printf(
+        "# the trace kept the last %zu of %" PRIu64 " syscalls\n",
+        records.size(), header.taken);
+  }
+
+  for (auto& rec : records) {
+    struct latency& lat = latencies[rec.nr];
+    lat.count++;
+    lat.cycles += rec.cycles;
+    lat.host_cycles += rec.host_cycles;
+    lat.max = std::max(lat.max, rec.cycles);
+    lat.buckets[log2_bucket(rec.cycles)]++;
+
+    if (!summary_only) {
+      print_record(rec, records.front().start);
+    }
+  }
+
+  for (auto& lat : latencies) {
+    print_histogram(lat.first, lat.second);
+  }
+  return 0;
+}
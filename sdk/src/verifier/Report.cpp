@@ -173,3 +173,53 @@ size_t
 Report::getDataSize() {
   return report.enclave.data_len;
 }
+
+int
+Report::isBatch() {
+  return report.enclave.data_len == ATTEST_BATCH_DATA_LEN &&
+         memcmp(
+             report.enclave.data, ATTEST_BATCH_TAG, ATTEST_BATCH_TAG_LEN) == 0;
+}
+
+int
+Report::verifyBatchProof(
+    const byte* data, size_t len, const struct attest_batch_proof* proof) {
+  byte node[ATTEST_BATCH_NODE_SIZE];
+  byte prefix;
+  sha3_ctx_t ctx;
+  uint32_t count = 0;
+  uint32_t n, i, k = 0;
+
+  if (!isBatch()) return 0;
+  for (i = 0; i < 4; i++)
+    count |= (uint32_t)report.enclave.data[ATTEST_BATCH_TAG_LEN + i] << (8 * i);
+  if (proof->count != count || proof->index >= count) return 0;
+
+  prefix = ATTEST_BATCH_LEAF;
+  sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+  sha3_update(&ctx, &prefix, 1);
+  sha3_update(&ctx, data, len);
+  sha3_final(node, &ctx);
+
+  /* the same walk up the tree as the SM takes */
+  prefix = ATTEST_BATCH_INNER;
+  for (n = count, i = proof->index; n > 1; n = (n + 1) / 2, i >>= 1) {
+    if ((i ^ 1) >= n) continue;
+    if (k == ATTEST_BATCH_DEPTH) return 0;
+    sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+    sha3_update(&ctx, &prefix, 1);
+    if (i & 1) {
+      sha3_update(&ctx, proof->siblings[k], ATTEST_BATCH_NODE_SIZE);
+      sha3_update(&ctx, node, ATTEST_BATCH_NODE_SIZE);
+    } else {
+      sha3_update(&ctx, node, ATTEST_BATCH_NODE_SIZE);
+      sha3_update(&ctx, proof->siblings[k], ATTEST_BATCH_NODE_SIZE);
+    }
+    sha3_final(node, &ctx);
+    k++;
+  }
+
+  return memcmp(
+             node, report.enclave.data + ATTEST_BATCH_TAG_LEN + 4,
+             ATTEST_BATCH_NODE_SIZE) == 0;
+}
@@ -1,6 +1,302 @@
 #include "ed25519/fe.h"
 #include "ed25519/fixedint.h"
 
+#ifdef ED25519_FE51
+
+/*
+    radix 2^51 arithmetic for targets with 64x64->128 bit multiplication,
+    see fe.h. Every function leaves its result with all limbs below
+    2^51 + 2^15, which is what the next one expects of its inputs.
+*/
+
+typedef unsigned __int128 uint128_t;
+
+#define FE51_MASK ((((uint64_t)1) << 51) - 1)
+
+/* 4p, so that f - g cannot go negative */
+#define FE51_4P0 ((uint64_t)0x1fffffffffffb4)
+#define FE51_4P ((uint64_t)0x1ffffffffffffc)
+
+static uint64_t
+load_8(const unsigned char* in) {
+  uint64_t result = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i) {
+    result = (result << 8) | in[i];
+  }
+
+  return result;
+}
+
+static void
+fe_carry(fe h) {
+  uint64_t c;
+
+  c = h[0] >> 51;
+  h[0] &= FE51_MASK;
+  h[1] += c;
+  c = h[1] >> 51;
+  h[1] &= FE51_MASK;
+  h[2] += c;
+  c = h[2] >> 51;
+  h[2] &= FE51_MASK;
+  h[3] += c;
+  c = h[3] >> 51;
+  h[3] &= FE51_MASK;
+  h[4] += c;
+  c = h[4] >> 51;
+  h[4] &= FE51_MASK;
+  h[0] += 19 * c;
+}
+
+/* carry the 128 bit column sums of a product into h */
+static void
+fe_carry_wide(
+    fe h, uint128_t t0, uint128_t t1, uint128_t t2, uint128_t t3,
+    uint128_t t4) {
+  uint64_t c;
+
+  h[0] = (uint64_t)t0 & FE51_MASK;
+  t1 += (uint64_t)(t0 >> 51);
+  h[1] = (uint64_t)t1 & FE51_MASK;
+  t2 += (uint64_t)(t1 >> 51);
+  h[2] = (uint64_t)t2 & FE51_MASK;
+  t3 += (uint64_t)(t2 >> 51);
+  h[3] = (uint64_t)t3 & FE51_MASK;
+  t4 += (uint64_t)(t3 >> 51);
+  h[4] = (uint64_t)t4 & FE51_MASK;
+  c    = (uint64_t)(t4 >> 51);
+  h[0] += 19 * c;
+  c = h[0] >> 51;
+  h[0] &= FE51_MASK;
+  h[1] += c;
+}
+
+void
+fe_0(fe h) {
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+void
+fe_1(fe h) {
+  h[0] = 1;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+void
+fe_copy(fe h, const fe f) {
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+void
+fe_add(fe h, const fe f, const fe g) {
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+  fe_carry(h);
+}
+
+void
+fe_sub(fe h, const fe f, const fe g) {
+  h[0] = f[0] + FE51_4P0 - g[0];
+  h[1] = f[1] + FE51_4P - g[1];
+  h[2] = f[2] + FE51_4P - g[2];
+  h[3] = f[3] + FE51_4P - g[3];
+  h[4] = f[4] + FE51_4P - g[4];
+  fe_carry(h);
+}
+
+void
+fe_neg(fe h, const fe f) {
+  h[0] = FE51_4P0 - f[0];
+  h[1] = FE51_4P - f[1];
+  h[2] = FE51_4P - f[2];
+  h[3] = FE51_4P - f[3];
+  h[4] = FE51_4P - f[4];
+  fe_carry(h);
+}
+
+/*
+    Replace (f,g) with (g,g) if b == 1;
+    replace (f,g) with (f,g) if b == 0.
+    Preconditions: b in {0,1}.
+*/
+
+void
+fe_cmov(fe f, const fe g, unsigned int b) {
+  uint64_t mask = (uint64_t)0 - b;
+
+  f[0] ^= mask & (f[0] ^ g[0]);
+  f[1] ^= mask & (f[1] ^ g[1]);
+  f[2] ^= mask & (f[2] ^ g[2]);
+  f[3] ^= mask & (f[3] ^ g[3]);
+  f[4] ^= mask & (f[4] ^ g[4]);
+}
+
+/*
+    Replace (f,g) with (g,f) if b == 1;
+    replace (f,g) with (f,g) if b == 0.
+    Preconditions: b in {0,1}.
+*/
+
+void
+fe_cswap(fe f, fe g, unsigned int b) {
+  uint64_t mask = (uint64_t)0 - b;
+  uint64_t x;
+  int i;
+
+  for (i = 0; i < 5; ++i) {
+    x = mask & (f[i] ^ g[i]);
+    f[i] ^= x;
+    g[i] ^= x;
+  }
+}
+
+/* Ignores the top bit of s, as the 32-bit version does */
+void
+fe_frombytes(fe h, const unsigned char* s) {
+  h[0] = load_8(s) & FE51_MASK;
+  h[1] = (load_8(s + 6) >> 3) & FE51_MASK;
+  h[2] = (load_8(s + 12) >> 6) & FE51_MASK;
+  h[3] = (load_8(s + 19) >> 1) & FE51_MASK;
+  h[4] = (load_8(s + 24) >> 12) & FE51_MASK;
+}
+
+/* Writes the representative of h in [0, p) */
+void
+fe_tobytes(unsigned char* s, const fe h) {
+  uint64_t t[5];
+  uint64_t w;
+  int i;
+
+  fe_copy(t, h);
+  fe_carry(t);
+  fe_carry(t);
+
+  /* t < 2^255 now; t + 19 carries out of 2^255 exactly if t >= p */
+  t[0] += 19;
+  fe_carry(t);
+
+  /* subtract the 19 again, through 2^255 - 19 + t - 2^255 */
+  t[0] += FE51_MASK + 1 - 19;
+  t[1] += FE51_MASK;
+  t[2] += FE51_MASK;
+  t[3] += FE51_MASK;
+  t[4] += FE51_MASK;
+  t[1] += t[0] >> 51;
+  t[0] &= FE51_MASK;
+  t[2] += t[1] >> 51;
+  t[1] &= FE51_MASK;
+  t[3] += t[2] >> 51;
+  t[2] &= FE51_MASK;
+  t[4] += t[3] >> 51;
+  t[3] &= FE51_MASK;
+  t[4] &= FE51_MASK;
+
+  w = t[0] | (t[1] << 51);
+  for (i = 0; i < 8; ++i, w >>= 8) s[i] = (unsigned char)w;
+  w = (t[1] >> 13) | (t[2] << 38);
+  for (i = 8; i < 16; ++i, w >>= 8) s[i] = (unsigned char)w;
+  w = (t[2] >> 26) | (t[3] << 25);
+  for (i = 16; i < 24; ++i, w >>= 8) s[i] = (unsigned char)w;
+  w = (t[3] >> 39) | (t[4] << 12);
+  for (i = 24; i < 32; ++i, w >>= 8) s[i] = (unsigned char)w;
+}
+
+/*
+    h = f * g
+    Can overlap h with f or g.
+*/
+
+void
+fe_mul(fe h, const fe f, const fe g) {
+  uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3,
+           g4_19 = 19 * g4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t)f0 * g0 + (uint128_t)f1 * g4_19 + (uint128_t)f2 * g3_19 +
+       (uint128_t)f3 * g2_19 + (uint128_t)f4 * g1_19;
+  t1 = (uint128_t)f0 * g1 + (uint128_t)f1 * g0 + (uint128_t)f2 * g4_19 +
+       (uint128_t)f3 * g3_19 + (uint128_t)f4 * g2_19;
+  t2 = (uint128_t)f0 * g2 + (uint128_t)f1 * g1 + (uint128_t)f2 * g0 +
+       (uint128_t)f3 * g4_19 + (uint128_t)f4 * g3_19;
+  t3 = (uint128_t)f0 * g3 + (uint128_t)f1 * g2 + (uint128_t)f2 * g1 +
+       (uint128_t)f3 * g0 + (uint128_t)f4 * g4_19;
+  t4 = (uint128_t)f0 * g4 + (uint128_t)f1 * g3 + (uint128_t)f2 * g2 +
+       (uint128_t)f3 * g1 + (uint128_t)f4 * g0;
+
+  fe_carry_wide(h, t0, t1, t2, t3, t4);
+}
+
+/*
+    h = f * 121666
+    Can overlap h with f.
+*/
+
+void
+fe_mul121666(fe h, fe f) {
+  fe_carry_wide(
+      h, (uint128_t)f[0] * 121666, (uint128_t)f[1] * 121666,
+      (uint128_t)f[2] * 121666, (uint128_t)f[3] * 121666,
+      (uint128_t)f[4] * 121666);
+}
+
+/*
+    h = f * f
+    Can overlap h with f.
+*/
+
+void
+fe_sq(fe h, const fe f) {
+  uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+  uint64_t f3_19 = 19 * f3, f3_38 = 38 * f3;
+  uint64_t f4_19 = 19 * f4, f4_38 = 38 * f4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t)f0 * f0 + (uint128_t)f1 * f4_38 + (uint128_t)f2 * f3_38;
+  t1 = (uint128_t)f0_2 * f1 + (uint128_t)f2 * f4_38 + (uint128_t)f3 * f3_19;
+  t2 = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1 + (uint128_t)f3 * f4_38;
+  t3 = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2 + (uint128_t)f4 * f4_19;
+  t4 = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3 + (uint128_t)f2 * f2;
+
+  fe_carry_wide(h, t0, t1, t2, t3, t4);
+}
+
+/*
+    h = 2 * f * f
+    Can overlap h with f.
+*/
+
+void
+fe_sq2(fe h, const fe f) {
+  fe_sq(h, f);
+  h[0] <<= 1;
+  h[1] <<= 1;
+  h[2] <<= 1;
+  h[3] <<= 1;
+  h[4] <<= 1;
+  fe_carry(h);
+}
+
+#else
+
 /*
     helper functions
 */
@@ -355,6 +651,8 @@ fe_frombytes(fe h, const unsigned char* s) {
   h[9] = (int32_t)h9;
 }
 
+#endif
+
 void
 fe_invert(fe out, const fe z) {
   fe t0;
@@ -512,6 +810,8 @@ fe_isnonzero(const fe f) {
   return r != 0;
 }
 
+#ifndef ED25519_FE51
+
 /*
     h = f * g
     Can overlap h with f or g.
@@ -899,6 +1199,8 @@ fe_neg(fe h, const fe f) {
   h[9] = h9;
 }
 
+#endif
+
 void
 fe_pow22523(fe out, const fe z) {
   fe t0;
@@ -985,6 +1287,8 @@ fe_pow22523(fe out, const fe z) {
   return;
 }
 
+#ifndef ED25519_FE51
+
 /*
 h = f * f
 Can overlap h with f.
@@ -1510,3 +1814,5 @@ fe_tobytes(unsigned char* s, const fe h) {
   s[30] = (unsigned char)(h9 >> 10);
   s[31] = (unsigned char)(h9 >> 18);
 }
+
+#endif
@@ -131,11 +131,23 @@ ge_double_scalarmult_vartime(
   }
 }
 
+#ifdef ED25519_FE51
+static const fe d = {
+    0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029,
+    0x739c663a03cbb, 0x52036cee2b6ff};
+#else
 static const fe d = {-10913610, 13857413, -15372611, 6949391,   114729,
                      -8787816,  -6275908, -3247719,  -18696448, -12055116};
+#endif
 
+#ifdef ED25519_FE51
+static const fe sqrtm1 = {
+    0x61b274a0ea0b0, 0x0d5a5fc8f189d, 0x7ef5e9cbd0c60,
+    0x78595a6804c9e, 0x2b8324804fc1d};
+#else
 static const fe sqrtm1 = {-32595792, -7943725,  9377950,  3500415, 12389472,
                           -272473,   -25146209, -2005654, 326686,  11406482};
+#endif
 
 int
 ge_frombytes_negate_vartime(ge_p3* h, const unsigned char* s) {
@@ -291,8 +303,14 @@ ge_p3_dbl(ge_p1p1* r, const ge_p3* p) {
 r = p
 */
 
+#ifdef ED25519_FE51
+static const fe d2 = {
+    0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052,
+    0x6738cc7407977, 0x2406d9dc56dff};
+#else
 static const fe d2 = {-21827239, -5839606,  -30745221, 13898782, 229458,
                       15978800,  -12551817, -6495438,  29715968, 9444199};
+#endif
 
 void
 ge_p3_to_cached(ge_cached* r, const ge_p3* p) {
@@ -6,15 +6,18 @@
 #include <getopt.h>
 #include <keystone.h>
 
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <string>
 #include <thread>
 
+#include "EnclavePool.hpp"
 #include "gtest/gtest.h"
 
 #define EYRIE_RT "eyrie-rt"
 #define TEST_EAPP "stack.eapp_riscv"
+#define TEST_LOADER "loader.bin"
 #define FAKE_EAPP "fake_file.riscv"
 #define FAKE_RT "fake-rt"
 #define MD_SIZE 64
@@ -23,6 +26,7 @@ size_t untrusted_size = 2 * 1024 * 1024;
 size_t freemem_size   = 48 * 1024 * 1024;
 
 using Keystone::Enclave;
+using Keystone::EnclavePool;
 using Keystone::Error;
 using Keystone::Params;
 
@@ -48,6 +52,34 @@ TEST(Enclave_Init, DeterministicMeasurement) {
   EXPECT_EQ(Error::Success, enclave2.destroy());
 }
 
+TEST(Enclave_Init, ImageMeasurement) {
+  /* An enclave created from an EnclaveImage has the measurement of one
+   * created from the files
+   *
+   * */
+  Enclave enclave1, enclave2;
+  Keystone::EnclaveImage image;
+  Params params;
+  char hash[MD_SIZE];
+
+  params.setFreeMemSize(untrusted_size);
+  params.setUntrustedSize(untrusted_size);
+  params.setSimulated(true);
+
+  EXPECT_EQ(Error::Success, image.init(TEST_EAPP, EYRIE_RT, TEST_LOADER));
+  EXPECT_EQ(
+      Error::Success, enclave1.init(TEST_EAPP, EYRIE_RT, TEST_LOADER, params));
+  EXPECT_EQ(Error::Success, enclave2.init(image, params));
+  EXPECT_EQ(0, memcmp(enclave1.getHash(), enclave2.getHash(), MD_SIZE));
+  EXPECT_EQ(0, memcmp(image.getHash(), enclave2.getHash(), MD_SIZE));
+
+  EXPECT_EQ(
+      Error::Success, Enclave::measure(hash, TEST_EAPP, EYRIE_RT, TEST_LOADER));
+  EXPECT_EQ(0, memcmp(hash, enclave2.getHash(), MD_SIZE));
+  EXPECT_EQ(Error::Success, enclave1.destroy());
+  EXPECT_EQ(Error::Success, enclave2.destroy());
+}
+
 TEST(Enclave_Init, InvalidRT) {
   /* Tests enclave with a non-existant runtime
    *
@@ -91,6 +123,115 @@ TEST(Enclave_Run, RunTest) {
   EXPECT_EQ(enclave.run(), Error::Success);
 }
 
+static Params
+pool_params() {
+  Params params;
+
+  params.setFreeMemSize(untrusted_size);
+  params.setUntrustedSize(untrusted_size);
+  params.setSimulated(true);
+  return params;
+}
+
+/* Waits for the filler to bring the pool up to ready enclaves */
+static bool
+wait_ready(EnclavePool* pool, size_t ready) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+  while (pool->getReady() < ready) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+TEST(Enclave_Pool, CheckoutFromEmptyPool) {
+  /* Checking out faster than the filler refills must fall back to
+   * creating the enclave in the caller
+   *
+   * */
+  EnclavePool pool;
+  EXPECT_EQ(
+      Error::Success,
+      pool.init(TEST_EAPP, EYRIE_RT, TEST_LOADER, pool_params(), 1));
+
+  std::vector<std::unique_ptr<Enclave>> enclaves;
+  for (int i = 0; i < 100 && pool.getStats().misses == 0; i++) {
+    enclaves.push_back(pool.checkout());
+    ASSERT_NE(nullptr, enclaves.back());
+  }
+
+  EnclavePool::Stats stats = pool.getStats();
+  EXPECT_LE(1u, stats.misses);
+  EXPECT_EQ(enclaves.size(), stats.hits + stats.misses);
+  EXPECT_EQ(0u, stats.failed);
+}
+
+TEST(Enclave_Pool, RefillsAfterCheckout) {
+  /* The filler tops the pool up again after every checkout
+   *
+   * */
+  EnclavePool pool;
+  EXPECT_EQ(
+      Error::Success,
+      pool.init(TEST_EAPP, EYRIE_RT, TEST_LOADER, pool_params(), 2));
+  ASSERT_TRUE(wait_ready(&pool, 2));
+
+  std::unique_ptr<Enclave> enclave = pool.checkout();
+  ASSERT_NE(nullptr, enclave);
+  EXPECT_TRUE(wait_ready(&pool, 2));
+  EXPECT_EQ(2u, pool.getReady());
+  EXPECT_EQ(Error::Success, enclave->destroy());
+}
+
+TEST(Enclave_Pool, Stats) {
+  /* Counts checkouts served from the pool and the enclaves created
+   *
+   * */
+  EnclavePool pool;
+  EXPECT_EQ(
+      Error::Success,
+      pool.init(TEST_EAPP, EYRIE_RT, TEST_LOADER, pool_params(), 2));
+  ASSERT_TRUE(wait_ready(&pool, 2));
+
+  EnclavePool::Stats stats = pool.getStats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(0u, stats.misses);
+  EXPECT_EQ(2u, stats.created);
+  EXPECT_EQ(0, stats.hitRate());
+
+  std::unique_ptr<Enclave> enclave = pool.checkout();
+  ASSERT_NE(nullptr, enclave);
+  ASSERT_TRUE(wait_ready(&pool, 2));
+
+  stats = pool.getStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(0u, stats.misses);
+  EXPECT_EQ(3u, stats.created);
+  EXPECT_EQ(0u, stats.failed);
+  EXPECT_EQ(1, stats.hitRate());
+  EXPECT_LT(0u, stats.avgCreateNs());
+  EXPECT_LE(stats.avgCreateNs(), stats.max_create_ns);
+  EXPECT_EQ(stats.create_ns / 3, stats.avgCreateNs());
+}
+
+TEST(Enclave_Pool, ShutdownWhileFilling) {
+  /* Dropping the pool while the filler is still creating enclaves stops
+   * and joins it, and destroys the enclaves it made
+   *
+   * */
+  for (int i = 0; i < 10; i++) {
+    EnclavePool pool;
+    EXPECT_EQ(
+        Error::Success,
+        pool.init(TEST_EAPP, EYRIE_RT, TEST_LOADER, pool_params(), 16));
+    std::unique_ptr<Enclave> enclave = pool.checkout();
+    EXPECT_NE(nullptr, enclave);
+  }
+}
+
 TEST(LoggingTest, RedirectsWithoutError) {
   /* Tests if we can direct to the standard streams or files without error. */
   Keystone::Logger logger{};
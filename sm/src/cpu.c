@@ -24,10 +24,16 @@ int cpu_get_enclave_id(void)
   return cpus[csr_read(mhartid)].eid;
 }
 
-void cpu_enter_enclave_context(enclave_id eid)
+unsigned int cpu_get_enclave_thread(void)
+{
+  return cpus[csr_read(mhartid)].tid;
+}
+
+void cpu_enter_enclave_context(enclave_id eid, unsigned int tid)
 {
   cpus[csr_read(mhartid)].is_enclave = 1;
   cpus[csr_read(mhartid)].eid = eid;
+  cpus[csr_read(mhartid)].tid = tid;
 }
 
 void cpu_exit_enclave_context(void)
@@ -13,12 +13,14 @@ struct cpu_state
 {
   int is_enclave;
   enclave_id eid;
+  unsigned int tid;
 };
 
 /* external functions */
 int cpu_is_enclave_context(void);
 int cpu_get_enclave_id(void);
-void cpu_enter_enclave_context(enclave_id eid);
+unsigned int cpu_get_enclave_thread(void);
+void cpu_enter_enclave_context(enclave_id eid, unsigned int tid);
 void cpu_exit_enclave_context(void);
 
 #endif
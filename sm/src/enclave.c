@@ -8,6 +8,10 @@
 #include "page.h"
 #include "cpu.h"
 #include "platform-hook.h"
+#include "ipi.h"
+#include "keystore.h"
+#include "perf.h"
+#include "trace.h"
 #include <sbi/sbi_string.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_locks.h>
@@ -21,11 +25,31 @@
 
 struct enclave enclaves[ENCL_MAX];
 
+/* There is no global enclave lock. enclaves[eid].state only changes by
+ * atomic compare-and-swap, so that exactly one hart wins each lifecycle
+ * transition; the rest of the metadata is guarded by enclaves[eid].lock.
+ * An eid is owned from the moment its bit is set in encl_eid_bitmap until
+ * its state is INVALID again. */
+#define EID_BITS_PER_WORD (8 * sizeof(unsigned long))
+#define EID_BITMAP_WORDS  ((ENCL_MAX + EID_BITS_PER_WORD - 1) / EID_BITS_PER_WORD)
+
+static unsigned long encl_eid_bitmap[EID_BITMAP_WORDS];
+
+static inline enclave_state encl_state(enclave_id eid)
+{
+  return __atomic_load_n(&enclaves[eid].state, __ATOMIC_ACQUIRE);
+}
+
+/* returns 1 if the state was `from` and is now `to`, 0 otherwise */
+static inline int encl_state_cas(enclave_id eid, enclave_state from, enclave_state to)
+{
+  return __atomic_compare_exchange_n(&enclaves[eid].state, &from, to, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
 // Enclave IDs are unsigned ints, so we do not need to check if eid is
 // greater than or equal to 0
-#define ENCLAVE_EXISTS(eid) (eid < ENCL_MAX && enclaves[eid].state >= 0)
-
-static spinlock_t encl_lock = SPIN_LOCK_INITIALIZER;
+#define ENCLAVE_EXISTS(eid) (eid < ENCL_MAX && encl_state(eid) >= 0)
 
 extern void save_host_regs(void);
 extern void restore_host_regs(void);
@@ -37,6 +61,8 @@ extern byte sm_private_key[PRIVATE_KEY_SIZE];
 extern byte sm_cert[CERT_SIZE];
 extern byte dev_cert[CERT_SIZE];
 extern byte man_cert[CERT_SIZE];
+
+static int build_crt_templates(void);
 extern int sm_cert_len;
 extern int dev_cert_len;
 extern int man_cert_len;
@@ -51,17 +77,22 @@ extern int man_cert_len;
 /* Internal function containing the core of the context switching
  * code to the enclave.
  *
- * Used by resume_enclave and run_enclave.
+ * Used by run_enclave and run_thread.
  *
- * Expects that eid has already been valided, and it is OK to run this enclave
+ * Expects that eid and tid have already been valided, and it is OK to run
+ * this thread of the enclave
 */
 static inline void context_switch_to_enclave(struct sbi_trap_regs* regs,
                                                 enclave_id eid,
+                                                unsigned int tid,
                                                 int load_parameters){
+  struct thread_state* thread = &enclaves[eid].threads[tid];
+  unsigned long start = sm_perf_now();
+
   /* save host context */
-  swap_prev_state(&enclaves[eid].threads[0], regs, 1);
-  swap_prev_mepc(&enclaves[eid].threads[0], regs, regs->mepc);
-  swap_prev_mstatus(&enclaves[eid].threads[0], regs, regs->mstatus);
+  swap_prev_state(thread, regs, 1);
+  swap_prev_mepc(thread, regs, regs->mepc);
+  swap_prev_mstatus(thread, regs, regs->mstatus);
 
   uintptr_t interrupts = 0;
   csr_write(mideleg, interrupts);
@@ -91,40 +122,38 @@ static inline void context_switch_to_enclave(struct sbi_trap_regs* regs,
 
   switch_vector_enclave();
 
-  // set PMP
-  osm_pmp_set(PMP_NO_PERM);
-  int memid;
-  for(memid=0; memid < ENCLAVE_REGIONS_MAX; memid++) {
-    if(enclaves[eid].regions[memid].type != REGION_INVALID) {
-      pmp_set_keystone(enclaves[eid].regions[memid].pmp_rid, PMP_ALL_PERM);
-    }
-  }
+  // set PMP: close the OS region, open the enclave regions
+  pmp_switch_apply(&enclaves[eid].pmp_switch, 1);
 
   // Setup any platform specific defenses
   platform_switch_to_enclave(&(enclaves[eid]));
-  cpu_enter_enclave_context(eid);
+  cpu_enter_enclave_context(eid, tid);
+
+  // global PMP updates can wait until this hart returns to the host
+  pmp_ipi_enter_enclave();
+
+  sm_perf_record(SM_PERF_SWITCH_TO_ENCLAVE, start);
 }
 
 static inline void context_switch_to_host(struct sbi_trap_regs *regs,
     enclave_id eid,
+    unsigned int tid,
     int return_on_resume){
+  struct thread_state* thread = &enclaves[eid].threads[tid];
+  unsigned long start = sm_perf_now();
 
   // set PMP
-  int memid;
-  for(memid=0; memid < ENCLAVE_REGIONS_MAX; memid++) {
-    if(enclaves[eid].regions[memid].type != REGION_INVALID) {
-      pmp_set_keystone(enclaves[eid].regions[memid].pmp_rid, PMP_NO_PERM);
-    }
-  }
-  osm_pmp_set(PMP_ALL_PERM);
+  pmp_switch_apply(&enclaves[eid].pmp_switch, 0);
+  // catch up on the global PMP updates made while in the enclave
+  pmp_ipi_exit_enclave();
 
   uintptr_t interrupts = MIP_SSIP | MIP_STIP | MIP_SEIP;
   csr_write(mideleg, interrupts);
 
   /* restore host context */
-  swap_prev_state(&enclaves[eid].threads[0], regs, return_on_resume);
-  swap_prev_mepc(&enclaves[eid].threads[0], regs, regs->mepc);
-  swap_prev_mstatus(&enclaves[eid].threads[0], regs, regs->mstatus);
+  swap_prev_state(thread, regs, return_on_resume);
+  swap_prev_mepc(thread, regs, regs->mepc);
+  swap_prev_mstatus(thread, regs, regs->mstatus);
 
   switch_vector_host();
 
@@ -148,6 +177,7 @@ static inline void context_switch_to_host(struct sbi_trap_regs *regs,
 
   cpu_exit_enclave_context();
 
+  sm_perf_record(SM_PERF_SWITCH_TO_HOST, start);
   return;
 }
 
@@ -156,15 +186,20 @@ static inline void context_switch_to_host(struct sbi_trap_regs *regs,
 // refactoring needed
 /*
  * Init all metadata as needed for keeping track of enclaves
- * Called once by the SM on startup
+ * Called once by the SM on startup; fails if the certificate templates
+ * every enclave needs cannot be built
  */
-void enclave_init_metadata(void){
+unsigned long enclave_init_metadata(void){
   enclave_id eid;
   int i=0;
 
+  for(i=0; i < EID_BITMAP_WORDS; i++)
+    encl_eid_bitmap[i] = 0;
+
   /* Assumes eids are incrementing values, which they are for now */
   for(eid=0; eid < ENCL_MAX; eid++){
     enclaves[eid].state = INVALID;
+    enclaves[eid].lock = (spinlock_t) SPIN_LOCK_INITIALIZER;
 
     // Clear out regions
     for(i=0; i < ENCLAVE_REGIONS_MAX; i++){
@@ -174,51 +209,75 @@ void enclave_init_metadata(void){
     platform_init_enclave(&(enclaves[eid]));
   }
 
+  if (build_crt_templates())
+    return SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
+  return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
 
-static unsigned long clean_enclave_memory(uintptr_t utbase, uintptr_t utsize)
+/* EPM regions of destroyed enclaves wait here, indexed by their PMP
+ * region, until the host has had them cleared through
+ * scrub_enclave_memory. Until then the PMP region stays allocated and
+ * NO_PERM on every hart running the host, so neither the OS nor a new
+ * enclave can map the memory. */
+struct scrub_region
 {
+  uintptr_t base;
+  size_t size;
+  size_t next;  // offset of the next chunk to hand out
+  size_t done;  // bytes cleared so far
+  int pending;
+};
 
-  // This function is quite temporary. See issue #38
-
-  // Zero out the untrusted memory region, since it may be in
-  // indeterminate state.
-  sbi_memset((void*)utbase, 0, utsize);
+static struct scrub_region scrubs[PMP_MAX_N_REGION];
 
-  return SBI_ERR_SM_ENCLAVE_SUCCESS;
+static void scrub_region_add(region_id rid)
+{
+  scrubs[rid].base = pmp_region_get_addr(rid);
+  scrubs[rid].size = pmp_region_get_size(rid);
+  scrubs[rid].next = 0;
+  scrubs[rid].done = 0;
+  __atomic_store_n(&scrubs[rid].pending, 1, __ATOMIC_RELEASE);
 }
 
+/* Claims the lowest free eid by atomically setting its bit, and marks the
+ * enclave ALLOCATED. Losing a race for a bit just moves on to the next. */
 static unsigned long encl_alloc_eid(enclave_id* _eid)
 {
+  unsigned long word, bit;
   enclave_id eid;
+  int i;
 
-  spin_lock(&encl_lock);
-
-  for(eid=0; eid<ENCL_MAX; eid++)
+  for(i = 0; i < EID_BITMAP_WORDS; i++)
   {
-    if(enclaves[eid].state == INVALID){
-      break;
+    word = __atomic_load_n(&encl_eid_bitmap[i], __ATOMIC_RELAXED);
+    while(~word)
+    {
+      eid = i * EID_BITS_PER_WORD + __builtin_ctzl(~word);
+      if(eid >= ENCL_MAX)
+        break;
+
+      bit = 1UL << (eid % EID_BITS_PER_WORD);
+      word = __atomic_fetch_or(&encl_eid_bitmap[i], bit, __ATOMIC_ACQUIRE);
+      if(!(word & bit)) {
+        __atomic_store_n(&enclaves[eid].state, ALLOCATED, __ATOMIC_RELEASE);
+        *_eid = eid;
+        return SBI_ERR_SM_ENCLAVE_SUCCESS;
+      }
+      word |= bit;
     }
   }
-  if(eid != ENCL_MAX)
-    enclaves[eid].state = ALLOCATED;
-
-  spin_unlock(&encl_lock);
 
-  if(eid != ENCL_MAX){
-    *_eid = eid;
-    return SBI_ERR_SM_ENCLAVE_SUCCESS;
-  }
-  else{
-    return SBI_ERR_SM_ENCLAVE_NO_FREE_RESOURCE;
-  }
+  return SBI_ERR_SM_ENCLAVE_NO_FREE_RESOURCE;
 }
 
 static unsigned long encl_free_eid(enclave_id eid)
 {
-  spin_lock(&encl_lock);
-  enclaves[eid].state = INVALID;
-  spin_unlock(&encl_lock);
+  unsigned long bit = 1UL << (eid % EID_BITS_PER_WORD);
+
+  /* the enclave reads INVALID before anyone may claim the eid again */
+  __atomic_store_n(&enclaves[eid].state, INVALID, __ATOMIC_RELEASE);
+  __atomic_fetch_and(&encl_eid_bitmap[eid / EID_BITS_PER_WORD], ~bit,
+                     __ATOMIC_RELEASE);
   return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
 
@@ -249,6 +308,33 @@ uintptr_t get_enclave_region_base(enclave_id eid, int memid)
   return 0;
 }
 
+/* Precompute the PMP changes of a context switch into the enclave: the
+ * OS region closes, the enclave regions open (and the other way around
+ * on the way out) */
+static unsigned long build_pmp_switch(enclave_id eid)
+{
+  struct pmp_switch* sw = &enclaves[eid].pmp_switch;
+  uint8_t perm;
+  int memid;
+
+  pmp_switch_init(sw);
+  if(osm_pmp_switch_add(sw))
+    return SBI_ERR_SM_ENCLAVE_PMP_FAILURE;
+
+  for(memid=0; memid < ENCLAVE_REGIONS_MAX; memid++) {
+    if(enclaves[eid].regions[memid].type == REGION_INVALID)
+      continue;
+    perm = PMP_ALL_PERM;
+    if(enclaves[eid].regions[memid].type == REGION_DEVICE)
+      perm = PMP_R | PMP_W;
+    if(pmp_switch_add(sw, enclaves[eid].regions[memid].pmp_rid,
+                      perm, PMP_NO_PERM, 1))
+      return SBI_ERR_SM_ENCLAVE_PMP_FAILURE;
+  }
+
+  return SBI_ERR_SM_ENCLAVE_SUCCESS;
+}
+
 // TODO: This function is externally used by sm-sbi.c.
 // Change it to be internal (remove from the enclave.h and make static)
 /* Internal function enforcing a copy source is from the untrusted world.
@@ -289,6 +375,35 @@ static unsigned long copy_enclave_report(struct enclave* enclave,
     return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
 
+struct device_window
+{
+  uintptr_t base;
+  size_t size;
+};
+
+#ifdef SM_DEVICE_WINDOWS
+static const struct device_window device_windows[] = SM_DEVICE_WINDOWS;
+#endif
+
+/* An enclave may only take (part of) a device window the platform lists;
+ * PMP regions and so the window are page granular */
+static int is_device_window_allowed(uintptr_t base, size_t size)
+{
+  if ((base | size) & (RISCV_PGSIZE - 1))
+    return 0;
+  if (base + size < base)
+    return 0;
+
+#ifdef SM_DEVICE_WINDOWS
+  for (size_t i = 0; i < sizeof(device_windows) / sizeof(device_windows[0]); i++) {
+    if (base >= device_windows[i].base &&
+        base + size <= device_windows[i].base + device_windows[i].size)
+      return 1;
+  }
+#endif
+  return 0;
+}
+
 static int is_create_args_valid(struct keystone_sbi_create_t* args)
 {
   uintptr_t epm_start, epm_end;
@@ -334,7 +449,12 @@ static int is_create_args_valid(struct keystone_sbi_create_t* args)
     return 0;
   if (args->user_paddr > args->free_paddr)
     return 0;
-  
+
+  if (args->device_region.size &&
+      !is_device_window_allowed(args->device_region.paddr,
+                                args->device_region.size))
+    return 0;
+
   return 1;
 }
 
@@ -346,10 +466,136 @@ static int is_create_args_valid(struct keystone_sbi_create_t* args)
  *********************************/
 
 
+/* The LAK and LDevID certificates of all enclaves differ only in their
+ * serial, subject key and measurement. Each is written once with the full
+ * DER writer, as a template for either value of the top bit of the serial
+ * (which changes its DER length); issuing one then takes a copy, three
+ * patches and a signature.
+ */
+static mbedtls_x509write_crt_template lak_crt_template[2];
+static mbedtls_x509write_crt_template ldev_crt_template[2];
+
+static int build_crt_template(mbedtls_x509write_crt_template *tmpl,
+                              const char *subject, const char *not_after,
+                              unsigned char serial)
+{
+  mbedtls_x509write_cert crt;
+  mbedtls_pk_context subj_key;
+  mbedtls_pk_context issu_key;
+  unsigned char pk[PUBLIC_KEY_SIZE];
+  dice_tcbInfo tcbInfo;
+  measure m;
+  const unsigned char OID_algo[] = {0x60,0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x0A};
+  unsigned char buf[324];
+  int ret;
+
+  // Placeholders for the subject key and the measurement, located in the DER afterwards
+  sbi_memset(pk, 0x11, PUBLIC_KEY_SIZE);
+  sbi_memset(m.digest, 0x22, 64);
+
+  mbedtls_x509write_crt_init(&crt);
+
+  ret = mbedtls_x509write_crt_set_issuer_name_mod(&crt, "CN=Security Monitor");
+  if (ret != 0)
+    return ret;
+  ret = mbedtls_x509write_crt_set_subject_name_mod(&crt, subject);
+  if (ret != 0)
+    return ret;
+
+  mbedtls_pk_init(&subj_key);
+  mbedtls_pk_init(&issu_key);
+
+  // The template is signed like any certificate, the signature is replaced on issuance
+  ret = mbedtls_pk_parse_public_key(&issu_key, sm_private_key, 64, 1);
+  if (ret != 0)
+    return ret;
+  ret = mbedtls_pk_parse_public_key(&issu_key, sm_public_key, 32, 0);
+  if (ret != 0)
+    return ret;
+  ret = mbedtls_pk_parse_public_key(&subj_key, pk, 32, 0);
+  if (ret != 0)
+    return ret;
+
+  mbedtls_x509write_crt_set_subject_key(&crt, &subj_key);
+  mbedtls_x509write_crt_set_issuer_key(&crt, &issu_key);
+  mbedtls_x509write_crt_set_serial_raw(&crt, &serial, 1);
+  mbedtls_x509write_crt_set_md_alg(&crt, KEYSTONE_SHA3);
+  mbedtls_x509write_crt_set_key_usage(&crt, MBEDTLS_X509_KU_DIGITAL_SIGNATURE);
+
+  ret = mbedtls_x509write_crt_set_validity(&crt, "20230101000000", not_after);
+  if (ret != 0)
+    return ret;
+
+  init_dice_tcbInfo(&tcbInfo);
+  m.oid_len = 9;
+  sbi_memcpy(m.OID_algho, OID_algo, m.oid_len);
+  set_dice_tcbInfo_measure(&tcbInfo, m);
+
+  ret = mbedtls_x509write_crt_set_dice_tcbInfo(&crt, tcbInfo, sizeof(buf), buf, sizeof(buf));
+  if (ret != 0)
+    return ret;
+
+  return mbedtls_x509write_crt_template_init(tmpl, &crt, pk, m.digest);
+}
+
+static int build_crt_templates(void)
+{
+  for (int msb = 0; msb < 2; msb++) {
+    if (build_crt_template(&lak_crt_template[msb], "CN=Enclave LAK",
+                           "20260101000000", msb << 7) ||
+        build_crt_template(&ldev_crt_template[msb], "CN=Enclave LDevID",
+                           "20250101000000", msb << 7)) {
+      sbi_printf("[SM] failed to build the enclave certificate templates\n");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Derive the enclave's CDI and local attestation key (LAK) from its
+ * measurement, and issue the LAK certificate signed by the SM.
+ *
+ * This only touches enclaves[eid]. create_enclave calls it while the
+ * enclave is still ALLOCATED, which no other SBI call acts on, so it runs
+ * without taking any lock.
+ */
+static unsigned long issue_local_attestation_cert(enclave_id eid)
+{
+  byte CDI[64];
+  sha3_ctx_t hash_ctx_to_use;
+  // The serial of the cert
+  unsigned char serial = eid;
+  int ret;
+
+  sha3_init(&hash_ctx_to_use, 64);
+  sha3_update(&hash_ctx_to_use, CDI, 64);
+  sha3_update(&hash_ctx_to_use, enclaves[eid].hash, 64);
+  sha3_final(enclaves[eid].CDI, &hash_ctx_to_use);
+
+  ed25519_create_keypair(enclaves[eid].local_att_pub, enclaves[eid].local_att_priv, enclaves[eid].CDI);
+
+  ret = mbedtls_x509write_crt_template_issue(&lak_crt_template[serial >> 7], serial,
+                                             enclaves[eid].local_att_pub, enclaves[eid].hash,
+                                             sm_public_key, sm_private_key,
+                                             enclaves[eid].crt_local_att_der,
+                                             sizeof(enclaves[eid].crt_local_att_der));
+  if (ret <= 0)
+    return SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
+
+  // The length of the der format of the cert is stored in the enclave structure
+  enclaves[eid].crt_local_att_der_length = ret;
+
+  return SBI_ERR_SM_ENCLAVE_SUCCESS;
+}
+
 /* This handles creation of a new enclave, based on arguments provided
  * by the untrusted host.
  *
  * This may fail if: it cannot allocate PMP regions, EIDs, etc
+ *
+ * Until the final ALLOCATED -> FRESH transition the enclave belongs to
+ * this hart alone, so measurement and certificate issuance run unlocked
+ * and creating one enclave does not hold up the other harts.
  */
 unsigned long create_enclave(unsigned long *eidptr, struct keystone_sbi_create_t create_args)
 {
@@ -358,17 +604,13 @@ unsigned long create_enclave(unsigned long *eidptr, struct keystone_sbi_create_t
   size_t size = create_args.epm_region.size;
   uintptr_t utbase = create_args.utm_region.paddr;
   size_t utsize = create_args.utm_region.size;
-  byte CDI[64];
-  sha3_ctx_t hash_ctx_to_use;
-  // Variable  used to specify the serial of the cert
-  unsigned char serial[] = {0x0};
-
-  unsigned char *cert_real;
-  int dif  = 0;
+  uintptr_t devbase = create_args.device_region.paddr;
+  size_t devsize = create_args.device_region.size;
 
   enclave_id eid;
   unsigned long ret;
-  int region, shared_region;
+  int region, shared_region, device_region = -1;
+  int i;
 
   /* Runtime parameters */
   if(!is_create_args_valid(&create_args))
@@ -385,8 +627,6 @@ unsigned long create_enclave(unsigned long *eidptr, struct keystone_sbi_create_t
   params.untrusted_size = utsize;
   params.free_requested = create_args.free_requested;
 
-  sbi_printf("creating the enclave...\n");
-
   // allocate eid
   ret = SBI_ERR_SM_ENCLAVE_NO_FREE_RESOURCE;
   if (encl_alloc_eid(&eid) != SBI_ERR_SM_ENCLAVE_SUCCESS)
@@ -401,13 +641,24 @@ unsigned long create_enclave(unsigned long *eidptr, struct keystone_sbi_create_t
   if(pmp_region_init_atomic(utbase, utsize, PMP_PRI_BOTTOM, &shared_region, 0))
     goto free_region;
 
-  // set pmp registers for private region (not shared)
-  if(pmp_set_global(region, PMP_NO_PERM))
+  // and one for the device window; as it may not overlap, a device
+  // belongs to one enclave at a time
+  if(devsize &&
+     pmp_region_init_atomic(devbase, devsize, PMP_PRI_ANY, &device_region, 0))
     goto free_shared_region;
 
-  // cleanup some memory regions for sanity See issue #38
-  clean_enclave_memory(utbase, utsize);
-
+  // set pmp registers for private region (not shared), in one IPI round
+  // together with whatever the platform sets up. The host loses the
+  // device window as well, until the enclave is destroyed
+  pmp_ipi_batch_begin();
+  if(pmp_set_global(region, PMP_NO_PERM)) {
+    pmp_ipi_batch_end();
+    goto free_device_region;
+  }
+  if(device_region >= 0 && pmp_set_global(device_region, PMP_NO_PERM)) {
+    pmp_ipi_batch_end();
+    goto unset_region;
+  }
 
   // initialize enclave metadata
   enclaves[eid].eid = eid;
@@ -416,6 +667,10 @@ unsigned long create_enclave(unsigned long *eidptr, struct keystone_sbi_create_t
   enclaves[eid].regions[0].type = REGION_EPM;
   enclaves[eid].regions[1].pmp_rid = shared_region;
   enclaves[eid].regions[1].type = REGION_UTM;
+  if(device_region >= 0) {
+    enclaves[eid].regions[2].pmp_rid = device_region;
+    enclaves[eid].regions[2].type = REGION_DEVICE;
+  }
 #if __riscv_xlen == 32
   enclaves[eid].encl_satp = ((base >> RISCV_PGSHIFT) | (SATP_MODE_SV32 << HGATP_MODE_SHIFT));
 #else
@@ -424,184 +679,53 @@ unsigned long create_enclave(unsigned long *eidptr, struct keystone_sbi_create_t
   enclaves[eid].n_thread = 0;
   enclaves[eid].params = params;
 
-  /* Init enclave state (regs etc) */
+  /* Init enclave state (regs etc); only thread 0 exists until the
+   * enclave creates more */
+  for(i = 0; i < MAX_ENCL_THREADS; i++)
+    enclaves[eid].thread_states[i] = THREAD_UNUSED;
+  enclaves[eid].thread_states[0] = THREAD_FRESH;
   clean_state(&enclaves[eid].threads[0]);
 
   /* Platform create happens as the last thing before hashing/etc since
      it may modify the enclave struct */
   ret = platform_create_enclave(&enclaves[eid]);
+  pmp_ipi_batch_end();
   if (ret)
     goto unset_region;
 
-  /* Validate memory, prepare hash and signature for attestation */
-    sbi_printf("in enclave creation before spin lock\n");
-
-  spin_lock(&encl_lock); // FIXME This should error for second enter.
+  ret = build_pmp_switch(eid);
+  if (ret)
+    goto free_platform;
 
-    sbi_printf("in enclave creation after spin lock\n");
- 
+  /* Validate memory, prepare hash and signature for attestation */
   ret = validate_and_hash_enclave(&enclaves[eid]);
-  /* The enclave is fresh if it has been validated and hashed but not run yet. */
   if (ret)
-    goto unlock;
-
-  enclaves[eid].state = FRESH;
-  /* EIDs are unsigned int in size, copy via simple copy */
-  *eidptr = eid;
-
-  sha3_init(&hash_ctx_to_use, 64);
-  sha3_update(&hash_ctx_to_use, CDI, 64);
-  sha3_update(&hash_ctx_to_use, enclaves[eid].hash, 64);
-  sha3_final(enclaves[eid].CDI, &hash_ctx_to_use);
-
-  ed25519_create_keypair(enclaves[eid].local_att_pub, enclaves[eid].local_att_priv, enclaves[eid].CDI);
-
-  sbi_printf("[SM] public_key: 0x");
-  for(int i = 0; i< 32; i++) {
-    sbi_printf("%02x", enclaves[eid].local_att_pub[i]);
-  }
-  sbi_printf("\n");
-
-  mbedtls_x509write_crt_init(&enclaves[eid].crt_local_att);
-
-  ret = mbedtls_x509write_crt_set_issuer_name_mod(&enclaves[eid].crt_local_att, "CN=Security Monitor");
-  if (ret != 0)
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-  
-  // Setting the name of the subject of the cert
-  ret = mbedtls_x509write_crt_set_subject_name_mod(&enclaves[eid].crt_local_att, "CN=Enclave LAK" );
-  if (ret != 0)
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-
-  // pk context used to embed the keys of the security monitor
-  mbedtls_pk_context subj_key;
-  mbedtls_pk_init(&subj_key);
-
-  // pk context used to embed the keys of the embedded CA
-  mbedtls_pk_context issu_key;
-  mbedtls_pk_init(&issu_key);
-
-  
-  // The keys of the embedded CA are used to sign the different certs associated to the local attestation keys of the different enclaves  
-  ret = mbedtls_pk_parse_public_key(&issu_key, sm_private_key, 64, 1);
-  if (ret != 0)
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-  ret = mbedtls_pk_parse_public_key(&issu_key, sm_public_key, 32, 0);
-  if (ret != 0)
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-
-  // Parsing the public key of the enclave that will be inserted in its certificate 
-  ret = mbedtls_pk_parse_public_key(&subj_key, enclaves[eid].local_att_pub, 32, 0);
-  if (ret != 0)
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-
-  serial[0] = eid;
-  
-  // The public key of the enclave is inserted in the structure
-  mbedtls_x509write_crt_set_subject_key(&enclaves[eid].crt_local_att, &subj_key);
-
-  // The private key of the embedded CA is used later to sign the cert
-  mbedtls_x509write_crt_set_issuer_key(&enclaves[eid].crt_local_att, &issu_key);
-  
-  // The serial of the cert is setted
-  mbedtls_x509write_crt_set_serial_raw(&enclaves[eid].crt_local_att, serial, 1);
-  
-  // The algoithm used to do the hash for the signature is specified
-  mbedtls_x509write_crt_set_md_alg(&enclaves[eid].crt_local_att, KEYSTONE_SHA3);
-  
-  mbedtls_x509write_crt_set_key_usage(&enclaves[eid].crt_local_att, MBEDTLS_X509_KU_DIGITAL_SIGNATURE);
-
-  // The validity of the crt is specified
-  ret = mbedtls_x509write_crt_set_validity(&enclaves[eid].crt_local_att, "20230101000000", "20260101000000");
-  if (ret != 0)
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-  //const char oid_ext[] = {0xff, 0x20, 0xff};
-  //const char oid_ext2[] = {0x55, 0x1d, 0x13};
-  //unsigned char max_path[] = {0x0A};
-  dice_tcbInfo tcbInfo;
-  init_dice_tcbInfo(&tcbInfo);
-
-  measure m;
-  const unsigned char OID_algo[] = {0x60,0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x0A};
-  m.oid_len = 9;
-  //unsigned char app[64];
-  sbi_memcpy(m.OID_algho, OID_algo, m.oid_len);
-  sbi_memcpy(m.digest, enclaves[eid].hash, 64);
-
-  set_dice_tcbInfo_measure(&tcbInfo, m);
-
-  int dim= 324;
-  unsigned char buf[324];
-
-  if(mbedtls_x509write_crt_set_dice_tcbInfo(&enclaves[eid].crt_local_att, tcbInfo, dim, buf, sizeof(buf))!=0)
-    sbi_printf("\nError setting DICETCB extension!\n");
+    goto free_platform;
 
-  unsigned char cert_der[1024];
-  int effe_len_cert_der = 0;
-  size_t len_cert_der_tot = 1024;
-
-  ret = mbedtls_x509write_crt_der(&enclaves[eid].crt_local_att, cert_der, len_cert_der_tot, NULL, NULL);
-  
-  if (ret > 0)
-  {
-    effe_len_cert_der = ret;
-    ret = 0;
-  }
-  else
-  {
-    ret = SBI_ERR_SM_ENCLAVE_UNKNOWN_ERROR;
-    goto unlock;
-  }
-  cert_real = cert_der;
-  dif  = 0;
-  dif= 1024-effe_len_cert_der;
-  cert_real += dif;
-
-  // The der format of the cert and its length are stored in the specific variables of the enclave structure
-  enclaves[eid].crt_local_att_der_length = effe_len_cert_der;
-  sbi_memcpy(enclaves[eid].crt_local_att_der, cert_real, effe_len_cert_der);
-
-  sbi_printf("[SM] certificato AK: 0x");
-  for(int i = 0; i< effe_len_cert_der; i++) {
-    sbi_printf("%02x", enclaves[eid].crt_local_att_der[i]);
-  }
-  sbi_printf("\n");
+  ret = issue_local_attestation_cert(eid);
+  if (ret)
+    goto free_platform;
 
   // The number of the keypair associated to the created enclave that are not the local attestation keys is set to 0
-  enclaves[eid].n_keypair = 0;
-
-  sbi_printf("enclave created before spin unlocked\n");
 
-  spin_unlock(&encl_lock);
+  /* The enclave is fresh if it has been validated and hashed but not run yet. */
+  encl_state_cas(eid, ALLOCATED, FRESH);
 
-  sbi_printf("enclave created and spin unlocked\n");
+  /* EIDs are unsigned int in size, copy via simple copy */
+  *eidptr = eid;
+  sm_trace_u32(SM_LOG_INFO, SM_TRACE_ENCLAVE_CREATE, eid);
 
   return SBI_ERR_SM_ENCLAVE_SUCCESS;
 
-unlock:
-  spin_unlock(&encl_lock);
-// free_platform:
+free_platform:
   platform_destroy_enclave(&enclaves[eid]);
 unset_region:
+  if(device_region >= 0)
+    pmp_unset_global(device_region);
   pmp_unset_global(region);
+free_device_region:
+  if(device_region >= 0)
+    pmp_region_free_atomic(device_region);
 free_shared_region:
   pmp_region_free_atomic(shared_region);
 free_region:
@@ -617,43 +741,56 @@ unsigned long create_keypair(enclave_id eid, unsigned char* pk, int seed_enc, un
   unsigned char seed[PRIVATE_KEY_SIZE];
   unsigned char pk_app[PUBLIC_KEY_SIZE];
   unsigned char sk_app[PRIVATE_KEY_SIZE];
+  unsigned char index[4];
   int ret = 0;
+  int first = 0;
+
+  if(seed_enc < 0)
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
 
-  unsigned char app[65];
+  // A key that was already derived is handed out again as it is
+  if(keystore_get(eid, seed_enc, pk_app, NULL) == 0)
+    return copy_from_sm((uintptr_t)pk, pk_app, PUBLIC_KEY_SIZE) ? SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT : 0;
 
   // The new keypair is obtained adding at the end of the CDI of the enclave an index, provided by the enclave itself
-  sbi_memcpy(app, enclaves[eid].CDI, 64);
-  app[64] = seed_enc + '0';
-  
+  // (little endian, so that every index gives a key of its own)
+  index[0] = seed_enc;
+  index[1] = seed_enc >> 8;
+  index[2] = seed_enc >> 16;
+  index[3] = seed_enc >> 24;
 
   sha3_ctx_t ctx_hash;
 
   // The hash function is used to provide the seed for the keys generation
   sha3_init(&ctx_hash, 64);
-  sha3_update(&ctx_hash, app, 65);
+  sha3_update(&ctx_hash, enclaves[eid].CDI, 64);
+  sha3_update(&ctx_hash, index, sizeof(index));
   sha3_final(seed, &ctx_hash);
   ed25519_create_keypair(pk_app, sk_app, seed);
-  
-  // The new keypair is stored in the relatives arrays
-  for(int i = 0; i < PUBLIC_KEY_SIZE; i ++)
-    enclaves[eid].pk_array[enclaves[eid].n_keypair][i] = pk_app[i];
-  for(int i = 0; i < PRIVATE_KEY_SIZE; i ++)
-    enclaves[eid].sk_array[enclaves[eid].n_keypair][i] = sk_app[i];
-  
+  sbi_memset(seed, 0, sizeof(seed));
+
+  // The new keypair is kept in the key store of the SM
+  if(keystore_put(eid, seed_enc, pk_app, sk_app, &first)){
+    sbi_memset(sk_app, 0, PRIVATE_KEY_SIZE);
+    return SBI_ERR_SM_ENCLAVE_NO_FREE_RESOURCE;
+  }
+
   // The first keypair that is asked to be created is the Local Device Keys, that is inserted in the relative variables
-  if(enclaves[eid].n_keypair == 0){
+  if(first){
+    spin_lock(&enclaves[eid].lock);
     sbi_memcpy(enclaves[eid].sk_ldev, sk_app, PRIVATE_KEY_SIZE );
     sbi_memcpy(enclaves[eid].pk_ldev, pk_app, PUBLIC_KEY_SIZE);
+    spin_unlock(&enclaves[eid].lock);
   }
 
-  sbi_printf("[SM] PK: 0x");
-  for(int i = 0; i< PUBLIC_KEY_SIZE; i++) {
-    sbi_printf("%02x", pk_app[i]);
+  if (SM_LOG_DEBUG <= SM_LOG_LEVEL) {
+    unsigned char rec[sizeof(uint32_t) + PUBLIC_KEY_SIZE];
+    uint32_t id = eid;
+    sbi_memcpy(rec, &id, sizeof(id));
+    sbi_memcpy(rec + sizeof(id), pk_app, PUBLIC_KEY_SIZE);
+    sm_trace(SM_LOG_DEBUG, SM_TRACE_KEYPAIR, rec, sizeof(rec));
   }
-  sbi_printf("\n");
 
-  enclaves[eid].n_keypair +=1;
-  
   ret = copy_from_sm((uintptr_t)pk, pk_app, PUBLIC_KEY_SIZE);
   // sbi_printf("ret:%d\n", ret);
   if(ret)
@@ -662,120 +799,27 @@ unsigned long create_keypair(enclave_id eid, unsigned char* pk, int seed_enc, un
   // The location in memoty of the private key of the keypair created is clean
   sbi_memset(sk_app, 0, 64);
 
-  if(enclaves[eid].n_keypair != 1)
+  if(!first)
     return 0;
 
-  // Associated to the keys of the enclaves, a new 509 cert is created 
-  mbedtls_x509write_crt_init(&enclaves[eid].crt_ldev);
-
-  // Setting the name of the issuer of the cert
-  ret = mbedtls_x509write_crt_set_issuer_name_mod(&enclaves[eid].crt_ldev, "CN=Security Monitor");
-  if (ret != 0)
-  {
-    return ret;
-  }
-  
-  // Setting the name of the subject of the cert
-  ret = mbedtls_x509write_crt_set_subject_name_mod(&enclaves[eid].crt_ldev, "CN=Enclave LDevID");
-  if (ret != 0)
-  {
-    return ret;
-  }
-
-  // pk context used to embed the keys of the subject
-  mbedtls_pk_context subj_key;
-  mbedtls_pk_init(&subj_key);
-
-  // pk context used to embed the keys of the embedded CA
-  mbedtls_pk_context issu_key;
-  mbedtls_pk_init(&issu_key);
-
-  
-  // The keys of the embedded CA are used to sign the different certs associated to the keys of the different enclaves  
-  ret = mbedtls_pk_parse_public_key(&issu_key, sm_private_key, 64, 1);
-  if (ret != 0)
-  {
-    return ret;
-  }
-  ret = mbedtls_pk_parse_public_key(&issu_key, sm_public_key, 32, 0);
-  if (ret != 0)
-  {
-    return ret;
-  }
-
-  // Parsing the public key of the enclave that will be inserted in its certificate 
-  ret = mbedtls_pk_parse_public_key(&subj_key, pk_app, 32, 0);
-  if (ret != 0)
-  {
-    return ret;
-  }
-
-  // Variable  used to specify the serial of the cert
-  unsigned char serial[] = {0x0};
-  serial[0] = 10*eid+1;
-  
-  // The public key of the enclave is inserted in the structure
-  mbedtls_x509write_crt_set_subject_key(&enclaves[eid].crt_ldev, &subj_key);
-
-  // The private key of the embedded CA is used later to sign the cert
-  mbedtls_x509write_crt_set_issuer_key(&enclaves[eid].crt_ldev, &issu_key);
-  
-  // The serial of the cert is setted
-  mbedtls_x509write_crt_set_serial_raw(&enclaves[eid].crt_ldev, serial, 1);
-  
-  // The algoithm used to do the hash for the signature is specified
-  mbedtls_x509write_crt_set_md_alg(&enclaves[eid].crt_ldev, KEYSTONE_SHA3);
-
-  mbedtls_x509write_crt_set_key_usage(&enclaves[eid].crt_ldev, MBEDTLS_X509_KU_DIGITAL_SIGNATURE);
-  
-  // The validity of the crt is specified
-  ret = mbedtls_x509write_crt_set_validity(&enclaves[eid].crt_ldev, "20230101000000", "20250101000000");
-  if (ret != 0)
-  {
-    return ret;
-  }
-  
-  dice_tcbInfo tcbInfo;
-  measure m;
-  const unsigned char OID_algo[] = {0x60,0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x0A};
-  m.oid_len = 9;
-  int dim= 324;
-  unsigned char buf[324];
-
-  init_dice_tcbInfo(&tcbInfo);
-  sbi_memcpy(m.OID_algho, OID_algo, m.oid_len);
-  sbi_memcpy(m.digest, enclaves[eid].hash, 64);
-  set_dice_tcbInfo_measure(&tcbInfo, m);
-
-  if(mbedtls_x509write_crt_set_dice_tcbInfo(&enclaves[eid].crt_ldev, tcbInfo, dim, buf, sizeof(buf))!=0)
-    sbi_printf("\nError setting DICETCB extension!\n");
+  // Associated to the keys of the enclaves, a new 509 cert is issued
+  unsigned char serial = 10*eid+1;
+  ret = mbedtls_x509write_crt_template_issue(&ldev_crt_template[serial >> 7], serial,
+                                             pk_app, enclaves[eid].hash,
+                                             sm_public_key, sm_private_key,
+                                             enclaves[eid].crt_ldev_der,
+                                             sizeof(enclaves[eid].crt_ldev_der));
+  if (ret <= 0)
+    return -1;
 
-  unsigned char cert_der[1024];
-  int effe_len_cert_der = 0;
-  size_t len_cert_der_tot = 1024;
-  ret = mbedtls_x509write_crt_der(&enclaves[eid].crt_ldev, cert_der, len_cert_der_tot, NULL, NULL);
+  int effe_len_cert_der = ret;
+  unsigned char *cert_real = enclaves[eid].crt_ldev_der;
+  ret = 0;
 
-  if (ret != 0)
-  {
-    effe_len_cert_der = ret;
-    ret = 0;
-  } else {
-    return -1;
-  }
-  unsigned char *cert_real = cert_der;
-  int dif  = 0;
-  dif= 1024-effe_len_cert_der;
-  cert_real += dif;
-
-  sbi_printf("[SM] crt: 0x");
-  for(int i = 0; i< effe_len_cert_der; i++) {
-    sbi_printf("%02x", cert_real[i]);
-  }
-  sbi_printf("\n[SM] crt_len: %d\n", effe_len_cert_der);
+  sm_trace(SM_LOG_DEBUG, SM_TRACE_CERT_LDEV, cert_real, effe_len_cert_der);
 
-  // The der format of the cert and its length are stored in the specific variables received from the caller
+  // The length of the der format of the cert is stored in the enclave structure
   enclaves[eid].crt_ldev_der_length = effe_len_cert_der;
-  sbi_memcpy(enclaves[eid].crt_ldev_der, cert_real, effe_len_cert_der);
 
   ret = copy_from_sm((uintptr_t)issued_crt_len, &effe_len_cert_der, sizeof(int));
   // sbi_printf("ret:%d\n", ret);
@@ -786,12 +830,6 @@ unsigned long create_keypair(enclave_id eid, unsigned char* pk, int seed_enc, un
   if(ret)
     return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
 
-  sbi_printf("[SM] ret_crt: 0x");
-  for(int i = 0; i< issued_crt_len[0]; i++) {
-    sbi_printf("%02x", issued_crt[i]);
-  }
-  sbi_printf("\n[SM] ret_crt_len: %d\n", issued_crt_len[0]);
-
   return 0;
 }
 
@@ -855,17 +893,24 @@ unsigned long get_cert_chain(enclave_id eid, unsigned char** certs, int* sizes)
   return 0;
 }
 
-unsigned long do_crypto_op(enclave_id eid, int flag, unsigned char* data, int data_len, unsigned char* out_data, int* len_out_data, unsigned char* pk){
+/* data_len is the length of data, and *len_out_data the size of out_data
+ * on entry and the length of the result on return: both come from the
+ * enclave, so they are checked against the SM buffers before any copy */
+unsigned long do_crypto_op(enclave_id eid, int flag, unsigned char* data, size_t data_len, unsigned char* out_data, size_t* len_out_data, unsigned char* pk){
 
   sha3_ctx_t ctx_hash;
   unsigned char fin_hash[64];
   unsigned char sign[64];
-  int ret, pos = -1;
+  int ret;
   unsigned char data_cp[2048];
   unsigned char pk_cp[32];
-  int sign_len = 64;
+  size_t out_size;
+  size_t sign_len = sizeof(sign);
 
-  if(data_len > 2048)
+  if(data_len > sizeof(data_cp))
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+  ret = copy_to_sm(&out_size, (uintptr_t)len_out_data, sizeof(out_size));
+  if(ret || out_size < sign_len)
     return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
   ret = copy_to_sm(data_cp, (uintptr_t)data, data_len);
   if(ret)
@@ -889,7 +934,7 @@ unsigned long do_crypto_op(enclave_id eid, int flag, unsigned char* data, int da
       ret = copy_from_sm((uintptr_t)out_data, sign, 64);
       if(ret)
         return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
-      ret = copy_from_sm((uintptr_t)len_out_data, &sign_len, sizeof(int));
+      ret = copy_from_sm((uintptr_t)len_out_data, &sign_len, sizeof(sign_len));
       if(ret)
         return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
       return 0;
@@ -898,21 +943,14 @@ unsigned long do_crypto_op(enclave_id eid, int flag, unsigned char* data, int da
       // Sign of generic data with a specific private key.
       // In this case the enclave provides directly the hash of the data that have to be signed
 
-      // Finding the private key associated to the public key passed
-      for(int i = 0;  i < enclaves[eid].n_keypair; i ++)
-        if(sbi_memcmp(enclaves[eid].pk_array[i], pk_cp, 32) == 0){
-          pos = i;
-          break;
-        }
-      if (pos == -1)
+      // Signing with the private key associated to the public key passed
+      if(keystore_sign(eid, pk_cp, sign, data_cp, data_len))
         return -1;
 
-      ed25519_sign(sign, data_cp, data_len, enclaves[eid].pk_array[pos], enclaves[eid].sk_array[pos]);
-
       ret = copy_from_sm((uintptr_t)out_data, sign, 64);
       if(ret)
         return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
-      ret = copy_from_sm((uintptr_t)len_out_data, &sign_len, sizeof(int));
+      ret = copy_from_sm((uintptr_t)len_out_data, &sign_len, sizeof(sign_len));
       if(ret)
         return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
       return 0;
@@ -938,44 +976,36 @@ unsigned long print_message(){
  */
 unsigned long destroy_enclave(enclave_id eid)
 {
-  int destroyable;
+  enclave_state state;
 
-  spin_lock(&encl_lock);
-  destroyable = (ENCLAVE_EXISTS(eid)
-                 && enclaves[eid].state <= STOPPED);
-  /* update the enclave state first so that
-   * no SM can run the enclave any longer */
-  if(destroyable)
-    enclaves[eid].state = DESTROYING;
-  spin_unlock(&encl_lock);
-
-  if(!destroyable)
+  if(eid >= ENCL_MAX)
     return SBI_ERR_SM_ENCLAVE_NOT_DESTROYABLE;
 
+  /* update the enclave state first so that
+   * no SM can run the enclave any longer.
+   * an ALLOCATED enclave is still being created and belongs to its
+   * creator until it turns FRESH */
+  do {
+    state = encl_state(eid);
+    if(state < FRESH || state > STOPPED)
+      return SBI_ERR_SM_ENCLAVE_NOT_DESTROYABLE;
+  } while(!encl_state_cas(eid, state, DESTROYING));
+
 
   // 0. Let the platform specifics do cleanup/modifications
   platform_destroy_enclave(&enclaves[eid]);
 
 
-  // 1. clear all the data in the enclave pages
-  // requires no lock (single runner)
+  // 1. hand the enclave pages over to be cleared in the background;
+  // they stay locked down until scrub_enclave_memory is done with them
   int i;
-  void* base;
-  size_t size;
   region_id rid;
   for(i = 0; i < ENCLAVE_REGIONS_MAX; i++){
     if(enclaves[eid].regions[i].type == REGION_INVALID ||
-       enclaves[eid].regions[i].type == REGION_UTM)
+       enclaves[eid].regions[i].type == REGION_UTM ||
+       enclaves[eid].regions[i].type == REGION_DEVICE)
       continue;
-    //1.a Clear all pages
-    rid = enclaves[eid].regions[i].pmp_rid;
-    base = (void*) pmp_region_get_addr(rid);
-    size = (size_t) pmp_region_get_size(rid);
-    sbi_memset((void*) base, 0, size);
-
-    //1.b free pmp region
-    pmp_unset_global(rid);
-    pmp_region_free_atomic(rid);
+    scrub_region_add(enclaves[eid].regions[i].pmp_rid);
   }
 
   // 2. free pmp region for UTM
@@ -983,15 +1013,73 @@ unsigned long destroy_enclave(enclave_id eid)
   if(rid != -1)
     pmp_region_free_atomic(enclaves[eid].regions[rid].pmp_rid);
 
+  // and give the device window back to the host. The SM cannot reset an
+  // arbitrary device, so the enclave has to leave nothing in it
+  rid = get_enclave_region_index(eid, REGION_DEVICE);
+  if(rid != -1) {
+    pmp_unset_global(enclaves[eid].regions[rid].pmp_rid);
+    pmp_region_free_atomic(enclaves[eid].regions[rid].pmp_rid);
+  }
+
   enclaves[eid].encl_satp = 0;
   enclaves[eid].n_thread = 0;
+  for(i = 0; i < MAX_ENCL_THREADS; i++)
+    enclaves[eid].thread_states[i] = THREAD_UNUSED;
   enclaves[eid].params = (struct runtime_params_t) {0};
   for(i=0; i < ENCLAVE_REGIONS_MAX; i++){
     enclaves[eid].regions[i].type = REGION_INVALID;
   }
 
-  // 3. release eid
+  // 3. forget the keys the enclave derived
+  keystore_clear(eid);
+  sbi_memset(enclaves[eid].sk_ldev, 0, sizeof(enclaves[eid].sk_ldev));
+
+  // 4. release eid
   encl_free_eid(eid);
+  sm_trace_u32(SM_LOG_INFO, SM_TRACE_ENCLAVE_DESTROY, eid);
+
+  return SBI_ERR_SM_ENCLAVE_SUCCESS;
+}
+
+/*
+ * Clears the next chunk of the destroyed enclave memory starting at base,
+ * and releases the memory to the OS once all of it is clear.
+ * Several harts may scrub the same region at once, each getting its own
+ * chunk. *cleared is set to the bytes this call cleared; 0 means there is
+ * nothing left to hand out (or no such region).
+ */
+unsigned long scrub_enclave_memory(uintptr_t base, unsigned long* cleared)
+{
+  struct scrub_region* scrub = NULL;
+  size_t off, len;
+  region_id rid;
+
+  *cleared = 0;
+
+  for(rid = 0; rid < PMP_MAX_N_REGION; rid++) {
+    if(__atomic_load_n(&scrubs[rid].pending, __ATOMIC_ACQUIRE) &&
+       scrubs[rid].base == base) {
+      scrub = &scrubs[rid];
+      break;
+    }
+  }
+  if(!scrub)
+    return SBI_ERR_SM_ENCLAVE_SUCCESS;
+
+  off = __atomic_fetch_add(&scrub->next, SCRUB_CHUNK_SIZE, __ATOMIC_RELAXED);
+  if(off >= scrub->size)
+    return SBI_ERR_SM_ENCLAVE_SUCCESS;
+
+  len = scrub->size - off < SCRUB_CHUNK_SIZE ? scrub->size - off : SCRUB_CHUNK_SIZE;
+  sbi_memset((void*) (scrub->base + off), 0, len);
+  *cleared = len;
+
+  /* whoever clears the last byte gives the region back */
+  if(__atomic_add_fetch(&scrub->done, len, __ATOMIC_ACQ_REL) == scrub->size) {
+    __atomic_store_n(&scrub->pending, 0, __ATOMIC_RELEASE);
+    pmp_unset_global(rid);
+    pmp_region_free_atomic(rid);
+  }
 
   return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
@@ -1000,63 +1088,77 @@ unsigned long run_enclave(struct sbi_trap_regs *regs, enclave_id eid)
 {
   int runable;
 
-  spin_lock(&encl_lock);
-  runable = (ENCLAVE_EXISTS(eid)
-            && enclaves[eid].state == FRESH);
+  if(eid >= ENCL_MAX)
+    return SBI_ERR_SM_ENCLAVE_NOT_FRESH;
+
+  spin_lock(&enclaves[eid].lock);
+  runable = encl_state_cas(eid, FRESH, RUNNING);
   if(runable) {
-    enclaves[eid].state = RUNNING;
+    enclaves[eid].thread_states[0] = THREAD_RUNNING;
     enclaves[eid].n_thread++;
   }
-  spin_unlock(&encl_lock);
+  spin_unlock(&enclaves[eid].lock);
 
   if(!runable) {
     return SBI_ERR_SM_ENCLAVE_NOT_FRESH;
   }
 
   // Enclave is OK to run, context switch to it
-  context_switch_to_enclave(regs, eid, 1);
+  context_switch_to_enclave(regs, eid, 0, 1);
 
   return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
 
+/* Takes thread tid of the enclave off its hart and leaves it in state.
+ * The enclave is STOPPED once no thread is left running.
+ * Must be called with the enclave lock held. */
+static void encl_thread_leave(enclave_id eid, unsigned int tid,
+                              enclave_thread_state state)
+{
+  enclaves[eid].thread_states[tid] = state;
+  enclaves[eid].n_thread--;
+  if(enclaves[eid].n_thread == 0)
+    encl_state_cas(eid, RUNNING, STOPPED);
+}
+
+/* Thread 0 stays resumable after it exits, as the single thread of an
+ * enclave always was; any other thread context is free for reuse. */
 unsigned long exit_enclave(struct sbi_trap_regs *regs, enclave_id eid)
 {
+  unsigned int tid = cpu_get_enclave_thread();
   int exitable;
 
-  spin_lock(&encl_lock);
-  exitable = enclaves[eid].state == RUNNING;
-  if (exitable) {
-    enclaves[eid].n_thread--;
-    if(enclaves[eid].n_thread == 0)
-      enclaves[eid].state = STOPPED;
-  }
-  spin_unlock(&encl_lock);
+  spin_lock(&enclaves[eid].lock);
+  exitable = (encl_state(eid) == RUNNING
+              && enclaves[eid].thread_states[tid] == THREAD_RUNNING);
+  if (exitable)
+    encl_thread_leave(eid, tid, tid ? THREAD_UNUSED : THREAD_STOPPED);
+  spin_unlock(&enclaves[eid].lock);
 
   if(!exitable)
     return SBI_ERR_SM_ENCLAVE_NOT_RUNNING;
 
-  context_switch_to_host(regs, eid, 0);
+  context_switch_to_host(regs, eid, tid, 0);
 
   return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
 
 unsigned long stop_enclave(struct sbi_trap_regs *regs, uint64_t request, enclave_id eid)
 {
+  unsigned int tid = cpu_get_enclave_thread();
   int stoppable;
 
-  spin_lock(&encl_lock);
-  stoppable = enclaves[eid].state == RUNNING;
-  if (stoppable) {
-    enclaves[eid].n_thread--;
-    if(enclaves[eid].n_thread == 0)
-      enclaves[eid].state = STOPPED;
-  }
-  spin_unlock(&encl_lock);
+  spin_lock(&enclaves[eid].lock);
+  stoppable = (encl_state(eid) == RUNNING
+               && enclaves[eid].thread_states[tid] == THREAD_RUNNING);
+  if (stoppable)
+    encl_thread_leave(eid, tid, THREAD_STOPPED);
+  spin_unlock(&enclaves[eid].lock);
 
   if(!stoppable)
     return SBI_ERR_SM_ENCLAVE_NOT_RUNNING;
 
-  context_switch_to_host(regs, eid, request == STOP_EDGE_CALL_HOST);
+  context_switch_to_host(regs, eid, tid, request == STOP_EDGE_CALL_HOST);
 
   switch(request) {
     case(STOP_TIMER_INTERRUPT):
@@ -1068,30 +1170,98 @@ unsigned long stop_enclave(struct sbi_trap_regs *regs, uint64_t request, enclave
   }
 }
 
-unsigned long resume_enclave(struct sbi_trap_regs *regs, enclave_id eid)
+/*
+ * Sets up thread context tid of the calling enclave to start at entry,
+ * in S-mode with a0 = arg and the address space and trap vector of the
+ * calling thread. The caller then stops to the host with
+ * SBI_ERR_SM_ENCLAVE_NEW_THREAD and the new tid, so that the host can find
+ * a hart for the thread (run_thread) before it resumes the caller.
+ * The caller picks tid; it must be a free context other than 0.
+ */
+unsigned long create_thread(struct sbi_trap_regs *regs, enclave_id eid,
+                            unsigned int tid, uintptr_t entry, uintptr_t arg)
 {
-  int resumable;
+  unsigned int cur;
+  struct thread_state* thread;
+  int created;
+
+  if(tid == 0 || tid >= MAX_ENCL_THREADS)
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+
+  cur = cpu_get_enclave_thread();
+
+  spin_lock(&enclaves[eid].lock);
+  created = (encl_state(eid) == RUNNING
+             && enclaves[eid].thread_states[cur] == THREAD_RUNNING
+             && enclaves[eid].thread_states[tid] == THREAD_UNUSED);
+  if(created) {
+    thread = &enclaves[eid].threads[tid];
+    clean_state(thread);
+    thread->prev_state.slot = 1; // a0 holds arg, not a return value
+    thread->prev_state.a0 = arg;
+    thread->prev_mepc = entry - 4; // run_thread steps over the ecall
+    thread->prev_mstatus = regs->mstatus;
+    thread->prev_csrs.sstatus = csr_read(sstatus);
+    thread->prev_csrs.sie = csr_read(sie);
+    thread->prev_csrs.stvec = csr_read(stvec);
+    thread->prev_csrs.satp = csr_read(satp);
+    enclaves[eid].thread_states[tid] = THREAD_FRESH;
+
+    encl_thread_leave(eid, cur, THREAD_STOPPED);
+  }
+  spin_unlock(&enclaves[eid].lock);
+
+  if(!created)
+    return SBI_ERR_SM_ENCLAVE_NO_FREE_RESOURCE;
 
-  spin_lock(&encl_lock);
-  resumable = (ENCLAVE_EXISTS(eid)
-               && (enclaves[eid].state == RUNNING || enclaves[eid].state == STOPPED)
-               && enclaves[eid].n_thread < MAX_ENCL_THREADS);
+  context_switch_to_host(regs, eid, cur, 1);
+  regs->a1 = tid;
 
-  if(!resumable) {
-    spin_unlock(&encl_lock);
+  return SBI_ERR_SM_ENCLAVE_NEW_THREAD;
+}
+
+/*
+ * Runs thread tid of the enclave on this hart: either a thread the enclave
+ * has just created, or a stopped one. Any number of threads of the same
+ * enclave may run at once, each on its own hart.
+ */
+unsigned long run_thread(struct sbi_trap_regs *regs, enclave_id eid, unsigned int tid)
+{
+  enclave_state state;
+  enclave_thread_state thread_state;
+  int runnable;
+
+  if(eid >= ENCL_MAX || tid >= MAX_ENCL_THREADS)
     return SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE;
-  } else {
+
+  /* thread states only change under the enclave lock, but destroy_enclave
+   * may still move a STOPPED enclave to DESTROYING; the CAS settles that */
+  spin_lock(&enclaves[eid].lock);
+  state = encl_state(eid);
+  thread_state = enclaves[eid].thread_states[tid];
+  runnable = ((state == RUNNING || state == STOPPED)
+              && (thread_state == THREAD_STOPPED || thread_state == THREAD_FRESH)
+              && encl_state_cas(eid, state, RUNNING));
+  if(runnable) {
+    enclaves[eid].thread_states[tid] = THREAD_RUNNING;
     enclaves[eid].n_thread++;
-    enclaves[eid].state = RUNNING;
   }
-  spin_unlock(&encl_lock);
+  spin_unlock(&enclaves[eid].lock);
 
-  // Enclave is OK to resume, context switch to it
-  context_switch_to_enclave(regs, eid, 0);
+  if(!runnable)
+    return SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE;
+
+  // Thread is OK to run, context switch to it
+  context_switch_to_enclave(regs, eid, tid, 0);
 
   return SBI_ERR_SM_ENCLAVE_SUCCESS;
 }
 
+unsigned long resume_enclave(struct sbi_trap_regs *regs, enclave_id eid)
+{
+  return run_thread(regs, eid, 0);
+}
+
 unsigned long attest_enclave(uintptr_t report_ptr, uintptr_t data, uintptr_t size, enclave_id eid)
 {
   int attestable;
@@ -1101,14 +1271,12 @@ unsigned long attest_enclave(uintptr_t report_ptr, uintptr_t data, uintptr_t siz
   if (size > ATTEST_DATA_MAXLEN)
     return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
 
-  spin_lock(&encl_lock);
   attestable = (ENCLAVE_EXISTS(eid)
-                && (enclaves[eid].state >= FRESH));
+                && (encl_state(eid) >= FRESH));
+  if(!attestable)
+    return SBI_ERR_SM_ENCLAVE_NOT_INITIALIZED;
 
-  if(!attestable) {
-    ret = SBI_ERR_SM_ENCLAVE_NOT_INITIALIZED;
-    goto err_unlock;
-  }
+  spin_lock(&enclaves[eid].lock);
 
   /* copy data to be signed */
   ret = copy_enclave_data(&enclaves[eid], report.enclave.data,
@@ -1120,7 +1288,14 @@ unsigned long attest_enclave(uintptr_t report_ptr, uintptr_t data, uintptr_t siz
     goto err_unlock;
   }
 
-  spin_unlock(&encl_lock); // Don't need to wait while signing, which might take some time
+  /* such data would pass for the root of a batch */
+  if (size >= ATTEST_BATCH_TAG_LEN &&
+      sbi_memcmp(report.enclave.data, ATTEST_BATCH_TAG, ATTEST_BATCH_TAG_LEN) == 0) {
+    ret = SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+    goto err_unlock;
+  }
+
+  spin_unlock(&enclaves[eid].lock); // Don't need to wait while signing, which might take some time
 
   sbi_memcpy(report.dev_public_key, dev_public_key, PUBLIC_KEY_SIZE);
   sbi_memcpy(report.sm.hash, sm_hash, MDSIZE);
@@ -1133,7 +1308,7 @@ unsigned long attest_enclave(uintptr_t report_ptr, uintptr_t data, uintptr_t siz
       - SIGNATURE_SIZE
       - ATTEST_DATA_MAXLEN + size);
 
-  spin_lock(&encl_lock);
+  spin_lock(&enclaves[eid].lock);
 
   /* copy report to the enclave */
   ret = copy_enclave_report(&enclaves[eid],
@@ -1148,10 +1323,169 @@ unsigned long attest_enclave(uintptr_t report_ptr, uintptr_t data, uintptr_t siz
   ret = SBI_ERR_SM_ENCLAVE_SUCCESS;
 
 err_unlock:
-  spin_unlock(&encl_lock);
+  spin_unlock(&enclaves[eid].lock);
   return ret;
 }
 
+/* Working memory of a batch attestation. It is too large for the stack
+ * of a hart in the SM, so every hart has its own here */
+#define ATTEST_BATCH_CHUNK 256
+
+struct attest_batch_buf {
+  byte tree[2 * ATTEST_BATCH_MAX - 1][ATTEST_BATCH_NODE_SIZE];
+  byte chunk[ATTEST_BATCH_CHUNK];
+  uint32_t size[ATTEST_BATCH_MAX];
+  struct attest_batch_proof proof;
+  struct report report;
+};
+
+static struct attest_batch_buf attest_batch_bufs[MAX_HARTS];
+
+/* leaf of a batch: H(0x00 | blob), the blob read from the enclave */
+static int attest_batch_leaf(byte* leaf, byte* chunk, uintptr_t data, size_t size)
+{
+  byte prefix = ATTEST_BATCH_LEAF;
+  sha3_ctx_t ctx;
+  size_t n;
+
+  sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+  sha3_update(&ctx, &prefix, 1);
+  while (size) {
+    n = size < ATTEST_BATCH_CHUNK ? size : ATTEST_BATCH_CHUNK;
+    if (copy_to_sm(chunk, data, n))
+      return -1;
+    sha3_update(&ctx, chunk, n);
+    data += n;
+    size -= n;
+  }
+  sha3_final(leaf, &ctx);
+  return 0;
+}
+
+/* Fills in the levels above the count leaves at the start of tree, each
+ * level right after the one below it; returns the index of the root */
+static unsigned int attest_batch_tree(byte tree[][ATTEST_BATCH_NODE_SIZE], unsigned int count)
+{
+  byte prefix = ATTEST_BATCH_INNER;
+  unsigned int base = 0, n = count, next, j;
+  sha3_ctx_t ctx;
+
+  while (n > 1) {
+    next = base + n;
+    for (j = 0; 2 * j < n; j++) {
+      if (2 * j + 1 == n) {
+        sbi_memcpy(tree[next + j], tree[base + 2 * j], ATTEST_BATCH_NODE_SIZE);
+        continue;
+      }
+      sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+      sha3_update(&ctx, &prefix, 1);
+      sha3_update(&ctx, tree[base + 2 * j], 2 * ATTEST_BATCH_NODE_SIZE);
+      sha3_final(tree[next + j], &ctx);
+    }
+    base = next;
+    n = (n + 1) / 2;
+  }
+  return base;
+}
+
+static void attest_batch_proof(struct attest_batch_proof* proof,
+                               byte tree[][ATTEST_BATCH_NODE_SIZE],
+                               unsigned int count, unsigned int index)
+{
+  unsigned int base = 0, n = count, i = index, k = 0;
+
+  sbi_memset(proof, 0, sizeof(*proof));
+  proof->index = index;
+  proof->count = count;
+  while (n > 1) {
+    if ((i ^ 1) < n)
+      sbi_memcpy(proof->siblings[k++], tree[base + (i ^ 1)], ATTEST_BATCH_NODE_SIZE);
+    base += n;
+    n = (n + 1) / 2;
+    i >>= 1;
+  }
+}
+
+static unsigned long __attest_enclave_batch(struct attest_batch_buf* buf,
+                                            uintptr_t report_ptr, uintptr_t proofs,
+                                            uintptr_t data, uintptr_t sizes,
+                                            uintptr_t count, enclave_id eid)
+{
+  byte (*tree)[ATTEST_BATCH_NODE_SIZE] = buf->tree;
+  uint32_t* size = buf->size;
+  struct attest_batch_proof* proof = &buf->proof;
+  struct report* report = &buf->report;
+  unsigned int i, root;
+  int ret;
+
+  if (count == 0 || count > ATTEST_BATCH_MAX)
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+
+  if (!ENCLAVE_EXISTS(eid) || encl_state(eid) < FRESH)
+    return SBI_ERR_SM_ENCLAVE_NOT_INITIALIZED;
+
+  spin_lock(&enclaves[eid].lock);
+
+  ret = copy_enclave_data(&enclaves[eid], size, sizes, count * sizeof(uint32_t));
+  for (i = 0; !ret && i < count; i++) {
+    if (size[i] > ATTEST_DATA_MAXLEN) {
+      spin_unlock(&enclaves[eid].lock);
+      return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+    }
+    ret = attest_batch_leaf(tree[i], buf->chunk, data, size[i]);
+    data += size[i];
+  }
+
+  spin_unlock(&enclaves[eid].lock);
+
+  if (ret)
+    return SBI_ERR_SM_ENCLAVE_NOT_ACCESSIBLE;
+
+  root = attest_batch_tree(tree, count);
+
+  sbi_memcpy(report->enclave.data, ATTEST_BATCH_TAG, ATTEST_BATCH_TAG_LEN);
+  for (i = 0; i < 4; i++)
+    report->enclave.data[ATTEST_BATCH_TAG_LEN + i] = count >> (8 * i);
+  sbi_memcpy(report->enclave.data + ATTEST_BATCH_TAG_LEN + 4, tree[root],
+             ATTEST_BATCH_NODE_SIZE);
+  report->enclave.data_len = ATTEST_BATCH_DATA_LEN;
+
+  sbi_memcpy(report->dev_public_key, dev_public_key, PUBLIC_KEY_SIZE);
+  sbi_memcpy(report->sm.hash, sm_hash, MDSIZE);
+  sbi_memcpy(report->sm.public_key, sm_public_key, PUBLIC_KEY_SIZE);
+  sbi_memcpy(report->sm.signature, sm_signature, SIGNATURE_SIZE);
+  sbi_memcpy(report->enclave.hash, enclaves[eid].hash, MDSIZE);
+  sm_sign(report->enclave.signature,
+      &report->enclave,
+      sizeof(struct enclave_report)
+      - SIGNATURE_SIZE
+      - ATTEST_DATA_MAXLEN + ATTEST_BATCH_DATA_LEN);
+
+  spin_lock(&enclaves[eid].lock);
+
+  ret = copy_enclave_report(&enclaves[eid], report_ptr, report);
+  for (i = 0; !ret && i < count; i++) {
+    attest_batch_proof(proof, tree, count, i);
+    ret = copy_from_sm(proofs + i * sizeof(*proof), proof, sizeof(*proof));
+  }
+
+  spin_unlock(&enclaves[eid].lock);
+
+  return ret ? SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT : SBI_ERR_SM_ENCLAVE_SUCCESS;
+}
+
+/* Attests count blobs, stored back to back at data with their sizes at
+ * sizes, with one signature over the root of a Merkle tree of them (see
+ * attest_batch.h). The report goes to report_ptr and the proof of every
+ * blob to proofs, in the order of the blobs. */
+unsigned long attest_enclave_batch(uintptr_t report_ptr, uintptr_t proofs,
+                                   uintptr_t data, uintptr_t sizes,
+                                   uintptr_t count, enclave_id eid)
+{
+  return __attest_enclave_batch(&attest_batch_bufs[current_hartid()],
+                                report_ptr, proofs, data, sizes, count, eid);
+}
+
 unsigned long get_sealing_key(uintptr_t sealing_key, uintptr_t key_ident,
                                  size_t key_ident_size, enclave_id eid)
 {
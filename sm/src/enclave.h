@@ -13,6 +13,8 @@
 #include "pmp.h"
 #include "thread.h"
 #include <crypto.h>
+#include "attest_batch.h"
+#include <sbi/riscv_locks.h>
 
 #define NAME_MAX 255
 
@@ -20,8 +22,12 @@
 #include TARGET_PLATFORM_HEADER
 
 #define ATTEST_DATA_MAXLEN  1024
-/* TODO: does not support multithreaded enclave yet */
-#define MAX_ENCL_THREADS 1
+/* destroyed enclave memory is cleared this much per scrub call */
+#define SCRUB_CHUNK_SIZE    (1 << 20)
+/* thread contexts per enclave; thread 0 is the one run_enclave starts */
+#ifndef MAX_ENCL_THREADS
+#define MAX_ENCL_THREADS 8
+#endif
 
 typedef enum {
   INVALID = -1,
@@ -33,6 +39,14 @@ typedef enum {
   RUNNING,
 } enclave_state;
 
+/* state of one thread context, guarded by the enclave lock */
+typedef enum {
+  THREAD_UNUSED = 0,
+  THREAD_FRESH,   // created by the enclave, waiting for the host to run it
+  THREAD_STOPPED,
+  THREAD_RUNNING,
+} enclave_thread_state;
+
 /* For now, eid's are a simple unsigned int */
 typedef unsigned int enclave_id;
 
@@ -40,6 +54,7 @@ typedef unsigned int enclave_id;
  * EPM is the 'home' for the enclave, contains runtime code/etc
  * UTM is the untrusted shared pages
  * OTHER is managed by some other component (e.g. platform_)
+ * DEVICE is an MMIO window of SM_DEVICE_WINDOWS, taken from the host
  * INVALID is an unused index
  */
 enum enclave_region_type{
@@ -48,6 +63,7 @@ enum enclave_region_type{
   REGION_UTM,
   REGION_LIBRARY,
   REGION_OTHER,
+  REGION_DEVICE,
 };
 
 struct enclave_region
@@ -59,10 +75,10 @@ struct enclave_region
 /* enclave metadata */
 struct enclave
 {
-  //spinlock_t lock; //local enclave lock. we don't need this until we have multithreaded enclave
+  spinlock_t lock; // local enclave lock, guards n_thread and the key store
   enclave_id eid; //enclave id
   unsigned long encl_satp; // enclave's page table base
-  enclave_state state; // global state of the enclave
+  enclave_state state; // global state of the enclave, only changed atomically
 
   /* Physical memory regions associate with this enclave */
   struct enclave_region regions[ENCLAVE_REGIONS_MAX];
@@ -73,27 +89,27 @@ struct enclave
   byte CDI[64];
   byte local_att_pub[32];
   byte local_att_priv[64];
-  mbedtls_x509write_cert crt_local_att;
   unsigned char crt_local_att_der[512];
   int crt_local_att_der_length;
 
   byte pk_ldev[32];
   byte sk_ldev[64];
-  mbedtls_x509write_cert crt_ldev;
   unsigned char crt_ldev_der[512];
   int crt_ldev_der_length;
 
-  byte sk_array[10][64];
-  byte pk_array[10][32];
-  int n_keypair;
 
   /* parameters */
   struct runtime_params_t params;
 
-  /* enclave execution context */
+  /* enclave execution context, one per thread; n_thread counts the
+   * threads running on some hart */
   unsigned int n_thread;
+  enclave_thread_state thread_states[MAX_ENCL_THREADS];
   struct thread_state threads[MAX_ENCL_THREADS];
 
+  /* PMP changes of a context switch, see build_pmp_switch */
+  struct pmp_switch pmp_switch;
+
   struct platform_enclave_data ped;
 
   char library_name[NAME_MAX+1];
@@ -145,16 +161,20 @@ struct sealing_key
 // callables from the host
 unsigned long create_enclave(unsigned long *eid, struct keystone_sbi_create_t create_args);
 unsigned long destroy_enclave(enclave_id eid);
+unsigned long scrub_enclave_memory(uintptr_t base, unsigned long* cleared);
 unsigned long run_enclave(struct sbi_trap_regs *regs, enclave_id eid);
 unsigned long resume_enclave(struct sbi_trap_regs *regs, enclave_id eid);
+unsigned long run_thread(struct sbi_trap_regs *regs, enclave_id eid, unsigned int tid);
 // callables from the enclave
 unsigned long exit_enclave(struct sbi_trap_regs *regs, enclave_id eid);
 unsigned long stop_enclave(struct sbi_trap_regs *regs, uint64_t request, enclave_id eid);
+unsigned long create_thread(struct sbi_trap_regs *regs, enclave_id eid, unsigned int tid, uintptr_t entry, uintptr_t arg);
 unsigned long attest_enclave(uintptr_t report, uintptr_t data, uintptr_t size, enclave_id eid);
+unsigned long attest_enclave_batch(uintptr_t report, uintptr_t proofs, uintptr_t data, uintptr_t sizes, uintptr_t count, enclave_id eid);
 // attestation
 unsigned long validate_and_hash_enclave(struct enclave* enclave);
 // TODO: These functions are supposed to be internal functions.
-void enclave_init_metadata(void);
+unsigned long enclave_init_metadata(void);
 unsigned long copy_enclave_create_args(uintptr_t src, struct keystone_sbi_create_t* dest);
 int get_enclave_region_index(enclave_id eid, enum enclave_region_type type);
 uintptr_t get_enclave_region_base(enclave_id eid, int memid);
@@ -164,7 +184,7 @@ unsigned long get_sealing_key(uintptr_t seal_key, uintptr_t key_ident, size_t ke
 void sbi_trap_handler_keystone_enclave(struct sbi_trap_regs *regs);
 unsigned long create_keypair(enclave_id eid, unsigned char* pk, int seed_enc, unsigned char* issued_crt, int *issued_crt_len);
 unsigned long get_cert_chain(enclave_id eid, unsigned char** certs, int* sizes);
-unsigned long do_crypto_op(enclave_id eid, int flag, unsigned char* data, int data_len, unsigned char* out_data, int* len_out_data, unsigned char* pk);
+unsigned long do_crypto_op(enclave_id eid, int flag, unsigned char* data, size_t data_len, unsigned char* out_data, size_t* len_out_data, unsigned char* pk);
 unsigned long print_message();
 unsigned long get_measures(enclave_id eid, unsigned char** out_data, int* n_elem);
 #endif
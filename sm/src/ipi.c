@@ -5,28 +5,145 @@
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/riscv_locks.h>
 #include "ipi.h"
 #include "pmp.h"
 
+#ifndef TARGET_PLATFORM_HEADER
+#error "SM requires a defined platform to build"
+#endif
+
+// Special target platform header, set by configure script
+#include TARGET_PLATFORM_HEADER
+
+/* A hart inside an enclave cannot reach any region but its enclave's own,
+ * since the OS region behind everything else is NO_PERM there. Global PMP
+ * updates are therefore only recorded for such a hart, as the registers
+ * they touch, and replayed by pmp_ipi_exit_enclave before it returns to
+ * the host. Only the harts running the host get an IPI. */
+struct pmp_hart_sync {
+  spinlock_t lock;
+  int in_enclave;
+  uint32_t dirty_regs;
+};
+
+/* PMP updates of one create/destroy, sent together once the outermost
+ * pmp_ipi_batch_end is reached */
+struct pmp_ipi_batch {
+  int depth;
+  unsigned long set_mask;
+  unsigned long unset_mask;
+  uint8_t perm;
+};
+
+static struct pmp_hart_sync pmp_harts[MAX_HARTS];
+static struct pmp_ipi_batch pmp_batches[MAX_HARTS];
+
 void sbi_pmp_ipi_local_update(struct sbi_tlb_info *__info)
 {
   struct sbi_pmp_ipi_info* info = (struct sbi_pmp_ipi_info *) __info;
-  if (info->type == SBI_PMP_IPI_TYPE_SET) {
-    pmp_set_keystone(info->rid, (uint8_t) info->perm);
-  } else {
-    pmp_unset(info->rid);
+  int rid;
+
+  for (rid = 0; rid < PMP_MAX_N_REGION; rid++) {
+    if (info->unset_mask & (1UL << rid))
+      pmp_unset(rid);
+  }
+  for (rid = 0; rid < PMP_MAX_N_REGION; rid++) {
+    if (info->set_mask & (1UL << rid))
+      pmp_set_keystone(rid, (uint8_t) info->perm);
   }
 }
 
-void send_and_sync_pmp_ipi(int region_idx, int type, uint8_t perm)
+static void pmp_ipi_flush(struct pmp_ipi_batch* batch)
 {
-  ulong mask = 0;
+  ulong mask = 0, targets = 0;
   ulong source_hart = current_hartid();
+  uint32_t regs = 0;
   struct sbi_tlb_info tlb_info;
+  int rid, hart;
+
+  if (!batch->set_mask && !batch->unset_mask)
+    return;
+
+  for (rid = 0; rid < PMP_MAX_N_REGION; rid++) {
+    if ((batch->set_mask | batch->unset_mask) & (1UL << rid))
+      regs |= pmp_region_reg_mask(rid);
+  }
+
   sbi_hsm_hart_interruptible_mask(sbi_domain_thishart_ptr(), 0, &mask);
+  for (hart = 0; hart < MAX_HARTS; hart++) {
+    if (!(mask & (1UL << hart)))
+      continue;
+
+    spin_lock(&pmp_harts[hart].lock);
+    if (pmp_harts[hart].in_enclave)
+      pmp_harts[hart].dirty_regs |= regs;
+    else
+      targets |= 1UL << hart;
+    spin_unlock(&pmp_harts[hart].lock);
+  }
 
-  SBI_TLB_INFO_INIT(&tlb_info, type, 0, region_idx, perm,
-      sbi_pmp_ipi_local_update, source_hart);
-  sbi_tlb_request(mask, 0, &tlb_info);
+  /* struct sbi_pmp_ipi_info overlays the tlb info fields */
+  SBI_TLB_INFO_INIT(&tlb_info, batch->set_mask, 0, batch->unset_mask,
+      batch->perm, sbi_pmp_ipi_local_update, source_hart);
+  if (targets)
+    sbi_tlb_request(targets, 0, &tlb_info);
+
+  batch->set_mask = 0;
+  batch->unset_mask = 0;
 }
 
+void pmp_ipi_batch_begin(void)
+{
+  pmp_batches[current_hartid()].depth++;
+}
+
+void pmp_ipi_batch_end(void)
+{
+  struct pmp_ipi_batch* batch = &pmp_batches[current_hartid()];
+
+  if (--batch->depth == 0)
+    pmp_ipi_flush(batch);
+}
+
+void send_and_sync_pmp_ipi(int region_idx, int type, uint8_t perm)
+{
+  struct pmp_ipi_batch* batch = &pmp_batches[current_hartid()];
+
+  /* one IPI carries a single permission for all the regions it sets */
+  if (type == SBI_PMP_IPI_TYPE_SET && batch->set_mask && batch->perm != perm)
+    pmp_ipi_flush(batch);
+
+  if (type == SBI_PMP_IPI_TYPE_SET) {
+    batch->set_mask |= 1UL << region_idx;
+    batch->unset_mask &= ~(1UL << region_idx);
+    batch->perm = perm;
+  } else {
+    batch->unset_mask |= 1UL << region_idx;
+    batch->set_mask &= ~(1UL << region_idx);
+  }
+
+  if (!batch->depth)
+    pmp_ipi_flush(batch);
+}
+
+void pmp_ipi_enter_enclave(void)
+{
+  struct pmp_hart_sync* hart = &pmp_harts[current_hartid()];
+
+  spin_lock(&hart->lock);
+  hart->in_enclave = 1;
+  spin_unlock(&hart->lock);
+}
+
+void pmp_ipi_exit_enclave(void)
+{
+  struct pmp_hart_sync* hart = &pmp_harts[current_hartid()];
+
+  spin_lock(&hart->lock);
+  if (hart->dirty_regs)
+    pmp_sync_global(hart->dirty_regs);
+  hart->dirty_regs = 0;
+  hart->in_enclave = 0;
+  spin_unlock(&hart->lock);
+}
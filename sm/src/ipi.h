@@ -8,10 +8,11 @@
 #define SBI_PMP_IPI_TYPE_SET    0
 #define SBI_PMP_IPI_TYPE_UNSET  1
 
+/* laid over struct sbi_tlb_info: start, size, asid, type */
 struct sbi_pmp_ipi_info {
-  unsigned long type;
+  unsigned long set_mask;
   unsigned long __dummy;
-  unsigned long rid;
+  unsigned long unset_mask;
   unsigned long perm;
 };
 
@@ -24,4 +25,8 @@ int sbi_pmp_ipi_init(struct sbi_scratch* scratch, bool cold_boot);
 int sbi_pmp_ipi_request(ulong hmask, ulong hbase, struct sbi_pmp_ipi_info* info);
 
 void send_and_sync_pmp_ipi(int region_idx, int type, uint8_t perm);
+void pmp_ipi_batch_begin(void);
+void pmp_ipi_batch_end(void);
+void pmp_ipi_enter_enclave(void);
+void pmp_ipi_exit_enclave(void);
 #endif
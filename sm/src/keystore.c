@@ -0,0 +1,201 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "keystore.h"
+#include "ed25519/ed25519.h"
+#include <sbi/sbi_string.h>
+#include <sbi/riscv_locks.h>
+
+/* A key is found by its index, which is the handle the enclave derived it
+ * with, or by its public key. Each slot is on one hash chain for either,
+ * so both lookups take a few steps however many keys there are.
+ *
+ * The private key kept is the expanded one ed25519_create_keypair
+ * returns (clamped scalar and nonce prefix), so signing with it does not
+ * hash the seed again. */
+
+#if KEYSTORE_SLOTS > 32767
+#error "KEYSTORE_SLOTS must fit the 16-bit chain links"
+#endif
+
+#define KEYSTORE_BUCKETS KEYSTORE_SLOTS
+#define KEYSTORE_NONE    (-1)
+
+struct key_slot {
+  int used;
+  enclave_id eid;
+  uint32_t index;
+  int16_t next_index;
+  int16_t next_pk;
+  byte pk[PUBLIC_KEY_SIZE];
+  byte sk[PRIVATE_KEY_SIZE];
+};
+
+static struct key_slot slots[KEYSTORE_SLOTS];
+static int16_t index_head[KEYSTORE_BUCKETS];
+static int16_t pk_head[KEYSTORE_BUCKETS];
+static unsigned int n_keys[ENCL_MAX];
+static int keystore_ready;
+static spinlock_t keystore_lock = SPIN_LOCK_INITIALIZER;
+
+static unsigned int index_bucket(enclave_id eid, uint32_t index)
+{
+  uint32_t h = (index ^ (eid << 24)) * 0x9e3779b1u;
+  return (h >> 8) % KEYSTORE_BUCKETS;
+}
+
+/* public keys are uniformly distributed already */
+static unsigned int pk_bucket(enclave_id eid, const byte* pk)
+{
+  uint32_t h = pk[0] | (pk[1] << 8) | (pk[2] << 16) | ((uint32_t) pk[3] << 24);
+  return (h ^ eid) % KEYSTORE_BUCKETS;
+}
+
+/* called with the lock held */
+static void keystore_init(void)
+{
+  int i;
+
+  if (keystore_ready)
+    return;
+  for (i = 0; i < KEYSTORE_BUCKETS; i++) {
+    index_head[i] = KEYSTORE_NONE;
+    pk_head[i] = KEYSTORE_NONE;
+  }
+  keystore_ready = 1;
+}
+
+static int find_index(enclave_id eid, uint32_t index)
+{
+  int s;
+
+  for (s = index_head[index_bucket(eid, index)]; s != KEYSTORE_NONE; s = slots[s].next_index)
+    if (slots[s].eid == eid && slots[s].index == index)
+      return s;
+  return KEYSTORE_NONE;
+}
+
+static int find_pk(enclave_id eid, const byte* pk)
+{
+  int s;
+
+  for (s = pk_head[pk_bucket(eid, pk)]; s != KEYSTORE_NONE; s = slots[s].next_pk)
+    if (slots[s].eid == eid && sbi_memcmp(slots[s].pk, pk, PUBLIC_KEY_SIZE) == 0)
+      return s;
+  return KEYSTORE_NONE;
+}
+
+int keystore_get(enclave_id eid, uint32_t index, byte* pk, byte* sk)
+{
+  int s;
+
+  spin_lock(&keystore_lock);
+  keystore_init();
+  s = find_index(eid, index);
+  if (s != KEYSTORE_NONE) {
+    sbi_memcpy(pk, slots[s].pk, PUBLIC_KEY_SIZE);
+    if (sk)
+      sbi_memcpy(sk, slots[s].sk, PRIVATE_KEY_SIZE);
+  }
+  spin_unlock(&keystore_lock);
+
+  return s == KEYSTORE_NONE ? -1 : 0;
+}
+
+int keystore_put(enclave_id eid, uint32_t index, const byte* pk,
+                 const byte* sk, int* first)
+{
+  unsigned int b;
+  int s;
+
+  spin_lock(&keystore_lock);
+  keystore_init();
+
+  *first = 0;
+  if (find_index(eid, index) != KEYSTORE_NONE) {
+    spin_unlock(&keystore_lock);
+    return 0;
+  }
+  if (n_keys[eid] >= KEYSTORE_MAX_PER_ENCLAVE) {
+    spin_unlock(&keystore_lock);
+    return -1;
+  }
+  for (s = 0; s < KEYSTORE_SLOTS && slots[s].used; s++)
+    ;
+  if (s == KEYSTORE_SLOTS) {
+    spin_unlock(&keystore_lock);
+    return -1;
+  }
+
+  slots[s].used = 1;
+  slots[s].eid = eid;
+  slots[s].index = index;
+  sbi_memcpy(slots[s].pk, pk, PUBLIC_KEY_SIZE);
+  sbi_memcpy(slots[s].sk, sk, PRIVATE_KEY_SIZE);
+
+  b = index_bucket(eid, index);
+  slots[s].next_index = index_head[b];
+  index_head[b] = s;
+  b = pk_bucket(eid, pk);
+  slots[s].next_pk = pk_head[b];
+  pk_head[b] = s;
+
+  *first = (n_keys[eid]++ == 0);
+  spin_unlock(&keystore_lock);
+
+  return 0;
+}
+
+int keystore_sign(enclave_id eid, const byte* pk, byte* sig,
+                  const byte* msg, size_t msg_len)
+{
+  byte sk[PRIVATE_KEY_SIZE];
+  int s;
+
+  spin_lock(&keystore_lock);
+  keystore_init();
+  s = find_pk(eid, pk);
+  if (s != KEYSTORE_NONE)
+    sbi_memcpy(sk, slots[s].sk, PRIVATE_KEY_SIZE);
+  spin_unlock(&keystore_lock);
+
+  if (s == KEYSTORE_NONE)
+    return -1;
+
+  ed25519_sign(sig, msg, msg_len, pk, sk);
+  sbi_memset(sk, 0, PRIVATE_KEY_SIZE);
+
+  return 0;
+}
+
+static void unlink_slot(int16_t* head, int s, int by_pk)
+{
+  int16_t* link = head;
+
+  while (*link != s)
+    link = by_pk ? &slots[*link].next_pk : &slots[*link].next_index;
+  *link = by_pk ? slots[s].next_pk : slots[s].next_index;
+}
+
+void keystore_clear(enclave_id eid)
+{
+  int s;
+
+  spin_lock(&keystore_lock);
+  keystore_init();
+  for (s = 0; s < KEYSTORE_SLOTS && n_keys[eid]; s++) {
+    if (!slots[s].used || slots[s].eid != eid)
+      continue;
+    unlink_slot(&index_head[index_bucket(eid, slots[s].index)], s, 0);
+    unlink_slot(&pk_head[pk_bucket(eid, slots[s].pk)], s, 1);
+    sbi_memset(&slots[s], 0, sizeof(struct key_slot));
+    n_keys[eid]--;
+  }
+  spin_unlock(&keystore_lock);
+}
+
+unsigned int keystore_count(enclave_id eid)
+{
+  return __atomic_load_n(&n_keys[eid], __ATOMIC_RELAXED);
+}
@@ -0,0 +1,30 @@
+#ifndef __KEYSTORE_H__
+#define __KEYSTORE_H__
+
+#include "enclave.h"
+
+/* Key pairs the enclaves derive with create_keypair. The store is shared
+ * by all enclaves; KEYSTORE_SLOTS bounds the keys of all of them together
+ * and KEYSTORE_MAX_PER_ENCLAVE those of any one, so that a single enclave
+ * cannot use up the store. Both can be set by the platform. */
+#ifndef KEYSTORE_SLOTS
+#define KEYSTORE_SLOTS 256
+#endif
+#ifndef KEYSTORE_MAX_PER_ENCLAVE
+#define KEYSTORE_MAX_PER_ENCLAVE 128
+#endif
+
+/* returns 0 and copies the key out if the enclave has a key of that index */
+int keystore_get(enclave_id eid, uint32_t index, byte* pk, byte* sk);
+/* returns 0 if the key was added, -1 if there is no room for it;
+ * *first is set if it is the first key of the enclave */
+int keystore_put(enclave_id eid, uint32_t index, const byte* pk,
+                 const byte* sk, int* first);
+/* signs msg with the enclave key pk; returns -1 if there is no such key */
+int keystore_sign(enclave_id eid, const byte* pk, byte* sig,
+                  const byte* msg, size_t msg_len);
+/* forgets and wipes all keys of the enclave */
+void keystore_clear(enclave_id eid);
+unsigned int keystore_count(enclave_id eid);
+
+#endif
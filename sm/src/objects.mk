@@ -3,8 +3,8 @@
 #############
 
 # General headers
-keystone-sm-headers += sm_assert.h cpu.h enclave.h ipi.h mprv.h page.h platform-hook.h \
-                        pmp.h safe_math_util.h sm.h sm-sbi.h sm-sbi-opensbi.h thread.h
+keystone-sm-headers += sm_assert.h cpu.h enclave.h ipi.h keystore.h mprv.h page.h perf.h platform-hook.h \
+                        pmp.h safe_math_util.h sm.h sm-sbi.h sm-sbi-opensbi.h thread.h trace.h
 
 # Crypto headers
 ifneq ($(KEYSTONE_SM_NO_CRYPTO),y)
@@ -35,7 +35,7 @@ keystone-sm-headers += plugins/multimem.h plugins/plugins.h
 
 # Core files
 keystone-sm-sources += attest.c cpu.c enclave.c pmp.c sm.c sm-sbi.c sm-sbi-opensbi.c \
-                        thread.c mprv.c sbi_trap_hack.c trap.c ipi.c x509.c
+                        thread.c mprv.c sbi_trap_hack.c trap.c ipi.c x509.c keystore.c trace.c
 
 # Crypto
 ifneq ($(KEYSTONE_SM_NO_CRYPTO),y)
@@ -44,6 +44,17 @@ keystone-sm-sources += crypto.c sha3/sha3.c ed25519/fe.c ed25519/ge.c ed25519/ke
                         hmac_sha3/hmac_sha3.c
 endif
 
+# Performance counters
+ifneq ($(KEYSTONE_SM_NO_PERF),y)
+keystone-sm-sources += perf.c
+platform-genflags-y += -DSM_PERF
+endif
+
+# Trace level, SM_LOG_INFO (2) unless set
+ifneq ($(KEYSTONE_SM_LOG_LEVEL),)
+platform-genflags-y += -DSM_LOG_LEVEL=$(KEYSTONE_SM_LOG_LEVEL)
+endif
+
 # Platform
 keystone-sm-sources += platform/$(PLATFORM)/platform.c
 
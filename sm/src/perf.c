@@ -0,0 +1,91 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "perf.h"
+#include "sm_call.h"
+#include "mprv.h"
+
+#ifndef TARGET_PLATFORM_HEADER
+#error "SM requires a defined platform to build"
+#endif
+
+// Special target platform header, set by configure script
+#include TARGET_PLATFORM_HEADER
+
+/* one cache line or more per hart, so that harts do not share lines */
+struct sm_perf_hart {
+  struct sm_perf_stats stats;
+  unsigned long call_start;
+  int call_counter;     /* counter of the open call plus one, 0 if none */
+} __attribute__((aligned(64)));
+
+static struct sm_perf_hart perf_harts[MAX_HARTS];
+
+static int sm_perf_counter_of(unsigned long funcid)
+{
+  switch (funcid) {
+    case SBI_SM_CREATE_ENCLAVE:   return SM_PERF_CREATE;
+    case SBI_SM_DESTROY_ENCLAVE:  return SM_PERF_DESTROY;
+    case SBI_SM_RUN_ENCLAVE:
+    case SBI_SM_RUN_THREAD:       return SM_PERF_RUN;
+    case SBI_SM_RESUME_ENCLAVE:   return SM_PERF_RESUME;
+    case SBI_SM_STOP_ENCLAVE:     return SM_PERF_STOP;
+    case SBI_SM_EXIT_ENCLAVE:     return SM_PERF_EXIT;
+    case SBI_SM_ATTEST_ENCLAVE:
+    case SBI_SM_ATTEST_BATCH:     return SM_PERF_ATTEST;
+    case SBI_CREATE_KEYPAIR:      return SM_PERF_KEYPAIR;
+    case SBI_CRYPTO_INTERFACE:    return SM_PERF_CRYPTO;
+    default:                      return -1;
+  }
+}
+
+void sm_perf_record(enum sm_perf_counter counter, unsigned long start)
+{
+  struct sm_perf_counter_stats* c =
+    &perf_harts[csr_read(mhartid)].stats.counters[counter];
+  unsigned long cycles = sm_perf_now() - start;
+  int bucket;
+
+  c->count++;
+  c->cycles += cycles;
+  if (cycles > c->max_cycles)
+    c->max_cycles = cycles;
+
+  bucket = (cycles ? sizeof(long) * 8 - 1 - __builtin_clzl(cycles) : 0) - SM_PERF_HIST_SHIFT;
+  if (bucket < 0)
+    bucket = 0;
+  if (bucket >= SM_PERF_HIST_BUCKETS)
+    bucket = SM_PERF_HIST_BUCKETS - 1;
+  c->hist[bucket]++;
+}
+
+void sm_perf_call_begin(unsigned long funcid)
+{
+  struct sm_perf_hart* h = &perf_harts[csr_read(mhartid)];
+
+  h->call_counter = sm_perf_counter_of(funcid) + 1;
+  h->call_start = sm_perf_now();
+}
+
+void sm_perf_call_end(void)
+{
+  struct sm_perf_hart* h = &perf_harts[csr_read(mhartid)];
+
+  if (!h->call_counter)
+    return;
+  sm_perf_record(h->call_counter - 1, h->call_start);
+  h->call_counter = 0;
+}
+
+/* copies the counters of hart to the host buffer stats */
+unsigned long sm_perf_get_stats(unsigned long hart, uintptr_t stats)
+{
+  if (hart >= MAX_HARTS)
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+
+  if (copy_from_sm(stats, &perf_harts[hart].stats, sizeof(struct sm_perf_stats)))
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+
+  return SBI_ERR_SM_ENCLAVE_SUCCESS;
+}
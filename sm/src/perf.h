@@ -0,0 +1,43 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <sbi/sbi_types.h>
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include "sm_err.h"
+#include "sm_perf.h"
+
+/* Per-hart counters of the SBI calls and context switches of the SM (see
+ * sm_perf.h). Only the hart a slot belongs to writes it, so recording
+ * takes no lock; a reader on another hart may see a call half recorded.
+ *
+ * The handler opens a call with sm_perf_call_begin and closes it with
+ * sm_perf_call_end, which the calls that leave through sbi_trap_exit make
+ * themselves. Without SM_PERF all of this compiles to nothing. */
+
+#ifdef SM_PERF
+
+static inline unsigned long sm_perf_now(void)
+{
+  return csr_read(CSR_MCYCLE);
+}
+
+void sm_perf_record(enum sm_perf_counter counter, unsigned long start);
+void sm_perf_call_begin(unsigned long funcid);
+void sm_perf_call_end(void);
+unsigned long sm_perf_get_stats(unsigned long hart, uintptr_t stats);
+
+#else
+
+static inline unsigned long sm_perf_now(void) { return 0; }
+static inline void sm_perf_record(enum sm_perf_counter counter, unsigned long start) { }
+static inline void sm_perf_call_begin(unsigned long funcid) { }
+static inline void sm_perf_call_end(void) { }
+static inline unsigned long sm_perf_get_stats(unsigned long hart, uintptr_t stats)
+{
+  return SBI_ERR_SM_NOT_IMPLEMENTED;
+}
+
+#endif
+
+#endif
@@ -22,6 +22,10 @@ struct platform_enclave_data{
 // CPU configuration
 #define MAX_HARTS               16
 
+// Device windows (base, size) an enclave may be given for itself; the
+// goldfish RTC of the QEMU virt machine
+#define SM_DEVICE_WINDOWS       { { 0x101000, 0x1000 } }
+
 // Initialization functions
 void sm_copy_key(void);
 
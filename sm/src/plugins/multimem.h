@@ -6,6 +6,8 @@
 
 #define MULTIMEM_GET_OTHER_REGION_SIZE 0x1
 #define MULTIMEM_GET_OTHER_REGION_ADDR 0x2
+#define MULTIMEM_GET_DEVICE_REGION_SIZE 0x3
+#define MULTIMEM_GET_DEVICE_REGION_ADDR 0x4
 
 uintptr_t do_sbi_multimem(enclave_id id, uintptr_t call_id, uintptr_t arg0);
 
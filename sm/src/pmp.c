@@ -29,6 +29,11 @@ static struct pmp_region regions[PMP_MAX_N_REGION];
 static uint32_t reg_bitmap = 0;
 static uint32_t region_def_bitmap = 0;
 
+/* regions that pmp_set_global has programmed on every hart running the
+ * host, and the permission they carry there */
+static uint32_t region_global_bitmap = 0;
+static uint8_t region_global_perm[PMP_MAX_N_REGION];
+
 static inline int region_register_idx(region_id i)
 {
   return regions[i].reg_idx;
@@ -114,6 +119,17 @@ static int is_pmp_region_valid(region_id region_idx)
   return TEST_BIT(region_def_bitmap, region_idx);
 }
 
+/* bitmap of the PMP registers a region occupies */
+static uint32_t region_reg_mask(region_id i)
+{
+  uint32_t mask = 0;
+
+  SET_BIT(mask, region_register_idx(i));
+  if(region_needs_two_entries(i))
+    SET_BIT(mask, region_register_idx(i) - 1);
+  return mask;
+}
+
 static int search_rightmost_unset(uint32_t bitmap, int max, uint32_t mask)
 {
   int i = 0;
@@ -205,6 +221,10 @@ int pmp_unset_global(int region_idx)
   if(!is_pmp_region_valid(region_idx))
     PMP_ERROR(SBI_ERR_SM_PMP_REGION_INVALID, "Invalid PMP region index");
 
+  spin_lock(&pmp_lock);
+  UNSET_BIT(region_global_bitmap, region_idx);
+  spin_unlock(&pmp_lock);
+
   send_and_sync_pmp_ipi(region_idx, SBI_PMP_IPI_TYPE_UNSET, PMP_NO_PERM);
 
   return SBI_ERR_SM_PMP_SUCCESS;
@@ -216,11 +236,58 @@ int pmp_set_global(int region_idx, uint8_t perm)
   if(!is_pmp_region_valid(region_idx))
     PMP_ERROR(SBI_ERR_SM_PMP_REGION_INVALID, "Invalid PMP region index");
 
+  spin_lock(&pmp_lock);
+  SET_BIT(region_global_bitmap, region_idx);
+  region_global_perm[region_idx] = perm;
+  spin_unlock(&pmp_lock);
+
   send_and_sync_pmp_ipi(region_idx, SBI_PMP_IPI_TYPE_SET, perm);
 
   return SBI_ERR_SM_PMP_SUCCESS;
 }
 
+uint32_t pmp_region_reg_mask(region_id region_idx)
+{
+  if(!is_pmp_region_valid(region_idx))
+    return 0;
+
+  return region_reg_mask(region_idx);
+}
+
+/* Bring the given PMP registers of this hart in line with the global
+ * regions, for a hart that missed the IPIs for them (see ipi.c).
+ * Registers no global region occupies any longer are cleared */
+void pmp_sync_global(uint32_t reg_mask)
+{
+  region_id i;
+  int n;
+
+  spin_lock(&pmp_lock);
+
+  for(i=0; i < PMP_MAX_N_REGION; i++)
+  {
+    if(!TEST_BIT(region_global_bitmap, i) || !(region_reg_mask(i) & reg_mask))
+      continue;
+
+    pmp_set_keystone(i, region_global_perm[i]);
+    reg_mask &= ~region_reg_mask(i);
+  }
+
+  for(n=0; n < PMP_N_REG; n++)
+  {
+    if(!TEST_BIT(reg_mask, n))
+      continue;
+
+    switch(n) {
+#define X(n,g) case n: { PMP_UNSET(n, g); break; }
+  LIST_OF_PMP_REGS
+#undef X
+    }
+  }
+
+  spin_unlock(&pmp_lock);
+}
+
 void pmp_init(void)
 {
   uintptr_t pmpaddr = 0;
@@ -280,6 +347,102 @@ int pmp_set_keystone(int region_idx, uint8_t perm)
   return SBI_ERR_SM_PMP_SUCCESS;
 }
 
+void pmp_switch_init(struct pmp_switch* sw)
+{
+  int g;
+
+  sw->n_addr = 0;
+  for(g=0; g < PMP_N_CFG; g++)
+  {
+    sw->cfg_mask[g] = 0;
+    sw->cfg_on[g] = 0;
+    sw->cfg_off[g] = 0;
+  }
+}
+
+static void pmp_switch_add_cfg(struct pmp_switch* sw, pmpreg_id reg_idx, uintptr_t on, uintptr_t off)
+{
+  int g = reg_idx / PMP_PER_GROUP;
+  int shift = 8 * (reg_idx % PMP_PER_GROUP);
+
+#if __riscv_xlen == 64
+  g *= 2;
+#endif
+  sw->cfg_mask[g] |= (uintptr_t) 0xff << shift;
+  sw->cfg_on[g] |= on << shift;
+  sw->cfg_off[g] |= off << shift;
+}
+
+static void pmp_switch_add_addr(struct pmp_switch* sw, pmpreg_id reg_idx, uintptr_t addr)
+{
+  sm_assert(sw->n_addr < PMP_MAX_N_REG);
+  sw->addr_reg[sw->n_addr] = reg_idx;
+  sw->addr_val[sw->n_addr] = addr;
+  sw->n_addr++;
+}
+
+/* Have pmp_switch_apply give region_idx on_perm or off_perm. With
+ * load_addr, the switch on also programs the address registers of the
+ * region, for regions that are not kept programmed on every hart */
+int pmp_switch_add(struct pmp_switch* sw, int region_idx, uint8_t on_perm, uint8_t off_perm, int load_addr)
+{
+  if(!is_pmp_region_valid(region_idx))
+    PMP_ERROR(SBI_ERR_SM_PMP_REGION_INVALID, "Invalid PMP region index");
+
+  pmpreg_id reg_idx = region_register_idx(region_idx);
+  uint8_t mode = regions[region_idx].addrmode;
+
+  pmp_switch_add_cfg(sw, reg_idx, mode | (on_perm & PMP_ALL_PERM), mode | (off_perm & PMP_ALL_PERM));
+  if(load_addr)
+    pmp_switch_add_addr(sw, reg_idx, region_pmpaddr_val(region_idx));
+
+  /* TOR decoding with 2 registers, the lower one is off */
+  if(region_needs_two_entries(region_idx))
+  {
+    pmp_switch_add_cfg(sw, reg_idx - 1, 0, 0);
+    if(load_addr)
+      pmp_switch_add_addr(sw, reg_idx - 1, region_get_addr(region_idx) >> 2);
+  }
+
+  return SBI_ERR_SM_PMP_SUCCESS;
+}
+
+static void pmp_write_addr(pmpreg_id n, uintptr_t addr)
+{
+  switch(n) {
+#define X(n,g) case n: { PMP_CSR_WRITE(pmpaddr##n, addr); break; }
+  LIST_OF_PMP_REGS
+#undef X
+    default:
+      sm_assert(false);
+  }
+}
+
+/* Switch the regions of sw to their on or off permissions on this hart:
+ * one write per pmpcfg register and a single fence */
+void pmp_switch_apply(struct pmp_switch* sw, int on)
+{
+  uintptr_t cfg;
+  int i;
+
+  if(on)
+  {
+    for(i=0; i < sw->n_addr; i++)
+      pmp_write_addr(sw->addr_reg[i], sw->addr_val[i]);
+  }
+
+#define X(g) \
+  if(sw->cfg_mask[g]) { \
+    cfg = csr_read(pmpcfg##g) & ~sw->cfg_mask[g]; \
+    cfg |= on ? sw->cfg_on[g] : sw->cfg_off[g]; \
+    PMP_CSR_WRITE(pmpcfg##g, cfg); \
+  }
+  LIST_OF_PMP_CFGS
+#undef X
+
+  asm volatile ("sfence.vma");
+}
+
 int pmp_unset(int region_idx)
 {
   if(!is_pmp_region_valid(region_idx))
@@ -440,6 +603,7 @@ int pmp_region_free_atomic(int region_idx)
 
   pmpreg_id reg_idx = region_register_idx(region_idx);
   UNSET_BIT(region_def_bitmap, region_idx);
+  UNSET_BIT(region_global_bitmap, region_idx);
   UNSET_BIT(reg_bitmap, reg_idx);
   if(region_needs_two_entries(region_idx))
     UNSET_BIT(reg_bitmap, reg_idx - 1);
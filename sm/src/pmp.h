@@ -61,6 +61,25 @@ enum pmp_priority {
                 : : "r" (0), "r" (pmpc) : "t0"); \
 }
 
+/* pmpcfg registers, by number */
+#if __riscv_xlen == 64
+# define LIST_OF_PMP_CFGS  X(0) X(2)
+#else
+# define LIST_OF_PMP_CFGS  X(0) X(1) X(2) X(3)
+#endif
+#define PMP_N_CFG 4
+/* entries in LIST_OF_PMP_REGS */
+#define PMP_MAX_N_REG 16
+
+/* write a PMP csr, skipping it if this hart does not implement it */
+#define PMP_CSR_WRITE(csr, val) \
+  asm volatile ("la t0, 1f\n\t" \
+                "csrrw t0, mtvec, t0\n\t" \
+                "csrw " #csr ", %0\n\t" \
+                ".align 2\n\t" \
+                "1: csrw mtvec, t0 \n\t" \
+                : : "r" (val) : "t0")
+
 #define PMP_ERROR(error, msg) {\
   sbi_printf("%s:" msg "\n", __func__);\
   return error; \
@@ -85,6 +104,20 @@ struct pmp_region
 typedef int pmpreg_id;
 typedef int region_id;
 
+/* The PMP settings of a set of regions that change on a context switch,
+ * computed once (pmp_switch_add) so that a switch writes the pmpaddr
+ * registers of the regions and each affected pmpcfg register just once
+ * (pmp_switch_apply) */
+struct pmp_switch
+{
+  int n_addr;
+  pmpreg_id addr_reg[PMP_MAX_N_REG];
+  uintptr_t addr_val[PMP_MAX_N_REG];
+  uintptr_t cfg_mask[PMP_N_CFG];
+  uintptr_t cfg_on[PMP_N_CFG];
+  uintptr_t cfg_off[PMP_N_CFG];
+};
+
 /* external functions */
 void pmp_init(void);
 int pmp_region_init_atomic(uintptr_t start, uint64_t size, enum pmp_priority pri, region_id* rid, int allow_overlap);
@@ -94,8 +127,13 @@ int pmp_set_keystone(region_id n, uint8_t perm);
 int pmp_set_global(region_id n, uint8_t perm);
 int pmp_unset(region_id n);
 int pmp_unset_global(region_id n);
+uint32_t pmp_region_reg_mask(region_id n);
+void pmp_sync_global(uint32_t reg_mask);
 int pmp_detect_region_overlap_atomic(uintptr_t base, uintptr_t size);
 void handle_pmp_ipi(void);
+void pmp_switch_init(struct pmp_switch* sw);
+int pmp_switch_add(struct pmp_switch* sw, region_id n, uint8_t on_perm, uint8_t off_perm, int load_addr);
+void pmp_switch_apply(struct pmp_switch* sw, int on);
 
 uintptr_t pmp_region_get_addr(region_id i);
 uint64_t pmp_region_get_size(region_id i);
@@ -1,4 +1,5 @@
 #include "enclave.h"
+#include "perf.h"
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_console.h>
@@ -60,6 +61,7 @@ static void sbi_trap_error(const char *msg, int rc,
 	sbi_printf("%s: hart%d: %s=0x%" PRILX "\n", __func__, hartid, "t6",
 		   regs->t6);
 
+  sm_perf_call_begin(SBI_SM_EXIT_ENCLAVE);
   sbi_sm_exit_enclave(regs, rc);
 }
 
@@ -98,6 +100,7 @@ void sbi_trap_handler_keystone_enclave(struct sbi_trap_regs *regs)
 		switch (mcause) {
 		case IRQ_M_TIMER: {
       regs->mepc -= 4;
+      sm_perf_call_begin(SBI_SM_STOP_ENCLAVE);
       sbi_sm_stop_enclave(regs, STOP_TIMER_INTERRUPT);
       regs->a0 = SBI_ERR_SM_ENCLAVE_INTERRUPTED;
       regs->mepc += 4;
@@ -105,6 +108,7 @@ void sbi_trap_handler_keystone_enclave(struct sbi_trap_regs *regs)
                       }
 		case IRQ_M_SOFT: {
       regs->mepc -= 4;
+      sm_perf_call_begin(SBI_SM_STOP_ENCLAVE);
       sbi_sm_stop_enclave(regs, STOP_TIMER_INTERRUPT);
       regs->a0 = SBI_ERR_SM_ENCLAVE_INTERRUPTED;
       regs->mepc += 4;
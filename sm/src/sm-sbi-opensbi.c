@@ -13,6 +13,7 @@
 #include "sm-sbi.h"
 #include "sm.h"
 #include "cpu.h"
+#include "perf.h"
 
 static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long funcid,
                      const struct sbi_trap_regs *regs,
@@ -33,6 +34,8 @@ static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long
       return SBI_ERR_SM_ENCLAVE_SBI_PROHIBITED;
   }
 
+  sm_perf_call_begin(funcid);
+
   switch (funcid) {
     case SBI_SM_CREATE_ENCLAVE:
       retval = sbi_sm_create_enclave(out_val, regs->a0);
@@ -40,6 +43,15 @@ static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long
     case SBI_SM_DESTROY_ENCLAVE:
       retval = sbi_sm_destroy_enclave(regs->a0);
       break;
+    case SBI_SM_GET_PERF_STATS:
+      retval = sbi_sm_get_perf_stats(regs->a0, regs->a1);
+      break;
+    case SBI_SM_DRAIN_TRACE:
+      retval = sbi_sm_drain_trace(out_val, regs->a0, regs->a1, regs->a2);
+      break;
+    case SBI_SM_SCRUB_ENCLAVE_MEMORY:
+      retval = sbi_sm_scrub_enclave_memory(out_val, regs->a0);
+      break;
     case SBI_SM_RUN_ENCLAVE:
       retval = sbi_sm_run_enclave((struct sbi_trap_regs*) regs, regs->a0);
       __builtin_unreachable();
@@ -48,6 +60,10 @@ static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long
       retval = sbi_sm_resume_enclave((struct sbi_trap_regs*) regs, regs->a0);
       __builtin_unreachable();
       break;
+    case SBI_SM_RUN_THREAD:
+      retval = sbi_sm_run_thread((struct sbi_trap_regs*) regs, regs->a0, regs->a1);
+      __builtin_unreachable();
+      break;
     case SBI_SM_RANDOM:
       *out_val = sbi_sm_random();
       retval = 0;
@@ -55,6 +71,9 @@ static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long
     case SBI_SM_ATTEST_ENCLAVE:
       retval = sbi_sm_attest_enclave(regs->a0, regs->a1, regs->a2);
       break;
+    case SBI_SM_ATTEST_BATCH:
+      retval = sbi_sm_attest_enclave_batch(regs->a0, regs->a1, regs->a2, regs->a3, regs->a4);
+      break;
     case SBI_SM_GET_SEALING_KEY:
       retval = sbi_sm_get_sealing_key(regs->a0, regs->a1, regs->a2);
       break;
@@ -66,12 +85,20 @@ static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long
       retval = sbi_sm_exit_enclave((struct sbi_trap_regs*) regs, regs->a0);
       __builtin_unreachable();
       break;
+    case SBI_SM_CREATE_THREAD:
+      retval = sbi_sm_create_thread((struct sbi_trap_regs*) regs, regs->a0, regs->a1, regs->a2);
+      __builtin_unreachable();
+      break;
     case SBI_SM_CALL_PLUGIN:
       retval = sbi_sm_call_plugin(regs->a0, regs->a1, regs->a2, regs->a3);
       break;
     case SBI_CREATE_KEYPAIR:
       retval = sbi_sm_create_keypair(regs->a0, regs->a1, (unsigned char*) regs->a2, (int*) regs->a3);
       break;
+    case SBI_CRYPTO_INTERFACE:
+      retval = sbi_sm_crypto_interface(regs->a0, (unsigned char*) regs->a1, regs->a2,
+                                       (unsigned char*) regs->a3, (size_t*) regs->a4, (unsigned char*) regs->a5);
+      break;
     case SBI_GET_CHAIN:
       retval = getting_cert_chain((long unsigned int*)regs->a0, (int*) regs->a1);
       break;
@@ -81,6 +108,7 @@ static int sbi_ecall_keystone_enclave_handler(unsigned long extid, unsigned long
       break;
   }
 
+  sm_perf_call_end();
   return retval;
 
 }
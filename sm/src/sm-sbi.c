@@ -10,6 +10,8 @@
 #include "platform-hook.h"
 #include "plugins/plugins.h"
 #include "mprv.h"
+#include "perf.h"
+#include "trace.h"
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_console.h>
 
@@ -34,10 +36,16 @@ unsigned long sbi_sm_destroy_enclave(unsigned long eid)
   return ret;
 }
 
+unsigned long sbi_sm_scrub_enclave_memory(unsigned long* cleared, uintptr_t base)
+{
+  return scrub_enclave_memory(base, cleared);
+}
+
 unsigned long sbi_sm_run_enclave(struct sbi_trap_regs *regs, unsigned long eid)
 {
   regs->a0 = run_enclave(regs, (unsigned int) eid);
   regs->mepc += 4;
+  sm_perf_call_end();
   sbi_trap_exit(regs);
   return 0;
 }
@@ -50,6 +58,20 @@ unsigned long sbi_sm_resume_enclave(struct sbi_trap_regs *regs, unsigned long ei
     regs->a0 = ret;
   regs->mepc += 4;
 
+  sm_perf_call_end();
+  sbi_trap_exit(regs);
+  return 0;
+}
+
+unsigned long sbi_sm_run_thread(struct sbi_trap_regs *regs, unsigned long eid, unsigned long tid)
+{
+  unsigned long ret;
+  ret = run_thread(regs, (unsigned int) eid, (unsigned int) tid);
+  if (!regs->zero)
+    regs->a0 = ret;
+  regs->mepc += 4;
+
+  sm_perf_call_end();
   sbi_trap_exit(regs);
   return 0;
 }
@@ -59,6 +81,7 @@ unsigned long sbi_sm_exit_enclave(struct sbi_trap_regs *regs, unsigned long retv
   regs->a0 = exit_enclave(regs, cpu_get_enclave_id());
   regs->a1 = retval;
   regs->mepc += 4;
+  sm_perf_call_end();
   sbi_trap_exit(regs);
   return 0;
 }
@@ -67,6 +90,17 @@ unsigned long sbi_sm_stop_enclave(struct sbi_trap_regs *regs, unsigned long requ
 {
   regs->a0 = stop_enclave(regs, request, cpu_get_enclave_id());
   regs->mepc += 4;
+  sm_perf_call_end();
+  sbi_trap_exit(regs);
+  return 0;
+}
+
+unsigned long sbi_sm_create_thread(struct sbi_trap_regs *regs, unsigned long tid,
+                                   uintptr_t entry, uintptr_t arg)
+{
+  regs->a0 = create_thread(regs, cpu_get_enclave_id(), (unsigned int) tid, entry, arg);
+  regs->mepc += 4;
+  sm_perf_call_end();
   sbi_trap_exit(regs);
   return 0;
 }
@@ -78,6 +112,13 @@ unsigned long sbi_sm_attest_enclave(uintptr_t report, uintptr_t data, uintptr_t
   return ret;
 }
 
+unsigned long sbi_sm_attest_enclave_batch(uintptr_t report, uintptr_t proofs, uintptr_t data, uintptr_t sizes, uintptr_t count)
+{
+  unsigned long ret;
+  ret = attest_enclave_batch(report, proofs, data, sizes, count, cpu_get_enclave_id());
+  return ret;
+}
+
 unsigned long sbi_sm_get_sealing_key(uintptr_t sealing_key, uintptr_t key_ident,
                        size_t key_ident_size)
 {
@@ -106,6 +147,24 @@ unsigned long sbi_sm_create_keypair(uintptr_t pk, int index, unsigned char *issu
   return ret;
 }
 
+unsigned long sbi_sm_crypto_interface(int flag, unsigned char* data, size_t data_len, unsigned char* out_data, size_t* out_data_len, unsigned char* pk)
+{
+  unsigned long ret;
+  ret = do_crypto_op(cpu_get_enclave_id(), flag, data, data_len, out_data, out_data_len, pk);
+  return ret;
+}
+
+unsigned long sbi_sm_get_perf_stats(unsigned long hart, uintptr_t stats)
+{
+  return sm_perf_get_stats(hart, stats);
+}
+
+unsigned long sbi_sm_drain_trace(unsigned long* drained, unsigned long hart,
+                                 uintptr_t buf, unsigned long max)
+{
+  return sm_trace_drain(hart, buf, max, drained);
+}
+
 unsigned long
 getting_cert_chain(uintptr_t* certs, int* sizes){
   unsigned long ret;
@@ -14,6 +14,9 @@ sbi_sm_create_enclave(unsigned long *out_val, uintptr_t create_args);
 unsigned long
 sbi_sm_destroy_enclave(unsigned long eid);
 
+unsigned long
+sbi_sm_scrub_enclave_memory(unsigned long* cleared, uintptr_t base);
+
 unsigned long
 sbi_sm_run_enclave(struct sbi_trap_regs *regs, unsigned long eid);
 
@@ -26,9 +29,18 @@ sbi_sm_stop_enclave(struct sbi_trap_regs *regs, unsigned long request);
 unsigned long
 sbi_sm_resume_enclave(struct sbi_trap_regs *regs, unsigned long eid);
 
+unsigned long
+sbi_sm_run_thread(struct sbi_trap_regs *regs, unsigned long eid, unsigned long tid);
+
+unsigned long
+sbi_sm_create_thread(struct sbi_trap_regs *regs, unsigned long tid, uintptr_t entry, uintptr_t arg);
+
 unsigned long
 sbi_sm_attest_enclave(uintptr_t report, uintptr_t data, uintptr_t size);
 
+unsigned long
+sbi_sm_attest_enclave_batch(uintptr_t report, uintptr_t proofs, uintptr_t data, uintptr_t sizes, uintptr_t count);
+
 unsigned long
 sbi_sm_get_sealing_key(uintptr_t seal_key, uintptr_t key_ident, size_t key_ident_size);
 
@@ -41,6 +53,15 @@ sbi_sm_call_plugin(uintptr_t plugin_id, uintptr_t call_id, uintptr_t arg0, uintp
 unsigned long
 sbi_sm_create_keypair(uintptr_t pk, int index, unsigned char *issued_crt, int* issued_crt_len);
 
+unsigned long
+sbi_sm_crypto_interface(int flag, unsigned char* data, size_t data_len, unsigned char* out_data, size_t* out_data_len, unsigned char* pk);
+
+unsigned long
+sbi_sm_get_perf_stats(unsigned long hart, uintptr_t stats);
+
+unsigned long
+sbi_sm_drain_trace(unsigned long* drained, unsigned long hart, uintptr_t buf, unsigned long max);
+
 unsigned long
 getting_cert_chain(uintptr_t* cert, int* sizes);
 
@@ -17,6 +17,7 @@
 #include "sha3/sha3.h"
 #include <sbi/sbi_timer.h>
 #include "x509.h"
+#include "trace.h"
 
 static int sm_init_done = 0;
 static int sm_region_id = 0, os_region_id = 0;
@@ -54,6 +55,12 @@ int osm_pmp_set(uint8_t perm)
   return pmp_set_keystone(os_region_id, perm);
 }
 
+/* the OS region is closed while an enclave runs */
+int osm_pmp_switch_add(struct pmp_switch* sw)
+{
+  return pmp_switch_add(sw, os_region_id, PMP_NO_PERM, PMP_ALL_PERM, 0);
+}
+
 static int smm_init(void)
 {
   int region = -1;
@@ -97,38 +104,14 @@ int sm_derive_sealing_key(unsigned char *key, const unsigned char *key_ident,
              info, MDSIZE + key_ident_size, key, SEALING_KEY_SIZE);
 }
 
-static void sm_print_hash(void)
-{
-  for (int i=0; i<MDSIZE; i++)
-  {
-    sbi_printf("%02x", (char) sm_hash[i]);
-  }
-  sbi_printf("\n");
-}
-
-
-void sm_print_cert()
+/* The measurement and keys of the SM go to the trace of the hart rather
+ * than the console, where they held up the boot of every hart */
+static void sm_trace_boot(void)
 {
-	int i;
-
-	sbi_printf("Booting from Security Monitor\n");
-	// sbi_printf("Size: %d\n", sm_size[0]);
-
-	sbi_printf("============ PUBKEY =============\n");
-	for(i=0; i<8; i+=1)
-	{
-		sbi_printf("%x",*((int*)dev_public_key+i));
-		if(i%4==3) sbi_printf("\n");
-	}
-	sbi_printf("=================================\n");
-
-	sbi_printf("=========== SIGNATURE ===========\n");
-	for(i=0; i<16; i+=1)
-	{
-		sbi_printf("%x",*((int*)sm_signature+i));
-		if(i%4==3) sbi_printf("\n");
-	}
-	sbi_printf("=================================\n");
+  sm_log(SM_LOG_INFO, "Booting from Security Monitor");
+  sm_trace(SM_LOG_INFO, SM_TRACE_SM_HASH, sm_hash, MDSIZE);
+  sm_trace(SM_LOG_INFO, SM_TRACE_DEV_PUBKEY, dev_public_key, PUBLIC_KEY_SIZE);
+  sm_trace(SM_LOG_INFO, SM_TRACE_SM_SIGNATURE, sm_signature, SIGNATURE_SIZE);
 }
 
 
@@ -161,22 +144,14 @@ void sm_init(bool cold_boot)
     sm_copy_key();
 
     // Init the enclave metadata
-    enclave_init_metadata();
-
-    sbi_printf("cert sm %d:\n", sm_cert_len);
-    for(int i = 0; i < sm_cert_len; i ++)
-      sbi_printf("%02x", sm_cert[i]);
-    sbi_printf("\n----------------------------------------\n");
-
-    sbi_printf("cert dev %d:\n", dev_cert_len);
-    for(int i = 0; i < dev_cert_len; i ++)
-      sbi_printf("%02x", dev_cert[i]);
-    sbi_printf("\n----------------------------------------\n");
+    if (enclave_init_metadata() != SBI_ERR_SM_ENCLAVE_SUCCESS) {
+      sbi_printf("[SM] intolerable error - failed to initialize enclave metadata");
+      sbi_hart_hang();
+    }
 
-    sbi_printf("cert man %d:\n", man_cert_len);
-    for(int i = 0; i < man_cert_len; i ++)
-      sbi_printf("%02x", man_cert[i]);
-    sbi_printf("\n----------------------------------------\n");
+    sm_trace(SM_LOG_DEBUG, SM_TRACE_CERT_SM, sm_cert, sm_cert_len);
+    sm_trace(SM_LOG_DEBUG, SM_TRACE_CERT_DEV, dev_cert, dev_cert_len);
+    sm_trace(SM_LOG_DEBUG, SM_TRACE_CERT_MAN, man_cert, man_cert_len);
 
     sm_init_done = 1;
     mb();
@@ -199,13 +174,10 @@ void sm_init(bool cold_boot)
     sbi_hart_hang();
   }
 
-  sm_print_cert();
+  sm_trace_u32(SM_LOG_INFO, SM_TRACE_HART_INIT, csr_read(mhartid));
+  sm_trace_boot();
 
   sbi_printf("[SM] Keystone security monitor has been initialized!\n");
 
-  sm_print_hash();
-
   return;
-  // for debug
-  // sm_print_cert();
 }
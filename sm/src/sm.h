@@ -26,4 +26,6 @@ int sm_derive_sealing_key(unsigned char *key,
                           const unsigned char *enclave_hash);
 
 int osm_pmp_set(uint8_t perm);
+struct pmp_switch;
+int osm_pmp_switch_add(struct pmp_switch* sw);
 #endif
@@ -50,15 +50,19 @@ void swap_prev_state(struct thread_state* thread, struct sbi_trap_regs* regs, in
 /* TODO: Right now we are only handling the ones that our test
    platforms support. Realistically we should have these behind
    defines for extensions (ex: N extension)*/
+/* CSRs that hold the same value on both sides (scounteren, often stvec
+   or sie on an edge call round trip) are not written */
 void swap_prev_smode_csrs(struct thread_state*
 thread){
 
-  uintptr_t tmp;
+  uintptr_t tmp, cur;
 
 #define LOCAL_SWAP_CSR(csrname) \
   tmp = thread->prev_csrs.csrname;                 \
-  thread->prev_csrs.csrname = csr_read(csrname);   \
-  csr_write(csrname, tmp);
+  cur = csr_read(csrname);                         \
+  thread->prev_csrs.csrname = cur;                 \
+  if (tmp != cur)                                  \
+    csr_write(csrname, tmp);
 
   LOCAL_SWAP_CSR(sstatus);
   // These only exist with N extension.
@@ -0,0 +1,125 @@
+//******************************************************************************
+// Copyright (c) 2018, The Regents of the University of California (Regents).
+// All Rights Reserved. See LICENSE for license details.
+//------------------------------------------------------------------------------
+#include "trace.h"
+#include "sm_err.h"
+#include "mprv.h"
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_timer.h>
+
+#ifndef TARGET_PLATFORM_HEADER
+#error "SM requires a defined platform to build"
+#endif
+
+// Special target platform header, set by configure script
+#include TARGET_PLATFORM_HEADER
+
+#if SM_TRACE_RECORDS & (SM_TRACE_RECORDS - 1)
+#error "SM_TRACE_RECORDS must be a power of two"
+#endif
+
+/* Only its own hart writes a ring. A record is published by storing its
+ * seq, after the rest of it, and then moving head past it; before a slot
+ * is reused its seq is changed to one no drain looks for there. A drain
+ * on another hart checks seq before and after copying a slot and drops
+ * the record if it was not the one it wanted, as if it had been
+ * overwritten before the drain. A full ring holds SM_TRACE_RECORDS
+ * records. */
+struct trace_ring {
+  uint64_t head;    /* records written */
+  uint64_t tail;    /* records drained or lost */
+  spinlock_t drain_lock;
+  struct sm_trace_record rec[SM_TRACE_RECORDS];
+} __attribute__((aligned(64)));
+
+static struct trace_ring trace_rings[MAX_HARTS];
+
+static void __sm_trace_write(struct trace_ring* ring, int level, int event,
+                             const void* data, size_t len)
+{
+  const uint8_t* bytes = data;
+  struct sm_trace_record* r;
+  uint64_t head = ring->head;
+  uint64_t time = sbi_timer_value();
+  size_t n;
+
+  do {
+    n = len < SM_TRACE_DATA_SIZE ? len : SM_TRACE_DATA_SIZE;
+    r = &ring->rec[head & (SM_TRACE_RECORDS - 1)];
+
+    /* the slot holds head - SM_TRACE_RECORDS, or nothing a drain wants */
+    __atomic_store_n(&r->seq, (uint32_t) (head - 1), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->time = time;
+    r->event = event;
+    r->level = level;
+    r->len = n | (len > n ? SM_TRACE_MORE : 0);
+    sbi_memcpy(r->data, bytes, n);
+    __atomic_store_n(&r->seq, (uint32_t) head, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&ring->head, ++head, __ATOMIC_RELEASE);
+    bytes += n;
+    len -= n;
+  } while (len);
+}
+
+void sm_trace_write(int level, int event, const void* data, size_t len)
+{
+  __sm_trace_write(&trace_rings[current_hartid()], level, event, data, len);
+}
+
+/* Copies the oldest records of hart, at most max of them, to the host
+ * buffer buf and forgets them */
+unsigned long sm_trace_drain(unsigned long hart, uintptr_t buf,
+                             unsigned long max, unsigned long* drained)
+{
+  struct trace_ring* ring;
+  struct sm_trace_record* r;
+  struct sm_trace_record rec;
+  uint64_t head, tail;
+  uint32_t seq;
+  unsigned long n = 0;
+  int ret = 0;
+
+  *drained = 0;
+  if (hart >= MAX_HARTS)
+    return SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT;
+  ring = &trace_rings[hart];
+
+  spin_lock(&ring->drain_lock);
+
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  tail = ring->tail;
+  if (head - tail > SM_TRACE_RECORDS)
+    tail = head - SM_TRACE_RECORDS;
+
+  while (tail < head && n < max) {
+    r = &ring->rec[tail & (SM_TRACE_RECORDS - 1)];
+    seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+    sbi_memcpy(&rec, r, sizeof(rec));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (seq != (uint32_t) tail ||
+        __atomic_load_n(&r->seq, __ATOMIC_RELAXED) != seq) {
+      tail++;
+      head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+      if (head - tail > SM_TRACE_RECORDS)
+        tail = head - SM_TRACE_RECORDS;
+      continue;
+    }
+
+    ret = copy_from_sm(buf + n * sizeof(rec), &rec, sizeof(rec));
+    if (ret)
+      break;
+    n++;
+    tail++;
+  }
+
+  ring->tail = tail;
+  spin_unlock(&ring->drain_lock);
+
+  *drained = n;
+  return ret ? SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT : SBI_ERR_SM_ENCLAVE_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <sbi/sbi_types.h>
+#include <sbi/sbi_string.h>
+#include "sm_trace.h"
+
+/* Leveled binary log of the SM (see sm_trace.h), written into a ring per
+ * hart instead of the console. Records above SM_LOG_LEVEL are compiled
+ * out; a production SM is built at SM_LOG_INFO or below, which leaves out
+ * the keys and certificates logged at SM_LOG_DEBUG. */
+
+#ifndef SM_LOG_LEVEL
+#define SM_LOG_LEVEL SM_LOG_INFO
+#endif
+
+/* records per hart, a power of two */
+#ifndef SM_TRACE_RECORDS
+#define SM_TRACE_RECORDS 64
+#endif
+
+void sm_trace_write(int level, int event, const void* data, size_t len);
+unsigned long sm_trace_drain(unsigned long hart, uintptr_t buf,
+                             unsigned long max, unsigned long* drained);
+
+#define sm_trace(level, event, data, len)             \
+  do {                                                \
+    if ((level) <= SM_LOG_LEVEL)                      \
+      sm_trace_write((level), (event), (data), (len)); \
+  } while (0)
+
+#define sm_trace_u32(level, event, value)             \
+  do {                                                \
+    uint32_t __v = (value);                           \
+    sm_trace((level), (event), &__v, sizeof(__v));    \
+  } while (0)
+
+#define sm_log(level, msg) \
+  sm_trace((level), SM_TRACE_MSG, (msg), sbi_strlen(msg))
+
+#endif
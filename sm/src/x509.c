@@ -872,6 +872,124 @@ int mbedtls_x509_write_sig(unsigned char **p, unsigned char *start,
     return (int) len;
 }
 
+/* Offset of the only occurrence of pat in der, -1 if there is none or more */
+static int x509_template_find(const unsigned char *der, int len,
+                              const unsigned char *pat, int pat_len)
+{
+    int off = -1;
+
+    for (int i = 0; i + pat_len <= len; i++) {
+        if (der[i] != pat[0] || sbi_memcmp(der + i, pat, pat_len) != 0) {
+            continue;
+        }
+        if (off >= 0) {
+            return -1;
+        }
+        off = i;
+    }
+    return off;
+}
+
+/*
+ * Write the certificate set up in ctx once and record where its variable
+ * fields are. ctx must have a one byte serial, pk as subject key and digest
+ * as the only measurement of its TCB info; pk and digest have to be values
+ * that occur nowhere else in the certificate.
+ */
+int mbedtls_x509write_crt_template_init(mbedtls_x509write_crt_template *tmpl,
+                                        mbedtls_x509write_cert *ctx,
+                                        const unsigned char *pk,
+                                        const unsigned char *digest)
+{
+    unsigned char buf[1024];
+    unsigned char *p, *end;
+    size_t len;
+    int ret;
+
+    tmpl->len = 0;
+    if (ctx->serial_len != 1) {
+        return MBEDTLS_ERR_X509_BAD_INPUT_DATA;
+    }
+
+    ret = mbedtls_x509write_crt_der(ctx, buf, sizeof(buf), NULL, NULL);
+    if (ret <= 0) {
+        return ret ? ret : MBEDTLS_ERR_X509_INVALID_FORMAT;
+    }
+    if ((size_t) ret > sizeof(tmpl->der)) {
+        return MBEDTLS_ERR_X509_BUFFER_TOO_SMALL;
+    }
+    sbi_memcpy(tmpl->der, buf + sizeof(buf) - ret, ret);
+
+    /* Certificate ::= SEQUENCE { tbsCertificate, ... } */
+    p = tmpl->der;
+    end = tmpl->der + ret;
+    if ((ret = mbedtls_asn1_get_tag(&p, end, &len,
+                                    MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE)) != 0) {
+        return ret;
+    }
+    tmpl->tbs_off = p - tmpl->der;
+    if ((ret = mbedtls_asn1_get_tag(&p, end, &len,
+                                    MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE)) != 0) {
+        return ret;
+    }
+    tmpl->tbs_len = (p - tmpl->der) + len - tmpl->tbs_off;
+
+    /* TBSCertificate ::= SEQUENCE { [0] version, serialNumber, ... } */
+    if (ctx->version != MBEDTLS_X509_CRT_VERSION_1) {
+        if ((ret = mbedtls_asn1_get_tag(&p, end, &len,
+                                        MBEDTLS_ASN1_CONTEXT_SPECIFIC |
+                                        MBEDTLS_ASN1_CONSTRUCTED | 0)) != 0) {
+            return ret;
+        }
+        p += len;
+    }
+    if ((ret = mbedtls_asn1_get_tag(&p, end, &len, MBEDTLS_ASN1_INTEGER)) != 0) {
+        return ret;
+    }
+    tmpl->serial_off = (p - tmpl->der) + len - 1;
+    tmpl->serial_msb = ctx->serial[0] & 0x80;
+
+    tmpl->pk_off = x509_template_find(tmpl->der, tmpl->tbs_off + tmpl->tbs_len, pk, 32);
+    tmpl->digest_off = x509_template_find(tmpl->der, tmpl->tbs_off + tmpl->tbs_len, digest, 64);
+    if (tmpl->pk_off < 0 || tmpl->digest_off < 0) {
+        return MBEDTLS_ERR_X509_INVALID_FORMAT;
+    }
+
+    tmpl->len = end - tmpl->der;
+    return 0;
+}
+
+/*
+ * Issue a certificate from a template: patch in the serial, the subject key
+ * and the digest, and sign the TBS part again. The serial has to encode to
+ * the same length as the one of the template, i.e. agree in its top bit.
+ * Returns the length of the certificate written to buf.
+ */
+int mbedtls_x509write_crt_template_issue(const mbedtls_x509write_crt_template *tmpl,
+                                         unsigned char serial,
+                                         const unsigned char *pk,
+                                         const unsigned char *digest,
+                                         const unsigned char *issuer_pub,
+                                         const unsigned char *issuer_priv,
+                                         unsigned char *buf, size_t size)
+{
+    if (tmpl->len == 0 || (serial & 0x80) != tmpl->serial_msb) {
+        return MBEDTLS_ERR_X509_BAD_INPUT_DATA;
+    }
+    if (size < (size_t) tmpl->len) {
+        return MBEDTLS_ERR_X509_BUFFER_TOO_SMALL;
+    }
+
+    sbi_memcpy(buf, tmpl->der, tmpl->len);
+    buf[tmpl->serial_off] = serial;
+    sbi_memcpy(buf + tmpl->pk_off, pk, 32);
+    sbi_memcpy(buf + tmpl->digest_off, digest, 64);
+    ed25519_sign(buf + tmpl->len - 64, buf + tmpl->tbs_off, tmpl->tbs_len,
+                 issuer_pub, issuer_priv);
+
+    return tmpl->len;
+}
+
 int mbedtls_pk_sign(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg,
                     const unsigned char *hash, size_t hash_len,
                     unsigned char *sig, size_t sig_size, size_t *sig_len,
@@ -396,6 +396,21 @@ typedef struct mbedtls_x509write_cert {
 }
 mbedtls_x509write_cert;
 
+/* DER of a certificate in which only the serial, the subject key and one
+ * measurement digest change from one issuance to the next. The offsets
+ * index der; the signature is always the last 64 bytes. */
+typedef struct mbedtls_x509write_crt_template {
+    unsigned char der[512];
+    int len;
+    int tbs_off;
+    int tbs_len;
+    int serial_off;
+    unsigned char serial_msb;
+    int pk_off;
+    int digest_off;
+}
+mbedtls_x509write_crt_template;
+
 
 /* Structure linking OIDs for X.509 DN AttributeTypes to their
  * string representations and default string encodings used by Mbed TLS. */
@@ -869,6 +884,18 @@ void set_dice_tcbInfo_vi(dice_tcbInfo* tcbInfo, unsigned char vi[], int l);
 void set_dice_tcbInfo_type(dice_tcbInfo* tcbInfo, unsigned char type[], int l);
 void set_dice_tcbInfo_measure(dice_tcbInfo* tcbInfo, measure m); 
 
+int mbedtls_x509write_crt_template_init(mbedtls_x509write_crt_template *tmpl,
+                                        mbedtls_x509write_cert *ctx,
+                                        const unsigned char *pk,
+                                        const unsigned char *digest);
+int mbedtls_x509write_crt_template_issue(const mbedtls_x509write_crt_template *tmpl,
+                                         unsigned char serial,
+                                         const unsigned char *pk,
+                                         const unsigned char *digest,
+                                         const unsigned char *issuer_pub,
+                                         const unsigned char *issuer_priv,
+                                         unsigned char *buf, size_t size);
+
 /*
 int mbedtls_x509_get_ext(unsigned char **p, const unsigned char *end,
                          mbedtls_x509_buf *ext, int tag);
@@ -4,3 +4,23 @@ void __wrap_send_and_sync_pmp_ipi(int region_idx, int type, uint8_t perm)
 {
   return;
 }
+
+void pmp_ipi_batch_begin(void)
+{
+  return;
+}
+
+void pmp_ipi_batch_end(void)
+{
+  return;
+}
+
+void pmp_ipi_enter_enclave(void)
+{
+  return;
+}
+
+void pmp_ipi_exit_enclave(void)
+{
+  return;
+}
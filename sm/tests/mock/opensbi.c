@@ -22,13 +22,44 @@ void __wrap_sbi_hart_hang(uint16_t code)
   mock_assert(0, "poweroff", __FILE__, __LINE__);
 }
 
+/* Real test-and-set locks, so that tests may run the SM from several
+ * threads. Each thread also remembers which locks it holds. */
+#define MOCK_MAX_HELD_LOCKS 4
+static __thread spinlock_t* mock_held_locks[MOCK_MAX_HELD_LOCKS];
+
+int mock_lock_is_held(spinlock_t* lock)
+{
+  for (int i = 0; i < MOCK_MAX_HELD_LOCKS; i++) {
+    if (mock_held_locks[i] == lock)
+      return 1;
+  }
+  return 0;
+}
+
 void __wrap_spin_lock(spinlock_t* lock)
 {
+  while (__atomic_test_and_set((char*) lock, __ATOMIC_ACQUIRE))
+    ;
+
+  for (int i = 0; i < MOCK_MAX_HELD_LOCKS; i++) {
+    if (!mock_held_locks[i]) {
+      mock_held_locks[i] = lock;
+      break;
+    }
+  }
   return;
 }
 
 void __wrap_spin_unlock(spinlock_t* lock)
 {
+  for (int i = 0; i < MOCK_MAX_HELD_LOCKS; i++) {
+    if (mock_held_locks[i] == lock) {
+      mock_held_locks[i] = NULL;
+      break;
+    }
+  }
+
+  __atomic_clear((char*) lock, __ATOMIC_RELEASE);
   return;
 }
 
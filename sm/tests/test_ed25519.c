@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "../src/ed25519/ed25519.h"
+#include "../src/ed25519/fe.h"
+
+/* Key pair and signature of the 32-bit field arithmetic for seed 0..31 and
+ * the message "keystone"; the 64-bit one has to agree */
+static const unsigned char kat_pk[32] = {
+  0x13, 0xc6, 0xc4, 0x5b, 0x3c, 0x30, 0x43, 0xfc,
+  0x0d, 0xd5, 0x8c, 0x02, 0x95, 0x5d, 0xd3, 0xbf,
+  0xbb, 0xe0, 0x5b, 0x43, 0xfe, 0xda, 0x45, 0xb5,
+  0x79, 0x9a, 0x0b, 0x45, 0x82, 0xf7, 0x03, 0x15,
+};
+
+static const unsigned char kat_sig[64] = {
+  0x96, 0xc1, 0xc8, 0xb4, 0xb5, 0x3c, 0x5c, 0x1a,
+  0xbc, 0x9e, 0x54, 0xab, 0xea, 0x95, 0x4f, 0x06,
+  0x06, 0xf4, 0x86, 0xd7, 0xe8, 0xc6, 0x88, 0x06,
+  0xb1, 0xf6, 0xaa, 0x4a, 0xf8, 0x49, 0xfa, 0x13,
+  0x0f, 0x90, 0x1f, 0x07, 0xaf, 0x11, 0x5e, 0x7b,
+  0xdb, 0x92, 0x3c, 0xe7, 0xd9, 0xcb, 0x08, 0x62,
+  0xad, 0xb9, 0x27, 0xd5, 0x56, 0xe6, 0xff, 0xca,
+  0x8c, 0x99, 0x77, 0xb3, 0x87, 0xe7, 0xee, 0x0c,
+};
+
+static uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void test_known_answer()
+{
+  unsigned char seed[32], pk[32], sk[64], sig[64];
+
+  for (int i = 0; i < 32; i++)
+    seed[i] = i;
+
+  ed25519_create_keypair(pk, sk, seed);
+  assert_memory_equal(pk, kat_pk, 32);
+
+  ed25519_sign(sig, (const unsigned char*) "keystone", 8, pk, sk);
+  assert_memory_equal(sig, kat_sig, 64);
+}
+
+/* Encodings are reduced mod p = 2^255 - 19 */
+static void test_fe_canonical()
+{
+  unsigned char s[32], out[32];
+  fe f, one, inv;
+
+  // p + 5
+  memset(s, 0xff, 32);
+  s[0] = 0xed + 5;
+  s[31] = 0x7f;
+  fe_frombytes(f, s);
+  fe_tobytes(out, f);
+  assert_int_equal(out[0], 5);
+  for (int i = 1; i < 32; i++)
+    assert_int_equal(out[i], 0);
+
+  // (p - 1) * (p - 1)^-1 = 1
+  s[0] = 0xec;
+  fe_frombytes(f, s);
+  fe_invert(inv, f);
+  fe_mul(one, f, inv);
+  fe_tobytes(out, one);
+  assert_int_equal(out[0], 1);
+  for (int i = 1; i < 32; i++)
+    assert_int_equal(out[i], 0);
+  assert_int_equal(fe_isnonzero(f), 1);
+  assert_int_equal(fe_isnegative(f), 0);
+}
+
+/* Microbenchmark: key pair generation and signing */
+static void bench_ed25519()
+{
+  const int rounds = 200;
+  unsigned char seed[32] = {0}, pk[32], sk[64], sig[64], msg[64] = {0};
+  uint64_t start;
+
+#ifdef ED25519_FE51
+  printf("[ BENCH ] radix 2^51 field arithmetic\n");
+#else
+  printf("[ BENCH ] radix 2^25.5 field arithmetic\n");
+#endif
+
+  start = now_ns();
+  for (int i = 0; i < rounds; i++) {
+    seed[0] = i;
+    ed25519_create_keypair(pk, sk, seed);
+  }
+  printf("[ BENCH ] keypair: %.1f us\n", (double) (now_ns() - start) / rounds / 1000);
+
+  start = now_ns();
+  for (int i = 0; i < rounds; i++) {
+    msg[0] = i;
+    ed25519_sign(sig, msg, sizeof(msg), pk, sk);
+  }
+  printf("[ BENCH ] sign: %.1f us\n", (double) (now_ns() - start) / rounds / 1000);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_known_answer),
+    cmocka_unit_test(test_fe_canonical),
+    cmocka_unit_test(bench_ed25519),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -7,18 +7,33 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <cmocka.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "../src/enclave.c"
 
+extern int mock_lock_is_held(spinlock_t* lock);
+
+/* trace.c reads mhartid, which traps under qemu-user, so records are only
+ * counted here */
+static int trace_records[SM_TRACE_EVENTS];
+
+void sm_trace_write(int level, int event, const void* data, size_t len)
+{
+  __atomic_add_fetch(&trace_records[event], 1, __ATOMIC_RELAXED);
+}
+
 static void test_is_create_args_valid()
 {
-  struct keystone_sbi_create args;
+  struct keystone_sbi_create_t args;
 
   // should return true
   args.epm_region.paddr = 0x4000;
   args.epm_region.size = 0x2000;
   args.utm_region.paddr = 0x8000;
   args.utm_region.size = 0x2000;
+  args.device_region.paddr = 0;
+  args.device_region.size = 0;
   args.runtime_paddr = 0x4000;
   args.user_paddr = 0x5000;
   args.free_paddr = 0x6000;
@@ -69,6 +84,25 @@ static void test_is_create_args_valid()
   args.epm_region.size = -1UL;
   assert_int_equal(is_create_args_valid(&args), 0);
   args.epm_region.size = 0x2000;
+
+  // true if the device window is one the platform lists
+  args.device_region.paddr = 0x101000;
+  args.device_region.size = 0x1000;
+  assert_int_equal(is_create_args_valid(&args), 1);
+
+  // false if it reaches past the listed window
+  args.device_region.size = 0x2000;
+  assert_int_equal(is_create_args_valid(&args), 0);
+
+  // false if it is not page granular
+  args.device_region.size = 0x100;
+  assert_int_equal(is_create_args_valid(&args), 0);
+
+  // false for memory no window covers
+  args.device_region.paddr = 0x8000;
+  args.device_region.size = 0x1000;
+  assert_int_equal(is_create_args_valid(&args), 0);
+  args.device_region.size = 0;
 }
 
 static void test_context_switch_to_enclave()
@@ -121,6 +155,516 @@ static void test_get_enclave_region_index()
   assert_int_equal( get_enclave_region_index(0, REGION_OTHER), 2 );
 }
 
+/* Measurement must run unlocked; count the calls that do not */
+static int hashed_under_lock;
+
+unsigned long __real_validate_and_hash_enclave(struct enclave* enclave);
+unsigned long __wrap_validate_and_hash_enclave(struct enclave* enclave)
+{
+  if (mock_lock_is_held(&enclave->lock))
+    __atomic_add_fetch(&hashed_under_lock, 1, __ATOMIC_RELAXED);
+  return __real_validate_and_hash_enclave(enclave);
+}
+
+#define STRESS_EPM_SIZE   0x40000
+#define STRESS_UTM_SIZE   0x1000
+#define STRESS_MAX_HARTS  4
+#define STRESS_ROUNDS     8
+
+struct stress_hart {
+  pthread_t thread;
+  void* epm;
+  void* utm;
+  int created;
+};
+
+static void* stress_create_destroy(void* arg)
+{
+  struct stress_hart* hart = arg;
+  struct keystone_sbi_create_t args;
+  unsigned long eid, cleared;
+
+  args.epm_region.paddr = (uintptr_t) hart->epm;
+  args.epm_region.size = STRESS_EPM_SIZE;
+  args.utm_region.paddr = (uintptr_t) hart->utm;
+  args.utm_region.size = STRESS_UTM_SIZE;
+  args.device_region.size = 0;
+  args.runtime_paddr = args.epm_region.paddr + 0x1000;
+  args.user_paddr = args.epm_region.paddr + 0x2000;
+  args.free_paddr = args.epm_region.paddr + STRESS_EPM_SIZE;
+  args.free_requested = 0;
+
+  for (int i = 0; i < STRESS_ROUNDS; i++) {
+    if (create_enclave(&eid, args) != SBI_ERR_SM_ENCLAVE_SUCCESS)
+      break;
+    if (destroy_enclave(eid) != SBI_ERR_SM_ENCLAVE_SUCCESS)
+      break;
+    // the EPM can only be reused once it has been scrubbed
+    do {
+      scrub_enclave_memory(args.epm_region.paddr, &cleared);
+    } while (cleared);
+    hart->created++;
+  }
+  return NULL;
+}
+
+/* Create and destroy enclaves from 1, 2 and 4 threads standing in for
+ * harts. Creation hashes the whole image and issues a certificate; with
+ * that work unlocked the throughput grows with the threads. */
+static void test_create_enclave_concurrent()
+{
+  struct stress_hart harts[STRESS_MAX_HARTS];
+  struct timespec start, end;
+  int traced = 0;
+
+  enclave_init_metadata();
+  hashed_under_lock = 0;
+  trace_records[SM_TRACE_ENCLAVE_CREATE] = 0;
+  trace_records[SM_TRACE_ENCLAVE_DESTROY] = 0;
+
+  for (int i = 0; i < STRESS_MAX_HARTS; i++) {
+    harts[i].epm = aligned_alloc(STRESS_EPM_SIZE, STRESS_EPM_SIZE);
+    harts[i].utm = aligned_alloc(STRESS_UTM_SIZE, STRESS_UTM_SIZE);
+    assert_non_null(harts[i].epm);
+    assert_non_null(harts[i].utm);
+  }
+
+  for (int n = 1; n <= STRESS_MAX_HARTS; n *= 2) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < n; i++) {
+      harts[i].created = 0;
+      pthread_create(&harts[i].thread, NULL, stress_create_destroy, &harts[i]);
+    }
+    for (int i = 0; i < n; i++) {
+      pthread_join(harts[i].thread, NULL);
+      assert_int_equal(harts[i].created, STRESS_ROUNDS);
+    }
+    traced += n * STRESS_ROUNDS;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("[ STRESS ] %d hart(s): %.1f enclaves/s\n", n, n * STRESS_ROUNDS / secs);
+  }
+
+  assert_int_equal(hashed_under_lock, 0);
+  assert_int_equal(trace_records[SM_TRACE_ENCLAVE_CREATE], traced);
+  assert_int_equal(trace_records[SM_TRACE_ENCLAVE_DESTROY], traced);
+
+  // every eid has been given back
+  for (int i = 0; i < ENCL_MAX; i++)
+    assert_int_equal(enclaves[i].state, INVALID);
+
+  for (int i = 0; i < STRESS_MAX_HARTS; i++) {
+    free(harts[i].epm);
+    free(harts[i].utm);
+  }
+}
+
+#define SCRUB_EPM_SIZE (4 * SCRUB_CHUNK_SIZE + 0x3000)
+
+struct scrub_hart {
+  pthread_t thread;
+  uintptr_t base;
+  unsigned long cleared;
+};
+
+static void* scrub_all(void* arg)
+{
+  struct scrub_hart* hart = arg;
+  unsigned long cleared;
+
+  do {
+    scrub_enclave_memory(hart->base, &cleared);
+    hart->cleared += cleared;
+  } while (cleared);
+  return NULL;
+}
+
+/* Destroyed enclave memory stays locked down until it has been cleared,
+ * chunk by chunk and possibly from several harts */
+static void test_scrub_enclave_memory()
+{
+  struct scrub_hart harts[4] = {0};
+  unsigned long cleared, total = 0;
+  unsigned char* epm;
+  region_id rid;
+
+  epm = aligned_alloc(0x1000, SCRUB_EPM_SIZE);
+  assert_non_null(epm);
+  memset(epm, 0xa5, SCRUB_EPM_SIZE);
+  assert_int_equal(pmp_region_init_atomic((uintptr_t) epm, SCRUB_EPM_SIZE,
+                                          PMP_PRI_ANY, &rid, 0), 0);
+  scrub_region_add(rid);
+
+  // the first chunk is cleared, the region stays allocated
+  assert_int_equal(scrub_enclave_memory((uintptr_t) epm, &cleared), 0);
+  assert_int_equal(cleared, SCRUB_CHUNK_SIZE);
+  assert_int_equal(epm[SCRUB_CHUNK_SIZE - 1], 0);
+  assert_int_equal(epm[SCRUB_CHUNK_SIZE], 0xa5);
+  assert_true(pmp_detect_region_overlap_atomic((uintptr_t) epm, 0x1000));
+
+  for (int i = 0; i < 4; i++) {
+    harts[i].base = (uintptr_t) epm;
+    pthread_create(&harts[i].thread, NULL, scrub_all, &harts[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(harts[i].thread, NULL);
+    total += harts[i].cleared;
+  }
+
+  // every byte was cleared exactly once, then the region was released
+  assert_int_equal(total, SCRUB_EPM_SIZE - SCRUB_CHUNK_SIZE);
+  for (size_t i = 0; i < SCRUB_EPM_SIZE; i++)
+    assert_int_equal(epm[i], 0);
+  assert_false(pmp_detect_region_overlap_atomic((uintptr_t) epm, 0x1000));
+  assert_int_equal(scrub_enclave_memory((uintptr_t) epm, &cleared), 0);
+  assert_int_equal(cleared, 0);
+
+  free(epm);
+}
+
+#define EID_HARTS 4
+
+struct eid_hart {
+  pthread_t thread;
+  enclave_id eids[ENCL_MAX];
+  int n;
+};
+
+static void* alloc_all_eids(void* arg)
+{
+  struct eid_hart* hart = arg;
+  enclave_id eid;
+
+  while (encl_alloc_eid(&eid) == SBI_ERR_SM_ENCLAVE_SUCCESS)
+    hart->eids[hart->n++] = eid;
+  return NULL;
+}
+
+/* Harts racing for eids each get distinct ones, and all of them are
+ * handed out exactly once */
+static void test_encl_alloc_eid_concurrent()
+{
+  struct eid_hart harts[EID_HARTS] = {0};
+  int seen[ENCL_MAX] = {0};
+  enclave_id eid;
+  int total = 0;
+
+  enclave_init_metadata();
+
+  for (int i = 0; i < EID_HARTS; i++)
+    pthread_create(&harts[i].thread, NULL, alloc_all_eids, &harts[i]);
+  for (int i = 0; i < EID_HARTS; i++) {
+    pthread_join(harts[i].thread, NULL);
+    for (int j = 0; j < harts[i].n; j++) {
+      assert_int_equal(seen[harts[i].eids[j]]++, 0);
+      assert_int_equal(enclaves[harts[i].eids[j]].state, ALLOCATED);
+    }
+    total += harts[i].n;
+  }
+  assert_int_equal(total, ENCL_MAX);
+
+  // a freed eid is the next one handed out
+  encl_free_eid(5);
+  assert_int_equal(encl_state(5), INVALID);
+  assert_int_equal(encl_alloc_eid(&eid), SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(eid, 5);
+}
+
+/* Lifecycle transitions only succeed from the states they expect */
+static void test_state_transitions()
+{
+  enclave_init_metadata();
+
+  enclaves[3].state = ALLOCATED;
+  assert_int_equal(destroy_enclave(3), SBI_ERR_SM_ENCLAVE_NOT_DESTROYABLE);
+  assert_int_equal(encl_state(3), ALLOCATED);
+
+  enclaves[3].state = RUNNING;
+  assert_int_equal(destroy_enclave(3), SBI_ERR_SM_ENCLAVE_NOT_DESTROYABLE);
+  assert_false(encl_state_cas(3, STOPPED, DESTROYING));
+  assert_true(encl_state_cas(3, RUNNING, STOPPED));
+  assert_int_equal(encl_state(3), STOPPED);
+
+  assert_int_equal(destroy_enclave(ENCL_MAX), SBI_ERR_SM_ENCLAVE_NOT_DESTROYABLE);
+  assert_int_equal(run_enclave(NULL, ENCL_MAX), SBI_ERR_SM_ENCLAVE_NOT_FRESH);
+  assert_int_equal(resume_enclave(NULL, ENCL_MAX), SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE);
+  enclaves[3].state = INVALID;
+}
+
+/* Thread 0 cannot be created, and only created or stopped threads of a
+ * started enclave can be run */
+static void test_thread_states()
+{
+  enclave_init_metadata();
+
+  enclaves[3].state = STOPPED;
+  enclaves[3].thread_states[0] = THREAD_STOPPED;
+  enclaves[3].thread_states[1] = THREAD_UNUSED;
+  enclaves[3].thread_states[2] = THREAD_RUNNING;
+
+  assert_int_equal(create_thread(NULL, 3, 0, 0, 0), SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+  assert_int_equal(create_thread(NULL, 3, MAX_ENCL_THREADS, 0, 0),
+                   SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+  assert_int_equal(enclaves[3].thread_states[1], THREAD_UNUSED);
+
+  assert_int_equal(run_thread(NULL, 3, 1), SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE);
+  assert_int_equal(run_thread(NULL, 3, 2), SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE);
+  assert_int_equal(run_thread(NULL, 3, MAX_ENCL_THREADS), SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE);
+  assert_int_equal(encl_state(3), STOPPED);
+  assert_int_equal(enclaves[3].n_thread, 0);
+
+  // a destroyed enclave leaves no thread behind
+  enclaves[3].state = FRESH;
+  enclaves[3].thread_states[0] = THREAD_FRESH;
+  assert_int_equal(run_thread(NULL, 3, 0), SBI_ERR_SM_ENCLAVE_NOT_RESUMABLE);
+  assert_int_equal(destroy_enclave(3), SBI_ERR_SM_ENCLAVE_SUCCESS);
+  for (int i = 0; i < MAX_ENCL_THREADS; i++)
+    assert_int_equal(enclaves[3].thread_states[i], THREAD_UNUSED);
+}
+
+/* A certificate issued from a template carries the patched fields and a
+ * signature over its TBS part; the serial has to fit the template */
+static void test_crt_template()
+{
+  unsigned char pk[32], digest[64], crt[512], sig[64];
+  const mbedtls_x509write_crt_template* tmpl = &ldev_crt_template[1];
+  int len;
+
+  assert_int_equal(enclave_init_metadata(), SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_true(lak_crt_template[0].len > 0);
+  assert_int_equal(ldev_crt_template[1].len, ldev_crt_template[0].len + 1);
+
+  memset(pk, 0xa5, sizeof(pk));
+  memset(digest, 0x5a, sizeof(digest));
+  len = mbedtls_x509write_crt_template_issue(tmpl, 151, pk, digest, sm_public_key,
+                                             sm_private_key, crt, sizeof(crt));
+  assert_int_equal(len, tmpl->len);
+  assert_int_equal(crt[tmpl->serial_off], 151);
+  assert_int_equal(crt[tmpl->serial_off - 1], 0);
+  assert_memory_equal(crt + tmpl->pk_off, pk, 32);
+  assert_memory_equal(crt + tmpl->digest_off, digest, 64);
+
+  ed25519_sign(sig, crt + tmpl->tbs_off, tmpl->tbs_len, sm_public_key, sm_private_key);
+  assert_memory_equal(crt + len - 64, sig, 64);
+
+  assert_true(mbedtls_x509write_crt_template_issue(tmpl, 21, pk, digest, sm_public_key,
+                                                   sm_private_key, crt, sizeof(crt)) < 0);
+  assert_true(mbedtls_x509write_crt_template_issue(tmpl, 151, pk, digest, sm_public_key,
+                                                   sm_private_key, crt, 64) < 0);
+}
+
+/* Keys are found by index and by public key, per enclave, and one enclave
+ * cannot take more than its share of the store */
+static void test_keystore()
+{
+  unsigned char pk[32], sk[64], out_pk[32], out_sk[64], seed[32], sig[64], ref[64];
+  const unsigned char msg[] = "keystone";
+  unsigned int i;
+  int first;
+
+  keystore_clear(5);
+  keystore_clear(6);
+
+  for (i = 0; i < KEYSTORE_MAX_PER_ENCLAVE; i++) {
+    memset(seed, i, sizeof(seed));
+    ed25519_create_keypair(pk, sk, seed);
+    assert_int_equal(keystore_put(5, 1000 * i, pk, sk, &first), 0);
+    assert_int_equal(first, i == 0);
+  }
+  assert_int_equal(keystore_count(5), KEYSTORE_MAX_PER_ENCLAVE);
+  assert_true(keystore_put(5, 1, pk, sk, &first) < 0);
+
+  /* the same index again is not a new key */
+  assert_int_equal(keystore_put(5, 0, pk, sk, &first), 0);
+  assert_int_equal(first, 0);
+  assert_int_equal(keystore_count(5), KEYSTORE_MAX_PER_ENCLAVE);
+
+  memset(seed, 7, sizeof(seed));
+  ed25519_create_keypair(pk, sk, seed);
+  assert_int_equal(keystore_get(5, 7000, out_pk, out_sk), 0);
+  assert_memory_equal(out_pk, pk, 32);
+  assert_memory_equal(out_sk, sk, 64);
+  assert_true(keystore_get(6, 7000, out_pk, NULL) < 0);
+
+  /* signing picks the key by its public key, within the enclave only */
+  ed25519_sign(ref, msg, sizeof(msg), pk, sk);
+  assert_int_equal(keystore_sign(5, pk, sig, msg, sizeof(msg)), 0);
+  assert_memory_equal(sig, ref, 64);
+  assert_true(keystore_sign(6, pk, sig, msg, sizeof(msg)) < 0);
+
+  assert_int_equal(keystore_put(6, 7000, pk, sk, &first), 0);
+  assert_int_equal(first, 1);
+
+  keystore_clear(5);
+  assert_int_equal(keystore_count(5), 0);
+  assert_true(keystore_get(5, 7000, out_pk, NULL) < 0);
+  assert_int_equal(keystore_sign(6, pk, sig, msg, sizeof(msg)), 0);
+  keystore_clear(6);
+  assert_true(keystore_sign(6, pk, sig, msg, sizeof(msg)) < 0);
+}
+
+/* Lengths from the enclave are bounded by the SM buffers before any copy */
+static void test_crypto_op_lengths()
+{
+  unsigned char data[2048], out[64], pk[32];
+  size_t out_len;
+
+  memset(data, 0x5a, sizeof(data));
+  memset(pk, 0, sizeof(pk));
+
+  /* a negative length from a signed caller */
+  out_len = sizeof(out);
+  assert_int_equal(do_crypto_op(0, 1, data, (size_t)-1, out, &out_len, pk),
+                   SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+  assert_int_equal(do_crypto_op(0, 1, data, 2049, out, &out_len, pk),
+                   SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+
+  /* no room for the signature */
+  out_len = sizeof(out) - 1;
+  assert_int_equal(do_crypto_op(0, 1, data, 16, out, &out_len, pk),
+                   SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+
+  out_len = sizeof(out);
+  assert_int_equal(do_crypto_op(0, 1, data, 2048, out, &out_len, pk), 0);
+  assert_int_equal(out_len, 64);
+}
+
+/* Every proof of a batch leads from its leaf to the root, for any number
+ * of blobs; a node without a sibling moves up unchanged */
+static void test_attest_batch_tree()
+{
+  byte tree[2 * ATTEST_BATCH_MAX - 1][ATTEST_BATCH_NODE_SIZE];
+  byte node[ATTEST_BATCH_NODE_SIZE], expect[ATTEST_BATCH_NODE_SIZE];
+  byte inner = ATTEST_BATCH_INNER;
+  struct attest_batch_proof proof;
+  unsigned int count, root, i, n, j, k;
+  sha3_ctx_t ctx;
+
+  for (count = 1; count <= ATTEST_BATCH_MAX; count++) {
+    for (i = 0; i < count; i++)
+      memset(tree[i], i + 1, ATTEST_BATCH_NODE_SIZE);
+    root = attest_batch_tree(tree, count);
+
+    for (i = 0; i < count; i++) {
+      attest_batch_proof(&proof, tree, count, i);
+      assert_int_equal(proof.index, i);
+      assert_int_equal(proof.count, count);
+
+      memcpy(node, tree[i], ATTEST_BATCH_NODE_SIZE);
+      for (n = count, j = i, k = 0; n > 1; n = (n + 1) / 2, j >>= 1) {
+        if ((j ^ 1) >= n)
+          continue;
+        sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+        sha3_update(&ctx, &inner, 1);
+        sha3_update(&ctx, j & 1 ? proof.siblings[k] : node, ATTEST_BATCH_NODE_SIZE);
+        sha3_update(&ctx, j & 1 ? node : proof.siblings[k], ATTEST_BATCH_NODE_SIZE);
+        sha3_final(node, &ctx);
+        k++;
+      }
+      assert_true(k <= ATTEST_BATCH_DEPTH);
+      assert_memory_equal(node, tree[root], ATTEST_BATCH_NODE_SIZE);
+    }
+  }
+
+  /* three blobs: H(1 | H(1 | L0 | L1) | L2) */
+  for (i = 0; i < 3; i++)
+    memset(tree[i], i + 1, ATTEST_BATCH_NODE_SIZE);
+  root = attest_batch_tree(tree, 3);
+  sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+  sha3_update(&ctx, &inner, 1);
+  sha3_update(&ctx, tree[0], 2 * ATTEST_BATCH_NODE_SIZE);
+  sha3_final(node, &ctx);
+  sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+  sha3_update(&ctx, &inner, 1);
+  sha3_update(&ctx, node, ATTEST_BATCH_NODE_SIZE);
+  sha3_update(&ctx, tree[2], ATTEST_BATCH_NODE_SIZE);
+  sha3_final(expect, &ctx);
+  assert_memory_equal(tree[root], expect, ATTEST_BATCH_NODE_SIZE);
+}
+
+/* A batch of the most blobs there may be, through the whole call: the
+ * report carries the root, and every blob gets a proof that leads to it */
+static void test_attest_enclave_batch_max()
+{
+  static struct attest_batch_buf buf;
+  static struct report report;
+  static struct attest_batch_proof proofs[ATTEST_BATCH_MAX];
+  static byte blobs[ATTEST_BATCH_MAX * ATTEST_DATA_MAXLEN];
+  uint32_t sizes[ATTEST_BATCH_MAX];
+  struct keystone_sbi_create_t args;
+  byte node[ATTEST_BATCH_NODE_SIZE], prefix;
+  byte* root = report.enclave.data + ATTEST_BATCH_TAG_LEN + 4;
+  byte* blob = blobs;
+  unsigned long eid, cleared;
+  unsigned int i, n, j, k;
+  sha3_ctx_t ctx;
+  void* epm = aligned_alloc(STRESS_EPM_SIZE, STRESS_EPM_SIZE);
+  void* utm = aligned_alloc(STRESS_UTM_SIZE, STRESS_UTM_SIZE);
+
+  enclave_init_metadata();
+  args.epm_region.paddr = (uintptr_t) epm;
+  args.epm_region.size = STRESS_EPM_SIZE;
+  args.utm_region.paddr = (uintptr_t) utm;
+  args.utm_region.size = STRESS_UTM_SIZE;
+  args.device_region.size = 0;
+  args.runtime_paddr = args.epm_region.paddr + 0x1000;
+  args.user_paddr = args.epm_region.paddr + 0x2000;
+  args.free_paddr = args.epm_region.paddr + STRESS_EPM_SIZE;
+  args.free_requested = 0;
+  assert_int_equal(create_enclave(&eid, args), SBI_ERR_SM_ENCLAVE_SUCCESS);
+
+  /* sizes that end partway through a copy chunk, up to the largest blob */
+  for (i = 0; i < ATTEST_BATCH_MAX; i++) {
+    sizes[i] = i == ATTEST_BATCH_MAX - 1 ? ATTEST_DATA_MAXLEN : 61 * i + 1;
+    memset(blob, i + 1, sizes[i]);
+    blob += sizes[i];
+  }
+
+  assert_int_equal(__attest_enclave_batch(&buf, (uintptr_t) &report,
+                                          (uintptr_t) proofs, (uintptr_t) blobs,
+                                          (uintptr_t) sizes, ATTEST_BATCH_MAX, eid),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_memory_equal(report.enclave.data, ATTEST_BATCH_TAG, ATTEST_BATCH_TAG_LEN);
+  assert_int_equal(report.enclave.data[ATTEST_BATCH_TAG_LEN], ATTEST_BATCH_MAX);
+  assert_int_equal(report.enclave.data_len, ATTEST_BATCH_DATA_LEN);
+
+  for (i = 0, blob = blobs; i < ATTEST_BATCH_MAX; blob += sizes[i++]) {
+    prefix = ATTEST_BATCH_LEAF;
+    sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+    sha3_update(&ctx, &prefix, 1);
+    sha3_update(&ctx, blob, sizes[i]);
+    sha3_final(node, &ctx);
+
+    assert_int_equal(proofs[i].index, i);
+    assert_int_equal(proofs[i].count, ATTEST_BATCH_MAX);
+    prefix = ATTEST_BATCH_INNER;
+    for (n = ATTEST_BATCH_MAX, j = i, k = 0; n > 1; n = (n + 1) / 2, j >>= 1) {
+      sha3_init(&ctx, ATTEST_BATCH_NODE_SIZE);
+      sha3_update(&ctx, &prefix, 1);
+      sha3_update(&ctx, j & 1 ? proofs[i].siblings[k] : node, ATTEST_BATCH_NODE_SIZE);
+      sha3_update(&ctx, j & 1 ? node : proofs[i].siblings[k], ATTEST_BATCH_NODE_SIZE);
+      sha3_final(node, &ctx);
+      k++;
+    }
+    assert_int_equal(k, ATTEST_BATCH_DEPTH);
+    assert_memory_equal(node, root, ATTEST_BATCH_NODE_SIZE);
+  }
+
+  /* one more is refused before anything is read */
+  assert_int_equal(__attest_enclave_batch(&buf, (uintptr_t) &report,
+                                          (uintptr_t) proofs, (uintptr_t) blobs,
+                                          (uintptr_t) sizes, ATTEST_BATCH_MAX + 1, eid),
+                   SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+
+  assert_int_equal(destroy_enclave(eid), SBI_ERR_SM_ENCLAVE_SUCCESS);
+  do {
+    scrub_enclave_memory(args.epm_region.paddr, &cleared);
+  } while (cleared);
+  free(epm);
+  free(utm);
+}
+
 int main()
 {
   const struct CMUnitTest tests[] = {
@@ -128,6 +672,16 @@ int main()
     cmocka_unit_test(test_context_switch_to_enclave),
     cmocka_unit_test(test_get_enclave_region_after_init),
     cmocka_unit_test(test_get_enclave_region_index),
+    cmocka_unit_test(test_encl_alloc_eid_concurrent),
+    cmocka_unit_test(test_state_transitions),
+    cmocka_unit_test(test_thread_states),
+    cmocka_unit_test(test_crt_template),
+    cmocka_unit_test(test_keystore),
+    cmocka_unit_test(test_crypto_op_lengths),
+    cmocka_unit_test(test_attest_batch_tree),
+    cmocka_unit_test(test_attest_enclave_batch_max),
+    cmocka_unit_test(test_scrub_enclave_memory),
+    cmocka_unit_test(test_create_enclave_concurrent),
   };
 
   return cmocka_run_group_tests(tests, NULL, NULL);
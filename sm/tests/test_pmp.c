@@ -217,6 +217,74 @@ static void test_region_helpers()
   assert_memory_equal(&regions[rid], &zero, sizeof(struct pmp_region));
 }
 
+static void test_region_global()
+{
+  region_id rid;
+
+  assert_int_equal(
+      pmp_region_init_atomic(0x8000, 0x4000, PMP_PRI_ANY, &rid, false),
+      PMP_SUCCESS);
+  assert_int_equal(pmp_region_reg_mask(rid), 0x1);
+
+  // global regions are remembered for harts that catch up later
+  assert_int_equal(pmp_set_global(rid, PMP_NO_PERM), PMP_SUCCESS);
+  assert_true(TEST_BIT(region_global_bitmap, rid));
+  assert_int_equal(region_global_perm[rid], PMP_NO_PERM);
+  assert_int_equal(pmp_unset_global(rid), PMP_SUCCESS);
+  assert_false(TEST_BIT(region_global_bitmap, rid));
+
+  pmp_set_global(rid, PMP_NO_PERM);
+  pmp_region_free_atomic(rid);
+  assert_int_equal(region_global_bitmap, 0x0);
+  assert_int_equal(pmp_region_reg_mask(rid), 0x0);
+
+  // a TOR region occupies its register and the one below
+  region_init(4, 0x10000, 0x3000, PMP_A_TOR, false, 5);
+  assert_int_equal(region_reg_mask(4), 0x60);
+  region_clear_all(4);
+}
+
+static void test_pmp_switch()
+{
+  struct pmp_switch sw;
+
+  region_init(2, 0x8000, 0x4000, PMP_A_NAPOT, false, 3);
+  region_init(4, 0x10000, 0x3000, PMP_A_TOR, false, 5);
+  SET_BIT(region_def_bitmap, 2);
+  SET_BIT(region_def_bitmap, 4);
+
+  pmp_switch_init(&sw);
+  assert_int_equal(pmp_switch_add(&sw, 2, PMP_ALL_PERM, PMP_NO_PERM, 1), PMP_SUCCESS);
+  assert_int_equal(pmp_switch_add(&sw, 4, PMP_ALL_PERM, PMP_R, 1), PMP_SUCCESS);
+  assert_int_not_equal(pmp_switch_add(&sw, 5, PMP_ALL_PERM, PMP_NO_PERM, 1), PMP_SUCCESS);
+
+  // one pmpcfg register covers all three entries; the lower TOR entry is off
+  assert_int_equal(sw.cfg_mask[0], 0xffUL << 24 | 0xffffUL << 40);
+  assert_int_equal(sw.cfg_on[0], (uintptr_t) (PMP_A_NAPOT | PMP_ALL_PERM) << 24 |
+                                 (uintptr_t) (PMP_A_TOR | PMP_ALL_PERM) << 48);
+  assert_int_equal(sw.cfg_off[0], (uintptr_t) PMP_A_NAPOT << 24 |
+                                  (uintptr_t) (PMP_A_TOR | PMP_R) << 48);
+  assert_int_equal(sw.cfg_mask[2], 0);
+
+  assert_int_equal(sw.n_addr, 3);
+  assert_int_equal(sw.addr_reg[0], 3);
+  assert_int_equal(sw.addr_val[0], 0x27ff);
+  assert_int_equal(sw.addr_reg[1], 6);
+  assert_int_equal(sw.addr_val[1], 0x13000 >> 2);
+  assert_int_equal(sw.addr_reg[2], 5);
+  assert_int_equal(sw.addr_val[2], 0x10000 >> 2);
+
+  // regions kept programmed everywhere only change permissions
+  pmp_switch_init(&sw);
+  pmp_switch_add(&sw, 2, PMP_NO_PERM, PMP_ALL_PERM, 0);
+  assert_int_equal(sw.n_addr, 0);
+  assert_int_equal(sw.cfg_on[0], (uintptr_t) PMP_A_NAPOT << 24);
+
+  region_clear_all(2);
+  region_clear_all(4);
+  region_def_bitmap = 0x0;
+}
+
 int main()
 {
   const struct CMUnitTest tests[] = {
@@ -228,6 +296,8 @@ int main()
     cmocka_unit_test(test_pmp_region_init_not_page_granularity),
     cmocka_unit_test(test_pmp_region_init_tor_pri_top),
     cmocka_unit_test(test_region_helpers),
+    cmocka_unit_test(test_region_global),
+    cmocka_unit_test(test_pmp_switch),
   };
 
   return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "../src/trace.c"
+
+/* the records of a test are told apart by seq, not by time */
+u64 sbi_timer_value(void)
+{
+  return 0;
+}
+
+static void reset_ring(unsigned long hart)
+{
+  memset(&trace_rings[hart], 0, sizeof(trace_rings[hart]));
+}
+
+static uint8_t payload_byte(int msg, int offset)
+{
+  return (uint8_t) (msg * 7 + offset);
+}
+
+static void test_trace_wraparound()
+{
+  struct sm_trace_record out[2 * SM_TRACE_RECORDS];
+  unsigned long drained;
+  uint32_t v;
+  int first = 100 - SM_TRACE_RECORDS;
+
+  reset_ring(0);
+  for (v = 0; v < 100; v++)
+    __sm_trace_write(&trace_rings[0], SM_LOG_INFO, SM_TRACE_HART_INIT,
+                     &v, sizeof(v));
+
+  // a full ring keeps the newest SM_TRACE_RECORDS, oldest first
+  assert_int_equal(sm_trace_drain(0, (uintptr_t) out, 2 * SM_TRACE_RECORDS,
+                                  &drained),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(drained, SM_TRACE_RECORDS);
+  for (int i = 0; i < SM_TRACE_RECORDS; i++) {
+    assert_int_equal(out[i].seq, first + i);
+    assert_int_equal(out[i].event, SM_TRACE_HART_INIT);
+    assert_int_equal(out[i].level, SM_LOG_INFO);
+    assert_int_equal(out[i].len, sizeof(v));
+    memcpy(&v, out[i].data, sizeof(v));
+    assert_int_equal(v, first + i);
+  }
+
+  // drained records are forgotten
+  assert_int_equal(sm_trace_drain(0, (uintptr_t) out, 2 * SM_TRACE_RECORDS,
+                                  &drained),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(drained, 0);
+}
+
+static void test_trace_truncation()
+{
+  struct sm_trace_record out[SM_TRACE_RECORDS];
+  uint8_t data[2 * SM_TRACE_DATA_SIZE + 4];
+  unsigned long drained;
+  int msgs = 40;
+  int parts = 3;
+  int first = msgs * parts - SM_TRACE_RECORDS;
+
+  // each message takes two full records and one of 4 bytes
+  reset_ring(1);
+  for (int m = 0; m < msgs; m++) {
+    for (int j = 0; j < sizeof(data); j++)
+      data[j] = payload_byte(m, j);
+    __sm_trace_write(&trace_rings[1], SM_LOG_DEBUG, SM_TRACE_CERT_SM,
+                     data, sizeof(data));
+  }
+
+  assert_int_equal(sm_trace_drain(1, (uintptr_t) out, SM_TRACE_RECORDS,
+                                  &drained),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(drained, SM_TRACE_RECORDS);
+  for (int i = 0; i < SM_TRACE_RECORDS; i++) {
+    int m = (first + i) / parts;
+    int part = (first + i) % parts;
+    int len = part < parts - 1 ? SM_TRACE_DATA_SIZE : 4;
+
+    assert_int_equal(out[i].seq, first + i);
+    assert_int_equal(out[i].event, SM_TRACE_CERT_SM);
+    assert_int_equal(out[i].len & SM_TRACE_LEN_MASK, len);
+    assert_int_equal(!!(out[i].len & SM_TRACE_MORE), part < parts - 1);
+    for (int j = 0; j < len; j++)
+      assert_int_equal(out[i].data[j],
+                       payload_byte(m, part * SM_TRACE_DATA_SIZE + j));
+  }
+
+  // exactly SM_TRACE_DATA_SIZE bytes fit in one record
+  __sm_trace_write(&trace_rings[1], SM_LOG_DEBUG, SM_TRACE_CERT_SM,
+                   data, SM_TRACE_DATA_SIZE);
+  assert_int_equal(sm_trace_drain(1, (uintptr_t) out, SM_TRACE_RECORDS,
+                                  &drained),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(drained, 1);
+  assert_int_equal(out[0].seq, msgs * parts);
+  assert_int_equal(out[0].len, SM_TRACE_DATA_SIZE);
+}
+
+static void test_trace_drain_partial()
+{
+  struct sm_trace_record out[SM_TRACE_RECORDS];
+  unsigned long drained;
+  uint32_t v;
+
+  reset_ring(2);
+  for (v = 0; v < 10; v++)
+    __sm_trace_write(&trace_rings[2], SM_LOG_INFO, SM_TRACE_ENCLAVE_CREATE,
+                     &v, sizeof(v));
+
+  // at most max records, the rest stays for the next drain
+  assert_int_equal(sm_trace_drain(2, (uintptr_t) out, 4, &drained),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(drained, 4);
+  assert_int_equal(out[3].seq, 3);
+
+  // the ring wraps past the undrained records
+  for (; v < 10 + SM_TRACE_RECORDS; v++)
+    __sm_trace_write(&trace_rings[2], SM_LOG_INFO, SM_TRACE_ENCLAVE_CREATE,
+                     &v, sizeof(v));
+  assert_int_equal(sm_trace_drain(2, (uintptr_t) out, SM_TRACE_RECORDS,
+                                  &drained),
+                   SBI_ERR_SM_ENCLAVE_SUCCESS);
+  assert_int_equal(drained, SM_TRACE_RECORDS);
+  assert_int_equal(out[0].seq, 10);
+  assert_int_equal(out[SM_TRACE_RECORDS - 1].seq, 10 + SM_TRACE_RECORDS - 1);
+
+  assert_int_equal(sm_trace_drain(MAX_HARTS, (uintptr_t) out,
+                                  SM_TRACE_RECORDS, &drained),
+                   SBI_ERR_SM_ENCLAVE_ILLEGAL_ARGUMENT);
+  assert_int_equal(drained, 0);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_trace_wraparound),
+    cmocka_unit_test(test_trace_truncation),
+    cmocka_unit_test(test_trace_drain_partial),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}